@@ -524,6 +524,9 @@ static void usage( const char *prog, const char *msg )
                               "                         (--addMissingColours also accepted)."<< std::endl;
     osg::notify(osg::NOTICE)<<"    --overallNormal    - Replace normals with a single overall normal."<< std::endl;
     osg::notify(osg::NOTICE)<<"    --enable-object-cache - Enable caching of objects, images, etc."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --optimizer-threads n - Run the per geometry optimizer passes on n threads,\n"
+                              "                         0 uses one thread per processor."<< std::endl;
+    osg::notify(osg::NOTICE)<<"    --optimizer-timings - Report the time taken by each optimizer pass."<< std::endl;
 
     osg::notify( osg::NOTICE ) << std::endl;
     osg::notify( osg::NOTICE ) <<
@@ -747,6 +750,12 @@ int main( int argc, char **argv )
     bool enableObjectCache = false;
     while(arguments.read("--enable-object-cache")) { enableObjectCache = true; }
 
+    int optimizerThreads = -1;
+    while(arguments.read("--optimizer-threads",optimizerThreads)) {}
+
+    bool optimizerTimings = false;
+    while(arguments.read("--optimizer-timings")) { optimizerTimings = true; }
+
     // any option left unread are converted into errors to write out later.
     arguments.reportRemainingOptionsAsUnrecognized();
 
@@ -818,6 +827,8 @@ int main( int argc, char **argv )
 
         // optimize the scene graph, remove rendundent nodes and state etc.
         osgUtil::Optimizer optimizer;
+        if (optimizerThreads>=0) optimizer.setNumThreads(optimizerThreads);
+        if (optimizerTimings) optimizer.setReportPassTimings(true);
         optimizer.optimize(root.get());
 
         if( do_convert )
@@ -0,0 +1,268 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "BufferPoolTests.h"
+
+#include <osg/BufferObject>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/Timer>
+
+#include <osgViewer/Viewer>
+
+#include <iostream>
+
+namespace
+{
+
+// A small grid placed at its slot in a square of tiles, the number of vertices varies with the variant so that tiles fall into several size classes.
+osg::Geode* createTile(unsigned int slot, unsigned int tilesAcross, unsigned int variant)
+{
+    unsigned int numColumns = 2 + (variant*7)%23;
+    float size = 1.0f/float(tilesAcross);
+    float x0 = float(slot%tilesAcross)*size - 0.5f;
+    float y0 = float(slot/tilesAcross)*size - 0.5f;
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array;
+    for(unsigned int r=0; r<numColumns; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            float u = float(c)/float(numColumns-1);
+            float v = float(r)/float(numColumns-1);
+            vertices->push_back(osg::Vec3(x0+u*size*0.9f, y0+v*size*0.9f, 0.0f));
+            colors->push_back(osg::Vec4(u, v, float(variant%5)*0.25f, 1.0f));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUShort> indices = new osg::DrawElementsUShort(GL_TRIANGLES);
+    for(unsigned int r=0; r+1<numColumns; ++r)
+    {
+        for(unsigned int c=0; c+1<numColumns; ++c)
+        {
+            unsigned int i = r*numColumns+c;
+            indices->push_back(i); indices->push_back(i+1); indices->push_back(i+numColumns);
+            indices->push_back(i+1); indices->push_back(i+numColumns+1); indices->push_back(i+numColumns);
+        }
+    }
+
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setUseDisplayList(false);
+    geometry->setUseVertexBufferObjects(true);
+    geometry->setVertexArray(vertices.get());
+    geometry->setColorArray(colors.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(indices.get());
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(geometry.get());
+    return geode;
+}
+
+struct CaptureCallback : public osg::Camera::DrawCallback
+{
+    CaptureCallback():
+        _capture(false) {}
+
+    virtual void operator () (osg::RenderInfo& renderInfo) const
+    {
+        if (_capture)
+        {
+            const osg::Viewport* viewport = renderInfo.getCurrentCamera()->getViewport();
+            _image = new osg::Image;
+            _image->readPixels(int(viewport->x()), int(viewport->y()), int(viewport->width()), int(viewport->height()), GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    }
+
+    bool                                _capture;
+    mutable osg::ref_ptr<osg::Image>    _image;
+};
+
+unsigned int countMismatchingPixels(const osg::Image* lhs, const osg::Image* rhs)
+{
+    if (!lhs || !rhs || lhs->s()!=rhs->s() || lhs->t()!=rhs->t()) return ~0u;
+
+    unsigned int numMismatches = 0;
+    for(int t=0; t<lhs->t(); ++t)
+    {
+        const unsigned char* lp = lhs->data(0,t);
+        const unsigned char* rp = rhs->data(0,t);
+        for(int s=0; s<lhs->s(); ++s, lp+=4, rp+=4)
+        {
+            for(int c=0; c<4; ++c)
+            {
+                if (osg::absolute(int(lp[c])-int(rp[c]))>1) { ++numMismatches; break; }
+            }
+        }
+    }
+    return numMismatches;
+}
+
+bool testSizeClasses()
+{
+    struct SizeClass { unsigned int size; unsigned int sizeClass; };
+    const SizeClass sizeClasses[] =
+    {
+        {0, 256}, {1, 256}, {256, 256}, {257, 512}, {4000, 4096}, {4096, 4096}, {100000, 131072}, {0x80000001u, 0x80000001u}
+    };
+
+    bool passed = true;
+    for(unsigned int i=0; i<sizeof(sizeClasses)/sizeof(SizeClass); ++i)
+    {
+        unsigned int sizeClass = osg::GLBufferObjectManager::computeSizeClass(sizeClasses[i].size);
+        if (sizeClass!=sizeClasses[i].sizeClass)
+        {
+            std::cout<<"Error: GLBufferObjectManager::computeSizeClass("<<sizeClasses[i].size<<") returned "<<sizeClass<<", expected "<<sizeClasses[i].sizeClass<<std::endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+}
+
+void runBufferPoolTests(unsigned int numTiles)
+{
+    if (!testSizeClasses())
+    {
+        std::cout<<"Error: buffer pool tests failed"<<std::endl;
+        return;
+    }
+
+    unsigned int width = 512;
+    unsigned int height = 512;
+    unsigned int numFrames = 100;
+    unsigned int numTilesReplacedPerFrame = osg::maximum(1u, numTiles/32);
+    unsigned int tilesAcross = static_cast<unsigned int>(ceilf(sqrtf(float(numTiles))));
+
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = width;
+    traits->height = height;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer.valid())
+    {
+        std::cout<<"Buffer pool tests skipped, unable to create a pbuffer."<<std::endl;
+        return;
+    }
+
+    osg::ref_ptr<CaptureCallback> capture = new CaptureCallback;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setDrawBuffer(GL_FRONT);
+    camera->setReadBuffer(GL_FRONT);
+    camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,1.0f));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsOrtho2D(-0.5, 0.5, -0.5, 0.5);
+    camera->setViewMatrix(osg::Matrixd::identity());
+    camera->setFinalDrawCallback(capture.get());
+
+    osg::ref_ptr<osg::Image> images[2];
+    for(unsigned int mode=0; mode<2; ++mode)
+    {
+        bool useSharedBuffers = (mode==1);
+
+        osg::ref_ptr<osg::Group> root = new osg::Group;
+        root->getOrCreateStateSet()->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+        for(unsigned int i=0; i<numTiles; ++i)
+        {
+            root->addChild(createTile(i, tilesAcross, i));
+        }
+
+        viewer.setSceneData(root.get());
+        if (!viewer.isRealized()) viewer.realize();
+
+        unsigned int contextID = pbuffer->getState()->getContextID();
+        osg::GLBufferObjectManager* bom = osg::GLBufferObjectManager::getGLBufferObjectManager(contextID).get();
+        bom->setSharedBufferSize(useSharedBuffers ? 1024*1024 : 0);
+        bom->setMaxGLBufferObjectPoolSize(64*1024*1024);
+
+        // first frame downloads all the tiles.
+        viewer.frame();
+
+        unsigned int numHits = bom->getNumberPoolHits();
+        unsigned int numMisses = bom->getNumberPoolMisses();
+
+        // page tiles in and out, the new tiles are given different variants so the buffers needed keep changing size.
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned int f=0; f<numFrames; ++f)
+        {
+            for(unsigned int i=0; i<numTilesReplacedPerFrame; ++i)
+            {
+                unsigned int slot = (f*numTilesReplacedPerFrame+i)%numTiles;
+                root->setChild(slot, createTile(slot, tilesAcross, slot+f*3+1));
+            }
+            viewer.frame();
+        }
+        osg::Timer_t end = osg::Timer::instance()->tick();
+
+        std::cout<<(useSharedBuffers ? "Sub-allocated " : "Separate buffers ")<<numTiles<<" tiles : "
+                 <<osg::Timer::instance()->delta_m(start, end)/double(numFrames)<<"ms per frame, "
+                 <<bom->getNumberPoolHits()-numHits<<" pool hits, "
+                 <<bom->getNumberPoolMisses()-numMisses<<" pool misses, "
+                 <<bom->computeNumBytesWasted()<<" bytes wasted"<<std::endl;
+
+        // drop three quarters of the tiles and shrink the pool so that the orphans are deleted, leaving sparse shared buffers to compact.
+        unsigned int numCompactionMoves = bom->getNumberCompactionMoves();
+        for(unsigned int slot=0; slot<numTiles; ++slot)
+        {
+            if (slot%4!=0) root->setChild(slot, new osg::Node);
+        }
+        bom->setMaxGLBufferObjectPoolSize(0);
+
+        for(unsigned int f=0; f<10; ++f)
+        {
+            viewer.frame();
+        }
+
+        if (useSharedBuffers)
+        {
+            std::cout<<"  after dropping tiles "<<bom->getNumberCompactionMoves()-numCompactionMoves<<" compaction moves, "
+                     <<bom->computeNumBytesWasted()<<" bytes wasted, "
+                     <<bom->getCurrGLBufferObjectPoolSize()<<" bytes in the pool"<<std::endl;
+        }
+
+        // the remaining tiles must still draw correctly after being moved between shared buffers.
+        capture->_capture = true;
+        viewer.frame();
+        capture->_capture = false;
+        images[mode] = capture->_image;
+
+        viewer.setSceneData(0);
+        viewer.frame();
+    }
+
+    unsigned int numMismatches = countMismatchingPixels(images[0].get(), images[1].get());
+    if (numMismatches>width*height/1000)
+    {
+        std::cout<<"Error: buffer pool tests failed, "<<numMismatches<<" pixels differ between separate and sub-allocated buffers"<<std::endl;
+    }
+}
@@ -0,0 +1,240 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "BufferStreamingTests.h"
+
+#include <osg/BufferObject>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/Timer>
+
+#include <osgViewer/Viewer>
+
+#include <iostream>
+
+namespace
+{
+
+// Move the vertices of a grid in a wave, by frame count rather than time so both runs draw the same final frame.
+struct WaveCallback : public osg::Drawable::UpdateCallback
+{
+    WaveCallback(): _frame(0) {}
+
+    virtual void update(osg::NodeVisitor*, osg::Drawable* drawable)
+    {
+        osg::Geometry* geometry = static_cast<osg::Geometry*>(drawable);
+        osg::Vec3Array* vertices = static_cast<osg::Vec3Array*>(geometry->getVertexArray());
+
+        float phase = float(_frame++)*0.1f;
+        for(osg::Vec3Array::iterator itr = vertices->begin(); itr != vertices->end(); ++itr)
+        {
+            itr->z() = 0.2f*sinf(itr->x()*6.0f+phase)*cosf(itr->y()*4.0f+phase);
+        }
+        vertices->dirty();
+    }
+
+    unsigned int _frame;
+};
+
+osg::Geometry* createWaveGrid(unsigned int numVertices, bool usePersistentMapping)
+{
+    unsigned int numColumns = osg::maximum(2u, static_cast<unsigned int>(sqrtf(float(numVertices))));
+
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec4Array> colors = new osg::Vec4Array;
+    for(unsigned int r=0; r<numColumns; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            float x = float(c)/float(numColumns-1)-0.5f;
+            float y = float(r)/float(numColumns-1)-0.5f;
+            vertices->push_back(osg::Vec3(x, y, 0.0f));
+            colors->push_back(osg::Vec4(x+0.5f, y+0.5f, 0.5f, 1.0f));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for(unsigned int r=0; r+1<numColumns; ++r)
+    {
+        for(unsigned int c=0; c+1<numColumns; ++c)
+        {
+            unsigned int i = r*numColumns+c;
+            indices->push_back(i); indices->push_back(i+1); indices->push_back(i+numColumns);
+            indices->push_back(i+1); indices->push_back(i+numColumns+1); indices->push_back(i+numColumns);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setUseDisplayList(false);
+    geometry->setUseVertexBufferObjects(true);
+    geometry->setDataVariance(osg::Object::DYNAMIC);
+    geometry->setVertexArray(vertices.get());
+    geometry->setColorArray(colors.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(indices.get());
+    geometry->setUpdateCallback(new WaveCallback);
+
+    vertices->getVertexBufferObject()->setUsage(GL_STREAM_DRAW_ARB);
+    vertices->getVertexBufferObject()->setUsePersistentMapping(usePersistentMapping);
+
+    return geometry;
+}
+
+struct CaptureCallback : public osg::Camera::DrawCallback
+{
+    CaptureCallback():
+        _capture(false) {}
+
+    virtual void operator () (osg::RenderInfo& renderInfo) const
+    {
+        if (_capture)
+        {
+            const osg::Viewport* viewport = renderInfo.getCurrentCamera()->getViewport();
+            _image = new osg::Image;
+            _image->readPixels(int(viewport->x()), int(viewport->y()), int(viewport->width()), int(viewport->height()), GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    }
+
+    bool                                _capture;
+    mutable osg::ref_ptr<osg::Image>    _image;
+};
+
+unsigned int countMismatchingPixels(const osg::Image* lhs, const osg::Image* rhs)
+{
+    if (!lhs || !rhs || lhs->s()!=rhs->s() || lhs->t()!=rhs->t()) return ~0u;
+
+    unsigned int numMismatches = 0;
+    for(int t=0; t<lhs->t(); ++t)
+    {
+        const unsigned char* lp = lhs->data(0,t);
+        const unsigned char* rp = rhs->data(0,t);
+        for(int s=0; s<lhs->s(); ++s, lp+=4, rp+=4)
+        {
+            for(int c=0; c<4; ++c)
+            {
+                if (osg::absolute(int(lp[c])-int(rp[c]))>1) { ++numMismatches; break; }
+            }
+        }
+    }
+    return numMismatches;
+}
+
+}
+
+void runBufferStreamingTests(unsigned int numVertices)
+{
+    unsigned int width = 512;
+    unsigned int height = 512;
+    unsigned int numFrames = 200;
+
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = width;
+    traits->height = height;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer.valid())
+    {
+        std::cout<<"Buffer streaming tests skipped, unable to create a pbuffer."<<std::endl;
+        return;
+    }
+
+    osg::ref_ptr<CaptureCallback> capture = new CaptureCallback;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setDrawBuffer(GL_FRONT);
+    camera->setReadBuffer(GL_FRONT);
+    camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,1.0f));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsPerspective(30.0, double(width)/double(height), 0.1, 100.0);
+    camera->setViewMatrixAsLookAt(osg::Vec3d(0.0, -1.5, 1.5), osg::Vec3d(0.0,0.0,0.0), osg::Vec3d(0.0,0.0,1.0));
+    camera->setFinalDrawCallback(capture.get());
+
+    osg::ref_ptr<osg::Image> images[2];
+    for(unsigned int mode=0; mode<2; ++mode)
+    {
+        bool usePersistentMapping = (mode==1);
+
+        osg::ref_ptr<osg::Geometry> geometry = createWaveGrid(numVertices, usePersistentMapping);
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(geometry.get());
+        geode->getOrCreateStateSet()->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+
+        viewer.setSceneData(geode.get());
+        if (!viewer.isRealized()) viewer.realize();
+
+        unsigned int contextID = pbuffer->getState()->getContextID();
+        osg::GLBufferObjectManager* bom = osg::GLBufferObjectManager::getGLBufferObjectManager(contextID).get();
+
+        // first frame uploads the geometry.
+        viewer.frame();
+
+        unsigned int numUpdates = bom->getNumberStreamingUpdates();
+        unsigned int numStalls = bom->getNumberStreamingStalls();
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        for(unsigned int i=0; i<numFrames; ++i)
+        {
+            viewer.frame();
+        }
+        osg::Timer_t end = osg::Timer::instance()->tick();
+
+        capture->_capture = true;
+        viewer.frame();
+        capture->_capture = false;
+        images[mode] = capture->_image;
+
+        osg::GLBufferObject* glBufferObject = geometry->getVertexArray()->getVertexBufferObject()->getGLBufferObject(contextID);
+        bool persistentlyMapped = glBufferObject && glBufferObject->isPersistentlyMapped();
+
+        std::cout<<(usePersistentMapping ? "Persistent mapping " : "glBufferSubData ")<<geometry->getVertexArray()->getNumElements()<<" vertices : "
+                 <<osg::Timer::instance()->delta_m(start, end)/double(numFrames)<<"ms per frame";
+        if (usePersistentMapping)
+        {
+            if (persistentlyMapped)
+            {
+                std::cout<<", "<<bom->getNumberStreamingUpdates()-numUpdates<<" streaming updates, "
+                         <<bom->getNumberStreamingStalls()-numStalls<<" stalls";
+            }
+            else
+            {
+                std::cout<<", GL_ARB_buffer_storage not supported, fell back to glBufferSubData";
+            }
+        }
+        std::cout<<std::endl;
+
+        viewer.setSceneData(0);
+    }
+
+    unsigned int numMismatches = countMismatchingPixels(images[0].get(), images[1].get());
+    if (numMismatches>width*height/1000)
+    {
+        std::cout<<"Error: buffer streaming tests failed, "<<numMismatches<<" pixels differ between glBufferSubData and persistent mapping"<<std::endl;
+    }
+}
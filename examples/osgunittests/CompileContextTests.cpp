@@ -0,0 +1,287 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "CompileContextTests.h"
+
+#include <osg/GLObjects>
+#include <osg/DisplaySettings>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/Texture2D>
+#include <osg/Timer>
+
+#include <osgUtil/IncrementalCompileOperation>
+
+#include <osgViewer/Viewer>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+
+const unsigned int s_textureSize = 256;
+
+osg::Node* createSubgraph(unsigned int i, unsigned int numSubgraphs)
+{
+    unsigned int across = static_cast<unsigned int>(ceilf(sqrtf(float(numSubgraphs))));
+    float size = 1.0f/float(across);
+    float x = float(i%across)*size - 0.5f;
+    float y = float(i/across)*size - 0.5f;
+
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(s_textureSize, s_textureSize, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    for(unsigned int t=0; t<s_textureSize; ++t)
+    {
+        for(unsigned int s=0; s<s_textureSize; ++s)
+        {
+            unsigned char* pixel = image->data(s, t);
+            pixel[0] = static_cast<unsigned char>(i*37 + s);
+            pixel[1] = static_cast<unsigned char>(i*91 + t);
+            pixel[2] = static_cast<unsigned char>(i*13 + (s^t));
+            pixel[3] = 255;
+        }
+    }
+
+    osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D(image.get());
+    texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+
+    osg::ref_ptr<osg::Geometry> geometry = osg::createTexturedQuadGeometry(osg::Vec3(x, y, 0.0f), osg::Vec3(size*0.9f, 0.0f, 0.0f), osg::Vec3(0.0f, size*0.9f, 0.0f));
+    geometry->setUseDisplayList(false);
+    geometry->setUseVertexBufferObjects(true);
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(geometry.get());
+    geode->getOrCreateStateSet()->setTextureAttributeAndModes(0, texture.get());
+    return geode;
+}
+
+struct CaptureCallback : public osg::Camera::DrawCallback
+{
+    CaptureCallback():
+        _capture(false) {}
+
+    virtual void operator () (osg::RenderInfo& renderInfo) const
+    {
+        if (_capture)
+        {
+            const osg::Viewport* viewport = renderInfo.getCurrentCamera()->getViewport();
+            _image = new osg::Image;
+            _image->readPixels(int(viewport->x()), int(viewport->y()), int(viewport->width()), int(viewport->height()), GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    }
+
+    bool                                _capture;
+    mutable osg::ref_ptr<osg::Image>    _image;
+};
+
+// tries to lock the mutex from a thread other than the one holding it.
+struct TryLockThread : public OpenThreads::Thread
+{
+    TryLockThread(OpenThreads::Mutex& mutex):
+        _mutex(mutex),
+        _locked(false) {}
+
+    virtual void run()
+    {
+        _locked = _mutex.trylock()==0;
+        if (_locked) _mutex.unlock();
+    }
+
+    OpenThreads::Mutex& _mutex;
+    bool                _locked;
+};
+
+bool isLockedByAnotherThread(OpenThreads::Mutex& mutex)
+{
+    TryLockThread thread(mutex);
+    thread.start();
+    thread.join();
+    return !thread._locked;
+}
+
+bool testGLObjectsMutex()
+{
+    osg::GLObjectsMutex* glObjectsMutex = osg::GLObjectsMutex::getGLObjectsMutex(0);
+    if (glObjectsMutex!=osg::GLObjectsMutex::getGLObjectsMutex(0) || glObjectsMutex==osg::GLObjectsMutex::getGLObjectsMutex(1))
+    {
+        std::cout<<"Error: GL objects mutexes not one per context"<<std::endl;
+        return false;
+    }
+
+    if (glObjectsMutex->hasCompileContext())
+    {
+        std::cout<<"Error: GL objects mutex has a compile context by default"<<std::endl;
+        return false;
+    }
+
+    // without a compile context the GL object managers aren't locked.
+    {
+        osg::ScopedGLObjectsLock lock(glObjectsMutex);
+        if (isLockedByAnotherThread(glObjectsMutex->getMutex()))
+        {
+            std::cout<<"Error: GL objects mutex locked without a compile context"<<std::endl;
+            return false;
+        }
+    }
+
+    bool passed = true;
+    glObjectsMutex->addCompileContext();
+    {
+        osg::ScopedGLObjectsLock lock(glObjectsMutex);
+        osg::ScopedGLObjectsLock nestedLock(glObjectsMutex);
+        if (!isLockedByAnotherThread(glObjectsMutex->getMutex()))
+        {
+            std::cout<<"Error: GL objects mutex not locked with a compile context"<<std::endl;
+            passed = false;
+        }
+    }
+    if (passed && isLockedByAnotherThread(glObjectsMutex->getMutex()))
+    {
+        std::cout<<"Error: GL objects mutex still locked after the nested locks"<<std::endl;
+        passed = false;
+    }
+    glObjectsMutex->removeCompileContext();
+
+    return passed;
+}
+
+}
+
+void runCompileContextTests(unsigned int numSubgraphs)
+{
+    if (!testGLObjectsMutex())
+    {
+        std::cout<<"Error: compile context tests failed"<<std::endl;
+        return;
+    }
+
+    unsigned int width = 256;
+    unsigned int height = 256;
+
+    bool compileContextsHint = osg::DisplaySettings::instance()->getCompileContextsHint();
+
+    // the first run compiles the subgraphs in the draw thread within each frame's budget, the second
+    // on the compile context of the pbuffer, so the draw thread only merges them.
+    const char* runNames[2] = { "Draw thread", "Compile context" };
+    osg::ref_ptr<osg::Image> images[2];
+    for(unsigned int run=0; run<2; ++run)
+    {
+        osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+        traits->width = width;
+        traits->height = height;
+        traits->red = 8;
+        traits->green = 8;
+        traits->blue = 8;
+        traits->alpha = 8;
+        traits->depth = 24;
+        traits->doubleBuffer = false;
+        traits->pbuffer = true;
+
+        osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+        if (!pbuffer.valid())
+        {
+            std::cout<<"Compile context tests skipped, unable to create a pbuffer."<<std::endl;
+            break;
+        }
+
+        osg::DisplaySettings::instance()->setCompileContextsHint(run==1);
+
+        osg::ref_ptr<osgUtil::IncrementalCompileOperation> ico = new osgUtil::IncrementalCompileOperation;
+        osg::ref_ptr<CaptureCallback> capture = new CaptureCallback;
+
+        osgViewer::Viewer viewer;
+        viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+        viewer.setIncrementalCompileOperation(ico.get());
+
+        osg::Camera* camera = viewer.getCamera();
+        camera->setGraphicsContext(pbuffer.get());
+        camera->setViewport(new osg::Viewport(0,0,width,height));
+        camera->setDrawBuffer(GL_FRONT);
+        camera->setReadBuffer(GL_FRONT);
+        camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,1.0f));
+        camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+        camera->setProjectionMatrixAsOrtho2D(-0.5, 0.5, -0.5, 0.5);
+        camera->setViewMatrix(osg::Matrixd::identity());
+        camera->setFinalDrawCallback(capture.get());
+
+        osg::ref_ptr<osg::Group> root = new osg::Group;
+        viewer.setSceneData(root.get());
+        viewer.realize();
+
+        osg::DisplaySettings::instance()->setCompileContextsHint(compileContextsHint);
+
+        if (run==1 && ico->getContextSet().count(pbuffer.get())!=0)
+        {
+            std::cout<<"Compile context tests skipped, unable to create a compile context."<<std::endl;
+            break;
+        }
+
+        for(unsigned int i=0; i<numSubgraphs; ++i)
+        {
+            ico->add(root.get(), createSubgraph(i, numSubgraphs));
+        }
+
+        // page in the subgraphs, timing each frame until they have all been merged.
+        double totalTime = 0.0;
+        double totalTimeSquared = 0.0;
+        double maxTime = 0.0;
+        unsigned int numFrames = 0;
+        while(root->getNumChildren()<numSubgraphs && numFrames<numSubgraphs*100)
+        {
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            viewer.frame();
+            double time = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+            totalTime += time;
+            totalTimeSquared += time*time;
+            if (time>maxTime) maxTime = time;
+            ++numFrames;
+        }
+
+        double meanTime = numFrames>0 ? totalTime/double(numFrames) : 0.0;
+        double variance = numFrames>0 ? totalTimeSquared/double(numFrames) - meanTime*meanTime : 0.0;
+
+        std::cout<<runNames[run]<<" compile of "<<numSubgraphs<<" subgraphs : "<<numFrames<<" frames, mean frame "<<meanTime<<"ms, max frame "
+                 <<maxTime<<"ms, standard deviation "<<sqrt(std::max(variance, 0.0))<<"ms"<<std::endl;
+
+        if (root->getNumChildren()!=numSubgraphs)
+        {
+            std::cout<<"Error: compile context tests failed, "<<root->getNumChildren()<<" of "<<numSubgraphs<<" subgraphs merged"<<std::endl;
+            break;
+        }
+
+        capture->_capture = true;
+        viewer.frame();
+        capture->_capture = false;
+        images[run] = capture->_image;
+    }
+
+    if (images[0].valid() && images[1].valid() &&
+        (images[0]->s()!=images[1]->s() || images[0]->t()!=images[1]->t() ||
+         memcmp(images[0]->data(), images[1]->data(), images[0]->getTotalSizeInBytes())!=0))
+    {
+        std::cout<<"Error: compile context tests failed, subgraphs compiled on the compile context render differently"<<std::endl;
+    }
+
+    osg::DisplaySettings::instance()->setCompileContextsHint(compileContextsHint);
+}
@@ -0,0 +1,324 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "DatabasePagerTests.h"
+
+#include <osg/Group>
+#include <osg/FrameStamp>
+#include <osg/Timer>
+
+#include <osgDB/DatabasePager>
+#include <osgDB/Callbacks>
+#include <osgDB/Options>
+
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <iostream>
+#include <list>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+/** Stands in for a slow http server, taking a fixed time to "read" each request.*/
+class SlowReadFileCallback : public osgDB::ReadFileCallback
+{
+    public:
+
+        SlowReadFileCallback(unsigned int readTime):
+            _readTime(readTime) {}
+
+        virtual osgDB::ReaderWriter::ReadResult readNode(const std::string&, const osgDB::Options*)
+        {
+            OpenThreads::Thread::microSleep(_readTime);
+            ++_numReads;
+            return new osg::Group;
+        }
+
+        unsigned int getNumReads() const { return _numReads; }
+
+    protected:
+
+        unsigned int        _readTime;
+        OpenThreads::Atomic _numReads;
+};
+
+struct WorkStealingResult
+{
+    WorkStealingResult():
+        numRead(0),
+        numStolen(0),
+        time(0.0) {}
+
+    unsigned int    numRead;
+    unsigned int    numStolen;
+    double          time;
+};
+
+/** Queue numRequests http requests on a pager with one local file thread and one http thread, and wait for them to be read.*/
+WorkStealingResult readHttpRequests(unsigned int numRequests, bool enableWorkStealing)
+{
+    const unsigned int readTime = 20000;
+
+    osg::ref_ptr<SlowReadFileCallback> readFileCallback = new SlowReadFileCallback(readTime);
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options;
+    options->setReadFileCallback(readFileCallback.get());
+
+    osg::ref_ptr<osgDB::DatabasePager> pager = new osgDB::DatabasePager;
+    pager->setUpThreads(2, 1);
+    pager->setEnableWorkStealing(enableWorkStealing);
+
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp;
+    frameStamp->setFrameNumber(1);
+    pager->signalBeginFrame(frameStamp.get());
+
+    osg::ref_ptr<osg::Group> group = new osg::Group;
+    osg::NodePath nodePath;
+    nodePath.push_back(group.get());
+
+    std::vector< osg::ref_ptr<osg::Referenced> > databaseRequests(numRequests);
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int i=0; i<numRequests; ++i)
+    {
+        std::ostringstream fileName;
+        fileName<<"http://localhost/tile"<<i<<".osgt";
+        pager->requestNodeFile(fileName.str(), nodePath, float(i), frameStamp.get(), databaseRequests[i], options.get());
+    }
+
+    // allow ten times the time a single http thread needs, in case the machine is heavily loaded.
+    double timeout = double(numRequests)*double(readTime)*10.0e-6;
+    while(readFileCallback->getNumReads()<numRequests && osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick())<timeout)
+    {
+        OpenThreads::Thread::microSleep(1000);
+    }
+
+    WorkStealingResult result;
+    result.time = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    result.numRead = readFileCallback->getNumReads();
+    result.numStolen = pager->getNumRequestsStolen();
+
+    pager->cancel();
+    return result;
+}
+
+/** Gives the tests access to the DatabasePager's request queues.*/
+class RequestQueuePager : public osgDB::DatabasePager
+{
+    public:
+
+        typedef DatabasePager::DatabaseRequest Request;
+        typedef DatabasePager::RequestQueue Queue;
+
+        void setFrameNumber(unsigned int frameNumber) { _frameNumber.exchange(frameNumber); }
+        unsigned int getFrameNumber() const { return _frameNumber; }
+
+        Queue* createRequestQueue() { return new Queue(this); }
+};
+
+typedef RequestQueuePager::Request Request;
+typedef std::vector< osg::ref_ptr<Request> > Requests;
+typedef std::list< osg::ref_ptr<Request> > RequestList;
+
+// the comparator the RequestQueue used to pick the next request before it held its requests in a heap.
+struct SortFileRequestFunctor
+{
+    bool operator() (const osg::ref_ptr<Request>& lhs,const osg::ref_ptr<Request>& rhs) const
+    {
+        if (lhs->_timestampLastRequest>rhs->_timestampLastRequest) return true;
+        else if (lhs->_timestampLastRequest<rhs->_timestampLastRequest) return false;
+        else return (lhs->_priorityLastRequest>rhs->_priorityLastRequest);
+    }
+};
+
+/** Take the next request as the sort-based RequestQueue did, scanning the list for the highest priority current request
+  * and dropping those that are no longer current.*/
+osg::ref_ptr<Request> takeFirstFromList(RequestList& requestList, unsigned int frameNumber)
+{
+    SortFileRequestFunctor highPriority;
+    RequestList::iterator selected_itr = requestList.end();
+    for(RequestList::iterator citr = requestList.begin();
+        citr != requestList.end();)
+    {
+        if ((*citr)->isRequestCurrent(frameNumber))
+        {
+            if (selected_itr==requestList.end() || highPriority(*citr, *selected_itr)) selected_itr = citr;
+            ++citr;
+        }
+        else
+        {
+            citr = requestList.erase(citr);
+        }
+    }
+
+    osg::ref_ptr<Request> request;
+    if (selected_itr!=requestList.end())
+    {
+        request = *selected_itr;
+        requestList.erase(selected_itr);
+    }
+    return request;
+}
+
+void setRequest(Request* request, unsigned int frameNumber, float priority)
+{
+    request->_frameNumberLastRequest = frameNumber;
+    request->_timestampLastRequest = double(frameNumber)/60.0;
+    request->_priorityLastRequest = priority;
+}
+
+}
+
+void runRequestQueueTests(unsigned int numRequests)
+{
+    std::cout<<"DatabasePager RequestQueue ordering of "<<numRequests<<" requests"<<std::endl;
+
+    osg::ref_ptr<RequestQueuePager> pager = new RequestQueuePager;
+    const unsigned int frameNumber = 100;
+    pager->setFrameNumber(frameNumber);
+
+    osg::ref_ptr<RequestQueuePager::Queue> queue = pager->createRequestQueue();
+
+    // unique priorities, so the order doesn't depend on how ties are broken, spread over the current frame,
+    // the previous frame and a frame old enough for the request to be dropped.
+    std::vector<float> priorities;
+    for(unsigned int i=0; i<numRequests*2; ++i) priorities.push_back(float(i));
+    unsigned int seed = 4321;
+    for(unsigned int i=priorities.size(); i>1; --i)
+    {
+        seed = seed*1664525u + 1013904223u;
+        std::swap(priorities[i-1], priorities[(seed>>8)%i]);
+    }
+
+    Requests requests;
+    for(unsigned int i=0; i<numRequests; ++i)
+    {
+        osg::ref_ptr<Request> request = new Request;
+        request->_valid = true;
+        seed = seed*1664525u + 1013904223u;
+        setRequest(request.get(), frameNumber-(seed>>8)%3, priorities[i]);
+        requests.push_back(request);
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(Requests::iterator itr = requests.begin(); itr != requests.end(); ++itr)
+    {
+        queue->add(itr->get());
+    }
+
+    // re-prioritise some of the queued requests, both through updatePriority() and by adding them again as requestNodeFile() does,
+    // and remove others.
+    unsigned int numUpdated = 0;
+    unsigned int numRemoved = 0;
+    std::vector<bool> removed(numRequests, false);
+    for(unsigned int i=0; i<numRequests; ++i)
+    {
+        Request* request = requests[i].get();
+        if (i%7==3)
+        {
+            queue->remove(request);
+            removed[i] = true;
+            ++numRemoved;
+        }
+        else if (i%5==1)
+        {
+            setRequest(request, frameNumber-i%2, priorities[numRequests+i]);
+            if (i%2) queue->updatePriority(request);
+            else queue->add(request);
+            ++numUpdated;
+        }
+    }
+
+    bool passed = queue->size()==numRequests-numRemoved;
+
+    Requests taken;
+    for(;;)
+    {
+        osg::ref_ptr<Request> request;
+        queue->takeFirst(request);
+        if (!request) break;
+        taken.push_back(request);
+    }
+    double heapTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    // the same adds, updates and removals through the old sort-based list.
+    start = osg::Timer::instance()->tick();
+    RequestList requestList;
+    for(unsigned int i=0; i<numRequests; ++i)
+    {
+        if (!removed[i]) requestList.push_back(requests[i]);
+    }
+
+    Requests expected;
+    for(;;)
+    {
+        osg::ref_ptr<Request> request = takeFirstFromList(requestList, frameNumber);
+        if (!request) break;
+        expected.push_back(request);
+    }
+    double listTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    bool sameOrder = taken.size()==expected.size() && std::equal(taken.begin(), taken.end(), expected.begin());
+    if (!sameOrder) passed = false;
+
+    // requests that were dropped for being out of date are invalidated, removed ones are left untouched.
+    unsigned int numDropped = 0;
+    for(unsigned int i=0; i<numRequests; ++i)
+    {
+        Request* request = requests[i].get();
+        bool current = request->_frameNumberLastRequest+1>=frameNumber;
+        if (request->_requestQueue!=0) passed = false;
+        if (removed[i] && !request->valid()) passed = false;
+        if (!removed[i] && !current)
+        {
+            ++numDropped;
+            if (request->valid()) passed = false;
+        }
+    }
+
+    if (queue->size()!=0) passed = false;
+
+    std::cout<<"  taken "<<taken.size()<<"\tupdated "<<numUpdated<<"\tremoved "<<numRemoved<<"\tdropped as out of date "<<numDropped
+             <<"\theap "<<heapTime*1000.0<<"ms\tsort-based list "<<listTime*1000.0<<"ms"
+             <<(sameOrder ? "\tsame order as the sort-based list" : "\tFAILED, order differs from the sort-based list")<<std::endl;
+
+    if (!passed) std::cout<<"Error: DatabasePager RequestQueue tests failed"<<std::endl;
+}
+
+void runWorkStealingTests(unsigned int numRequests)
+{
+    std::cout<<"DatabasePager work stealing of "<<numRequests<<" http requests with one local file and one http thread"<<std::endl;
+
+    bool passed = true;
+    for(unsigned int enable=0; enable<2; ++enable)
+    {
+        WorkStealingResult result = readHttpRequests(numRequests, enable!=0);
+
+        // when enabled the idle local file thread must take some of the http thread's requests, and none when disabled.
+        bool correct = result.numRead==numRequests && (enable ? result.numStolen>0 : result.numStolen==0);
+        if (!correct) passed = false;
+
+        std::cout<<"  work stealing "<<(enable ? "on " : "off")<<"\tread "<<result.numRead<<"\ttaken by the local file thread "<<result.numStolen
+                 <<"\ttime "<<result.time*1000.0<<"ms"<<(correct ? "" : "\tFAILED")<<std::endl;
+    }
+
+    if (!passed) std::cout<<"Error: DatabasePager work stealing tests failed"<<std::endl;
+}
@@ -0,0 +1,254 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "GLMemoryBudgetTests.h"
+
+#include <osg/GLMemoryBudget>
+#include <osg/DisplaySettings>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/Texture2D>
+
+#include <osgViewer/Viewer>
+
+#include <iostream>
+#include <string.h>
+
+namespace
+{
+
+const unsigned int s_textureSize = 64;
+
+osg::Image* createImage(unsigned int variant)
+{
+    osg::Image* image = new osg::Image;
+    image->allocateImage(s_textureSize, s_textureSize, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    for(unsigned int t=0; t<s_textureSize; ++t)
+    {
+        for(unsigned int s=0; s<s_textureSize; ++s)
+        {
+            unsigned char* pixel = image->data(s, t);
+            pixel[0] = static_cast<unsigned char>(variant*37 + s*4);
+            pixel[1] = static_cast<unsigned char>(variant*91 + t*4);
+            pixel[2] = static_cast<unsigned char>(variant*13 + (s^t)*4);
+            pixel[3] = 255;
+        }
+    }
+    return image;
+}
+
+osg::Group* createScene(unsigned int numTextures)
+{
+    unsigned int across = static_cast<unsigned int>(ceilf(sqrtf(float(numTextures))));
+    float size = 1.0f/float(across);
+
+    osg::Group* root = new osg::Group;
+    for(unsigned int i=0; i<numTextures; ++i)
+    {
+        float x = float(i%across)*size - 0.5f;
+        float y = float(i/across)*size - 0.5f;
+        osg::ref_ptr<osg::Geometry> geometry = osg::createTexturedQuadGeometry(osg::Vec3(x, y, 0.0f), osg::Vec3(size*0.9f, 0.0f, 0.0f), osg::Vec3(0.0f, size*0.9f, 0.0f));
+
+        // no mipmaps so each texture object is the size of its image.
+        osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D(createImage(i));
+        texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST);
+        texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(geometry.get());
+        geode->getOrCreateStateSet()->setTextureAttributeAndModes(0, texture.get());
+        root->addChild(geode.get());
+    }
+    return root;
+}
+
+void setNumVisible(osg::Group* root, unsigned int numVisible)
+{
+    for(unsigned int i=0; i<root->getNumChildren(); ++i)
+    {
+        root->getChild(i)->setNodeMask(i<numVisible ? 0xffffffff : 0x0);
+    }
+}
+
+struct CaptureCallback : public osg::Camera::DrawCallback
+{
+    CaptureCallback():
+        _capture(false) {}
+
+    virtual void operator () (osg::RenderInfo& renderInfo) const
+    {
+        if (_capture)
+        {
+            const osg::Viewport* viewport = renderInfo.getCurrentCamera()->getViewport();
+            _image = new osg::Image;
+            _image->readPixels(int(viewport->x()), int(viewport->y()), int(viewport->width()), int(viewport->height()), GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    }
+
+    bool                                _capture;
+    mutable osg::ref_ptr<osg::Image>    _image;
+};
+
+bool testSettings()
+{
+    bool passed = true;
+
+    osg::ref_ptr<osg::DisplaySettings> ds = new osg::DisplaySettings;
+    if (ds->getMaxGLMemorySize()!=0)
+    {
+        std::cout<<"Error: GL memory budget enabled by default"<<std::endl;
+        passed = false;
+    }
+
+    osg::ref_ptr<osg::State> state = new osg::State;
+    state->setContextID(osg::GraphicsContext::createNewContextID());
+
+    osg::GLMemoryBudget* budget = osg::GLMemoryBudget::getGLMemoryBudget(state->getContextID()).get();
+    state->setMaxGLMemorySize(1024*1024);
+    if (!budget->isEnabled() || budget->getMaxSize()!=1024*1024)
+    {
+        std::cout<<"Error: State::setMaxGLMemorySize() not passed on to the GLMemoryBudget"<<std::endl;
+        passed = false;
+    }
+
+    state->setMaxGLMemorySize(0);
+    if (budget->isEnabled())
+    {
+        std::cout<<"Error: GL memory budget not disabled by a size of 0"<<std::endl;
+        passed = false;
+    }
+
+    osg::GraphicsContext::decrementContextIDUsageCount(state->getContextID());
+    return passed;
+}
+
+}
+
+void runGLMemoryBudgetTests(unsigned int numTextures)
+{
+    if (!testSettings())
+    {
+        std::cout<<"Error: GL memory budget tests failed"<<std::endl;
+        return;
+    }
+
+    unsigned int width = 256;
+    unsigned int height = 256;
+
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = width;
+    traits->height = height;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer.valid())
+    {
+        std::cout<<"GL memory budget tests skipped, unable to create a pbuffer."<<std::endl;
+        return;
+    }
+
+    osg::ref_ptr<CaptureCallback> capture = new CaptureCallback;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setDrawBuffer(GL_FRONT);
+    camera->setReadBuffer(GL_FRONT);
+    camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,1.0f));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsOrtho2D(-0.5, 0.5, -0.5, 0.5);
+    camera->setViewMatrix(osg::Matrixd::identity());
+    camera->setFinalDrawCallback(capture.get());
+
+    osg::ref_ptr<osg::Group> scene = createScene(numTextures);
+    viewer.setSceneData(scene.get());
+    viewer.realize();
+
+    // room for half the textures, a quarter are kept in view while the rest are evicted.
+    unsigned int textureSize = s_textureSize*s_textureSize*4;
+    unsigned int maxSize = (numTextures/2)*textureSize;
+    unsigned int numVisible = numTextures/4;
+
+    osg::State* state = pbuffer->getState();
+    state->setMaxGLMemorySize(maxSize);
+    osg::GLMemoryBudget* budget = osg::GLMemoryBudget::getGLMemoryBudget(state->getContextID()).get();
+
+    capture->_capture = true;
+    viewer.frame();
+    capture->_capture = false;
+    osg::ref_ptr<osg::Image> before = capture->_image;
+
+    setNumVisible(scene.get(), numVisible);
+
+    unsigned int numBytesEvicted = 0;
+    unsigned int numObjectsEvicted = 0;
+    for(unsigned int i=0; i<4; ++i)
+    {
+        viewer.frame();
+        numBytesEvicted += budget->getNumBytesEvicted();
+        numObjectsEvicted += budget->getNumObjectsEvicted();
+    }
+    unsigned int numBytesResident = budget->getNumBytesResident();
+
+    // eviction alone brings the context back within its budget, so the DatabasePager isn't asked to expire anything.
+    bool overBudgetAfterEviction = osg::GLMemoryBudget::isAnyOverBudget() || osg::GLMemoryBudget::computeMaxFractionOverBudget()>0.0;
+
+    setNumVisible(scene.get(), numTextures);
+
+    capture->_capture = true;
+    viewer.frame();
+    capture->_capture = false;
+    osg::ref_ptr<osg::Image> after = capture->_image;
+
+    std::cout<<"GL memory budget of "<<maxSize/1024<<"KB with "<<numTextures<<" textures of "<<textureSize/1024<<"KB : "
+             <<numObjectsEvicted<<" evicted, "<<numBytesEvicted/1024<<"KB evicted, "<<numBytesResident/1024<<"KB resident"<<std::endl;
+
+    if (numTextures<4)
+    {
+        // too few textures to leave any out of view.
+    }
+    else if (numObjectsEvicted==0 || numBytesEvicted==0)
+    {
+        std::cout<<"Error: GL memory budget tests failed, no textures evicted"<<std::endl;
+    }
+    else if (numBytesResident>maxSize)
+    {
+        std::cout<<"Error: GL memory budget tests failed, "<<numBytesResident<<" bytes resident exceeds the budget of "<<maxSize<<std::endl;
+    }
+    else if (overBudgetAfterEviction)
+    {
+        std::cout<<"Error: GL memory budget tests failed, still reported over budget once eviction brought it within"<<std::endl;
+    }
+    else if (!before.valid() || !after.valid() || before->s()!=after->s() || before->t()!=after->t() ||
+             memcmp(before->data(), after->data(), before->getTotalSizeInBytes())!=0)
+    {
+        std::cout<<"Error: GL memory budget tests failed, evicted textures render differently once back in view"<<std::endl;
+    }
+
+    state->setMaxGLMemorySize(0);
+}
@@ -0,0 +1,309 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ImageKernelsTests.h"
+
+#include <osg/Image>
+#include <osg/ImageUtils>
+#include <osg/Timer>
+#include <osg/ref_ptr>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+
+struct ImageDescription
+{
+    const char* name;
+    GLenum      pixelFormat;
+    GLenum      dataType;
+};
+
+const ImageDescription s_imageDescriptions[] =
+{
+    { "RGB8",   GL_RGB,         GL_UNSIGNED_BYTE },
+    { "RGBA8",  GL_RGBA,        GL_UNSIGNED_BYTE },
+    { "R16",    GL_LUMINANCE,   GL_UNSIGNED_SHORT },
+    { "R32F",   GL_LUMINANCE,   GL_FLOAT }
+};
+
+const unsigned int s_numImageDescriptions = sizeof(s_imageDescriptions)/sizeof(ImageDescription);
+
+// Fill an image from a linear congruential generator so every run, and every instruction set, sees the same data.
+osg::Image* createImage(const ImageDescription& description, int s, int t)
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(s, t, 1, description.pixelFormat, description.dataType);
+
+    unsigned int seed = 12345;
+    unsigned int numElements = s*t*osg::Image::computeNumComponents(description.pixelFormat);
+    for(unsigned int i=0; i<numElements; ++i)
+    {
+        seed = seed*1664525u + 1013904223u;
+        unsigned int value = seed>>8;
+        switch(description.dataType)
+        {
+            case(GL_UNSIGNED_BYTE):     image->data()[i] = static_cast<unsigned char>(value); break;
+            case(GL_UNSIGNED_SHORT):    reinterpret_cast<unsigned short*>(image->data())[i] = static_cast<unsigned short>(value); break;
+            case(GL_FLOAT):             reinterpret_cast<float*>(image->data())[i] = float(value & 0xffff)/65535.0f; break;
+        }
+    }
+    return image.release();
+}
+
+osg::Image* cloneImage(const osg::Image* image)
+{
+    return new osg::Image(*image, osg::CopyOp::DEEP_COPY_ALL);
+}
+
+GLenum otherDataType(GLenum dataType)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):     return GL_FLOAT;
+        case(GL_UNSIGNED_SHORT):    return GL_UNSIGNED_BYTE;
+        default:                    return GL_UNSIGNED_SHORT;
+    }
+}
+
+// Each operation returns a new image holding its result so the results of instruction sets can be compared byte for byte.
+struct ImageOperation
+{
+    const char* name;
+    osg::Image* (*run)(const osg::Image* image);
+};
+
+osg::Image* scaleDown(const osg::Image* image)
+{
+    osg::Image* result = cloneImage(image);
+    result->scaleImage(image->s()*3/5, image->t()*2/3, 1);
+    return result;
+}
+
+osg::Image* scaleUp(const osg::Image* image)
+{
+    osg::Image* result = cloneImage(image);
+    result->scaleImage(image->s()*3/2+1, image->t()*5/4+1, 1);
+    return result;
+}
+
+osg::Image* halve(const osg::Image* image)
+{
+    osg::Image* result = cloneImage(image);
+    result->scaleImage(image->s()/2, image->t()/2, 1);
+    return result;
+}
+
+osg::Image* minMax(const osg::Image* image)
+{
+    osg::Vec4 minValue, maxValue;
+    osg::computeMinMax(image, minValue, maxValue);
+
+    osg::Image* result = new osg::Image;
+    result->allocateImage(2, 1, 1, GL_RGBA, GL_FLOAT);
+    memcpy(result->data(0,0), minValue.ptr(), sizeof(osg::Vec4));
+    memcpy(result->data(1,0), maxValue.ptr(), sizeof(osg::Vec4));
+    return result;
+}
+
+osg::Image* offsetAndScale(const osg::Image* image)
+{
+    osg::Image* result = cloneImage(image);
+    osg::offsetAndScaleImage(result, osg::Vec4(0.05f, 0.1f, 0.02f, 0.0f), osg::Vec4(0.9f, 0.75f, 0.95f, 0.5f));
+    return result;
+}
+
+osg::Image* copyToDataType(const osg::Image* image)
+{
+    osg::Image* result = new osg::Image;
+    result->allocateImage(image->s(), image->t(), 1, image->getPixelFormat(), otherDataType(image->getDataType()));
+    osg::copyImage(image, 0, 0, 0, image->s(), image->t(), 1, result, 0, 0, 0, true);
+    return result;
+}
+
+osg::Image* copyToRGBA(const osg::Image* image)
+{
+    osg::Image* result = new osg::Image;
+    result->allocateImage(image->s(), image->t(), 1, GL_RGBA, image->getDataType());
+    osg::copyImage(image, 0, 0, 0, image->s(), image->t(), 1, result, 0, 0, 0, false);
+    return result;
+}
+
+osg::Image* colorSpace(const osg::Image* image, osg::ColorSpaceOperation op)
+{
+    osg::ref_ptr<osg::Image> rgba = copyToRGBA(image);
+    return osg::colorSpaceConversion(op, rgba.release(), osg::Vec4(0.9f, 0.6f, 0.3f, 1.0f));
+}
+
+osg::Image* modulateAlphaByLuminance(const osg::Image* image) { return colorSpace(image, osg::MODULATE_ALPHA_BY_LUMINANCE); }
+osg::Image* modulateAlphaByColor(const osg::Image* image) { return colorSpace(image, osg::MODULATE_ALPHA_BY_COLOR); }
+osg::Image* replaceAlphaWithLuminance(const osg::Image* image) { return colorSpace(image, osg::REPLACE_ALPHA_WITH_LUMINANCE); }
+
+const ImageOperation s_imageOperations[] =
+{
+    { "scale down", scaleDown },
+    { "scale up", scaleUp },
+    { "halve", halve },
+    { "computeMinMax", minMax },
+    { "offsetAndScale", offsetAndScale },
+    { "copy to data type", copyToDataType },
+    { "copy to RGBA", copyToRGBA },
+    { "modulate alpha by luminance", modulateAlphaByLuminance },
+    { "modulate alpha by color", modulateAlphaByColor },
+    { "replace alpha with luminance", replaceAlphaWithLuminance }
+};
+
+const unsigned int s_numImageOperations = sizeof(s_imageOperations)/sizeof(ImageOperation);
+
+bool sameImages(const osg::Image* lhs, const osg::Image* rhs)
+{
+    if (lhs->s()!=rhs->s() || lhs->t()!=rhs->t() || lhs->r()!=rhs->r()) return false;
+    if (lhs->getPixelFormat()!=rhs->getPixelFormat() || lhs->getDataType()!=rhs->getDataType()) return false;
+    return memcmp(lhs->data(), rhs->data(), lhs->getTotalSizeInBytes())==0;
+}
+
+const char* instructionSetName(osg::ImageKernelInstructionSet instructionSet)
+{
+    switch(instructionSet)
+    {
+        case(osg::IMAGE_KERNELS_SSE2):  return "SSE2";
+        case(osg::IMAGE_KERNELS_AVX2):  return "AVX2";
+        default:                        return "GENERIC";
+    }
+}
+
+// Runs an operation on a thread of its own, so that several threads call into the image kernels at once as the
+// DatabasePager's threads do.
+class ImageOperationThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    ImageOperationThread(const ImageOperation& operation, const osg::Image* image):
+        _operation(operation),
+        _image(image) {}
+
+    virtual void run() { _result = _operation.run(_image.get()); }
+
+    osg::ref_ptr<osg::Image> _result;
+
+protected:
+
+    virtual ~ImageOperationThread() {}
+
+    ImageOperationThread& operator = (const ImageOperationThread&) { return *this; }
+
+    const ImageOperation&           _operation;
+    osg::ref_ptr<const osg::Image>  _image;
+};
+
+}
+
+void runImageKernelsTests(unsigned int size)
+{
+    osg::ImageKernelInstructionSet previousInstructionSet = osg::getImageKernelInstructionSet();
+    unsigned int previousNumThreads = osg::getImageKernelNumThreads();
+
+    // find the instruction sets supported, setting one beyond what the CPU supports falls back to the best it does.
+    std::vector<osg::ImageKernelInstructionSet> instructionSets;
+    osg::ImageKernelInstructionSet candidates[] = { osg::IMAGE_KERNELS_GENERIC, osg::IMAGE_KERNELS_SSE2, osg::IMAGE_KERNELS_AVX2 };
+    for(unsigned int i=0; i<3; ++i)
+    {
+        osg::setImageKernelInstructionSet(candidates[i]);
+        if (osg::getImageKernelInstructionSet()==candidates[i]) instructionSets.push_back(candidates[i]);
+    }
+
+    const unsigned int threadCounts[] = { 1, 4 };
+    const unsigned int numRepeats = 4;
+
+    std::cout<<"Image kernel tests of "<<size<<"x"<<size<<" images"<<std::endl;
+
+    bool passed = true;
+    for(unsigned int d=0; d<s_numImageDescriptions; ++d)
+    {
+        const ImageDescription& description = s_imageDescriptions[d];
+        osg::ref_ptr<osg::Image> image = createImage(description, size, size);
+
+        for(unsigned int o=0; o<s_numImageOperations; ++o)
+        {
+            const ImageOperation& operation = s_imageOperations[o];
+            std::cout<<"  "<<description.name<<" "<<operation.name<<std::endl;
+
+            osg::ref_ptr<osg::Image> reference;
+            for(unsigned int is=0; is<instructionSets.size(); ++is)
+            {
+                for(unsigned int tc=0; tc<2; ++tc)
+                {
+                    // the per pixel code doesn't use threads.
+                    if (instructionSets[is]==osg::IMAGE_KERNELS_GENERIC && tc>0) continue;
+
+                    osg::setImageKernelInstructionSet(instructionSets[is]);
+                    osg::setImageKernelNumThreads(threadCounts[tc]);
+
+                    osg::ref_ptr<osg::Image> result;
+                    osg::Timer_t start = osg::Timer::instance()->tick();
+                    for(unsigned int r=0; r<numRepeats; ++r)
+                    {
+                        result = operation.run(image.get());
+                    }
+                    double time = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick())/double(numRepeats);
+
+                    bool identical = true;
+                    if (!reference) reference = result;
+                    else identical = sameImages(reference.get(), result.get());
+                    if (!identical) passed = false;
+
+                    std::cout<<"    "<<instructionSetName(instructionSets[is])<<"\t"<<threadCounts[tc]<<" threads\t"<<time*1000.0<<"ms"
+                             <<(identical ? "" : "\tFAILED, differs from GENERIC")<<std::endl;
+                }
+            }
+
+            // the kernel threads are shared between callers, so check that callers on several threads at once get the same results.
+            osg::setImageKernelInstructionSet(instructionSets.back());
+            osg::setImageKernelNumThreads(threadCounts[1]);
+
+            const unsigned int numCallers = 3;
+            std::vector< osg::ref_ptr<ImageOperationThread> > callers;
+            for(unsigned int c=0; c<numCallers; ++c)
+            {
+                callers.push_back(new ImageOperationThread(operation, image.get()));
+                callers.back()->startThread();
+            }
+
+            bool identical = true;
+            for(unsigned int c=0; c<numCallers; ++c)
+            {
+                callers[c]->join();
+                if (!callers[c]->_result || !sameImages(reference.get(), callers[c]->_result.get())) identical = false;
+            }
+            if (!identical) passed = false;
+
+            std::cout<<"    "<<instructionSetName(instructionSets.back())<<"\t"<<numCallers<<" callers at once"
+                     <<(identical ? "" : "\tFAILED, differs from GENERIC")<<std::endl;
+        }
+    }
+
+    osg::setImageKernelInstructionSet(previousInstructionSet);
+    osg::setImageKernelNumThreads(previousNumThreads);
+
+    if (!passed) std::cout<<"Error: image kernel tests failed"<<std::endl;
+}
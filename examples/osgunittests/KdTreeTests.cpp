@@ -0,0 +1,314 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+
+#include "KdTreeTests.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/KdTree>
+#include <osg/Timer>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+
+namespace
+{
+
+osg::Geometry* createTerrainGeometry(unsigned int gridSize)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    for(unsigned int r=0; r<gridSize; ++r)
+    {
+        for(unsigned int c=0; c<gridSize; ++c)
+        {
+            float x = float(c);
+            float y = float(r);
+
+            // rolling hills with a steep ridge, so the triangles are unevenly spread in height.
+            float z = 8.0f*sinf(x*0.05f)*cosf(y*0.07f) + (fabsf(x-y)<8.0f ? 40.0f-5.0f*fabsf(x-y) : 0.0f);
+            vertices->push_back(osg::Vec3(x, y, z));
+        }
+    }
+
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for(unsigned int r=0; r<gridSize-1; ++r)
+    {
+        for(unsigned int c=0; c<gridSize-1; ++c)
+        {
+            unsigned int i = r*gridSize+c;
+            indices->push_back(i); indices->push_back(i+1); indices->push_back(i+gridSize);
+            indices->push_back(i+1); indices->push_back(i+gridSize+1); indices->push_back(i+gridSize);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(indices.get());
+    return geometry;
+}
+
+float random(float minimum, float maximum)
+{
+    return minimum + (maximum-minimum)*float(rand())/float(RAND_MAX);
+}
+
+// height above terrain style vertical segments and line of sight style segments fanning out from a few observers.
+void createSegments(unsigned int gridSize, osg::KdTree::LineSegmentList& segments)
+{
+    float size = float(gridSize-1);
+    for(unsigned int i=0; i<4096; ++i)
+    {
+        float x = random(0.0f, size);
+        float y = random(0.0f, size);
+        segments.push_back(osg::KdTree::LineSegment(osg::Vec3d(x, y, 100.0), osg::Vec3d(x, y, -100.0)));
+    }
+
+    for(unsigned int observer=0; observer<16; ++observer)
+    {
+        osg::Vec3d eye(random(0.0f, size), random(0.0f, size), 50.0);
+        for(unsigned int i=0; i<256; ++i)
+        {
+            segments.push_back(osg::KdTree::LineSegment(eye, osg::Vec3d(random(0.0f, size), random(0.0f, size), 0.0)));
+        }
+    }
+}
+
+osg::KdTree* buildKdTree(osg::Geometry* geometry, osg::KdTree::BuildOptions::BuildMethod method, double& buildTime)
+{
+    osg::KdTree::BuildOptions options;
+    options._buildMethod = method;
+
+    osg::ref_ptr<osg::KdTree> kdTree = new osg::KdTree;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    bool built = kdTree->build(options, geometry);
+    buildTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+    return built ? kdTree.release() : 0;
+}
+
+// the nearest hit of each segment, one segment at a time through the original intersect() path.
+double intersectSingle(const osg::KdTree& kdTree, const osg::KdTree::LineSegmentList& segments, osg::KdTree::LineSegmentIntersections& nearest)
+{
+    nearest.clear();
+    nearest.resize(segments.size());
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    osg::KdTree::LineSegmentIntersections intersections;
+    for(unsigned int i=0; i<segments.size(); ++i)
+    {
+        intersections.clear();
+        if (kdTree.intersect(segments[i].start, segments[i].end, intersections))
+        {
+            nearest[i] = *std::min_element(intersections.begin(), intersections.end());
+        }
+    }
+    return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+}
+
+double intersectPackets(const osg::KdTree& kdTree, const osg::KdTree::LineSegmentList& segments, osg::KdTree::LineSegmentIntersections& nearest)
+{
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    kdTree.intersect(segments, nearest);
+    return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+}
+
+unsigned int countDifferences(const osg::KdTree::LineSegmentIntersections& lhs, const osg::KdTree::LineSegmentIntersections& rhs)
+{
+    unsigned int numDifferences = 0;
+    for(unsigned int i=0; i<lhs.size(); ++i)
+    {
+        if (fabs(lhs[i].ratio-rhs[i].ratio)>1e-6) ++numDifferences;
+    }
+    return numDifferences;
+}
+
+}
+
+void runKdTreeTests(unsigned int gridSize)
+{
+    if (gridSize<2) gridSize = 2;
+
+    osg::ref_ptr<osg::Geometry> geometry = createTerrainGeometry(gridSize);
+
+    double midpointBuildTime = 0.0, sahBuildTime = 0.0;
+    osg::ref_ptr<osg::KdTree> midpoint = buildKdTree(geometry.get(), osg::KdTree::BuildOptions::SPATIAL_MIDPOINT, midpointBuildTime);
+    osg::ref_ptr<osg::KdTree> sah = buildKdTree(geometry.get(), osg::KdTree::BuildOptions::SURFACE_AREA_HEURISTIC, sahBuildTime);
+    if (!midpoint || !sah)
+    {
+        std::cout<<"Error: KdTree build failed"<<std::endl;
+        return;
+    }
+
+    std::cout<<"KdTree of "<<midpoint->getTriangles().size()<<" triangles, sizeof(KdNode)="<<sizeof(osg::KdTree::KdNode)<<std::endl;
+    std::cout<<"    midpoint build "<<midpointBuildTime<<"ms, "<<midpoint->getNodes().size()<<" nodes"<<std::endl;
+    std::cout<<"    SAH build      "<<sahBuildTime<<"ms, "<<sah->getNodes().size()<<" nodes"<<std::endl;
+
+    osg::KdTree::LineSegmentList segments;
+    createSegments(gridSize, segments);
+
+    osg::KdTree::LineSegmentIntersections reference, midpointPackets, sahSingle, sahPackets;
+    double referenceTime = intersectSingle(*midpoint, segments, reference);
+    double midpointPacketTime = intersectPackets(*midpoint, segments, midpointPackets);
+    double sahSingleTime = intersectSingle(*sah, segments, sahSingle);
+    double sahPacketTime = intersectPackets(*sah, segments, sahPackets);
+
+    unsigned int numHits = 0;
+    for(unsigned int i=0; i<reference.size(); ++i)
+    {
+        if (reference[i].ratio>=0.0) ++numHits;
+    }
+
+    std::cout<<"    "<<segments.size()<<" segments, "<<numHits<<" hits"<<std::endl;
+    std::cout<<"    midpoint single "<<referenceTime<<"ms"<<std::endl;
+    std::cout<<"    midpoint packet "<<midpointPacketTime<<"ms, speed up "<<referenceTime/midpointPacketTime<<std::endl;
+    std::cout<<"    SAH single      "<<sahSingleTime<<"ms, speed up "<<referenceTime/sahSingleTime<<std::endl;
+    std::cout<<"    SAH packet      "<<sahPacketTime<<"ms, speed up "<<referenceTime/sahPacketTime<<std::endl;
+
+    unsigned int numDifferences = countDifferences(reference, midpointPackets) +
+                                  countDifferences(reference, sahSingle) +
+                                  countDifferences(reference, sahPackets);
+    if (numDifferences!=0)
+    {
+        std::cout<<"Error: "<<numDifferences<<" nearest intersections differ from the single segment midpoint KdTree"<<std::endl;
+    }
+}
+
+namespace
+{
+
+unsigned int countNodes(osg::Geode& geode)
+{
+    unsigned int numNodes = 0;
+    for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+    {
+        osg::KdTree* kdTree = dynamic_cast<osg::KdTree*>(geode.getDrawable(i)->getShape());
+        if (kdTree) numNodes += kdTree->getNodes().size();
+    }
+    return numNodes;
+}
+
+}
+
+void runKdTreeBuildTests(unsigned int maxNumThreads)
+{
+    if (maxNumThreads<1) maxNumThreads = 1;
+
+    const unsigned int largeGridSize = 1024;
+    osg::ref_ptr<osg::Geometry> large = createTerrainGeometry(largeGridSize);
+
+    osg::KdTree::LineSegmentList segments;
+    createSegments(largeGridSize, segments);
+
+    std::cout<<"KdTree build of one "<<(largeGridSize-1)*(largeGridSize-1)*2<<" triangle mesh"<<std::endl;
+
+    osg::KdTree::LineSegmentIntersections reference;
+    double referenceTime = 0.0;
+    unsigned int referenceNumNodes = 0;
+    for(unsigned int numThreads=1; numThreads<=maxNumThreads; ++numThreads)
+    {
+        osg::KdTree::BuildOptions options;
+        options._numThreads = numThreads;
+
+        osg::ref_ptr<osg::KdTree> kdTree = new osg::KdTree;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        kdTree->build(options, large.get());
+        double buildTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+        osg::KdTree::LineSegmentIntersections nearest;
+        intersectPackets(*kdTree, segments, nearest);
+
+        if (numThreads==1)
+        {
+            reference = nearest;
+            referenceTime = buildTime;
+            referenceNumNodes = kdTree->getNodes().size();
+        }
+
+        std::cout<<"    "<<numThreads<<" threads "<<buildTime<<"ms, speed up "<<referenceTime/buildTime<<", "<<kdTree->getNodes().size()<<" nodes"<<std::endl;
+
+        unsigned int numDifferences = countDifferences(reference, nearest);
+        if (numDifferences!=0 || kdTree->getNodes().size()!=referenceNumNodes)
+        {
+            std::cout<<"Error: "<<numDifferences<<" nearest intersections differ from the single threaded build"<<std::endl;
+        }
+    }
+
+    // a tile's worth of small meshes that are each too small to divide in parallel.
+    const unsigned int numSmall = 256;
+    const unsigned int smallGridSize = 96;
+    std::cout<<"KdTreeBuilder of "<<numSmall<<" "<<(smallGridSize-1)*(smallGridSize-1)*2<<" triangle meshes"<<std::endl;
+
+    referenceTime = 0.0;
+    referenceNumNodes = 0;
+    for(unsigned int numThreads=1; numThreads<=maxNumThreads; ++numThreads)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        for(unsigned int i=0; i<numSmall; ++i)
+        {
+            geode->addDrawable(createTerrainGeometry(smallGridSize));
+        }
+
+        osg::ref_ptr<osg::KdTreeBuilder> builder = new osg::KdTreeBuilder;
+        builder->_buildOptions._numThreads = numThreads;
+        builder->setBuildInParallel(true);
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        geode->accept(*builder);
+        builder->buildKdTrees();
+        double buildTime = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+        unsigned int numNodes = countNodes(*geode);
+        if (numThreads==1)
+        {
+            referenceTime = buildTime;
+            referenceNumNodes = numNodes;
+        }
+
+        std::cout<<"    "<<numThreads<<" threads "<<buildTime<<"ms, speed up "<<referenceTime/buildTime<<", "<<numNodes<<" nodes"<<std::endl;
+
+        if (numNodes!=referenceNumNodes)
+        {
+            std::cout<<"Error: built "<<numNodes<<" nodes, the single threaded build has "<<referenceNumNodes<<std::endl;
+        }
+    }
+
+    // by default the KdTrees are built as the builder traverses, without a call to buildKdTrees().
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        for(unsigned int i=0; i<numSmall; ++i)
+        {
+            geode->addDrawable(createTerrainGeometry(smallGridSize));
+        }
+
+        osg::ref_ptr<osg::KdTreeBuilder> builder = new osg::KdTreeBuilder;
+        builder->_buildOptions._numThreads = maxNumThreads;
+        geode->accept(*builder);
+
+        unsigned int numNodes = countNodes(*geode);
+        if (numNodes!=referenceNumNodes)
+        {
+            std::cout<<"Error: KdTreeBuilder traversal built "<<numNodes<<" nodes, the single threaded build has "<<referenceNumNodes<<std::endl;
+        }
+    }
+}
@@ -0,0 +1,338 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "MatrixKernelsTests.h"
+
+#include <osg/Matrixd>
+#include <osg/Matrixf>
+#include <osg/Timer>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+
+// Linear congruential generator so every run sees the same values, in the range -2 to 2.
+struct Random
+{
+    Random(): _seed(12345) {}
+
+    double operator() ()
+    {
+        _seed = _seed*1664525u + 1013904223u;
+        return double(_seed>>8)/double(1<<24)*4.0-2.0;
+    }
+
+    unsigned int _seed;
+};
+
+template<class M>
+M createMatrix(Random& random)
+{
+    M m;
+    for(int r=0; r<4; ++r)
+    {
+        for(int c=0; c<4; ++c) m(r,c) = random();
+    }
+    return m;
+}
+
+// The per element code the matrix kernels stand in for, summed in the same order as the original Matrix_implementation::mult().
+template<class M>
+void referenceMult(const M& lhs, const M& rhs, M& result)
+{
+    for(int r=0; r<4; ++r)
+    {
+        for(int c=0; c<4; ++c)
+        {
+            result(r,c) = lhs(r,0)*rhs(0,c) + lhs(r,1)*rhs(1,c) + lhs(r,2)*rhs(2,c) + lhs(r,3)*rhs(3,c);
+        }
+    }
+}
+
+// The original Gauss-Jordan elimination of Matrix_implementation::invert_4x4().
+template<class M>
+bool referenceInvert(const M& mat, M& result)
+{
+    unsigned int indxc[4], indxr[4], ipiv[4];
+    unsigned int icol = 0;
+    unsigned int irow = 0;
+
+    result = mat;
+
+    for(unsigned int j=0; j<4; ++j) ipiv[j] = 0;
+
+    for(unsigned int i=0; i<4; ++i)
+    {
+        double big = 0.0;
+        for(unsigned int j=0; j<4; ++j)
+        {
+            if (ipiv[j]==1) continue;
+            for(unsigned int k=0; k<4; ++k)
+            {
+                if (ipiv[k]==0)
+                {
+                    double value = result(j,k)>=0 ? result(j,k) : -result(j,k);
+                    if (value>=big)
+                    {
+                        big = value;
+                        irow = j;
+                        icol = k;
+                    }
+                }
+                else if (ipiv[k]>1) return false;
+            }
+        }
+        ++(ipiv[icol]);
+        if (irow!=icol)
+        {
+            for(unsigned int l=0; l<4; ++l) std::swap(result(irow,l), result(icol,l));
+        }
+
+        indxr[i] = irow;
+        indxc[i] = icol;
+        if (result(icol,icol)==0) return false;
+
+        double pivinv = 1.0/result(icol,icol);
+        result(icol,icol) = 1;
+        for(unsigned int l=0; l<4; ++l) result(icol,l) *= pivinv;
+        for(unsigned int ll=0; ll<4; ++ll)
+        {
+            if (ll==icol) continue;
+            double dum = result(ll,icol);
+            result(ll,icol) = 0;
+            for(unsigned int l=0; l<4; ++l) result(ll,l) -= result(icol,l)*dum;
+        }
+    }
+
+    for(int lx=4; lx>0; --lx)
+    {
+        if (indxr[lx-1]!=indxc[lx-1])
+        {
+            for(unsigned int k=0; k<4; ++k) std::swap(result(k,indxr[lx-1]), result(k,indxc[lx-1]));
+        }
+    }
+    return true;
+}
+
+template<class T>
+bool sameValues(const std::vector<T>& lhs, const std::vector<T>& rhs)
+{
+    return lhs.size()==rhs.size() && memcmp(&lhs.front(), &rhs.front(), lhs.size()*sizeof(T))==0;
+}
+
+const unsigned int numRepeats = 4;
+
+// the average time of the numRepeats runs since start.
+double elapsedTime(osg::Timer_t start)
+{
+    return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick())/double(numRepeats);
+}
+
+bool report(const char* name, const char* operation, double referenceTime, double kernelTime, bool identical)
+{
+    std::cout<<"    "<<name<<" "<<operation<<"\tper element "<<referenceTime<<"ms\tkernels "<<kernelTime<<"ms";
+    if (kernelTime>0.0) std::cout<<"\tx"<<referenceTime/kernelTime;
+    std::cout<<(identical ? "" : "\tFAILED, differs from the per element code")<<std::endl;
+    return identical;
+}
+
+template<class M>
+bool testMatrices(const char* name, unsigned int num)
+{
+    Random random;
+    std::vector<M> lhs(num), rhs(num);
+    for(unsigned int i=0; i<num; ++i)
+    {
+        lhs[i] = createMatrix<M>(random);
+        rhs[i] = createMatrix<M>(random);
+    }
+
+    std::vector<M> reference(num), result(num);
+    bool passed = true;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) referenceMult(lhs[i], rhs[i], reference[i]);
+    }
+    double referenceTime = elapsedTime(start);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) result[i].mult(lhs[i], rhs[i]);
+    }
+    passed = report(name, "mult", referenceTime, elapsedTime(start), sameValues(reference, result)) && passed;
+
+    // the products written over one of their operands.
+    for(unsigned int i=0; i<num; ++i)
+    {
+        result[i] = lhs[i];
+        result[i].postMult(rhs[i]);
+    }
+    if (!sameValues(reference, result)) passed = report(name, "postMult", 0.0, 0.0, false) && passed;
+
+    for(unsigned int i=0; i<num; ++i)
+    {
+        result[i] = rhs[i];
+        result[i].preMult(lhs[i]);
+    }
+    if (!sameValues(reference, result)) passed = report(name, "preMult", 0.0, 0.0, false) && passed;
+
+    std::vector<bool> referenceInverted(num), inverted(num);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) referenceInverted[i] = referenceInvert(lhs[i], reference[i]);
+    }
+    referenceTime = elapsedTime(start);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) inverted[i] = result[i].invert_4x4(lhs[i]);
+    }
+    double kernelTime = elapsedTime(start);
+
+    // a matrix found to be singular is left part way through the elimination, so only compare the inverses found.
+    bool identical = referenceInverted==inverted;
+    for(unsigned int i=0; i<num && identical; ++i)
+    {
+        if (inverted[i]) identical = memcmp(reference[i].ptr(), result[i].ptr(), sizeof(M))==0;
+    }
+    passed = report(name, "invert_4x4", referenceTime, kernelTime, identical) && passed;
+
+    return passed;
+}
+
+template<class M, class V>
+bool testTransforms(const char* name, const M& matrix, unsigned int num)
+{
+    Random random;
+    std::vector<V> src(num);
+    for(unsigned int i=0; i<num; ++i) src[i].set(random()*100.0, random()*100.0, random()*100.0);
+
+    std::vector<V> reference(num), result(num);
+    bool passed = true;
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) reference[i] = matrix.preMult(src[i]);
+    }
+    double referenceTime = elapsedTime(start);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        matrix.preMult(&src.front(), &result.front(), num);
+    }
+    passed = report(name, "preMult", referenceTime, elapsedTime(start), sameValues(reference, result)) && passed;
+
+    // transforming the array in place, as TransformAttributeFunctor does.
+    result = src;
+    matrix.preMult(&result.front(), &result.front(), num);
+    if (!sameValues(reference, result)) passed = report(name, "preMult in place", 0.0, 0.0, false) && passed;
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) reference[i] = matrix.postMult(src[i]);
+    }
+    referenceTime = elapsedTime(start);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        matrix.postMult(&src.front(), &result.front(), num);
+    }
+    passed = report(name, "postMult", referenceTime, elapsedTime(start), sameValues(reference, result)) && passed;
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) reference[i] = M::transform3x3(src[i], matrix);
+    }
+    referenceTime = elapsedTime(start);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        M::transform3x3(&src.front(), &result.front(), num, matrix);
+    }
+    passed = report(name, "transform3x3(v,m)", referenceTime, elapsedTime(start), sameValues(reference, result)) && passed;
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        for(unsigned int i=0; i<num; ++i) reference[i] = M::transform3x3(matrix, src[i]);
+    }
+    referenceTime = elapsedTime(start);
+
+    start = osg::Timer::instance()->tick();
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        M::transform3x3(matrix, &src.front(), &result.front(), num);
+    }
+    passed = report(name, "transform3x3(m,v)", referenceTime, elapsedTime(start), sameValues(reference, result)) && passed;
+
+    return passed;
+}
+
+template<class M>
+bool testMatrixTransforms(const char* name, unsigned int num)
+{
+    // a model view projection, so the points have a w to divide by, and an arbitrary matrix.
+    M modelViewProjection = M::rotate(0.3, osg::Vec3d(0.2, 0.4, 0.8)) *
+                            M::lookAt(osg::Vec3d(10.0, -200.0, 50.0), osg::Vec3d(0.0, 0.0, 0.0), osg::Vec3d(0.0, 0.0, 1.0)) *
+                            M::perspective(30.0, 1.6, 1.0, 1000.0);
+
+    Random random;
+    M arbitrary = createMatrix<M>(random);
+
+    std::string vec3fName = std::string(name)+" Vec3f";
+    std::string vec3dName = std::string(name)+" Vec3d";
+
+    bool passed = true;
+    passed = testTransforms<M, osg::Vec3f>(vec3fName.c_str(), modelViewProjection, num) && passed;
+    passed = testTransforms<M, osg::Vec3d>(vec3dName.c_str(), modelViewProjection, num) && passed;
+    passed = testTransforms<M, osg::Vec3f>(vec3fName.c_str(), arbitrary, num) && passed;
+    passed = testTransforms<M, osg::Vec3d>(vec3dName.c_str(), arbitrary, num) && passed;
+    return passed;
+}
+
+}
+
+void runMatrixKernelsTests(unsigned int num)
+{
+    std::cout<<"Matrix kernel tests of "<<num<<" matrices and vectors"<<std::endl;
+
+    bool passed = true;
+    passed = testMatrices<osg::Matrixd>("Matrixd", num) && passed;
+    passed = testMatrices<osg::Matrixf>("Matrixf", num) && passed;
+    passed = testMatrixTransforms<osg::Matrixd>("Matrixd", num) && passed;
+    passed = testMatrixTransforms<osg::Matrixf>("Matrixf", num) && passed;
+
+    if (!passed) std::cout<<"Error: matrix kernel tests failed"<<std::endl;
+}
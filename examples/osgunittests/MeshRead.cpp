@@ -0,0 +1,384 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+#include "MeshRead.h"
+
+#include <osg/Endian>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+const char* plyAsciiFileName = "osgunittests_grid_ascii.ply";
+const char* plyBigEndianFileName = "osgunittests_grid_be.ply";
+const char* plyLittleEndianFileName = "osgunittests_grid_le.ply";
+const char* stlFileName = "osgunittests_grid.stl";
+
+osg::Vec3 gridVertex(unsigned int gridSize, unsigned int r, unsigned int c)
+{
+    float x = float(c)/float(gridSize);
+    float y = float(r)/float(gridSize);
+    return osg::Vec3(x, y, sinf(x*10.0f)*cosf(y*7.0f)*0.1f);
+}
+
+// the STL reader computes the facet normals itself, a flat grid spaced by a power of two gives every facet exactly
+// the same normal so that all the corners weld.
+osg::Vec3 flatGridVertex(unsigned int r, unsigned int c)
+{
+    return osg::Vec3(float(c)*0.125f, float(r)*0.125f, 0.0f);
+}
+
+template<typename T>
+void writeBinary(std::ofstream& out, T value, bool bigEndian)
+{
+    if (bigEndian!=(osg::getCpuByteOrder()==osg::BigEndian)) osg::swapBytes((char*)&value, sizeof(T));
+    out.write((const char*)&value, sizeof(T));
+}
+
+/** Write a grid of gridSize x gridSize cells of coloured vertices with normals as two triangles per cell.*/
+bool writePly(const char* filename, unsigned int gridSize, const char* format)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) return false;
+
+    unsigned int numVertices = (gridSize+1)*(gridSize+1);
+    unsigned int numFaces = gridSize*gridSize*2;
+
+    out<<"ply\n";
+    out<<"format "<<format<<" 1.0\n";
+    out<<"element vertex "<<numVertices<<"\n";
+    out<<"property float x\nproperty float y\nproperty float z\n";
+    out<<"property float nx\nproperty float ny\nproperty float nz\n";
+    out<<"property uchar red\nproperty uchar green\nproperty uchar blue\n";
+    out<<"element face "<<numFaces<<"\n";
+    out<<"property list uchar int vertex_indices\n";
+    out<<"end_header\n";
+
+    bool ascii = strcmp(format, "ascii")==0;
+    bool bigEndian = strcmp(format, "binary_big_endian")==0;
+
+    for(unsigned int r=0; r<=gridSize; ++r)
+    {
+        for(unsigned int c=0; c<=gridSize; ++c)
+        {
+            osg::Vec3 v = gridVertex(gridSize, r, c);
+            osg::Vec3 n(-v.z(), -v.z(), 1.0f);
+            n.normalize();
+            unsigned char color[3] = { (unsigned char)(c%256), (unsigned char)(r%256), (unsigned char)((r*c)%256) };
+
+            if (ascii)
+            {
+                char buffer[256];
+                sprintf(buffer, "%.9g %.9g %.9g %.9g %.9g %.9g %u %u %u\n", v.x(), v.y(), v.z(), n.x(), n.y(), n.z(), color[0], color[1], color[2]);
+                out<<buffer;
+            }
+            else
+            {
+                for(unsigned int i=0; i<3; ++i) writeBinary(out, v[i], bigEndian);
+                for(unsigned int i=0; i<3; ++i) writeBinary(out, n[i], bigEndian);
+                out.write((const char*)color, 3);
+            }
+        }
+    }
+
+    for(unsigned int r=0; r<gridSize; ++r)
+    {
+        for(unsigned int c=0; c<gridSize; ++c)
+        {
+            int i = r*(gridSize+1)+c;
+            int triangles[2][3] = { { i, i+1, i+int(gridSize)+2 }, { i, i+int(gridSize)+2, i+int(gridSize)+1 } };
+            for(unsigned int t=0; t<2; ++t)
+            {
+                if (ascii)
+                {
+                    out<<"3 "<<triangles[t][0]<<" "<<triangles[t][1]<<" "<<triangles[t][2]<<"\n";
+                }
+                else
+                {
+                    unsigned char count = 3;
+                    out.write((const char*)&count, 1);
+                    for(unsigned int k=0; k<3; ++k) writeBinary(out, triangles[t][k], bigEndian);
+                }
+            }
+        }
+    }
+
+    return out.good();
+}
+
+/** Write a flat grid as a binary STL, every facet repeating the corners it shares with its neighbours.*/
+bool writeStl(const char* filename, unsigned int gridSize)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) return false;
+
+    char header[80];
+    memset(header, 0, sizeof(header));
+    strcpy(header, "osgunittests grid");
+    out.write(header, sizeof(header));
+    writeBinary(out, gridSize*gridSize*2, false);
+
+    for(unsigned int r=0; r<gridSize; ++r)
+    {
+        for(unsigned int c=0; c<gridSize; ++c)
+        {
+            osg::Vec3 corners[4] = { flatGridVertex(r, c), flatGridVertex(r, c+1), flatGridVertex(r+1, c+1), flatGridVertex(r+1, c) };
+            unsigned int triangles[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+            for(unsigned int t=0; t<2; ++t)
+            {
+                writeBinary(out, 0.0f, false); writeBinary(out, 0.0f, false); writeBinary(out, 1.0f, false);
+                for(unsigned int k=0; k<3; ++k)
+                {
+                    const osg::Vec3& v = corners[triangles[t][k]];
+                    for(unsigned int i=0; i<3; ++i) writeBinary(out, v[i], false);
+                }
+                writeBinary(out, (unsigned short)0, false);
+            }
+        }
+    }
+
+    return out.good();
+}
+
+class CollectGeometriesVisitor : public osg::NodeVisitor
+{
+public:
+
+    CollectGeometriesVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+    virtual void apply(osg::Geode& geode)
+    {
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+            if (geometry) _geometries.push_back(geometry);
+        }
+    }
+
+    std::vector<osg::Geometry*> _geometries;
+};
+
+osg::Geometry* getGeometry(osg::Node* node)
+{
+    CollectGeometriesVisitor geometries;
+    if (node) node->accept(geometries);
+    return geometries._geometries.size()==1 ? geometries._geometries[0] : 0;
+}
+
+bool sameArray(const osg::Array* lhs, const osg::Array* rhs)
+{
+    if (!lhs || !rhs) return lhs==rhs;
+    return lhs->getTotalDataSize()==rhs->getTotalDataSize() &&
+           memcmp(lhs->getDataPointer(), rhs->getDataPointer(), lhs->getTotalDataSize())==0;
+}
+
+bool sameGeometry(osg::Geometry* lhs, osg::Geometry* rhs)
+{
+    if (!lhs || !rhs) return false;
+
+    if (!sameArray(lhs->getVertexArray(), rhs->getVertexArray()) ||
+        !sameArray(lhs->getNormalArray(), rhs->getNormalArray()) ||
+        !sameArray(lhs->getColorArray(), rhs->getColorArray()) ||
+        lhs->getNumPrimitiveSets()!=rhs->getNumPrimitiveSets()) return false;
+
+    for(unsigned int p=0; p<lhs->getNumPrimitiveSets(); ++p)
+    {
+        const osg::PrimitiveSet* lp = lhs->getPrimitiveSet(p);
+        const osg::PrimitiveSet* rp = rhs->getPrimitiveSet(p);
+        if (lp->getMode()!=rp->getMode() || lp->getNumIndices()!=rp->getNumIndices()) return false;
+        for(unsigned int i=0; i<lp->getNumIndices(); ++i)
+        {
+            if (lp->index(i)!=rp->index(i)) return false;
+        }
+    }
+    return true;
+}
+
+osg::ref_ptr<osg::Node> readMesh(const char* filename, const std::string& optionString, double& time)
+{
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options(optionString);
+    options->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(filename, options.get());
+    time = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+    return node;
+}
+
+double fileSizeInMegabytes(const char* filename)
+{
+    std::ifstream fin(filename, std::ios::in | std::ios::binary);
+    fin.seekg(0, std::ios::end);
+    return double(fin.tellg())/(1024.0*1024.0);
+}
+
+bool runPlyReadTests(unsigned int gridSize)
+{
+    bool passed = true;
+
+    if (!writePly(plyAsciiFileName, gridSize, "ascii") ||
+        !writePly(plyBigEndianFileName, gridSize, "binary_big_endian") ||
+        !writePly(plyLittleEndianFileName, gridSize, "binary_little_endian"))
+    {
+        std::cout<<"Error: unable to write the ply files"<<std::endl;
+        passed = false;
+    }
+    else
+    {
+        const char* filenames[3] = { plyAsciiFileName, plyBigEndianFileName, plyLittleEndianFileName };
+        osg::ref_ptr<osg::Node> nodes[3];
+        for(unsigned int i=0; i<3; ++i)
+        {
+            double time = 0.0;
+            nodes[i] = readMesh(filenames[i], "", time);
+
+            double megabytes = fileSizeInMegabytes(filenames[i]);
+            std::cout<<"ply read "<<filenames[i]<<", "<<megabytes<<"MB : "<<time<<"ms ("<<megabytes/(time*0.001)<<"MB/s)"<<std::endl;
+        }
+
+        // big endian files are read a vertex at a time on little endian machines, and the other way round.
+        osg::Geometry* geometry = getGeometry(nodes[2].get());
+        if (!geometry || !geometry->getVertexArray() || geometry->getVertexArray()->getNumElements()!=(gridSize+1)*(gridSize+1))
+        {
+            std::cout<<"Error: little endian ply file not read as a single geometry of the written vertices"<<std::endl;
+            passed = false;
+        }
+        else
+        {
+            for(unsigned int i=0; i<2; ++i)
+            {
+                if (!sameGeometry(getGeometry(nodes[i].get()), geometry))
+                {
+                    std::cout<<"Error: "<<filenames[i]<<" differs from "<<filenames[2]<<std::endl;
+                    passed = false;
+                }
+            }
+        }
+    }
+
+    remove(plyAsciiFileName);
+    remove(plyBigEndianFileName);
+    remove(plyLittleEndianFileName);
+
+    return passed;
+}
+
+bool runStlReadTests(unsigned int gridSize)
+{
+    bool passed = true;
+
+    if (writeStl(stlFileName, gridSize))
+    {
+        double megabytes = fileSizeInMegabytes(stlFileName);
+        unsigned int numVertices = (gridSize+1)*(gridSize+1);
+
+        double time = 0.0;
+        osg::ref_ptr<osg::Node> welded = readMesh(stlFileName, "noTriStripPolygons", time);
+        std::cout<<"stl read welded, "<<megabytes<<"MB : "<<time<<"ms ("<<megabytes/(time*0.001)<<"MB/s)"<<std::endl;
+
+        osg::Geometry* geometry = getGeometry(welded.get());
+        const osg::Vec3Array* vertices = geometry ? dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray()) : 0;
+        const osg::DrawElementsUInt* triangles = (geometry && geometry->getNumPrimitiveSets()==1) ? dynamic_cast<const osg::DrawElementsUInt*>(geometry->getPrimitiveSet(0)) : 0;
+        if (!vertices || vertices->size()!=numVertices || !triangles || triangles->size()!=gridSize*gridSize*6 ||
+            !geometry->getNormalArray() || geometry->getNormalArray()->getNumElements()!=numVertices)
+        {
+            std::cout<<"Error: stl grid not welded to "<<numVertices<<" vertices"<<std::endl;
+            passed = false;
+        }
+        else
+        {
+            // the triangles should come back in the order written, indexing the corners written.
+            for(unsigned int r=0; r<gridSize && passed; ++r)
+            {
+                for(unsigned int c=0; c<gridSize && passed; ++c)
+                {
+                    osg::Vec3 corners[4] = { flatGridVertex(r, c), flatGridVertex(r, c+1), flatGridVertex(r+1, c+1), flatGridVertex(r+1, c) };
+                    unsigned int written[6] = { 0, 1, 2, 0, 2, 3 };
+                    for(unsigned int k=0; k<6; ++k)
+                    {
+                        if ((*vertices)[(*triangles)[(r*gridSize+c)*6+k]]!=corners[written[k]])
+                        {
+                            std::cout<<"Error: stl welded triangle "<<(r*gridSize+c)*2+k/3<<" differs from the one written"<<std::endl;
+                            passed = false;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        osg::ref_ptr<osg::Node> stripped = readMesh(stlFileName, "", time);
+        std::cout<<"stl read welded and tri stripped, "<<megabytes<<"MB : "<<time<<"ms ("<<megabytes/(time*0.001)<<"MB/s)"<<std::endl;
+
+        geometry = getGeometry(stripped.get());
+        if (!geometry || !geometry->getVertexArray() || geometry->getVertexArray()->getNumElements()!=numVertices)
+        {
+            std::cout<<"Error: tri stripped stl grid doesn't have "<<numVertices<<" vertices"<<std::endl;
+            passed = false;
+        }
+    }
+    else
+    {
+        std::cout<<"Error: unable to write "<<stlFileName<<std::endl;
+        passed = false;
+    }
+    remove(stlFileName);
+
+    return passed;
+}
+
+}
+
+void runMeshReadTests(unsigned int gridSize)
+{
+    bool passed = true;
+
+    if (osgDB::Registry::instance()->getReaderWriterForExtension("ply"))
+    {
+        if (!runPlyReadTests(gridSize)) passed = false;
+    }
+    else
+    {
+        std::cout<<"ply read tests skipped, no ply plugin"<<std::endl;
+    }
+
+    if (osgDB::Registry::instance()->getReaderWriterForExtension("stl"))
+    {
+        if (!runStlReadTests(gridSize)) passed = false;
+    }
+    else
+    {
+        std::cout<<"stl read tests skipped, no stl plugin"<<std::endl;
+    }
+
+    if (!passed) std::cout<<"Error: mesh read tests failed"<<std::endl;
+}
@@ -0,0 +1,377 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ParallelCull.h"
+
+#include "MultiDrawIndirect.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/MatrixTransform>
+#include <osg/Program>
+#include <osg/Shader>
+#include <osg/Timer>
+
+#include <osgUtil/MultiDrawIndirectBin>
+
+#include <osgViewer/Viewer>
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+const char* referenceVertexShader =
+    "#version 120\n"
+    "varying vec3 normal;\n"
+    "void main()\n"
+    "{\n"
+    "    normal = abs(gl_Normal);\n"
+    "    gl_Position = gl_ProjectionMatrix * (gl_ModelViewMatrix * gl_Vertex);\n"
+    "}\n";
+
+const char* referenceFragmentShader =
+    "#version 120\n"
+    "varying vec3 normal;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(normal, 1.0);\n"
+    "}\n";
+
+const char* multiDrawIndirectVertexShader =
+    "#version 430 compatibility\n"
+    "#extension GL_ARB_shader_draw_parameters : require\n"
+    "layout(std430, binding = 0) buffer osg_DrawModelViewMatrices { mat4 osg_DrawModelViewMatrix[]; };\n"
+    "out vec3 normal;\n"
+    "void main()\n"
+    "{\n"
+    "    normal = abs(gl_Normal);\n"
+    "    gl_Position = gl_ProjectionMatrix * (osg_DrawModelViewMatrix[gl_DrawIDARB] * gl_Vertex);\n"
+    "}\n";
+
+const char* multiDrawIndirectFragmentShader =
+    "#version 430 compatibility\n"
+    "in vec3 normal;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = vec4(normal, 1.0);\n"
+    "}\n";
+
+osg::Geometry* createPyramid(unsigned int numSides, float height)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUShort> indices = new osg::DrawElementsUShort(GL_TRIANGLES);
+
+    osg::Vec3 apex(0.0f, 0.0f, height);
+    for(unsigned int i=0; i<numSides; ++i)
+    {
+        float a0 = osg::PI*2.0f*float(i)/float(numSides);
+        float a1 = osg::PI*2.0f*float(i+1)/float(numSides);
+        osg::Vec3 v0(cosf(a0), sinf(a0), 0.0f);
+        osg::Vec3 v1(cosf(a1), sinf(a1), 0.0f);
+
+        osg::Vec3 normal = (v1-v0)^(apex-v0);
+        normal.normalize();
+
+        unsigned int base = vertices->size();
+        vertices->push_back(v0); normals->push_back(normal);
+        vertices->push_back(v1); normals->push_back(normal);
+        vertices->push_back(apex); normals->push_back(normal);
+
+        indices->push_back(base);
+        indices->push_back(base+1);
+        indices->push_back(base+2);
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setUseDisplayList(false);
+    geometry->setUseVertexBufferObjects(true);
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(indices.get());
+    return geometry;
+}
+
+/** Create a grid of pyramids scaled by scale, if mixUnbatchable is true every other pyramid is given a color array, which the
+  * shaders ignore but which stops the MultiDrawIndirectBin batching it.*/
+osg::Node* createScene(unsigned int numColumns, osg::StateSet* stateset, bool mixUnbatchable, float scale)
+{
+    std::vector< osg::ref_ptr<osg::Geometry> > geometries;
+    for(unsigned int i=3; i<8; ++i)
+    {
+        geometries.push_back(createPyramid(i, 0.5f+0.25f*float(i)));
+        if (mixUnbatchable)
+        {
+            osg::Geometry* geometry = createPyramid(i, 0.5f+0.25f*float(i));
+            osg::Vec4Array* colors = new osg::Vec4Array;
+            colors->push_back(osg::Vec4(1.0f,1.0f,1.0f,1.0f));
+            geometry->setColorArray(colors, osg::Array::BIND_OVERALL);
+            geometries.push_back(geometry);
+        }
+    }
+
+    osg::Group* group = new osg::Group;
+    group->setStateSet(stateset);
+
+    float offset = float(numColumns)*0.5f;
+    for(unsigned int r=0; r<numColumns; ++r)
+    {
+        for(unsigned int c=0; c<numColumns; ++c)
+        {
+            unsigned int i = r*numColumns+c;
+
+            osg::Geode* geode = new osg::Geode;
+            geode->addDrawable(geometries[i%geometries.size()].get());
+
+            osg::MatrixTransform* transform = new osg::MatrixTransform;
+            transform->setMatrix(osg::Matrix::rotate(float(i)*0.37f, osg::Vec3(0.0f,0.0f,1.0f)) *
+                                 osg::Matrix::scale(scale, scale, scale) *
+                                 osg::Matrix::translate(float(c)-offset, float(r)-offset, 0.0f));
+            transform->addChild(geode);
+
+            group->addChild(transform);
+        }
+    }
+
+    return group;
+}
+
+/** Create the StateSet of a scene, without depth testing the image depends on the order the leaves are drawn in.*/
+osg::StateSet* createStateSet(const char* vertexShader, const char* fragmentShader, const std::string& binName, bool depthTest)
+{
+    osg::ref_ptr<osg::Program> program = new osg::Program;
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, vertexShader));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, fragmentShader));
+
+    osg::StateSet* stateset = new osg::StateSet;
+    stateset->setAttributeAndModes(program.get());
+    stateset->setMode(GL_CULL_FACE, osg::StateAttribute::OFF);
+    if (!depthTest) stateset->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+    stateset->setRenderBinDetails(1, binName);
+    return stateset;
+}
+
+struct CaptureCallback : public osg::Camera::DrawCallback
+{
+    CaptureCallback():
+        _capture(false),
+        _supported(false) {}
+
+    virtual void operator () (osg::RenderInfo& renderInfo) const
+    {
+        _supported = osgUtil::MultiDrawIndirectBin::isSupported(renderInfo.getContextID());
+
+        if (_capture)
+        {
+            const osg::Viewport* viewport = renderInfo.getCurrentCamera()->getViewport();
+            _image = new osg::Image;
+            _image->readPixels(int(viewport->x()), int(viewport->y()), int(viewport->width()), int(viewport->height()), GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    }
+
+    bool                                _capture;
+    mutable bool                        _supported;
+    mutable osg::ref_ptr<osg::Image>    _image;
+};
+
+double renderFrames(osgViewer::Viewer& viewer, CaptureCallback* capture, unsigned int numFrames)
+{
+    // first frame compiles the shaders and uploads the geometry.
+    capture->_capture = false;
+    viewer.frame();
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int i=0; i<numFrames; ++i)
+    {
+        viewer.frame();
+    }
+    osg::Timer_t end = osg::Timer::instance()->tick();
+
+    capture->_capture = true;
+    viewer.frame();
+    capture->_capture = false;
+
+    return osg::Timer::instance()->delta_m(start, end)/double(numFrames);
+}
+
+unsigned int countLitPixels(const osg::Image* image)
+{
+    if (!image) return 0;
+
+    unsigned int numLit = 0;
+    for(int t=0; t<image->t(); ++t)
+    {
+        const unsigned char* p = image->data(0,t);
+        for(int s=0; s<image->s(); ++s, p+=4)
+        {
+            if (p[0]!=0 || p[1]!=0 || p[2]!=0) ++numLit;
+        }
+    }
+    return numLit;
+}
+
+unsigned int countMismatchingPixels(const osg::Image* lhs, const osg::Image* rhs)
+{
+    if (!lhs || !rhs || lhs->s()!=rhs->s() || lhs->t()!=rhs->t()) return ~0u;
+
+    unsigned int numMismatches = 0;
+    for(int t=0; t<lhs->t(); ++t)
+    {
+        const unsigned char* lp = lhs->data(0,t);
+        const unsigned char* rp = rhs->data(0,t);
+        for(int s=0; s<lhs->s(); ++s, lp+=4, rp+=4)
+        {
+            for(int c=0; c<4; ++c)
+            {
+                if (osg::absolute(int(lp[c])-int(rp[c]))>1) { ++numMismatches; break; }
+            }
+        }
+    }
+    return numMismatches;
+}
+
+struct SceneComparison
+{
+    SceneComparison():
+        supported(false),
+        referenceTime(0.0),
+        multiDrawIndirectTime(0.0),
+        numLitPixels(0),
+        numMismatches(0) {}
+
+    bool            supported;
+    double          referenceTime;
+    double          multiDrawIndirectTime;
+    unsigned int    numLitPixels;
+    unsigned int    numMismatches;
+};
+
+/** Render the same scene through a RenderBin and a MultiDrawIndirectBin and compare the images, if orderSensitive is true
+  * the pyramids overlap and are drawn without depth testing, so the images only match if the leaves are drawn in the same order.*/
+SceneComparison compareScenes(osgViewer::Viewer& viewer, CaptureCallback* capture, unsigned int numColumns, bool mixUnbatchable, bool orderSensitive, unsigned int numFrames)
+{
+    SceneComparison comparison;
+
+    viewer.getCamera()->setViewMatrixAsLookAt(osg::Vec3d(0.0, -1.5*double(numColumns), 1.5*double(numColumns)), osg::Vec3d(0.0,0.0,0.0), osg::Vec3d(0.0,0.0,1.0));
+
+    float scale = orderSensitive ? 0.9f : 0.4f;
+    osg::ref_ptr<osg::Node> referenceScene = createScene(numColumns, createStateSet(referenceVertexShader, referenceFragmentShader, "RenderBin", !orderSensitive), mixUnbatchable, scale);
+    osg::ref_ptr<osg::Node> multiDrawIndirectScene = createScene(numColumns, createStateSet(multiDrawIndirectVertexShader, multiDrawIndirectFragmentShader, "MultiDrawIndirectBin", !orderSensitive), mixUnbatchable, scale);
+
+    viewer.setSceneData(referenceScene.get());
+
+    comparison.referenceTime = renderFrames(viewer, capture, numFrames);
+    osg::ref_ptr<osg::Image> referenceImage = capture->_image;
+
+    comparison.supported = capture->_supported;
+    if (!comparison.supported) return comparison;
+
+    viewer.setSceneData(multiDrawIndirectScene.get());
+
+    comparison.multiDrawIndirectTime = renderFrames(viewer, capture, numFrames);
+    osg::ref_ptr<osg::Image> multiDrawIndirectImage = capture->_image;
+
+    comparison.numLitPixels = countLitPixels(referenceImage.get());
+    comparison.numMismatches = countMismatchingPixels(referenceImage.get(), multiDrawIndirectImage.get());
+    return comparison;
+}
+
+}
+
+void runMultiDrawIndirectTests(unsigned int numColumns)
+{
+    unsigned int width = 512;
+    unsigned int height = 512;
+    unsigned int numFrames = 50;
+
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = width;
+    traits->height = height;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer.valid())
+    {
+        std::cout<<"MultiDrawIndirectBin tests skipped, unable to create a pbuffer."<<std::endl;
+        return;
+    }
+
+    osg::ref_ptr<CaptureCallback> capture = new CaptureCallback;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setDrawBuffer(GL_FRONT);
+    camera->setReadBuffer(GL_FRONT);
+    camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,1.0f));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsPerspective(30.0, double(width)/double(height), 1.0, 1000.0);
+    camera->setFinalDrawCallback(capture.get());
+
+    viewer.realize();
+
+    unsigned int maxMismatches = width*height/1000;
+
+    SceneComparison grid = compareScenes(viewer, capture.get(), numColumns, false, false, numFrames);
+    if (!grid.supported)
+    {
+        std::cout<<"MultiDrawIndirectBin tests skipped, graphics context lacks multi draw indirect, shader storage buffer or shader draw parameters support."<<std::endl;
+        return;
+    }
+
+    std::cout<<"MultiDrawIndirectBin "<<numColumns*numColumns<<" leaves : RenderBin "<<grid.referenceTime<<"ms per frame, "
+             <<"MultiDrawIndirectBin "<<grid.multiDrawIndirectTime<<"ms per frame, "
+             <<grid.numMismatches<<" mismatching pixels"<<std::endl;
+
+    if (grid.numMismatches>maxMismatches)
+    {
+        std::cout<<"Error: MultiDrawIndirectBin rendering differs from RenderBin rendering"<<std::endl;
+    }
+
+    // a lone leaf is below the minimum batch size so is drawn on its own, but still through the multi draw indirect shader.
+    SceneComparison single = compareScenes(viewer, capture.get(), 1, false, false, 1);
+    if (single.numLitPixels==0 || single.numMismatches>maxMismatches)
+    {
+        std::cout<<"Error: MultiDrawIndirectBin single leaf rendering differs from RenderBin rendering, "<<single.numMismatches<<" mismatching pixels"<<std::endl;
+    }
+
+    SceneComparison mixed = compareScenes(viewer, capture.get(), numColumns, true, false, 1);
+    if (mixed.numMismatches>maxMismatches)
+    {
+        std::cout<<"Error: MultiDrawIndirectBin rendering of unbatchable leaves differs from RenderBin rendering, "<<mixed.numMismatches<<" mismatching pixels"<<std::endl;
+    }
+
+    // batches are interrupted by the unbatchable leaves, so every leaf is drawn in the same order as by a RenderBin.
+    SceneComparison ordered = compareScenes(viewer, capture.get(), numColumns, true, true, 1);
+    if (ordered.numMismatches>maxMismatches)
+    {
+        std::cout<<"Error: MultiDrawIndirectBin draws leaves in a different order to RenderBin, "<<ordered.numMismatches<<" mismatching pixels"<<std::endl;
+    }
+}
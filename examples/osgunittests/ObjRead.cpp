@@ -0,0 +1,340 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+#include "ObjRead.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Timer>
+
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+const char* pointsFileName = "osgunittests_points.obj";
+const char* gridFileName = "osgunittests_grid.obj";
+const unsigned int numPoints = 16384;
+const unsigned int pointsPerElement = 64;
+const unsigned int gridSize = 384;
+
+unsigned int s_seed = 1;
+
+unsigned int nextRandom()
+{
+    s_seed = s_seed*1103515245u + 12345u;
+    return (s_seed>>8)&0xffffff;
+}
+
+float randomFloat(float range)
+{
+    return (float(nextRandom())/float(0xffffff)*2.0f-1.0f)*range;
+}
+
+// a number in one of the many ways exporters write them, including ones which need more than a simple parse.
+std::string createNumber()
+{
+    char buffer[64];
+    switch(nextRandom()%12)
+    {
+        case(0): sprintf(buffer, "%f", randomFloat(1000.0f)); break;
+        case(1): sprintf(buffer, "%g", randomFloat(1.0f)); break;
+        case(2): sprintf(buffer, "%.9g", randomFloat(100000.0f)); break;
+        case(3): sprintf(buffer, "%.17g", double(randomFloat(10.0f))/3.0); break;
+        case(4): sprintf(buffer, "%e", randomFloat(1.0f)*1e-20f); break;
+        case(5): sprintf(buffer, "%E", randomFloat(1.0f)*1e30f); break;
+        case(6): sprintf(buffer, "%d", int(nextRandom()%2001)-1000); break;
+        case(7): sprintf(buffer, "%.1f", randomFloat(10.0f)); break;
+        case(8): sprintf(buffer, "%.25f", randomFloat(1.0f)); break;
+        case(9): sprintf(buffer, "%+.3f", randomFloat(1.0f)); break;
+        case(10):
+        {
+            const char* special[] = { "-0", "0", "+1.", "-.5", "1e-40", "3.4028235e38", "1.17549435e-38", "0.1", "16777217", "0.30000001192092896", "1e-7", "123456789012345678901234567890" };
+            sprintf(buffer, "%s", special[nextRandom()%12]);
+            break;
+        }
+        default: sprintf(buffer, "%.4f", randomFloat(100.0f)); break;
+    }
+    return buffer;
+}
+
+/** Write points with awkward numbers, line endings, continuations and white space, which read with noRotation
+  * should give a single geometry with the vertices in the order written, and return the vertices sscanf reads,
+  * as the plugin always has, from the text.*/
+bool writePoints(const char* filename, std::vector<osg::Vec3>& expected)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) return false;
+
+    const char* endOfLines[] = { "\n", "\r\n", "\n", " \t\n", "\n", "\r" };
+
+    out<<"# points to check the number parsing"<<endOfLines[0];
+    out<<"vn 0 0 1"<<endOfLines[1];
+    for(unsigned int i=0; i<numPoints; ++i)
+    {
+        std::string x = createNumber(), y = createNumber(), z = createNumber();
+
+        osg::Vec3 v;
+        sscanf(x.c_str(), "%f", &v.x());
+        sscanf(y.c_str(), "%f", &v.y());
+        sscanf(z.c_str(), "%f", &v.z());
+        expected.push_back(v);
+
+        if (i%97==0) out<<"  v\t"<<x<<"  "<<y<<" \\"<<endOfLines[nextRandom()%2]<<z<<endOfLines[nextRandom()%6];
+        else out<<"v "<<x<<" "<<y<<" "<<z<<endOfLines[nextRandom()%6];
+
+        if ((i+1)%pointsPerElement==0)
+        {
+            // alternate between absolute and relative indices.
+            out<<"p";
+            for(unsigned int j=0; j<pointsPerElement; ++j)
+            {
+                if (((i+1)/pointsPerElement)%2==0) out<<" "<<(i+2-pointsPerElement+j)<<"//1";
+                else out<<" "<<(int(j)-int(pointsPerElement))<<"//-1";
+            }
+            out<<endOfLines[nextRandom()%6];
+        }
+    }
+
+    return out.good();
+}
+
+/** Write a textured grid of triangles split into groups of rows, with the indices of every other group relative.*/
+bool writeGrid(const char* filename)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) return false;
+
+    out<<"# "<<gridSize<<" x "<<gridSize<<" grid"<<std::endl;
+    out<<"o grid"<<std::endl;
+    for(unsigned int r=0; r<gridSize; ++r)
+    {
+        for(unsigned int c=0; c<gridSize; ++c)
+        {
+            char buffer[128];
+            float x = float(c)/float(gridSize-1);
+            float y = float(r)/float(gridSize-1);
+            sprintf(buffer, "v %f %f %f\nvt %f %f\nvn %f %f %f\n", x, y, sinf(x*10.0f)*cosf(y*7.0f), x, y, randomFloat(0.1f), randomFloat(0.1f), 1.0f);
+            out<<buffer;
+        }
+    }
+
+    const unsigned int rowsPerGroup = 32;
+    const int numVertices = gridSize*gridSize;
+    for(unsigned int r=0; r<gridSize-1; ++r)
+    {
+        if (r%rowsPerGroup==0)
+        {
+            out<<"g rows_"<<r<<std::endl;
+            out<<"s "<<(r/rowsPerGroup)%4<<std::endl;
+        }
+
+        bool relative = (r/rowsPerGroup)%2==1;
+        for(unsigned int c=0; c<gridSize-1; ++c)
+        {
+            int i = r*gridSize+c+1;
+            int corners[4] = { i, i+1, i+int(gridSize)+1, i+int(gridSize) };
+            if (relative)
+            {
+                for(unsigned int k=0; k<4; ++k) corners[k] -= numVertices+1;
+            }
+
+            out<<"f "<<corners[0]<<"/"<<corners[0]<<"/"<<corners[0]
+               <<" "<<corners[1]<<"/"<<corners[1]<<"/"<<corners[1]
+               <<" "<<corners[2]<<"/"<<corners[2]<<"/"<<corners[2]<<"\n";
+            out<<"f "<<corners[0]<<"//"<<corners[0]
+               <<" "<<corners[2]<<"//"<<corners[2]
+               <<" "<<corners[3]<<"//"<<corners[3]<<"\n";
+        }
+    }
+
+    return out.good();
+}
+
+class CollectGeometriesVisitor : public osg::NodeVisitor
+{
+public:
+
+    CollectGeometriesVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+    virtual void apply(osg::Geode& geode)
+    {
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+            if (geometry)
+            {
+                _names.push_back(geode.getName());
+                _geometries.push_back(geometry);
+            }
+        }
+    }
+
+    std::vector<std::string> _names;
+    std::vector<osg::Geometry*> _geometries;
+};
+
+bool sameArray(const osg::Array* lhs, const osg::Array* rhs)
+{
+    if (!lhs || !rhs) return lhs==rhs;
+    return lhs->getTotalDataSize()==rhs->getTotalDataSize() &&
+           memcmp(lhs->getDataPointer(), rhs->getDataPointer(), lhs->getTotalDataSize())==0;
+}
+
+bool samePrimitiveSet(const osg::PrimitiveSet* lhs, const osg::PrimitiveSet* rhs)
+{
+    if (lhs->getType()!=rhs->getType() || lhs->getMode()!=rhs->getMode() || lhs->getNumIndices()!=rhs->getNumIndices()) return false;
+
+    for(unsigned int i=0; i<lhs->getNumIndices(); ++i)
+    {
+        if (lhs->index(i)!=rhs->index(i)) return false;
+    }
+
+    const osg::DrawArrayLengths* lhsLengths = dynamic_cast<const osg::DrawArrayLengths*>(lhs);
+    const osg::DrawArrayLengths* rhsLengths = dynamic_cast<const osg::DrawArrayLengths*>(rhs);
+    if (lhsLengths && rhsLengths)
+    {
+        return static_cast<const osg::DrawArrayLengths::vector_type&>(*lhsLengths)==static_cast<const osg::DrawArrayLengths::vector_type&>(*rhsLengths);
+    }
+    return true;
+}
+
+bool sameScene(osg::Node* lhs, osg::Node* rhs)
+{
+    if (!lhs || !rhs) return false;
+
+    CollectGeometriesVisitor lhsGeometries, rhsGeometries;
+    lhs->accept(lhsGeometries);
+    rhs->accept(rhsGeometries);
+
+    if (lhsGeometries._names!=rhsGeometries._names) return false;
+
+    for(unsigned int i=0; i<lhsGeometries._geometries.size(); ++i)
+    {
+        osg::Geometry* lg = lhsGeometries._geometries[i];
+        osg::Geometry* rg = rhsGeometries._geometries[i];
+        if (!sameArray(lg->getVertexArray(), rg->getVertexArray()) ||
+            !sameArray(lg->getNormalArray(), rg->getNormalArray()) ||
+            !sameArray(lg->getTexCoordArray(0), rg->getTexCoordArray(0)) ||
+            lg->getNumPrimitiveSets()!=rg->getNumPrimitiveSets()) return false;
+
+        for(unsigned int p=0; p<lg->getNumPrimitiveSets(); ++p)
+        {
+            if (!samePrimitiveSet(lg->getPrimitiveSet(p), rg->getPrimitiveSet(p))) return false;
+        }
+    }
+    return true;
+}
+
+osg::ref_ptr<osg::Node> readOBJ(const char* filename, const std::string& optionString, double& time)
+{
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options(optionString);
+    options->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::Node> node = osgDB::readRefNodeFile(filename, options.get());
+    time = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+    return node;
+}
+
+}
+
+void runObjReadTests(unsigned int maxNumThreads)
+{
+    if (!osgDB::Registry::instance()->getReaderWriterForExtension("obj"))
+    {
+        std::cout<<"obj read tests skipped, no obj plugin"<<std::endl;
+        return;
+    }
+
+    bool passed = true;
+    double time = 0.0;
+
+    std::vector<osg::Vec3> expected;
+    if (writePoints(pointsFileName, expected))
+    {
+        for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+        {
+            std::ostringstream optionString;
+            optionString<<"noRotation noTriStripPolygons parseThreads="<<numThreads;
+
+            osg::ref_ptr<osg::Node> node = readOBJ(pointsFileName, optionString.str(), time);
+
+            CollectGeometriesVisitor geometries;
+            if (node.valid()) node->accept(geometries);
+
+            const osg::Vec3Array* vertices = geometries._geometries.size()==1 ? dynamic_cast<const osg::Vec3Array*>(geometries._geometries[0]->getVertexArray()) : 0;
+            if (!vertices || vertices->size()!=expected.size() || memcmp(&vertices->front(), &expected.front(), expected.size()*sizeof(osg::Vec3))!=0)
+            {
+                std::cout<<"Error: points read with "<<numThreads<<" threads differ from those written"<<std::endl;
+                passed = false;
+            }
+        }
+    }
+    else
+    {
+        std::cout<<"Error: unable to write "<<pointsFileName<<std::endl;
+        passed = false;
+    }
+    remove(pointsFileName);
+
+    if (writeGrid(gridFileName))
+    {
+        std::ifstream fin(gridFileName, std::ios::in | std::ios::binary);
+        fin.seekg(0, std::ios::end);
+        double megabytes = double(fin.tellg())/(1024.0*1024.0);
+        fin.close();
+
+        osg::ref_ptr<osg::Node> reference = readOBJ(gridFileName, "noTriStripPolygons NoMemoryMapping parseThreads=1", time);
+        std::cout<<"obj read through a stream with 1 thread, "<<megabytes<<"MB : "<<time<<"ms ("<<megabytes/(time*0.001)<<"MB/s)"<<std::endl;
+
+        for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+        {
+            std::ostringstream optionString;
+            optionString<<"noTriStripPolygons parseThreads="<<numThreads;
+
+            osg::ref_ptr<osg::Node> node = readOBJ(gridFileName, optionString.str(), time);
+            std::cout<<"obj read memory mapped with "<<numThreads<<" threads, "<<megabytes<<"MB : "<<time<<"ms ("<<megabytes/(time*0.001)<<"MB/s)"<<std::endl;
+
+            if (!sameScene(reference.get(), node.get()))
+            {
+                std::cout<<"Error: grid read with "<<numThreads<<" threads differs from the grid read through a stream"<<std::endl;
+                passed = false;
+            }
+        }
+    }
+    else
+    {
+        std::cout<<"Error: unable to write "<<gridFileName<<std::endl;
+        passed = false;
+    }
+    remove(gridFileName);
+
+    if (!passed) std::cout<<"Error: obj read tests failed"<<std::endl;
+}
@@ -0,0 +1,294 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+#include "ObjectCacheTests.h"
+
+#include <osg/Image>
+#include <osg/Timer>
+
+#include <osgDB/ObjectCache>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <vector>
+
+namespace
+{
+
+const unsigned int numNames = 4096;
+const unsigned int numLookupsPerThread = 200000;
+
+std::string createFileName(unsigned int i)
+{
+    std::ostringstream str;
+    str<<"terrain/textures/L"<<i%16<<"/X"<<i/16<<"_Y"<<i%64<<".dds";
+    return str.str();
+}
+
+osg::Image* createImage(unsigned int size)
+{
+    osg::Image* image = new osg::Image;
+    image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    return image;
+}
+
+/** The cache as it was before, one map behind a single mutex, to time the sharded cache against.*/
+class SingleMutexCache
+{
+public:
+
+    void add(const std::string& fileName, osg::Object* object)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        _objects[fileName] = object;
+    }
+
+    osg::ref_ptr<osg::Object> get(const std::string& fileName)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        Objects::iterator itr = _objects.find(fileName);
+        return itr!=_objects.end() ? itr->second : 0;
+    }
+
+protected:
+
+    typedef std::map<std::string, osg::ref_ptr<osg::Object> > Objects;
+    OpenThreads::Mutex  _mutex;
+    Objects             _objects;
+};
+
+typedef std::vector<std::string> FileNames;
+
+class LookupThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    LookupThread(osgDB::ObjectCache* cache, SingleMutexCache* singleMutexCache, const FileNames& fileNames, unsigned int seed, OpenThreads::Barrier& startBarrier, OpenThreads::Barrier& endBarrier):
+        _cache(cache),
+        _singleMutexCache(singleMutexCache),
+        _fileNames(fileNames),
+        _seed(seed),
+        _startBarrier(startBarrier),
+        _endBarrier(endBarrier),
+        _numFound(0) {}
+
+    virtual void run()
+    {
+        _startBarrier.block();
+
+        unsigned int r = _seed;
+        for(unsigned int i=0; i<numLookupsPerThread; ++i)
+        {
+            r = r*1664525u + 1013904223u;
+            const std::string& fileName = _fileNames[(r>>8)%_fileNames.size()];
+            osg::ref_ptr<osg::Object> object = _cache ? _cache->getRefFromObjectCache(fileName) : _singleMutexCache->get(fileName);
+            if (object.valid()) ++_numFound;
+        }
+
+        _endBarrier.block();
+    }
+
+    unsigned int getNumFound() const { return _numFound; }
+
+protected:
+
+    virtual ~LookupThread() {}
+
+    osgDB::ObjectCache*         _cache;
+    SingleMutexCache*           _singleMutexCache;
+    const FileNames&            _fileNames;
+    unsigned int                _seed;
+    OpenThreads::Barrier&       _startBarrier;
+    OpenThreads::Barrier&       _endBarrier;
+    unsigned int                _numFound;
+};
+
+double lookup(osgDB::ObjectCache* cache, SingleMutexCache* singleMutexCache, const FileNames& fileNames, unsigned int numThreads, unsigned int& numFound)
+{
+    OpenThreads::Barrier startBarrier(numThreads+1);
+    OpenThreads::Barrier endBarrier(numThreads+1);
+
+    typedef std::vector< osg::ref_ptr<LookupThread> > Threads;
+    Threads threads;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads.push_back(new LookupThread(cache, singleMutexCache, fileNames, i*7919+1, startBarrier, endBarrier));
+        threads.back()->startThread();
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    startBarrier.block();
+    endBarrier.block();
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    for(Threads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        while((*itr)->isRunning()) OpenThreads::Thread::YieldCurrentThread();
+        numFound += (*itr)->getNumFound();
+    }
+
+    return osg::Timer::instance()->delta_m(startTick, endTick);
+}
+
+bool testEviction()
+{
+    bool passed = true;
+
+    // each image is 64*64*4 bytes, so the cache has room for 64 of them.
+    const unsigned int imageSize = 64*64*4;
+    osg::ref_ptr<osgDB::ObjectCache> cache = new osgDB::ObjectCache;
+    cache->setMaxSize(64*imageSize);
+
+    osg::ref_ptr<osg::Image> image = createImage(64);
+    if (osgDB::ObjectCache::computeObjectSize(image.get())!=imageSize)
+    {
+        std::cout<<"Error: computeObjectSize() of a 64x64 RGBA image returned "<<osgDB::ObjectCache::computeObjectSize(image.get())<<std::endl;
+        passed = false;
+    }
+
+    // keep the first image referenced, it should never be evicted.
+    osg::ref_ptr<osg::Image> held = createImage(64);
+    cache->addEntryToObjectCache(createFileName(0), held.get());
+
+    for(unsigned int i=1; i<numNames; ++i)
+    {
+        cache->addEntryToObjectCache(createFileName(i), createImage(64));
+
+        // keep touching the second image so it stays among the most recently used.
+        if (!cache->getFromObjectCache(createFileName(1)))
+        {
+            std::cout<<"Error: most recently used entry evicted after "<<i<<" additions"<<std::endl;
+            passed = false;
+            break;
+        }
+    }
+
+    if (cache->getNumBytes()>cache->getMaxSize())
+    {
+        std::cout<<"Error: object cache holds "<<cache->getNumBytes()<<" bytes, over its "<<cache->getMaxSize()<<" byte budget"<<std::endl;
+        passed = false;
+    }
+
+    if (!cache->getFromObjectCache(createFileName(0)))
+    {
+        std::cout<<"Error: externally referenced entry evicted"<<std::endl;
+        passed = false;
+    }
+
+    if (cache->getNumEvictions()+cache->getNumObjects()!=numNames)
+    {
+        std::cout<<"Error: "<<cache->getNumEvictions()<<" evictions and "<<cache->getNumObjects()<<" objects don't account for the "<<numNames<<" added"<<std::endl;
+        passed = false;
+    }
+
+    if (cache->getFromObjectCache("not_in_cache.dds") || cache->getNumMisses()!=1)
+    {
+        std::cout<<"Error: expected a single miss, counted "<<cache->getNumMisses()<<std::endl;
+        passed = false;
+    }
+
+    // expiry still applies, and leaves nothing behind.
+    cache->updateTimeStampOfObjectsInCacheWithExternalReferences(10.0);
+    cache->removeExpiredObjectsInCache(5.0);
+    if (cache->getNumObjects()!=1 || cache->getNumBytes()!=imageSize)
+    {
+        std::cout<<"Error: expiry left "<<cache->getNumObjects()<<" objects and "<<cache->getNumBytes()<<" bytes, expected just the referenced image"<<std::endl;
+        passed = false;
+    }
+
+    cache->clear();
+    if (cache->getNumObjects()!=0 || cache->getNumBytes()!=0)
+    {
+        std::cout<<"Error: clear() left "<<cache->getNumObjects()<<" objects and "<<cache->getNumBytes()<<" bytes"<<std::endl;
+        passed = false;
+    }
+
+    // an object bigger than a shard's share of the budget stays while the cache as a whole is within it.
+    cache->resetStats();
+    cache->addEntryToObjectCache(createFileName(0), createImage(256));
+    cache->addEntryToObjectCache(createFileName(1), createImage(64));
+    if (cache->getNumEvictions()!=0 || !cache->getFromObjectCache(createFileName(0)))
+    {
+        std::cout<<"Error: object of a quarter of the budget evicted from a cache within its budget"<<std::endl;
+        passed = false;
+    }
+
+    // the least recently used entry goes first, whichever shard it is in.
+    for(unsigned int i=2; i<numNames && cache->getNumEvictions()==0; ++i)
+    {
+        cache->getFromObjectCache(createFileName(0));
+        cache->addEntryToObjectCache(createFileName(i), createImage(64));
+    }
+    if (cache->getNumEvictions()!=1 || cache->getFromObjectCache(createFileName(1)) || !cache->getFromObjectCache(createFileName(0)))
+    {
+        std::cout<<"Error: least recently used entry not the first evicted"<<std::endl;
+        passed = false;
+    }
+
+    return passed;
+}
+
+}
+
+void runObjectCacheTests(unsigned int maxNumThreads)
+{
+    bool passed = testEviction();
+
+    // time concurrent lookups, a quarter of which miss, against the single mutex cache.
+    FileNames fileNames;
+    osg::ref_ptr<osgDB::ObjectCache> cache = new osgDB::ObjectCache;
+    SingleMutexCache singleMutexCache;
+    for(unsigned int i=0; i<numNames; ++i)
+    {
+        fileNames.push_back(createFileName(i));
+        if (i%4==3) continue;
+
+        osg::ref_ptr<osg::Image> image = createImage(4);
+        cache->addEntryToObjectCache(fileNames.back(), image.get());
+        singleMutexCache.add(fileNames.back(), image.get());
+    }
+
+    for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+    {
+        unsigned int numFoundSingle = 0, numFoundSharded = 0;
+        double singleTime = lookup(0, &singleMutexCache, fileNames, numThreads, numFoundSingle);
+        double shardedTime = lookup(cache.get(), 0, fileNames, numThreads, numFoundSharded);
+
+        double numLookups = double(numLookupsPerThread)*double(numThreads);
+        std::cout<<"object cache "<<numLookups<<" lookups with "<<numThreads<<" threads : "
+                 <<"single mutex "<<singleTime<<"ms ("<<numLookups/(singleTime*1000.0)<<"M/s), "
+                 <<"sharded "<<shardedTime<<"ms ("<<numLookups/(shardedTime*1000.0)<<"M/s)"<<std::endl;
+
+        if (numFoundSingle!=numFoundSharded)
+        {
+            std::cout<<"Error: sharded cache found "<<numFoundSharded<<" objects, single mutex cache "<<numFoundSingle<<std::endl;
+            passed = false;
+        }
+    }
+
+    cache->reportStats(std::cout);
+
+    if (!passed) std::cout<<"Error: object cache tests failed"<<std::endl;
+}
@@ -0,0 +1,213 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+
+#include "OptimizerThreads.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Group>
+#include <osg/Timer>
+
+#include <osgUtil/Optimizer>
+
+#include <iostream>
+#include <vector>
+
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+
+const unsigned int numGeodes = 64;
+const unsigned int numGeometriesPerGeode = 4;
+const unsigned int gridSize = 24;
+
+// an unindexed triangle grid, so INDEX_MESH has duplicate vertices to remove.
+osg::Geometry* createGridGeometry(unsigned int seed)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+
+    for(unsigned int r=0; r<gridSize; ++r)
+    {
+        for(unsigned int c=0; c<gridSize; ++c)
+        {
+            unsigned int corners[6][2] = { {c,r}, {c+1,r}, {c,r+1}, {c+1,r}, {c+1,r+1}, {c,r+1} };
+            for(unsigned int i=0; i<6; ++i)
+            {
+                float x = float(corners[i][0]);
+                float y = float(corners[i][1]);
+                float z = sinf(x*0.3f+float(seed))*cosf(y*0.2f);
+                vertices->push_back(osg::Vec3(x+float(seed%numGeometriesPerGeode)*float(gridSize), y, z));
+                normals->push_back(osg::Vec3(-z, z*0.5f, 1.0f));
+            }
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, vertices->size()));
+    return geometry;
+}
+
+osg::Node* createScene()
+{
+    osg::ref_ptr<osg::Group> group = new osg::Group;
+    for(unsigned int g=0; g<numGeodes; ++g)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        for(unsigned int i=0; i<numGeometriesPerGeode; ++i)
+        {
+            geode->addDrawable(createGridGeometry(g*numGeometriesPerGeode+i));
+        }
+
+        // every eighth Geode shares a normal array with the previous one, so the scheduler has to group them.
+        if (g%8==7)
+        {
+            osg::Geode* previous = group->getChild(g-1)->asGeode();
+            geode->getDrawable(0)->asGeometry()->setNormalArray(previous->getDrawable(0)->asGeometry()->getNormalArray(), osg::Array::BIND_PER_VERTEX);
+        }
+
+        group->addChild(geode.get());
+    }
+    return group.release();
+}
+
+class CollectGeometryVisitor : public osg::NodeVisitor
+{
+    public:
+
+        CollectGeometryVisitor():
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        virtual void apply(osg::Geode& geode)
+        {
+            for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+            {
+                if (geode.getDrawable(i)->asGeometry()) _geometries.push_back(geode.getDrawable(i)->asGeometry());
+            }
+        }
+
+        std::vector<const osg::Geometry*> _geometries;
+};
+
+bool sameData(const osg::Array* lhs, const osg::Array* rhs)
+{
+    if (!lhs || !rhs) return lhs==rhs;
+    return lhs->getType()==rhs->getType() &&
+           lhs->getTotalDataSize()==rhs->getTotalDataSize() &&
+           memcmp(lhs->getDataPointer(), rhs->getDataPointer(), lhs->getTotalDataSize())==0;
+}
+
+bool samePrimitiveSet(const osg::PrimitiveSet* lhs, const osg::PrimitiveSet* rhs)
+{
+    if (lhs->getType()!=rhs->getType() || lhs->getMode()!=rhs->getMode() || lhs->getNumIndices()!=rhs->getNumIndices()) return false;
+    for(unsigned int i=0; i<lhs->getNumIndices(); ++i)
+    {
+        if (lhs->index(i)!=rhs->index(i)) return false;
+    }
+    return true;
+}
+
+bool sameScene(osg::Node* lhs, osg::Node* rhs)
+{
+    CollectGeometryVisitor lcgv, rcgv;
+    lhs->accept(lcgv);
+    rhs->accept(rcgv);
+    if (lcgv._geometries.size()!=rcgv._geometries.size()) return false;
+
+    for(unsigned int g=0; g<lcgv._geometries.size(); ++g)
+    {
+        const osg::Geometry* lg = lcgv._geometries[g];
+        const osg::Geometry* rg = rcgv._geometries[g];
+        if (!sameData(lg->getVertexArray(), rg->getVertexArray()) ||
+            !sameData(lg->getNormalArray(), rg->getNormalArray()) ||
+            lg->getNumPrimitiveSets()!=rg->getNumPrimitiveSets()) return false;
+
+        for(unsigned int i=0; i<lg->getNumPrimitiveSets(); ++i)
+        {
+            if (!samePrimitiveSet(lg->getPrimitiveSet(i), rg->getPrimitiveSet(i))) return false;
+        }
+    }
+    return true;
+}
+
+const unsigned int meshOptimizations = osgUtil::Optimizer::MERGE_GEOMETRY |
+                                       osgUtil::Optimizer::INDEX_MESH |
+                                       osgUtil::Optimizer::VERTEX_POSTTRANSFORM |
+                                       osgUtil::Optimizer::VERTEX_PRETRANSFORM;
+
+// the vertex cache passes expect triangle lists, so strip the optimized meshes in a second call.
+double optimizeScene(osg::Node* scene, unsigned int numThreads, osgUtil::Optimizer::PassTimings& timings)
+{
+    osgUtil::Optimizer optimizer;
+    optimizer.setNumThreads(numThreads);
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    optimizer.optimize(scene, meshOptimizations);
+    timings = optimizer.getPassTimings();
+
+    optimizer.optimize(scene, osgUtil::Optimizer::TRISTRIP_GEOMETRY);
+    timings.insert(timings.end(), optimizer.getPassTimings().begin(), optimizer.getPassTimings().end());
+
+    return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+}
+
+void printPassTimings(const osgUtil::Optimizer::PassTimings& timings)
+{
+    for(osgUtil::Optimizer::PassTimings::const_iterator itr = timings.begin();
+        itr != timings.end();
+        ++itr)
+    {
+        std::cout<<"    "<<itr->first<<" "<<itr->second*1000.0<<"ms"<<std::endl;
+    }
+}
+
+}
+
+void runOptimizerThreadTests(unsigned int maxNumThreads)
+{
+    osgUtil::Optimizer::PassTimings timings;
+
+    osg::ref_ptr<osg::Node> reference = createScene();
+    double serialTime = optimizeScene(reference.get(), 1, timings);
+
+    std::cout<<"Optimizer of "<<numGeodes*numGeometriesPerGeode<<" geometries, 1 thread : "<<serialTime<<"ms"<<std::endl;
+    printPassTimings(timings);
+
+    bool passed = true;
+    for(unsigned int numThreads=2; numThreads<=maxNumThreads; ++numThreads)
+    {
+        osg::ref_ptr<osg::Node> scene = createScene();
+        double time = optimizeScene(scene.get(), numThreads, timings);
+
+        std::cout<<"Optimizer of "<<numGeodes*numGeometriesPerGeode<<" geometries, "<<numThreads<<" threads : "<<time<<"ms, speed up "<<serialTime/time<<std::endl;
+        printPassTimings(timings);
+
+        if (!sameScene(reference.get(), scene.get()))
+        {
+            std::cout<<"Error: optimizing with "<<numThreads<<" threads gives a different result to a single thread"<<std::endl;
+            passed = false;
+        }
+    }
+
+    if (!passed) std::cout<<"Error: optimizer thread tests failed"<<std::endl;
+}
@@ -0,0 +1,272 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+#include "OsgaRead.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+
+#include <osgDB/Archive>
+#include <osgDB/MappedFile>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Barrier>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+const unsigned int numTiles = 64;
+const unsigned int tileSize = 64;
+const unsigned int numReadsPerThread = 256;
+const char* archiveFileName = "osgunittests_tiles.osga";
+
+osg::Geometry* createTileGeometry(unsigned int tile)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+
+    for(unsigned int r=0; r<tileSize; ++r)
+    {
+        for(unsigned int c=0; c<tileSize; ++c)
+        {
+            float x = float(c)/float(tileSize-1);
+            float y = float(r)/float(tileSize-1);
+            float z = sinf(x*10.0f+float(tile))*cosf(y*7.0f);
+            vertices->push_back(osg::Vec3(x+float(tile), y, z));
+            normals->push_back(osg::Vec3(-z, z*0.5f, 1.0f));
+        }
+    }
+
+    for(unsigned int r=0; r<tileSize-1; ++r)
+    {
+        for(unsigned int c=0; c<tileSize-1; ++c)
+        {
+            unsigned int i = r*tileSize+c;
+            indices->push_back(i); indices->push_back(i+1); indices->push_back(i+tileSize);
+            indices->push_back(i+1); indices->push_back(i+tileSize+1); indices->push_back(i+tileSize);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->addPrimitiveSet(indices.get());
+    return geometry;
+}
+
+std::string createTileFileName(unsigned int tile)
+{
+    std::ostringstream str;
+    str<<"tile_"<<tile<<".osgb";
+    return str.str();
+}
+
+const osg::Geometry* getTileGeometry(const osg::Node* node)
+{
+    const osg::Geode* geode = node ? node->asGeode() : 0;
+    return (geode && geode->getNumDrawables()==1) ? geode->getDrawable(0)->asGeometry() : 0;
+}
+
+bool sameData(const osg::Array* lhs, const osg::Array* rhs)
+{
+    return lhs && rhs &&
+           lhs->getType()==rhs->getType() &&
+           lhs->getTotalDataSize()==rhs->getTotalDataSize() &&
+           memcmp(lhs->getDataPointer(), rhs->getDataPointer(), lhs->getTotalDataSize())==0;
+}
+
+bool sameGeometry(const osg::Geometry* lhs, const osg::Geometry* rhs)
+{
+    if (!lhs || !rhs) return false;
+    if (!sameData(lhs->getVertexArray(), rhs->getVertexArray()) ||
+        !sameData(lhs->getNormalArray(), rhs->getNormalArray())) return false;
+
+    const osg::DrawElementsUInt* lde = dynamic_cast<const osg::DrawElementsUInt*>(lhs->getPrimitiveSet(0));
+    const osg::DrawElementsUInt* rde = dynamic_cast<const osg::DrawElementsUInt*>(rhs->getPrimitiveSet(0));
+    return lde && rde && lde->getMode()==rde->getMode() && static_cast<const osg::DrawElementsUInt::vector_type&>(*lde)==static_cast<const osg::DrawElementsUInt::vector_type&>(*rde);
+}
+
+typedef std::vector< osg::ref_ptr<osg::Geometry> > Tiles;
+
+// each thread reads its own sequence of tiles, so threads are mostly reading different entries of the archive.
+class ArchiveReadThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    ArchiveReadThread(osgDB::Archive* archive, const osgDB::Options* options, const Tiles& tiles, unsigned int first, OpenThreads::Barrier& startBarrier, OpenThreads::Barrier& endBarrier):
+        _archive(archive),
+        _options(options),
+        _tiles(tiles),
+        _first(first),
+        _startBarrier(startBarrier),
+        _endBarrier(endBarrier),
+        _numFailed(0) {}
+
+    virtual void run()
+    {
+        _startBarrier.block();
+
+        for(unsigned int i=0; i<numReadsPerThread; ++i)
+        {
+            unsigned int tile = (_first+i*7)%numTiles;
+            osgDB::ReaderWriter::ReadResult result = _archive->readNode(createTileFileName(tile), _options);
+            if (!sameGeometry(_tiles[tile].get(), getTileGeometry(result.getNode()))) ++_numFailed;
+        }
+
+        _endBarrier.block();
+    }
+
+    unsigned int getNumFailed() const { return _numFailed; }
+
+protected:
+
+    virtual ~ArchiveReadThread() {}
+
+    osgDB::Archive*             _archive;
+    const osgDB::Options*       _options;
+    const Tiles&                _tiles;
+    unsigned int                _first;
+    OpenThreads::Barrier&       _startBarrier;
+    OpenThreads::Barrier&       _endBarrier;
+    unsigned int                _numFailed;
+};
+
+double readArchive(osgDB::Archive* archive, const osgDB::Options* options, const Tiles& tiles, unsigned int numThreads, unsigned int& numFailed)
+{
+    OpenThreads::Barrier startBarrier(numThreads+1);
+    OpenThreads::Barrier endBarrier(numThreads+1);
+
+    typedef std::vector< osg::ref_ptr<ArchiveReadThread> > Threads;
+    Threads threads;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads.push_back(new ArchiveReadThread(archive, options, tiles, i*numTiles/numThreads, startBarrier, endBarrier));
+        threads.back()->startThread();
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    startBarrier.block();
+    endBarrier.block();
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    for(Threads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        while((*itr)->isRunning()) OpenThreads::Thread::YieldCurrentThread();
+        numFailed += (*itr)->getNumFailed();
+    }
+
+    return osg::Timer::instance()->delta_m(startTick, endTick);
+}
+
+}
+
+void runOsgaReadTests(unsigned int maxNumThreads)
+{
+    // don't let the Registry cache the archives, so the write only archive isn't handed back for reading
+    // and the two reading archives are opened with their own settings.
+    osg::ref_ptr<osgDB::Options> mappedOptions = new osgDB::Options;
+    mappedOptions->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    osg::ref_ptr<osgDB::Options> streamOptions = new osgDB::Options("NoMemoryMapping");
+    streamOptions->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    Tiles tiles;
+    {
+        osg::ref_ptr<osgDB::Archive> archive = osgDB::openArchive(archiveFileName, osgDB::Archive::CREATE, 4096, mappedOptions.get());
+        if (!archive)
+        {
+            std::cout<<"osga read tests skipped, unable to create "<<archiveFileName<<std::endl;
+            return;
+        }
+
+        for(unsigned int tile=0; tile<numTiles; ++tile)
+        {
+            osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+            tiles.push_back(createTileGeometry(tile));
+            geode->addDrawable(tiles.back().get());
+
+            if (!archive->writeNode(*geode, createTileFileName(tile)).success())
+            {
+                std::cout<<"osga read tests skipped, unable to write "<<createTileFileName(tile)<<" to the archive"<<std::endl;
+                archive->close();
+                remove(archiveFileName);
+                return;
+            }
+        }
+        archive->close();
+    }
+
+    osg::ref_ptr<osgDB::Archive> mapped = osgDB::openArchive(archiveFileName, osgDB::Archive::READ, 4096, mappedOptions.get());
+    osg::ref_ptr<osgDB::Archive> streamed = osgDB::openArchive(archiveFileName, osgDB::Archive::READ, 4096, streamOptions.get());
+
+    bool passed = mapped.valid() && streamed.valid();
+    if (passed)
+    {
+        double megabytesPerThread = 0.0;
+        {
+            osg::ref_ptr<osgDB::MappedFile> file = new osgDB::MappedFile(archiveFileName);
+            megabytesPerThread = double(file->size())/(1024.0*1024.0)*double(numReadsPerThread)/double(numTiles);
+        }
+
+        for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+        {
+            unsigned int numFailed = 0;
+
+            // alternate between the two archives and keep the best time of each, so both read from a warm page cache.
+            double mappedTime = 0.0, streamTime = 0.0;
+            for(unsigned int pass=0; pass<2; ++pass)
+            {
+                double t = readArchive(streamed.get(), streamOptions.get(), tiles, numThreads, numFailed);
+                if (pass==0 || t<streamTime) streamTime = t;
+
+                t = readArchive(mapped.get(), mappedOptions.get(), tiles, numThreads, numFailed);
+                if (pass==0 || t<mappedTime) mappedTime = t;
+            }
+
+            double megabytes = megabytesPerThread*double(numThreads);
+            std::cout<<"osga read with "<<numThreads<<" threads, "<<megabytes<<"MB : "
+                     <<"serialized ifstream "<<streamTime<<"ms ("<<megabytes/(streamTime*0.001)<<"MB/s), "
+                     <<"memory mapped "<<mappedTime<<"ms ("<<megabytes/(mappedTime*0.001)<<"MB/s)"<<std::endl;
+
+            if (numFailed!=0)
+            {
+                std::cout<<"Error: "<<numFailed<<" reads with "<<numThreads<<" threads differ from the written geometry"<<std::endl;
+                passed = false;
+            }
+        }
+    }
+
+    if (mapped.valid()) mapped->close();
+    if (streamed.valid()) streamed->close();
+    mapped = 0;
+    streamed = 0;
+
+    remove(archiveFileName);
+
+    if (!passed) std::cout<<"Error: osga read tests failed"<<std::endl;
+}
@@ -0,0 +1,183 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "OsgbRead.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <osgDB/MappedFile>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+const unsigned int tileSize = 256;
+
+osg::Geometry* createTileGeometry(unsigned int tile)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec2Array> texcoords = new osg::Vec2Array;
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+
+    for(unsigned int r=0; r<tileSize; ++r)
+    {
+        for(unsigned int c=0; c<tileSize; ++c)
+        {
+            float x = float(c)/float(tileSize-1);
+            float y = float(r)/float(tileSize-1);
+            float z = sinf(x*10.0f+float(tile))*cosf(y*7.0f);
+            vertices->push_back(osg::Vec3(x+float(tile), y, z));
+            normals->push_back(osg::Vec3(-z, z*0.5f, 1.0f));
+            texcoords->push_back(osg::Vec2(x, y));
+        }
+    }
+
+    for(unsigned int r=0; r<tileSize-1; ++r)
+    {
+        for(unsigned int c=0; c<tileSize-1; ++c)
+        {
+            unsigned int i = r*tileSize+c;
+            indices->push_back(i); indices->push_back(i+1); indices->push_back(i+tileSize);
+            indices->push_back(i+1); indices->push_back(i+tileSize+1); indices->push_back(i+tileSize);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+    geometry->setTexCoordArray(0, texcoords.get());
+    geometry->addPrimitiveSet(indices.get());
+    return geometry;
+}
+
+std::string createTileFileName(unsigned int tile)
+{
+    std::ostringstream str;
+    str<<"osgunittests_tile_"<<tile<<".osgb";
+    return str.str();
+}
+
+const osg::Geometry* getTileGeometry(const osg::Node* node)
+{
+    const osg::Geode* geode = node ? node->asGeode() : 0;
+    return (geode && geode->getNumDrawables()==1) ? geode->getDrawable(0)->asGeometry() : 0;
+}
+
+bool sameData(const osg::Array* lhs, const osg::Array* rhs)
+{
+    return lhs && rhs &&
+           lhs->getType()==rhs->getType() &&
+           lhs->getTotalDataSize()==rhs->getTotalDataSize() &&
+           memcmp(lhs->getDataPointer(), rhs->getDataPointer(), lhs->getTotalDataSize())==0;
+}
+
+bool sameGeometry(const osg::Geometry* lhs, const osg::Geometry* rhs)
+{
+    if (!lhs || !rhs) return false;
+    if (!sameData(lhs->getVertexArray(), rhs->getVertexArray()) ||
+        !sameData(lhs->getNormalArray(), rhs->getNormalArray()) ||
+        !sameData(lhs->getTexCoordArray(0), rhs->getTexCoordArray(0))) return false;
+
+    const osg::DrawElementsUInt* lde = dynamic_cast<const osg::DrawElementsUInt*>(lhs->getPrimitiveSet(0));
+    const osg::DrawElementsUInt* rde = dynamic_cast<const osg::DrawElementsUInt*>(rhs->getPrimitiveSet(0));
+    return lde && rde && lde->getMode()==rde->getMode() && static_cast<const osg::DrawElementsUInt::vector_type&>(*lde)==static_cast<const osg::DrawElementsUInt::vector_type&>(*rde);
+}
+
+double readTiles(unsigned int numTiles, const osgDB::Options* options, bool& passed)
+{
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int tile=0; tile<numTiles; ++tile)
+    {
+        osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(createTileFileName(tile), options);
+        if (!getTileGeometry(node.get())) passed = false;
+    }
+    return osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+}
+
+}
+
+void runOsgbReadTests(unsigned int numTiles)
+{
+    osg::ref_ptr<osgDB::Options> mappedOptions = new osgDB::Options;
+    mappedOptions->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    osg::ref_ptr<osgDB::Options> streamOptions = new osgDB::Options("NoMemoryMapping");
+    streamOptions->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    double totalSize = 0.0;
+    bool passed = true;
+    for(unsigned int tile=0; tile<numTiles; ++tile)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(createTileGeometry(tile));
+
+        std::string filename = createTileFileName(tile);
+        if (!osgDB::writeNodeFile(*geode, filename))
+        {
+            std::cout<<"osgb read tests skipped, unable to write "<<filename<<std::endl;
+            return;
+        }
+        osg::ref_ptr<osgDB::MappedFile> file = new osgDB::MappedFile(filename);
+        totalSize += double(file->size());
+
+        // check both read paths return exactly what was written.
+        osg::ref_ptr<osg::Node> mapped = osgDB::readNodeFile(filename, mappedOptions.get());
+        osg::ref_ptr<osg::Node> streamed = osgDB::readNodeFile(filename, streamOptions.get());
+        const osg::Geometry* original = geode->getDrawable(0)->asGeometry();
+        if (!sameGeometry(original, getTileGeometry(mapped.get())) ||
+            !sameGeometry(original, getTileGeometry(streamed.get())))
+        {
+            std::cout<<"Error: "<<filename<<" read back differs from the written geometry"<<std::endl;
+            passed = false;
+        }
+    }
+
+    // alternate between the two paths and keep the best time of each, so both read from a warm page cache.
+    double mappedTime = 0.0, streamTime = 0.0;
+    for(unsigned int pass=0; pass<3; ++pass)
+    {
+        double t = readTiles(numTiles, streamOptions.get(), passed);
+        if (pass==0 || t<streamTime) streamTime = t;
+
+        t = readTiles(numTiles, mappedOptions.get(), passed);
+        if (pass==0 || t<mappedTime) mappedTime = t;
+    }
+
+    for(unsigned int tile=0; tile<numTiles; ++tile)
+    {
+        remove(createTileFileName(tile).c_str());
+    }
+
+    double megabytes = totalSize/(1024.0*1024.0);
+    std::cout<<"osgb read of "<<numTiles<<" tiles, "<<megabytes<<"MB : "
+             <<"ifstream "<<streamTime<<"ms ("<<megabytes/(streamTime*0.001)<<"MB/s), "
+             <<"memory mapped "<<mappedTime<<"ms ("<<megabytes/(mappedTime*0.001)<<"MB/s)"<<std::endl;
+
+    if (!passed) std::cout<<"Error: osgb read tests failed"<<std::endl;
+}
@@ -0,0 +1,222 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ParallelCull.h"
+
+#include <osg/Math>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/Timer>
+
+#include <osgUtil/CullVisitor>
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+struct LeafRecord
+{
+    LeafRecord(const osgUtil::RenderBin* bin, const osgUtil::RenderLeaf* leaf):
+        _bin(bin->getBinNum()),
+        _stateSet(leaf->_parent->getStateSet()),
+        _drawable(leaf->getDrawable()),
+        _modelview(*leaf->_modelview),
+        _depth(leaf->_depth),
+        _traversalNumber(leaf->_traversalNumber) {}
+
+    bool operator == (const LeafRecord& rhs) const
+    {
+        return _bin==rhs._bin &&
+               _stateSet==rhs._stateSet &&
+               _drawable==rhs._drawable &&
+               _modelview==rhs._modelview &&
+               _depth==rhs._depth &&
+               _traversalNumber==rhs._traversalNumber;
+    }
+
+    int                     _bin;
+    const osg::StateSet*    _stateSet;
+    const osg::Drawable*    _drawable;
+    osg::Matrix             _modelview;
+    float                   _depth;
+    unsigned int            _traversalNumber;
+};
+
+typedef std::vector<LeafRecord> LeafRecords;
+
+void collectLeaves(const osgUtil::RenderBin* bin, LeafRecords& records)
+{
+    for(osgUtil::RenderBin::RenderBinList::const_iterator itr = bin->getRenderBinList().begin();
+        itr != bin->getRenderBinList().end() && itr->first<0;
+        ++itr)
+    {
+        collectLeaves(itr->second.get(), records);
+    }
+
+    for(osgUtil::RenderBin::StateGraphList::const_iterator sitr = bin->getStateGraphList().begin();
+        sitr != bin->getStateGraphList().end();
+        ++sitr)
+    {
+        for(osgUtil::StateGraph::LeafList::const_iterator litr = (*sitr)->_leaves.begin();
+            litr != (*sitr)->_leaves.end();
+            ++litr)
+        {
+            records.push_back(LeafRecord(bin, litr->get()));
+        }
+    }
+
+    for(osgUtil::RenderBin::RenderBinList::const_iterator itr = bin->getRenderBinList().begin();
+        itr != bin->getRenderBinList().end();
+        ++itr)
+    {
+        if (itr->first>=0) collectLeaves(itr->second.get(), records);
+    }
+}
+
+osg::Node* createScene(unsigned int numChildren)
+{
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    vertices->push_back(osg::Vec3(-0.5f,0.0f,-0.5f));
+    vertices->push_back(osg::Vec3(0.5f,0.0f,-0.5f));
+    vertices->push_back(osg::Vec3(0.5f,0.0f,0.5f));
+    vertices->push_back(osg::Vec3(-0.5f,0.0f,0.5f));
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(new osg::DrawArrays(GL_QUADS,0,4));
+
+    const unsigned int numStateSets = 8;
+    std::vector< osg::ref_ptr<osg::StateSet> > stateSets;
+    for(unsigned int i=0; i<numStateSets; ++i)
+    {
+        osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+        stateset->setMode(GL_LIGHTING, (i%2)==0 ? osg::StateAttribute::ON : osg::StateAttribute::OFF);
+        if (i>=numStateSets-2) stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+        stateSets.push_back(stateset);
+    }
+
+    osg::Group* root = new osg::Group;
+
+    unsigned int numColumns = static_cast<unsigned int>(sqrtf(static_cast<float>(numChildren)));
+    if (numColumns==0) numColumns = 1;
+
+    for(unsigned int i=0; i<numChildren; ++i)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(geometry.get());
+        geode->setStateSet(stateSets[i%numStateSets].get());
+
+        osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform;
+        transform->setMatrix(osg::Matrix::translate(float(i%numColumns)*2.0f-float(numColumns), float(i/numColumns)*2.0f, 0.0f));
+        transform->addChild(geode.get());
+
+        root->addChild(transform.get());
+    }
+
+    // compute the bounding volumes up front as the cull traversal assumes they are already valid.
+    root->getBound();
+
+    return root;
+}
+
+double cullScene(osg::Node* scene, unsigned int parallelCullThreshold, unsigned int numThreads, unsigned int numFrames, LeafRecords& records, double& znear, double& zfar)
+{
+    osg::ref_ptr<osgUtil::CullVisitor> cv = new osgUtil::CullVisitor;
+    osg::ref_ptr<osgUtil::StateGraph> stateGraph = new osgUtil::StateGraph;
+    osg::ref_ptr<osgUtil::RenderStage> renderStage = new osgUtil::RenderStage;
+    osg::ref_ptr<osg::Viewport> viewport = new osg::Viewport(0,0,1280,1024);
+
+    cv->setParallelCullThreshold(parallelCullThreshold);
+    cv->setNumParallelCullThreads(numThreads);
+
+    const osg::BoundingSphere& bs = scene->getBound();
+    osg::Matrix projection = osg::Matrix::perspective(60.0, 1.25, 1.0, 10000.0);
+    osg::Matrix view = osg::Matrix::lookAt(bs.center()-osg::Vec3(0.0f,bs.radius(),-bs.radius()*0.25f), bs.center(), osg::Vec3(0.0f,0.0f,1.0f));
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    for(unsigned int i=0; i<numFrames; ++i)
+    {
+        cv->reset();
+        stateGraph->clean();
+        renderStage->reset();
+
+        cv->setStateGraph(stateGraph.get());
+        cv->setRenderStage(renderStage.get());
+        cv->setTraversalNumber(i);
+
+        cv->pushViewport(viewport.get());
+        cv->pushProjectionMatrix(new osg::RefMatrix(projection));
+        cv->pushModelViewMatrix(new osg::RefMatrix(view), osg::Transform::ABSOLUTE_RF);
+
+        scene->accept(*cv);
+
+        znear = cv->getCalculatedNearPlane();
+        zfar = cv->getCalculatedFarPlane();
+
+        cv->popModelViewMatrix();
+        cv->popProjectionMatrix();
+        cv->popViewport();
+
+        stateGraph->prune();
+    }
+
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    records.clear();
+    collectLeaves(renderStage.get(), records);
+
+    return osg::Timer::instance()->delta_m(startTick, endTick)/double(numFrames);
+}
+
+}
+
+void runParallelCullTests(unsigned int maxNumThreads)
+{
+    const unsigned int numChildren = 40000;
+    const unsigned int numFrames = 20;
+    const unsigned int parallelCullThreshold = 64;
+
+    std::cout<<"**** parallel cull tests, "<<numChildren<<" children, "<<numFrames<<" frames ****"<<std::endl;
+
+    osg::ref_ptr<osg::Node> scene = createScene(numChildren);
+
+    LeafRecords serialRecords;
+    double serialNear, serialFar;
+    double serialTime = cullScene(scene.get(), 0, 1, numFrames, serialRecords, serialNear, serialFar);
+
+    std::cout<<"  serial\t\tcull time="<<serialTime<<"ms\tleaves="<<serialRecords.size()<<std::endl;
+
+    for(unsigned int numThreads=2; numThreads<=maxNumThreads; numThreads*=2)
+    {
+        LeafRecords parallelRecords;
+        double parallelNear, parallelFar;
+        double parallelTime = cullScene(scene.get(), parallelCullThreshold, numThreads, numFrames, parallelRecords, parallelNear, parallelFar);
+
+        bool identical = parallelRecords==serialRecords && parallelNear==serialNear && parallelFar==serialFar;
+
+        std::cout<<"  parallel\tthreads="<<numThreads
+                 <<"\tcull time="<<parallelTime<<"ms"
+                 <<"\tspeed up="<<(parallelTime>0.0 ? serialTime/parallelTime : 0.0)
+                 <<"\t"<<(identical ? "identical to serial cull" : "FAILED, differs from serial cull")<<std::endl;
+    }
+
+    std::cout<<std::endl;
+}
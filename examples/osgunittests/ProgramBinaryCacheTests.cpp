@@ -0,0 +1,318 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ProgramBinaryCacheTests.h"
+
+#include <osg/ProgramBinaryCache>
+#include <osg/GL2Extensions>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/Timer>
+
+#include <osgDB/FileUtils>
+
+#include <osgViewer/Viewer>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+
+namespace
+{
+
+osg::Program* createProgram(unsigned int variant)
+{
+    std::ostringstream fragmentSource;
+    fragmentSource<<"void main()\n"
+                  <<"{\n"
+                  <<"    float v = "<<float(variant%17)/16.0f<<";\n"
+                  <<"    gl_FragColor = vec4(v, 1.0-v, "<<float(variant%5)*0.25f<<", 1.0);\n"
+                  <<"}\n";
+
+    osg::Program* program = new osg::Program;
+    program->addShader(new osg::Shader(osg::Shader::VERTEX, "void main() { gl_Position = ftransform(); }\n"));
+    program->addShader(new osg::Shader(osg::Shader::FRAGMENT, fragmentSource.str()));
+    return program;
+}
+
+osg::Program::ProgramBinary* createProgramBinary(unsigned int size)
+{
+    osg::Program::ProgramBinary* programBinary = new osg::Program::ProgramBinary;
+    programBinary->allocate(size);
+    programBinary->setFormat(0x1234);
+    for(unsigned int i=0; i<size; ++i) programBinary->getData()[i] = static_cast<unsigned char>(i*7);
+    return programBinary;
+}
+
+void removeEntries(const std::string& directory)
+{
+    osgDB::DirectoryContents contents = osgDB::getDirectoryContents(directory);
+    for(osgDB::DirectoryContents::iterator itr = contents.begin(); itr != contents.end(); ++itr)
+    {
+        if (*itr!="." && *itr!="..") remove((directory+"/"+*itr).c_str());
+    }
+}
+
+bool testKeys()
+{
+    osg::ref_ptr<osg::State> state = new osg::State;
+    osg::ref_ptr<osg::Program> program = createProgram(1);
+    osg::ref_ptr<osg::Program> sameProgram = createProgram(1);
+    osg::ref_ptr<osg::Program> otherProgram = createProgram(2);
+    osg::ref_ptr<osg::Program> boundProgram = createProgram(1);
+    boundProgram->addBindAttribLocation("tangent", 6);
+
+    std::string key = osg::ProgramBinaryCache::computeKey(*program, *state);
+
+    bool passed = true;
+    if (key!=osg::ProgramBinaryCache::computeKey(*sameProgram, *state))
+    {
+        std::cout<<"Error: programs with the same shaders have different keys"<<std::endl;
+        passed = false;
+    }
+    if (key==osg::ProgramBinaryCache::computeKey(*otherProgram, *state))
+    {
+        std::cout<<"Error: programs with different shaders have the same key"<<std::endl;
+        passed = false;
+    }
+    if (key==osg::ProgramBinaryCache::computeKey(*boundProgram, *state))
+    {
+        std::cout<<"Error: programs with different attribute bindings have the same key"<<std::endl;
+        passed = false;
+    }
+
+    state->setUseVertexAttributeAliasing(true);
+    if (key==osg::ProgramBinaryCache::computeKey(*program, *state))
+    {
+        std::cout<<"Error: vertex attribute aliasing doesn't change the key"<<std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+bool testEntries(osg::ProgramBinaryCache* cache)
+{
+    const std::string driver = "Vendor; Renderer; 1.0";
+    const std::string key = "0123456789abcdef";
+
+    bool passed = true;
+    cache->resetStats();
+
+    osg::ref_ptr<osg::Program::ProgramBinary> programBinary = createProgramBinary(1000);
+    osg::ref_ptr<osg::Program::ProgramBinary> result = cache->readProgramBinary(key, driver);
+    if (result.valid() || cache->getNumberMisses()!=1)
+    {
+        std::cout<<"Error: lookup of an empty cache didn't miss"<<std::endl;
+        passed = false;
+    }
+
+    // a written entry reads back the same.
+    cache->writeProgramBinary(key, driver, *programBinary);
+    result = cache->readProgramBinary(key, driver);
+    if (!result.valid() || result->getFormat()!=programBinary->getFormat() || result->getSize()!=programBinary->getSize() ||
+        memcmp(result->getData(), programBinary->getData(), programBinary->getSize())!=0 || cache->getNumberHits()!=1)
+    {
+        std::cout<<"Error: entry read back doesn't match the one written"<<std::endl;
+        passed = false;
+    }
+
+    // another driver invalidates the entry.
+    result = cache->readProgramBinary(key, "Vendor; Renderer; 2.0");
+    if (result.valid() || cache->getNumberInvalidated()!=1 || osgDB::fileExists(cache->getFileName(key)))
+    {
+        std::cout<<"Error: entry written by another driver wasn't invalidated"<<std::endl;
+        passed = false;
+    }
+
+    // so does a truncated file.
+    cache->writeProgramBinary(key, driver, *programBinary);
+    {
+        std::ifstream fin(cache->getFileName(key).c_str(), std::ios::in | std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+        fin.close();
+
+        std::ofstream fout(cache->getFileName(key).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        fout.write(contents.data(), contents.size()/2);
+    }
+    result = cache->readProgramBinary(key, driver);
+    if (result.valid() || cache->getNumberInvalidated()!=2)
+    {
+        std::cout<<"Error: truncated entry wasn't invalidated"<<std::endl;
+        passed = false;
+    }
+
+    if (cache->getNumberWritten()!=2 || cache->getHitRate()!=0.25)
+    {
+        std::cout<<"Error: cache stats wrong, "<<cache->getNumberWritten()<<" written, hit rate "<<cache->getHitRate()<<std::endl;
+        passed = false;
+    }
+
+    return passed;
+}
+
+osg::Node* createScene(unsigned int numPrograms)
+{
+    unsigned int across = static_cast<unsigned int>(ceilf(sqrtf(float(numPrograms))));
+    float size = 1.0f/float(across);
+
+    osg::Group* root = new osg::Group;
+    for(unsigned int i=0; i<numPrograms; ++i)
+    {
+        float x = float(i%across)*size - 0.5f;
+        float y = float(i/across)*size - 0.5f;
+        osg::ref_ptr<osg::Geometry> geometry = osg::createTexturedQuadGeometry(osg::Vec3(x, y, 0.0f), osg::Vec3(size*0.9f, 0.0f, 0.0f), osg::Vec3(0.0f, size*0.9f, 0.0f));
+
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(geometry.get());
+        geode->getOrCreateStateSet()->setAttribute(createProgram(i));
+        root->addChild(geode.get());
+    }
+    return root;
+}
+
+struct CaptureCallback : public osg::Camera::DrawCallback
+{
+    CaptureCallback():
+        _capture(false) {}
+
+    virtual void operator () (osg::RenderInfo& renderInfo) const
+    {
+        if (_capture)
+        {
+            const osg::Viewport* viewport = renderInfo.getCurrentCamera()->getViewport();
+            _image = new osg::Image;
+            _image->readPixels(int(viewport->x()), int(viewport->y()), int(viewport->width()), int(viewport->height()), GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    }
+
+    bool                                _capture;
+    mutable osg::ref_ptr<osg::Image>    _image;
+};
+
+}
+
+void runProgramBinaryCacheTests(unsigned int numPrograms)
+{
+    osg::ProgramBinaryCache* cache = osg::ProgramBinaryCache::instance().get();
+    std::string previousDirectory = cache->getDirectory();
+
+    std::string directory = osgDB::getCurrentWorkingDirectory()+"/osgunittests_program_binaries";
+    cache->setDirectory(directory);
+    if (!cache->isEnabled())
+    {
+        std::cout<<"Error: program binary cache tests failed, unable to create "<<directory<<std::endl;
+        return;
+    }
+    removeEntries(directory);
+
+    bool passed = testKeys() && testEntries(cache);
+    removeEntries(directory);
+
+    if (!passed)
+    {
+        std::cout<<"Error: program binary cache tests failed"<<std::endl;
+        cache->setDirectory(previousDirectory);
+        return;
+    }
+
+    unsigned int width = 256;
+    unsigned int height = 256;
+
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = width;
+    traits->height = height;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer.valid())
+    {
+        std::cout<<"Program binary cache tests skipped, unable to create a pbuffer."<<std::endl;
+        cache->setDirectory(previousDirectory);
+        return;
+    }
+
+    osg::ref_ptr<CaptureCallback> capture = new CaptureCallback;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setDrawBuffer(GL_FRONT);
+    camera->setReadBuffer(GL_FRONT);
+    camera->setClearColor(osg::Vec4(0.0f,0.0f,0.0f,1.0f));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsOrtho2D(-0.5, 0.5, -0.5, 0.5);
+    camera->setViewMatrix(osg::Matrixd::identity());
+    camera->setFinalDrawCallback(capture.get());
+    viewer.realize();
+
+    // the first run compiles and links every program and fills the cache, the second creates the same
+    // programs afresh so they are linked again, this time from the cached binaries.
+    const char* runNames[2] = { "Cold", "Warm" };
+    osg::ref_ptr<osg::Image> images[2];
+    for(unsigned int run=0; run<2; ++run)
+    {
+        viewer.setSceneData(createScene(numPrograms));
+        cache->resetStats();
+
+        capture->_capture = true;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        viewer.frame();
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        capture->_capture = false;
+        images[run] = capture->_image;
+
+        std::cout<<runNames[run]<<" start with "<<numPrograms<<" programs : "<<osg::Timer::instance()->delta_m(start, end)<<"ms, "
+                 <<cache->getNumberHits()<<" hits, "<<cache->getNumberMisses()<<" misses, "<<cache->getNumberWritten()<<" written"<<std::endl;
+
+        if (run==0 && cache->getNumberHits()+cache->getNumberMisses()==0)
+        {
+            std::cout<<"Program binary cache tests skipped, GL_ARB_get_program_binary not supported."<<std::endl;
+            break;
+        }
+
+        viewer.setSceneData(0);
+        viewer.frame();
+    }
+
+    if (images[1].valid())
+    {
+        if (cache->getNumberHits()!=numPrograms)
+        {
+            std::cout<<"Error: program binary cache tests failed, "<<cache->getNumberHits()<<" of "<<numPrograms<<" programs loaded from the cache"<<std::endl;
+        }
+        else if (images[0]->s()!=images[1]->s() || images[0]->t()!=images[1]->t() ||
+                 memcmp(images[0]->data(), images[1]->data(), images[0]->getTotalSizeInBytes())!=0)
+        {
+            std::cout<<"Error: program binary cache tests failed, programs loaded from the cache render differently"<<std::endl;
+        }
+    }
+
+    removeEntries(directory);
+    cache->setDirectory(previousDirectory);
+}
@@ -0,0 +1,153 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ReferencedThreads.h"
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <osg/observer_ptr>
+#include <osg/Group>
+#include <osg/Timer>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Barrier>
+
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+enum Operation
+{
+    REF_UNREF,
+    OBSERVER_LOCK
+};
+
+class ReferencedThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    ReferencedThread(Operation operation, osg::Group* group, OpenThreads::Barrier& startBarrier, OpenThreads::Barrier& endBarrier, unsigned int numIterations):
+        _operation(operation),
+        _group(group),
+        _observer(group),
+        _startBarrier(startBarrier),
+        _endBarrier(endBarrier),
+        _numIterations(numIterations),
+        _numSuccessful(0) {}
+
+    virtual void run()
+    {
+        _startBarrier.block();
+
+        if (_operation==REF_UNREF)
+        {
+            for(unsigned int i=0; i<_numIterations; ++i)
+            {
+                osg::ref_ptr<osg::Group> local = _group;
+                if (local.valid()) ++_numSuccessful;
+            }
+        }
+        else
+        {
+            for(unsigned int i=0; i<_numIterations; ++i)
+            {
+                osg::ref_ptr<osg::Group> local;
+                if (_observer.lock(local)) ++_numSuccessful;
+            }
+        }
+
+        _endBarrier.block();
+    }
+
+    unsigned int getNumSuccessful() const { return _numSuccessful; }
+
+protected:
+
+    virtual ~ReferencedThread() {}
+
+    Operation                       _operation;
+    osg::Group*                     _group;
+    osg::observer_ptr<osg::Group>   _observer;
+    OpenThreads::Barrier&           _startBarrier;
+    OpenThreads::Barrier&           _endBarrier;
+    unsigned int                    _numIterations;
+    unsigned int                    _numSuccessful;
+};
+
+void runReferencedThreadTest(const char* name, Operation operation, unsigned int numThreads, unsigned int numIterations)
+{
+    osg::ref_ptr<osg::Group> group = new osg::Group;
+
+    OpenThreads::Barrier startBarrier(numThreads+1);
+    OpenThreads::Barrier endBarrier(numThreads+1);
+
+    typedef std::vector< osg::ref_ptr<ReferencedThread> > Threads;
+    Threads threads;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads.push_back(new ReferencedThread(operation, group.get(), startBarrier, endBarrier, numIterations));
+        threads.back()->startThread();
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    startBarrier.block();
+    endBarrier.block();
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    unsigned int numSuccessful = 0;
+    for(Threads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        while((*itr)->isRunning()) OpenThreads::Thread::YieldCurrentThread();
+        numSuccessful += (*itr)->getNumSuccessful();
+    }
+
+    double duration = osg::Timer::instance()->delta_s(startTick, endTick);
+    double numOperations = double(numThreads)*double(numIterations);
+
+    std::cout<<"  "<<name<<"\tthreads="<<numThreads
+             <<"\ttime="<<duration*1000.0<<"ms"
+             <<"\tthroughput="<<(duration>0.0 ? numOperations/duration/1000000.0 : 0.0)<<" Mops/s";
+    if (numSuccessful!=numThreads*numIterations) std::cout<<"\tFAILED "<<numThreads*numIterations-numSuccessful<<" operations";
+    std::cout<<std::endl;
+}
+
+}
+
+void runReferencedThreadTests(unsigned int maxNumThreads)
+{
+    const unsigned int numIterations = 1000000;
+
+    std::cout<<"**** osg::Referenced multi-threaded tests, "<<numIterations<<" iterations per thread ****"<<std::endl;
+    std::cout<<"  thread safe reference counting : "<<(osg::Referenced::getThreadSafeReferenceCounting() ? "on" : "off")<<std::endl;
+
+    for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+    {
+        runReferencedThreadTest("ref/unref", REF_UNREF, numThreads, numIterations);
+    }
+
+    for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+    {
+        runReferencedThreadTest("observer_ptr::lock", OBSERVER_LOCK, numThreads, numIterations);
+    }
+
+    std::cout<<std::endl;
+}
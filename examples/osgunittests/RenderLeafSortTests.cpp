@@ -0,0 +1,167 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "RenderLeafSortTests.h"
+
+#include <osg/Geometry>
+#include <osg/Timer>
+
+#include <osgUtil/RenderBin>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+typedef std::vector< osg::ref_ptr<osgUtil::StateGraph> > StateGraphs;
+typedef std::vector<osgUtil::RenderLeaf*> Leaves;
+
+// the comparators RenderBin sorted with before it sorted on 64 bit keys.
+struct FrontToBackSortFunctor
+{
+    bool operator() (const osgUtil::RenderLeaf* lhs,const osgUtil::RenderLeaf* rhs) const { return (lhs->_depth<rhs->_depth); }
+};
+
+struct BackToFrontSortFunctor
+{
+    bool operator() (const osgUtil::RenderLeaf* lhs,const osgUtil::RenderLeaf* rhs) const { return (rhs->_depth<lhs->_depth); }
+};
+
+struct TraversalOrderFunctor
+{
+    bool operator() (const osgUtil::RenderLeaf* lhs,const osgUtil::RenderLeaf* rhs) const { return (lhs->_traversalNumber<rhs->_traversalNumber); }
+};
+
+// the old comparators leave the order of equal depths unspecified, the keys break ties on the traversal number.
+template<class Functor>
+struct TieBreakFunctor
+{
+    bool operator() (const osgUtil::RenderLeaf* lhs,const osgUtil::RenderLeaf* rhs) const
+    {
+        Functor less;
+        if (less(lhs, rhs)) return true;
+        if (less(rhs, lhs)) return false;
+        return lhs->_traversalNumber<rhs->_traversalNumber;
+    }
+};
+
+/** Create numLeaves leaves spread over numStateGraphs StateGraphs in traversal order, with depths drawn from a range
+  * small enough for many of them to be equal.*/
+void createLeaves(unsigned int numLeaves, unsigned int numStateGraphs, osg::Drawable* drawable, StateGraphs& stateGraphs, Leaves& leaves)
+{
+    for(unsigned int i=0; i<numStateGraphs; ++i)
+    {
+        stateGraphs.push_back(new osgUtil::StateGraph);
+    }
+
+    unsigned int seed = 12345;
+    for(unsigned int i=0; i<numLeaves; ++i)
+    {
+        seed = seed*1664525u + 1013904223u;
+        float depth = float((seed>>8)%(numLeaves/4+1))*0.25f - float(numLeaves/32);
+
+        osgUtil::RenderLeaf* leaf = new osgUtil::RenderLeaf(drawable, 0, 0, depth, i);
+        stateGraphs[(seed>>16)%numStateGraphs]->addLeaf(leaf);
+        leaves.push_back(leaf);
+    }
+}
+
+template<class Functor>
+bool testSortMode(const char* name, osgUtil::RenderBin::SortMode sortMode, const StateGraphs& stateGraphs, const Leaves& leaves, unsigned int numRepeats)
+{
+    Leaves expected(leaves);
+    std::sort(expected.begin(), expected.end(), TieBreakFunctor<Functor>());
+
+    double comparatorTime = 0.0;
+    double keyTime = 0.0;
+    bool matches = true;
+
+    osg::ref_ptr<osgUtil::RenderBin> bin = new osgUtil::RenderBin(sortMode);
+    for(unsigned int r=0; r<numRepeats; ++r)
+    {
+        // RenderBin copies the leaves of its StateGraphs into its RenderLeafList before sorting, so time the same copy here.
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        Leaves sorted;
+        sorted.reserve(leaves.size());
+        for(StateGraphs::const_iterator itr = stateGraphs.begin();
+            itr != stateGraphs.end();
+            ++itr)
+        {
+            for(osgUtil::StateGraph::LeafList::const_iterator litr = (*itr)->_leaves.begin();
+                litr != (*itr)->_leaves.end();
+                ++litr)
+            {
+                sorted.push_back(litr->get());
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), Functor());
+        comparatorTime += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        bin->reset();
+        for(StateGraphs::const_iterator itr = stateGraphs.begin();
+            itr != stateGraphs.end();
+            ++itr)
+        {
+            bin->addStateGraph(itr->get());
+        }
+
+        start = osg::Timer::instance()->tick();
+        bin->sort();
+        keyTime += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        const osgUtil::RenderBin::RenderLeafList& renderLeafList = bin->getRenderLeafList();
+        if (renderLeafList.size()!=expected.size() || !std::equal(renderLeafList.begin(), renderLeafList.end(), expected.begin())) matches = false;
+    }
+
+    std::cout<<"  "<<name<<"\tstd::sort "<<comparatorTime*1000.0/double(numRepeats)<<"ms"
+             <<"\tRenderBin "<<keyTime*1000.0/double(numRepeats)<<"ms"
+             <<(matches ? "" : "\tFAILED, order differs from std::sort")<<std::endl;
+
+    return matches;
+}
+
+}
+
+void runRenderLeafSortTests(unsigned int numLeaves)
+{
+    const unsigned int numStateGraphs = 64;
+    const unsigned int numRepeats = 8;
+
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+
+    bool passed = true;
+
+    // lists below 256 leaves are sorted with std::sort on the keys, larger ones with the radix sort.
+    unsigned int sizes[] = { numLeaves<256 ? numLeaves : 255, numLeaves<256 ? 256 : numLeaves };
+    for(unsigned int s=0; s<2; ++s)
+    {
+        StateGraphs stateGraphs;
+        Leaves leaves;
+        createLeaves(sizes[s], numStateGraphs, geometry.get(), stateGraphs, leaves);
+
+        std::cout<<"RenderBin sort of "<<sizes[s]<<" leaves"<<std::endl;
+
+        if (!testSortMode<FrontToBackSortFunctor>("front to back", osgUtil::RenderBin::SORT_FRONT_TO_BACK, stateGraphs, leaves, numRepeats)) passed = false;
+        if (!testSortMode<BackToFrontSortFunctor>("back to front", osgUtil::RenderBin::SORT_BACK_TO_FRONT, stateGraphs, leaves, numRepeats)) passed = false;
+        if (!testSortMode<TraversalOrderFunctor>("traversal order", osgUtil::RenderBin::TRAVERSAL_ORDER, stateGraphs, leaves, numRepeats)) passed = false;
+    }
+
+    if (!passed) std::cout<<"Error: RenderBin sorts differ from std::sort"<<std::endl;
+}
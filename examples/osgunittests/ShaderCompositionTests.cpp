@@ -0,0 +1,437 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "ShaderCompositionTests.h"
+
+#include <osg/ShaderComposer>
+#include <osg/DisplaySettings>
+#include <osg/Material>
+#include <osg/Fog>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Notify>
+#include <osg/Timer>
+
+#include <osgUtil/IncrementalCompileOperation>
+
+#include <osgViewer/Viewer>
+
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+
+osg::ShaderComponent* createShaderComponent(osg::Shader::Type type, float position, const std::string& code)
+{
+    osg::ref_ptr<osg::Shader> shader = new osg::Shader(type);
+    shader->addCodeInjection(position, code);
+
+    osg::ShaderComponent* shaderComponent = new osg::ShaderComponent;
+    shaderComponent->addShader(shader.get());
+    return shaderComponent;
+}
+
+osg::ShaderComponent* createBaseComponent()
+{
+    osg::ShaderComponent* shaderComponent = createShaderComponent(osg::Shader::VERTEX, 0.0f, "gl_Position = ftransform();\n");
+    shaderComponent->addShader(new osg::Shader(osg::Shader::FRAGMENT));
+    shaderComponent->getShader(1)->addCodeInjection(0.0f, "gl_FragColor = vec4(1.0);\n");
+    return shaderComponent;
+}
+
+// a fragment shader component that scales the colour, the salt makes components of separate runs distinct.
+osg::ShaderComponent* createVariantComponent(unsigned int variant, unsigned int salt)
+{
+    std::ostringstream code;
+    code<<"gl_FragColor.rgb *= vec3("<<float(variant%7)/6.0f<<", "<<float(variant%11)/10.0f<<", "<<float(salt)<<".0/"<<float(salt+1)<<".0);\n";
+    return createShaderComponent(osg::Shader::FRAGMENT, 0.5f, code.str());
+}
+
+osg::Material* createMaterial(osg::ShaderComponent* shaderComponent)
+{
+    osg::Material* material = new osg::Material;
+    material->setShaderComponent(shaderComponent);
+    return material;
+}
+
+osg::Fog* createFog(osg::ShaderComponent* shaderComponent)
+{
+    osg::Fog* fog = new osg::Fog;
+    fog->setShaderComponent(shaderComponent);
+    return fog;
+}
+
+osg::Geode* createGeode()
+{
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable(osg::createTexturedQuadGeometry(osg::Vec3(0.0f,0.0f,0.0f), osg::Vec3(1.0f,0.0f,0.0f), osg::Vec3(0.0f,1.0f,0.0f)));
+    return geode;
+}
+
+osg::ShaderComponents makeShaderComponents(osg::ShaderComponent* first, osg::ShaderComponent* second=0)
+{
+    osg::ShaderComponents shaderComponents;
+    shaderComponents.push_back(first);
+    if (second) shaderComponents.push_back(second);
+    return shaderComponents;
+}
+
+bool testKeys()
+{
+    osg::ref_ptr<osg::ShaderComponent> base = createBaseComponent();
+    osg::ref_ptr<osg::ShaderComponent> sameBase = createBaseComponent();
+    osg::ref_ptr<osg::ShaderComponent> variant = createVariantComponent(1, 0);
+    osg::ref_ptr<osg::ShaderComponent> sameVariant = createVariantComponent(1, 0);
+    osg::ref_ptr<osg::ShaderComponent> otherVariant = createVariantComponent(2, 0);
+
+    std::string key = osg::ShaderComposer::computeKey(makeShaderComponents(base.get(), variant.get()));
+
+    bool passed = true;
+    if (key!=osg::ShaderComposer::computeKey(makeShaderComponents(sameBase.get(), sameVariant.get())))
+    {
+        std::cout<<"Error: compositions of components with the same shaders have different keys"<<std::endl;
+        passed = false;
+    }
+    if (key==osg::ShaderComposer::computeKey(makeShaderComponents(base.get(), otherVariant.get())))
+    {
+        std::cout<<"Error: compositions of components with different shaders have the same key"<<std::endl;
+        passed = false;
+    }
+    if (key==osg::ShaderComposer::computeKey(makeShaderComponents(base.get())))
+    {
+        std::cout<<"Error: compositions of different numbers of components have the same key"<<std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+bool testEnumeration()
+{
+    osg::ref_ptr<osg::ShaderComponent> base = createBaseComponent();
+    osg::ref_ptr<osg::ShaderComponent> variant0 = createVariantComponent(0, 0);
+    osg::ref_ptr<osg::ShaderComponent> variant1 = createVariantComponent(1, 0);
+    osg::ref_ptr<osg::ShaderComponent> overrideBase = createVariantComponent(2, 0);
+    osg::ref_ptr<osg::ShaderComponent> protectedBase = createVariantComponent(3, 0);
+
+    osg::ref_ptr<osg::Group> root = new osg::Group;
+    root->getOrCreateStateSet()->setAttribute(createMaterial(base.get()));
+
+    // inherits the base component, composes { base, variant0 }.
+    osg::Group* group = new osg::Group;
+    group->getOrCreateStateSet()->setAttribute(createFog(variant0.get()));
+    group->addChild(createGeode());
+    root->addChild(group);
+
+    // the same composition made from different ShaderComponent objects.
+    group = new osg::Group;
+    group->getOrCreateStateSet()->setAttribute(createFog(createVariantComponent(0, 0)));
+    group->addChild(createGeode());
+    root->addChild(group);
+
+    // the geode replaces the base component, composes { overrideBase, variant1 }.
+    group = new osg::Group;
+    group->getOrCreateStateSet()->setAttribute(createFog(variant1.get()));
+    osg::Geode* geode = createGeode();
+    geode->getOrCreateStateSet()->setAttribute(createMaterial(overrideBase.get()));
+    group->addChild(geode);
+    root->addChild(group);
+
+    // an OVERRIDE stops the geode replacing the base component unless the geode's attribute is PROTECTED,
+    // composes { overrideBase } and { protectedBase }.
+    group = new osg::Group;
+    group->getOrCreateStateSet()->setAttribute(createMaterial(overrideBase.get()), osg::StateAttribute::OVERRIDE);
+    geode = createGeode();
+    geode->getOrCreateStateSet()->setAttribute(createMaterial(protectedBase.get()));
+    group->addChild(geode);
+    geode = createGeode();
+    geode->getOrCreateStateSet()->setAttribute(createMaterial(protectedBase.get()), osg::StateAttribute::PROTECTED);
+    group->addChild(geode);
+    root->addChild(group);
+
+    osgUtil::StateToCompile stateToCompile(osgUtil::GLObjectsVisitor::COMPILE_STATE_ATTRIBUTES|osgUtil::GLObjectsVisitor::COMPILE_SHADER_COMPOSITIONS);
+    root->accept(stateToCompile);
+
+    osg::ShaderComponents expected[4] =
+    {
+        makeShaderComponents(base.get(), variant0.get()),
+        makeShaderComponents(overrideBase.get(), variant1.get()),
+        makeShaderComponents(overrideBase.get()),
+        makeShaderComponents(protectedBase.get())
+    };
+
+    bool passed = true;
+    if (stateToCompile._shaderCompositions.size()!=4)
+    {
+        std::cout<<"Error: "<<stateToCompile._shaderCompositions.size()<<" shader compositions collected, expected 4"<<std::endl;
+        passed = false;
+    }
+    for(unsigned int i=0; i<4; ++i)
+    {
+        if (stateToCompile._shaderCompositions.count(osg::ShaderComposer::computeKey(expected[i]))==0)
+        {
+            std::cout<<"Error: shader composition "<<i<<" wasn't collected"<<std::endl;
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+bool testEviction()
+{
+    osg::ref_ptr<osg::ShaderComposer> shaderComposer = new osg::ShaderComposer;
+    shaderComposer->setMaximumNumberOfPrograms(2);
+
+    osg::ref_ptr<osg::ShaderComponent> base = createBaseComponent();
+    osg::ref_ptr<osg::ShaderComponent> variants[3] = { createVariantComponent(0, 0), createVariantComponent(1, 0), createVariantComponent(2, 0) };
+    osg::ShaderComponents compositions[3];
+    for(unsigned int i=0; i<3; ++i) compositions[i] = makeShaderComponents(base.get(), variants[i].get());
+
+    osg::ref_ptr<osg::Program> program0 = shaderComposer->getOrCreateProgram(compositions[0]);
+    osg::ref_ptr<osg::Program> program1 = shaderComposer->getOrCreateProgram(compositions[1]);
+
+    // use the first composition again so the second is the least recently used when the third is added.
+    shaderComposer->getOrCreateProgram(compositions[0]);
+    shaderComposer->getOrCreateProgram(compositions[2]);
+
+    bool passed = true;
+    if (shaderComposer->getNumberOfPrograms()!=2 || shaderComposer->getNumberOfProgramsEvicted()!=1)
+    {
+        std::cout<<"Error: ShaderComposer holds "<<shaderComposer->getNumberOfPrograms()<<" programs with "
+                 <<shaderComposer->getNumberOfProgramsEvicted()<<" evicted, expected 2 and 1"<<std::endl;
+        passed = false;
+    }
+    if (shaderComposer->getOrCreateProgram(compositions[0])!=program0.get())
+    {
+        std::cout<<"Error: ShaderComposer evicted the most recently used program"<<std::endl;
+        passed = false;
+    }
+    if (shaderComposer->getOrCreateProgram(makeShaderComponents(base.get(), createVariantComponent(0, 0)))!=program0.get())
+    {
+        std::cout<<"Error: ShaderComposer composed a second program for the same shaders"<<std::endl;
+        passed = false;
+    }
+    if (shaderComposer->getOrCreateProgram(compositions[1])==program1.get() || shaderComposer->getNumberOfProgramsEvicted()!=2)
+    {
+        std::cout<<"Error: ShaderComposer didn't evict the least recently used program"<<std::endl;
+        passed = false;
+    }
+    return passed;
+}
+
+osg::Node* createScene(unsigned int numCompositions, unsigned int salt)
+{
+    unsigned int across = static_cast<unsigned int>(ceilf(sqrtf(float(numCompositions))));
+    float size = 1.0f/float(across);
+
+    osg::Group* root = new osg::Group;
+    root->getOrCreateStateSet()->setAttribute(createMaterial(createBaseComponent()));
+    for(unsigned int i=0; i<numCompositions; ++i)
+    {
+        float x = float(i%across)*size - 0.5f;
+        float y = float(i/across)*size - 0.5f;
+
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(osg::createTexturedQuadGeometry(osg::Vec3(x, y, 0.0f), osg::Vec3(size*0.9f, 0.0f, 0.0f), osg::Vec3(0.0f, size*0.9f, 0.0f)));
+        geode->getOrCreateStateSet()->setAttribute(createFog(createVariantComponent(i, salt)));
+        root->addChild(geode.get());
+    }
+    return root;
+}
+
+osg::GraphicsContext* createPbuffer(unsigned int width, unsigned int height)
+{
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = width;
+    traits->height = height;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    return osg::GraphicsContext::createGraphicsContext(traits.get());
+}
+
+// precompile the compositions on the compile context of the pbuffer, whose own osg::State has shader composition
+// disabled, and check that the draw context finds the Programs in its ShaderComposer.
+void testCompileContextPrecompile(unsigned int numCompositions)
+{
+    unsigned int width = 256;
+    unsigned int height = 256;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = createPbuffer(width, height);
+    if (!pbuffer.valid())
+    {
+        std::cout<<"Compile context shader composition test skipped, unable to create a pbuffer."<<std::endl;
+        return;
+    }
+
+    bool compileContextsHint = osg::DisplaySettings::instance()->getCompileContextsHint();
+    osg::DisplaySettings::instance()->setCompileContextsHint(true);
+
+    osg::ref_ptr<osgUtil::IncrementalCompileOperation> ico = new osgUtil::IncrementalCompileOperation;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+    viewer.setIncrementalCompileOperation(ico.get());
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsOrtho2D(-0.5, 0.5, -0.5, 0.5);
+    camera->setViewMatrix(osg::Matrixd::identity());
+    viewer.realize();
+
+    osg::DisplaySettings::instance()->setCompileContextsHint(compileContextsHint);
+
+    if (ico->getContextSet().count(pbuffer.get())!=0)
+    {
+        std::cout<<"Compile context shader composition test skipped, unable to create a compile context."<<std::endl;
+        return;
+    }
+
+    osg::State* state = pbuffer->getState();
+    state->setShaderCompositionEnabled(true);
+    osg::ShaderComposer* shaderComposer = state->getShaderComposer();
+
+    osg::ref_ptr<osg::Node> scene = createScene(numCompositions, 2);
+
+    osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(scene.get());
+    ico->add(compileSet.get());
+
+    unsigned int numFrames = 0;
+    while(!compileSet->compiled() && numFrames<numCompositions+1000)
+    {
+        viewer.frame();
+        OpenThreads::Thread::microSleep(1000);
+        ++numFrames;
+    }
+
+    unsigned int numProgramsPrecompiled = shaderComposer->getNumberOfPrograms();
+
+    viewer.setSceneData(scene.get());
+    viewer.frame();
+
+    unsigned int numProgramsComposed = shaderComposer->getNumberOfPrograms()-numProgramsPrecompiled;
+
+    std::cout<<"Compile context precompiled "<<numProgramsPrecompiled<<" of "<<numCompositions<<" shader compositions in "<<numFrames<<" frames, "
+             <<numProgramsComposed<<" programs composed while drawing"<<std::endl;
+
+    if (!compileSet->compiled() || numProgramsComposed!=0)
+    {
+        std::cout<<"Error: shader composition tests failed, "<<numProgramsComposed<<" programs weren't precompiled on the compile context"<<std::endl;
+    }
+}
+
+}
+
+void runShaderCompositionTests(unsigned int numCompositions)
+{
+    // ShaderComposer::composeMain() reports each shader it composes at NOTICE level.
+    osg::NotifySeverity notifyLevel = osg::getNotifyLevel();
+    osg::setNotifyLevel(osg::WARN);
+
+    bool passed = testKeys() && testEnumeration() && testEviction();
+    if (!passed)
+    {
+        std::cout<<"Error: shader composition tests failed"<<std::endl;
+        osg::setNotifyLevel(notifyLevel);
+        return;
+    }
+
+    unsigned int width = 256;
+    unsigned int height = 256;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = createPbuffer(width, height);
+    if (!pbuffer.valid())
+    {
+        std::cout<<"Shader composition tests skipped, unable to create a pbuffer."<<std::endl;
+        osg::setNotifyLevel(notifyLevel);
+        return;
+    }
+
+    osg::ref_ptr<osgUtil::IncrementalCompileOperation> ico = new osgUtil::IncrementalCompileOperation;
+
+    osgViewer::Viewer viewer;
+    viewer.setThreadingModel(osgViewer::Viewer::SingleThreaded);
+    viewer.setIncrementalCompileOperation(ico.get());
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext(pbuffer.get());
+    camera->setViewport(new osg::Viewport(0,0,width,height));
+    camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+    camera->setProjectionMatrixAsOrtho2D(-0.5, 0.5, -0.5, 0.5);
+    camera->setViewMatrix(osg::Matrixd::identity());
+    viewer.realize();
+
+    osg::State* state = pbuffer->getState();
+    state->setShaderCompositionEnabled(true);
+    osg::ShaderComposer* shaderComposer = state->getShaderComposer();
+
+    // the first run composes and compiles the programs as they are drawn, the second precompiles them on
+    // the IncrementalCompileOperation before the scene is drawn.
+    const char* runNames[2] = { "Lazy", "Precompiled" };
+    for(unsigned int run=0; run<2; ++run)
+    {
+        osg::ref_ptr<osg::Node> scene = createScene(numCompositions, run);
+
+        unsigned int numFrames = 0;
+        if (run==1)
+        {
+            osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(scene.get());
+            ico->add(compileSet.get());
+            while(!compileSet->compiled() && numFrames<numCompositions+100)
+            {
+                viewer.frame();
+                ++numFrames;
+            }
+        }
+
+        unsigned int numProgramsBeforeDraw = shaderComposer->getNumberOfPrograms();
+
+        viewer.setSceneData(scene.get());
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        viewer.frame();
+        osg::Timer_t end = osg::Timer::instance()->tick();
+
+        unsigned int numProgramsComposed = shaderComposer->getNumberOfPrograms()-numProgramsBeforeDraw;
+
+        std::cout<<runNames[run]<<" first frame with "<<numCompositions<<" shader compositions : "<<osg::Timer::instance()->delta_m(start, end)<<"ms, "
+                 <<numProgramsComposed<<" programs composed while drawing";
+        if (run==1) std::cout<<", "<<numFrames<<" frames to precompile";
+        std::cout<<std::endl;
+
+        if (run==1 && numProgramsComposed!=0)
+        {
+            std::cout<<"Error: shader composition tests failed, "<<numProgramsComposed<<" programs weren't precompiled"<<std::endl;
+        }
+
+        viewer.setSceneData(0);
+        viewer.frame();
+    }
+
+    testCompileContextPrecompile(numCompositions);
+
+    osg::setNotifyLevel(notifyLevel);
+}
@@ -0,0 +1,229 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+
+
+#include "StateStackTests.h"
+
+#include <osg/GL>
+#include <osg/State>
+#include <osg/StateSet>
+#include <osg/Timer>
+#include <osg/Uniform>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+
+// StateAttribute that records its applications rather than calling OpenGL, so the State's stacks can be
+// exercised without a graphics context.
+class TestAttribute : public osg::StateAttribute
+{
+public:
+
+    TestAttribute():
+        _type(MATERIAL),
+        _member(0),
+        _textureAttribute(false),
+        _id(0) {}
+
+    TestAttribute(Type type, unsigned int member, bool textureAttribute, unsigned int id):
+        _type(type),
+        _member(member),
+        _textureAttribute(textureAttribute),
+        _id(id) {}
+
+    TestAttribute(const TestAttribute& rhs, const osg::CopyOp& copyop=osg::CopyOp::SHALLOW_COPY):
+        osg::StateAttribute(rhs, copyop),
+        _type(rhs._type),
+        _member(rhs._member),
+        _textureAttribute(rhs._textureAttribute),
+        _id(rhs._id) {}
+
+    virtual osg::Object* cloneType() const { return new TestAttribute(_type, _member, _textureAttribute, _id); }
+    virtual osg::Object* clone(const osg::CopyOp& copyop) const { return new TestAttribute(*this, copyop); }
+    virtual bool isSameKindAs(const osg::Object* obj) const { return dynamic_cast<const TestAttribute*>(obj)!=0; }
+    virtual const char* libraryName() const { return "osgunittests"; }
+    virtual const char* className() const { return "TestAttribute"; }
+
+    virtual Type getType() const { return _type; }
+    virtual unsigned int getMember() const { return _member; }
+    virtual bool isTextureAttribute() const { return _textureAttribute; }
+
+    virtual int compare(const osg::StateAttribute& sa) const
+    {
+        COMPARE_StateAttribute_Types(TestAttribute,sa)
+        COMPARE_StateAttribute_Parameter(_member)
+        COMPARE_StateAttribute_Parameter(_id)
+        return 0;
+    }
+
+    virtual void apply(osg::State&) const
+    {
+        ++s_numApplied;
+        // State::apply() doesn't apply the attributes in key order, so the hash doesn't depend on the order within an apply.
+        s_appliedHash += _id*2654435761u;
+    }
+
+    static unsigned int s_numApplied;
+    static unsigned int s_appliedHash;
+
+protected:
+
+    Type            _type;
+    unsigned int    _member;
+    bool            _textureAttribute;
+    unsigned int    _id;
+};
+
+unsigned int TestAttribute::s_numApplied = 0;
+unsigned int TestAttribute::s_appliedHash = 0;
+
+const osg::StateAttribute::GLMode testModes[] =
+{
+    GL_LIGHTING, GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_POLYGON_OFFSET_FILL, GL_NORMALIZE,
+    GL_CLIP_PLANE0, GL_CLIP_PLANE0+1, GL_LIGHT0, GL_LIGHT0+1, GL_LIGHT0+2, GL_LIGHT0+3
+};
+
+const unsigned int numTestModes = sizeof(testModes)/sizeof(osg::StateAttribute::GLMode);
+
+const unsigned int numMaterials = 32;
+const unsigned int numLeaves = 256;
+const unsigned int numStateChangesPerFrame = 20000;
+
+unsigned int s_nextId = 1;
+
+TestAttribute* createAttribute(osg::StateAttribute::Type type, unsigned int member, bool textureAttribute=false)
+{
+    return new TestAttribute(type, member, textureAttribute, s_nextId++);
+}
+
+std::string uniformName(const char* prefix, unsigned int i)
+{
+    std::ostringstream str;
+    str<<prefix<<i;
+    return str.str();
+}
+
+osg::StateSet* createRootStateSet()
+{
+    osg::StateSet* stateset = new osg::StateSet;
+    for(unsigned int i=0; i<numTestModes; ++i)
+    {
+        stateset->setMode(testModes[i], (i%2)==0 ? osg::StateAttribute::ON : osg::StateAttribute::OFF);
+    }
+    stateset->setAttribute(createAttribute(osg::StateAttribute::DEPTH, 0));
+    stateset->setAttribute(createAttribute(osg::StateAttribute::CULLFACE, 0));
+    stateset->setAttribute(createAttribute(osg::StateAttribute::LIGHT, 0));
+    stateset->setAttribute(createAttribute(osg::StateAttribute::LIGHT, 1));
+    for(unsigned int i=0; i<4; ++i)
+    {
+        stateset->addUniform(new osg::Uniform(uniformName("osg_RootUniform", i).c_str(), float(i)));
+    }
+    return stateset;
+}
+
+osg::StateSet* createMaterialStateSet(unsigned int i)
+{
+    osg::StateSet* stateset = new osg::StateSet;
+    stateset->setAttribute(createAttribute(osg::StateAttribute::MATERIAL, 0));
+    stateset->setAttribute(createAttribute(osg::StateAttribute::LIGHT, 2+i%6));
+    if (i%3==0)
+    {
+        stateset->setAttribute(createAttribute(osg::StateAttribute::BLENDFUNC, 0));
+        stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+    }
+    if (i%8==0)
+    {
+        // override the depth of everything below.
+        stateset->setAttribute(createAttribute(osg::StateAttribute::DEPTH, 0), osg::StateAttribute::OVERRIDE);
+    }
+    stateset->addUniform(new osg::Uniform("osg_MaterialColor", float(i)));
+    stateset->addUniform(new osg::Uniform(uniformName("osg_MaterialUniform", i%4).c_str(), float(i)));
+    return stateset;
+}
+
+osg::StateSet* createLeafStateSet(unsigned int i)
+{
+    osg::StateSet* stateset = new osg::StateSet;
+    stateset->setTextureAttribute(0, createAttribute(osg::StateAttribute::TEXTURE, 0, true));
+    stateset->setTextureAttribute(0, createAttribute(osg::StateAttribute::TEXENV, 0, true));
+    if (i%2==0) stateset->setTextureAttribute(1, createAttribute(osg::StateAttribute::TEXTURE, 0, true));
+    if (i%5==0) stateset->setMode(GL_CULL_FACE, osg::StateAttribute::OFF);
+    if (i%4==0) stateset->setAttribute(createAttribute(osg::StateAttribute::CLIPPLANE, i%6));
+    if (i%7==0) stateset->setAttribute(createAttribute(osg::StateAttribute::DEPTH, 0));
+    stateset->addUniform(new osg::Uniform("osg_LeafIndex", int(i)));
+    return stateset;
+}
+
+}
+
+void runStateStackTests(unsigned int numFrames)
+{
+    osg::ref_ptr<osg::State> state = new osg::State;
+
+    // the test attributes don't call OpenGL, invalidate the modes so they don't either.
+    for(unsigned int i=0; i<numTestModes; ++i)
+    {
+        state->setModeValidity(testModes[i], false);
+    }
+
+    osg::ref_ptr<osg::StateSet> root = createRootStateSet();
+
+    typedef std::vector< osg::ref_ptr<osg::StateSet> > StateSets;
+    StateSets materials, leaves;
+    for(unsigned int i=0; i<numMaterials; ++i) materials.push_back(createMaterialStateSet(i));
+    for(unsigned int i=0; i<numLeaves; ++i) leaves.push_back(createLeafStateSet(i));
+
+    TestAttribute::s_numApplied = 0;
+    TestAttribute::s_appliedHash = 0;
+
+    // the same sequence of StateSet changes as RenderLeaf::render() of state sorted leaves.
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    for(unsigned int frame=0; frame<numFrames; ++frame)
+    {
+        state->pushStateSet(root.get());
+
+        unsigned int currentMaterial = numMaterials;
+        for(unsigned int i=0; i<numStateChangesPerFrame; ++i)
+        {
+            unsigned int material = (i/4)%numMaterials;
+            if (material!=currentMaterial)
+            {
+                if (currentMaterial!=numMaterials) state->popStateSet();
+                state->pushStateSet(materials[material].get());
+                currentMaterial = material;
+            }
+
+            state->apply(leaves[(i*7919)%numLeaves].get());
+        }
+
+        state->popAllStateSets();
+        state->apply();
+    }
+    double time = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    unsigned int numStateChanges = numFrames*numStateChangesPerFrame;
+    std::cout<<"State stack test of "<<numFrames<<" frames of "<<numStateChangesPerFrame<<" state changes"<<std::endl;
+    std::cout<<"    "<<time*1000.0<<"ms, "<<time*1e9/double(numStateChanges)<<"ns per state change, "
+             <<time*1000.0/double(numFrames)<<"ms per frame"<<std::endl;
+    std::cout<<"    "<<TestAttribute::s_numApplied<<" attributes applied, hash "<<TestAttribute::s_appliedHash<<std::endl;
+}
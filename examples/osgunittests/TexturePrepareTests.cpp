@@ -0,0 +1,386 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+
+#include "TexturePrepareTests.h"
+
+#include <osg/GraphicsContext>
+#include <osg/Image>
+#include <osg/ImageUtils>
+#include <osg/Math>
+#include <osg/Texture2D>
+#include <osg/Timer>
+#include <osg/ref_ptr>
+
+#include <iostream>
+#include <string.h>
+
+namespace
+{
+
+// Smooth gradients with a little noise, closer to the photographic textures block compression is made for than noise alone.
+osg::Image* createImage(GLenum pixelFormat, int s, int t)
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(s, t, 1, pixelFormat, GL_UNSIGNED_BYTE);
+
+    const unsigned int numComponents = osg::Image::computeNumComponents(pixelFormat);
+    unsigned int seed = 12345;
+    for(int y=0; y<t; ++y)
+    {
+        unsigned char* data = image->data(0,y);
+        for(int x=0; x<s; ++x)
+        {
+            float u = float(x)/float(s);
+            float v = float(y)/float(t);
+            float values[4] =
+            {
+                0.5f+0.5f*sinf(u*7.0f+v*3.0f),
+                u,
+                0.5f+0.5f*cosf(v*5.0f-u*2.0f),
+                1.0f-(u-0.5f)*(u-0.5f)-(v-0.5f)*(v-0.5f)
+            };
+
+            for(unsigned int c=0; c<numComponents; ++c)
+            {
+                seed = seed*1664525u + 1013904223u;
+                int value = int(values[c]*240.0f) + int((seed>>24)&7);
+                *data++ = static_cast<unsigned char>(osg::clampBetween(value, 0, 255));
+            }
+        }
+    }
+    return image.release();
+}
+
+osg::Image* cloneImage(const osg::Image* image)
+{
+    return new osg::Image(*image, osg::CopyOp::DEEP_COPY_ALL);
+}
+
+// Check the box filtered levels against averaging the level above directly.
+bool checkBoxMipmaps(const osg::Image* image)
+{
+    const unsigned int C = osg::Image::computeNumComponents(image->getPixelFormat());
+    for(unsigned int level=1; level<image->getNumMipmapLevels(); ++level)
+    {
+        const int sourceWidth = osg::maximum(image->s()>>(level-1), 1);
+        const int sourceHeight = osg::maximum(image->t()>>(level-1), 1);
+        const int width = osg::maximum(image->s()>>level, 1);
+        const int height = osg::maximum(image->t()>>level, 1);
+        const unsigned char* source = image->getMipmapData(level-1);
+        const unsigned char* dest = image->getMipmapData(level);
+        for(int y=0; y<height; ++y)
+        {
+            for(int x=0; x<width; ++x)
+            {
+                for(unsigned int c=0; c<C; ++c)
+                {
+                    int x0 = osg::minimum(x*2, sourceWidth-1), x1 = osg::minimum(x*2+1, sourceWidth-1);
+                    int y0 = osg::minimum(y*2, sourceHeight-1), y1 = osg::minimum(y*2+1, sourceHeight-1);
+                    int sum = source[(y0*sourceWidth+x0)*C+c] + source[(y0*sourceWidth+x1)*C+c] +
+                              source[(y1*sourceWidth+x0)*C+c] + source[(y1*sourceWidth+x1)*C+c];
+                    if (dest[(y*width+x)*C+c]!=(sum+2)/4) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// A filter whose weights sum to one leaves a constant image unchanged at every level.
+bool checkConstantMipmaps(int s, int t, osg::MipmapFilter filter)
+{
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(s, t, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    for(unsigned int i=0; i<image->getTotalSizeInBytes(); ++i) image->data()[i] = static_cast<unsigned char>(37+(i%4)*50);
+
+    if (!osg::generateMipmaps(image.get(), filter)) return false;
+
+    for(unsigned int level=0; level<image->getNumMipmapLevels(); ++level)
+    {
+        unsigned int size = osg::maximum(s>>level, 1)*osg::maximum(t>>level, 1)*4;
+        const unsigned char* data = image->getMipmapData(level);
+        for(unsigned int i=0; i<size; ++i)
+        {
+            if (data[i]!=37+(i%4)*50) return false;
+        }
+    }
+    return true;
+}
+
+void decodeColourBlock(const unsigned char* block, unsigned char rgba[16][4])
+{
+    unsigned int c0 = block[0] | (block[1]<<8);
+    unsigned int c1 = block[2] | (block[3]<<8);
+
+    int colours[4][4];
+    colours[0][0] = ((c0>>11)&31)*255/31; colours[0][1] = ((c0>>5)&63)*255/63; colours[0][2] = (c0&31)*255/31;
+    colours[1][0] = ((c1>>11)&31)*255/31; colours[1][1] = ((c1>>5)&63)*255/63; colours[1][2] = (c1&31)*255/31;
+    for(int c=0; c<3; ++c)
+    {
+        if (c0>c1)
+        {
+            colours[2][c] = (2*colours[0][c]+colours[1][c])/3;
+            colours[3][c] = (colours[0][c]+2*colours[1][c])/3;
+        }
+        else
+        {
+            colours[2][c] = (colours[0][c]+colours[1][c])/2;
+            colours[3][c] = 0;
+        }
+    }
+
+    unsigned int indices = block[4] | (block[5]<<8) | (block[6]<<16) | (block[7]<<24);
+    for(int i=0; i<16; ++i)
+    {
+        int index = (indices>>(i*2))&3;
+        for(int c=0; c<3; ++c) rgba[i][c] = static_cast<unsigned char>(colours[index][c]);
+    }
+}
+
+void decodeValueBlock(const unsigned char* block, unsigned char rgba[16][4], int component)
+{
+    int values[8];
+    values[0] = block[0];
+    values[1] = block[1];
+    if (values[0]>values[1])
+    {
+        for(int i=1; i<7; ++i) values[i+1] = ((7-i)*values[0]+i*values[1])/7;
+    }
+    else
+    {
+        for(int i=1; i<5; ++i) values[i+1] = ((5-i)*values[0]+i*values[1])/5;
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    for(int i=0; i<16; ++i)
+    {
+        int bit = 16+i*3;
+        int index = 0;
+        for(int b=0; b<3; ++b, ++bit) index |= ((block[bit/8]>>(bit%8))&1)<<b;
+        rgba[i][component] = static_cast<unsigned char>(values[index]);
+    }
+}
+
+struct CompressionTest
+{
+    const char*     name;
+    GLenum          pixelFormat;
+    GLenum          compressedFormat;
+    unsigned int    numComponents;
+    double          maximumError;
+};
+
+const CompressionTest s_compressionTests[] =
+{
+    { "BC1", GL_RGB,                GL_COMPRESSED_RGB_S3TC_DXT1_EXT,    3, 6.0 },
+    { "BC3", GL_RGBA,               GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,   4, 6.0 },
+    { "BC4", GL_LUMINANCE,          GL_COMPRESSED_RED_RGTC1_EXT,        1, 3.0 },
+    { "BC5", GL_RGB,                GL_COMPRESSED_RED_GREEN_RGTC2_EXT,  2, 3.0 }
+};
+
+const unsigned int s_numCompressionTests = sizeof(s_compressionTests)/sizeof(CompressionTest);
+
+// Decode the first level of the compressed image and return the root mean square error against the source.
+double computeCompressionError(const CompressionTest& test, const osg::Image* source, const osg::Image* compressed)
+{
+    const unsigned int blockSize = (test.compressedFormat==GL_COMPRESSED_RGB_S3TC_DXT1_EXT || test.compressedFormat==GL_COMPRESSED_RED_RGTC1_EXT) ? 8 : 16;
+    const int numBlocksWide = (source->s()+3)/4;
+
+    double sumOfSquares = 0.0;
+    unsigned int numValues = 0;
+    for(int y=0; y<source->t(); y+=4)
+    {
+        for(int x=0; x<source->s(); x+=4)
+        {
+            const unsigned char* block = compressed->data() + ((y/4)*numBlocksWide + x/4)*blockSize;
+
+            unsigned char rgba[16][4];
+            switch(test.compressedFormat)
+            {
+                case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):      decodeColourBlock(block, rgba); break;
+                case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):     decodeValueBlock(block, rgba, 3); decodeColourBlock(block+8, rgba); break;
+                case(GL_COMPRESSED_RED_RGTC1_EXT):          decodeValueBlock(block, rgba, 0); break;
+                case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):    decodeValueBlock(block, rgba, 0); decodeValueBlock(block+8, rgba, 1); break;
+            }
+
+            for(int by=0; by<4 && y+by<source->t(); ++by)
+            {
+                for(int bx=0; bx<4 && x+bx<source->s(); ++bx)
+                {
+                    const unsigned char* pixel = source->data(x+bx, y+by);
+                    for(unsigned int c=0; c<test.numComponents; ++c)
+                    {
+                        // compare the components the format keeps, BC5 keeps the red and green of an RGB image.
+                        double difference = double(rgba[by*4+bx][c]) - double(pixel[c]);
+                        sumOfSquares += difference*difference;
+                        ++numValues;
+                    }
+                }
+            }
+        }
+    }
+    return numValues>0 ? sqrt(sumOfSquares/double(numValues)) : 0.0;
+}
+
+// Time compiling a texture of the image in a pbuffer, once leaving the mipmaps and compression to the driver
+// and once with the image prepared as the DatabasePager's threads would.
+void runUploadTests(unsigned int size)
+{
+    osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+    traits->width = 64;
+    traits->height = 64;
+    traits->red = 8;
+    traits->green = 8;
+    traits->blue = 8;
+    traits->alpha = 8;
+    traits->depth = 24;
+    traits->doubleBuffer = false;
+    traits->pbuffer = true;
+
+    osg::ref_ptr<osg::GraphicsContext> pbuffer = osg::GraphicsContext::createGraphicsContext(traits.get());
+    if (!pbuffer.valid() || !pbuffer->realize() || !pbuffer->makeCurrent())
+    {
+        std::cout<<"  Texture upload tests skipped, unable to create a pbuffer."<<std::endl;
+        return;
+    }
+
+    osg::State& state = *(pbuffer->getState());
+    osg::Texture::Extensions* extensions = osg::Texture::getExtensions(state.getContextID(), true);
+    if (!extensions->isTextureCompressionS3TCSupported())
+    {
+        std::cout<<"  Texture upload tests skipped, S3TC compression is not supported."<<std::endl;
+        pbuffer->releaseContext();
+        return;
+    }
+
+    osg::ref_ptr<osg::Image> source = createImage(GL_RGBA, size, size);
+
+    double uploadTimes[2] = { 0.0, 0.0 };
+    for(unsigned int prepare=0; prepare<2; ++prepare)
+    {
+        osg::ref_ptr<osg::Image> image = cloneImage(source.get());
+
+        osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D(image.get());
+        texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
+        texture->setInternalFormatMode(osg::Texture::USE_S3TC_DXT5_COMPRESSION);
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        if (prepare)
+        {
+            osg::generateMipmaps(image.get());
+            osg::compressImage(image.get(), GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+            texture->setInternalFormatMode(osg::Texture::USE_IMAGE_DATA_FORMAT);
+        }
+        double prepareTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        start = osg::Timer::instance()->tick();
+        texture->apply(state);
+        glFinish();
+        double uploadTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+        uploadTimes[prepare] = uploadTime;
+
+        std::cout<<"  "<<(prepare ? "prepared DXT5 upload" : "driver mipmaps and DXT5 upload")
+                 <<"\tprepare "<<prepareTime*1000.0<<"ms\tupload "<<uploadTime*1000.0<<"ms"<<std::endl;
+
+        texture->releaseGLObjects(&state);
+    }
+
+    // the preparation runs on the DatabasePager's threads, so the difference is the time saved on the draw thread.
+    std::cout<<"  draw thread upload before "<<uploadTimes[0]*1000.0<<"ms	after "<<uploadTimes[1]*1000.0<<"ms"
+             <<"	saved "<<(uploadTimes[0]-uploadTimes[1])*1000.0<<"ms"<<std::endl;
+
+    pbuffer->releaseContext();
+}
+
+}
+
+void runTexturePrepareTests(unsigned int size)
+{
+    unsigned int previousNumThreads = osg::getImageKernelNumThreads();
+
+    const unsigned int threadCounts[] = { 1, 4 };
+    const unsigned int numRepeats = 4;
+
+    std::cout<<"Texture prepare tests of "<<size<<"x"<<size<<" images"<<std::endl;
+
+    bool passed = true;
+
+    osg::ref_ptr<osg::Image> rgba = createImage(GL_RGBA, size, size);
+    const char* filterNames[] = { "box", "Kaiser" };
+    for(unsigned int f=0; f<2; ++f)
+    {
+        osg::MipmapFilter filter = f==0 ? osg::MIPMAP_BOX_FILTER : osg::MIPMAP_KAISER_FILTER;
+        for(unsigned int tc=0; tc<2; ++tc)
+        {
+            osg::setImageKernelNumThreads(threadCounts[tc]);
+
+            osg::ref_ptr<osg::Image> image;
+            double time = 0.0;
+            for(unsigned int r=0; r<numRepeats; ++r)
+            {
+                image = cloneImage(rgba.get());
+                osg::Timer_t start = osg::Timer::instance()->tick();
+                if (!osg::generateMipmaps(image.get(), filter)) passed = false;
+                time += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            }
+
+            bool correct = image->getNumMipmapLevels()==static_cast<unsigned int>(osg::Image::computeNumberOfMipmapLevels(size, size)) &&
+                           (filter==osg::MIPMAP_KAISER_FILTER || checkBoxMipmaps(image.get())) &&
+                           checkConstantMipmaps(size, size/2+1, filter);
+            if (!correct) passed = false;
+
+            std::cout<<"  "<<filterNames[f]<<" mipmaps\t"<<threadCounts[tc]<<" threads\t"<<time*1000.0/double(numRepeats)<<"ms"
+                     <<(correct ? "" : "\tFAILED")<<std::endl;
+        }
+    }
+
+    for(unsigned int ct=0; ct<s_numCompressionTests; ++ct)
+    {
+        const CompressionTest& test = s_compressionTests[ct];
+        osg::ref_ptr<osg::Image> source = createImage(test.pixelFormat, size, size);
+
+        for(unsigned int tc=0; tc<2; ++tc)
+        {
+            osg::setImageKernelNumThreads(threadCounts[tc]);
+
+            osg::ref_ptr<osg::Image> image;
+            double time = 0.0;
+            for(unsigned int r=0; r<numRepeats; ++r)
+            {
+                image = cloneImage(source.get());
+                osg::Timer_t start = osg::Timer::instance()->tick();
+                if (!osg::compressImage(image.get(), test.compressedFormat)) passed = false;
+                time += osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            }
+
+            double error = image->isCompressed() ? computeCompressionError(test, source.get(), image.get()) : 255.0;
+            bool correct = error<=test.maximumError;
+            if (!correct) passed = false;
+
+            std::cout<<"  "<<test.name<<"\t"<<threadCounts[tc]<<" threads\t"<<time*1000.0/double(numRepeats)<<"ms\tRMSE "<<error
+                     <<(correct ? "" : "\tFAILED")<<std::endl;
+        }
+    }
+
+    osg::setImageKernelNumThreads(previousNumThreads);
+
+    runUploadTests(size);
+
+    if (!passed) std::cout<<"Error: texture prepare tests failed"<<std::endl;
+}
@@ -0,0 +1,338 @@
+/* OpenSceneGraph example, osgunittests.
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*  THE SOFTWARE.
+*/
+#include "ZipRead.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Timer>
+
+#include <osgDB/Archive>
+#include <osgDB/Registry>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Barrier>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+
+const unsigned int numTiles = 512;
+const unsigned int tileSize = 32;
+const unsigned int numReadsPerThread = 512;
+const char* zipFileName = "osgunittests_tiles.zip";
+
+osg::Geometry* createTileGeometry(unsigned int tile)
+{
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+
+    for(unsigned int r=0; r<tileSize; ++r)
+    {
+        for(unsigned int c=0; c<tileSize; ++c)
+        {
+            float x = float(c)/float(tileSize-1);
+            float y = float(r)/float(tileSize-1);
+            vertices->push_back(osg::Vec3(x+float(tile), y, sinf(x*10.0f+float(tile))*cosf(y*7.0f)));
+        }
+    }
+
+    for(unsigned int r=0; r<tileSize-1; ++r)
+    {
+        for(unsigned int c=0; c<tileSize-1; ++c)
+        {
+            unsigned int i = r*tileSize+c;
+            indices->push_back(i); indices->push_back(i+1); indices->push_back(i+tileSize);
+            indices->push_back(i+1); indices->push_back(i+tileSize+1); indices->push_back(i+tileSize);
+        }
+    }
+
+    osg::Geometry* geometry = new osg::Geometry;
+    geometry->setVertexArray(vertices.get());
+    geometry->addPrimitiveSet(indices.get());
+    return geometry;
+}
+
+std::string createTileFileName(unsigned int tile)
+{
+    std::ostringstream str;
+    str<<"tiles/"<<tile/64<<"/tile_"<<tile<<".osgb";
+    return str.str();
+}
+
+bool sameGeometry(const osg::Geometry* lhs, const osg::Node* node)
+{
+    const osg::Geode* geode = node ? node->asGeode() : 0;
+    const osg::Geometry* rhs = (geode && geode->getNumDrawables()==1) ? geode->getDrawable(0)->asGeometry() : 0;
+    if (!lhs || !rhs) return false;
+
+    const osg::Array* lv = lhs->getVertexArray();
+    const osg::Array* rv = rhs->getVertexArray();
+    if (!rv || lv->getTotalDataSize()!=rv->getTotalDataSize() ||
+        memcmp(lv->getDataPointer(), rv->getDataPointer(), lv->getTotalDataSize())!=0) return false;
+
+    const osg::DrawElementsUInt* lde = dynamic_cast<const osg::DrawElementsUInt*>(lhs->getPrimitiveSet(0));
+    const osg::DrawElementsUInt* rde = dynamic_cast<const osg::DrawElementsUInt*>(rhs->getPrimitiveSet(0));
+    return lde && rde && static_cast<const osg::DrawElementsUInt::vector_type&>(*lde)==static_cast<const osg::DrawElementsUInt::vector_type&>(*rde);
+}
+
+unsigned int crc32(const std::string& data)
+{
+    static unsigned int table[256];
+    if (table[1]==0)
+    {
+        for(unsigned int i=0; i<256; ++i)
+        {
+            unsigned int c = i;
+            for(unsigned int k=0; k<8; ++k) c = (c&1) ? (0xEDB88320u ^ (c>>1)) : (c>>1);
+            table[i] = c;
+        }
+    }
+
+    unsigned int crc = 0xFFFFFFFFu;
+    for(std::string::const_iterator itr=data.begin(); itr!=data.end(); ++itr)
+    {
+        crc = table[(crc ^ static_cast<unsigned char>(*itr)) & 0xFF] ^ (crc>>8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void write16(std::ostream& out, unsigned int value)
+{
+    out.put(char(value&0xFF)); out.put(char((value>>8)&0xFF));
+}
+
+void write32(std::ostream& out, unsigned int value)
+{
+    write16(out, value&0xFFFF); write16(out, value>>16);
+}
+
+/** Write the files to a zip, stored rather than deflated, with the central directory at the end as zip tools write it.*/
+bool writeZip(const char* filename, const std::vector<std::string>& names, const std::vector<std::string>& contents)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) return false;
+
+    std::vector<unsigned int> offsets, crcs;
+    for(unsigned int i=0; i<names.size(); ++i)
+    {
+        offsets.push_back(static_cast<unsigned int>(out.tellp()));
+        crcs.push_back(crc32(contents[i]));
+
+        write32(out, 0x04034b50);
+        write16(out, 10); write16(out, 0); write16(out, 0);     // version needed, flags, stored
+        write16(out, 0); write16(out, 0x21);                    // dos time and date
+        write32(out, crcs[i]);
+        write32(out, contents[i].size()); write32(out, contents[i].size());
+        write16(out, names[i].size()); write16(out, 0);
+        out<<names[i]<<contents[i];
+    }
+
+    unsigned int centralDirectoryOffset = static_cast<unsigned int>(out.tellp());
+    for(unsigned int i=0; i<names.size(); ++i)
+    {
+        write32(out, 0x02014b50);
+        write16(out, 0x031e); write16(out, 10); write16(out, 0); write16(out, 0);   // made by unix, version needed, flags, stored
+        write16(out, 0); write16(out, 0x21);
+        write32(out, crcs[i]);
+        write32(out, contents[i].size()); write32(out, contents[i].size());
+        write16(out, names[i].size()); write16(out, 0); write16(out, 0);            // name, extra and comment lengths
+        write16(out, 0); write16(out, 0);                                           // disk, internal attributes
+        write32(out, 0100644u<<16);                                                 // regular file
+        write32(out, offsets[i]);
+        out<<names[i];
+    }
+    unsigned int centralDirectorySize = static_cast<unsigned int>(out.tellp())-centralDirectoryOffset;
+
+    write32(out, 0x06054b50);
+    write16(out, 0); write16(out, 0);
+    write16(out, names.size()); write16(out, names.size());
+    write32(out, centralDirectorySize); write32(out, centralDirectoryOffset);
+    write16(out, 0);
+
+    return out.good();
+}
+
+typedef std::vector< osg::ref_ptr<osg::Geometry> > Tiles;
+
+// each thread reads its own sequence of tiles, striding backwards through the archive so every read is of an
+// entry before the last one read on the handle.
+class ZipReadThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    ZipReadThread(osgDB::Archive* archive, const Tiles& tiles, unsigned int first, OpenThreads::Barrier& startBarrier, OpenThreads::Barrier& endBarrier):
+        _archive(archive),
+        _tiles(tiles),
+        _first(first),
+        _startBarrier(startBarrier),
+        _endBarrier(endBarrier),
+        _numFailed(0) {}
+
+    virtual void run()
+    {
+        _startBarrier.block();
+
+        for(unsigned int i=0; i<numReadsPerThread; ++i)
+        {
+            unsigned int tile = (_first+numTiles*numReadsPerThread-i*13)%numTiles;
+            osgDB::ReaderWriter::ReadResult result = _archive->readNode(createTileFileName(tile));
+            if (!sameGeometry(_tiles[tile].get(), result.getNode())) ++_numFailed;
+        }
+
+        _endBarrier.block();
+    }
+
+    unsigned int getNumFailed() const { return _numFailed; }
+
+protected:
+
+    virtual ~ZipReadThread() {}
+
+    osgDB::Archive*             _archive;
+    const Tiles&                _tiles;
+    unsigned int                _first;
+    OpenThreads::Barrier&       _startBarrier;
+    OpenThreads::Barrier&       _endBarrier;
+    unsigned int                _numFailed;
+};
+
+double readZip(osgDB::Archive* archive, const Tiles& tiles, unsigned int numThreads, unsigned int& numFailed)
+{
+    OpenThreads::Barrier startBarrier(numThreads+1);
+    OpenThreads::Barrier endBarrier(numThreads+1);
+
+    typedef std::vector< osg::ref_ptr<ZipReadThread> > Threads;
+    Threads threads;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        threads.push_back(new ZipReadThread(archive, tiles, i*numTiles/numThreads, startBarrier, endBarrier));
+        threads.back()->startThread();
+    }
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+    startBarrier.block();
+    endBarrier.block();
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    for(Threads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        while((*itr)->isRunning()) OpenThreads::Thread::YieldCurrentThread();
+        numFailed += (*itr)->getNumFailed();
+    }
+
+    return osg::Timer::instance()->delta_m(startTick, endTick);
+}
+
+}
+
+void runZipReadTests(unsigned int maxNumThreads)
+{
+    osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    if (!rw)
+    {
+        std::cout<<"zip read tests skipped, no osgb plugin"<<std::endl;
+        return;
+    }
+
+    Tiles tiles;
+    std::vector<std::string> names, contents;
+    double totalSize = 0.0;
+    for(unsigned int tile=0; tile<numTiles; ++tile)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        tiles.push_back(createTileGeometry(tile));
+        geode->addDrawable(tiles.back().get());
+
+        std::ostringstream str;
+        if (!rw->writeNode(*geode, str).success())
+        {
+            std::cout<<"zip read tests skipped, unable to write "<<createTileFileName(tile)<<std::endl;
+            return;
+        }
+        names.push_back(createTileFileName(tile));
+        contents.push_back(str.str());
+        totalSize += double(contents.back().size());
+    }
+
+    if (!writeZip(zipFileName, names, contents))
+    {
+        std::cout<<"zip read tests skipped, unable to write "<<zipFileName<<std::endl;
+        remove(zipFileName);
+        return;
+    }
+
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options;
+    options->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+
+    bool passed = true;
+    osg::ref_ptr<osgDB::Archive> archive = osgDB::openArchive(zipFileName, osgDB::Archive::READ, 4096, options.get());
+    if (archive.valid())
+    {
+        // time looking up every entry, including ones that aren't there.
+        osg::Timer_t startTick = osg::Timer::instance()->tick();
+        unsigned int numFound = 0;
+        for(unsigned int tile=0; tile<numTiles*2; ++tile)
+        {
+            if (archive->fileExists(createTileFileName(tile))) ++numFound;
+        }
+        double lookupTime = osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick());
+        if (numFound!=numTiles)
+        {
+            std::cout<<"Error: found "<<numFound<<" of the "<<numTiles<<" entries in "<<zipFileName<<std::endl;
+            passed = false;
+        }
+        std::cout<<"zip lookup of "<<numTiles*2<<" names in "<<numTiles<<" entries "<<lookupTime<<"ms"<<std::endl;
+
+        double megabytesPerThread = totalSize/(1024.0*1024.0)*double(numReadsPerThread)/double(numTiles);
+        for(unsigned int numThreads=1; numThreads<=maxNumThreads; numThreads*=2)
+        {
+            unsigned int numFailed = 0;
+            double time = readZip(archive.get(), tiles, numThreads, numFailed);
+
+            double megabytes = megabytesPerThread*double(numThreads);
+            std::cout<<"zip read with "<<numThreads<<" threads, "<<megabytes<<"MB : "<<time<<"ms ("<<megabytes/(time*0.001)<<"MB/s)"<<std::endl;
+
+            if (numFailed!=0)
+            {
+                std::cout<<"Error: "<<numFailed<<" reads with "<<numThreads<<" threads differ from the written geometry"<<std::endl;
+                passed = false;
+            }
+        }
+
+        archive->close();
+        archive = 0;
+    }
+    else
+    {
+        std::cout<<"Error: unable to open "<<zipFileName<<std::endl;
+        passed = false;
+    }
+
+    remove(zipFileName);
+
+    if (!passed) std::cout<<"Error: zip read tests failed"<<std::endl;
+}
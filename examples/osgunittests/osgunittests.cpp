@@ -30,6 +30,29 @@
 #include "UnitTestFramework.h"
 #include "performance.h"
 #include "MultiThreadRead.h"
+#include "ReferencedThreads.h"
+#include "ParallelCull.h"
+#include "MultiDrawIndirect.h"
+#include "OsgbRead.h"
+#include "OptimizerThreads.h"
+#include "KdTreeTests.h"
+#include "StateStackTests.h"
+#include "ImageKernelsTests.h"
+#include "TexturePrepareTests.h"
+#include "BufferStreamingTests.h"
+#include "BufferPoolTests.h"
+#include "ProgramBinaryCacheTests.h"
+#include "ShaderCompositionTests.h"
+#include "GLMemoryBudgetTests.h"
+#include "CompileContextTests.h"
+#include "MatrixKernelsTests.h"
+#include "OsgaRead.h"
+#include "ZipRead.h"
+#include "ObjectCacheTests.h"
+#include "ObjRead.h"
+#include "MeshRead.h"
+#include "RenderLeafSortTests.h"
+#include "DatabasePagerTests.h"
 
 #include <iostream>
 
@@ -572,6 +595,31 @@ int main( int argc, char** argv )
     arguments.getApplicationUsage()->addCommandLineOption("matrix","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("performance","Display qualified tests.");
     arguments.getApplicationUsage()->addCommandLineOption("read-threads <numthreads>","Run multi-thread reading test.");
+    arguments.getApplicationUsage()->addCommandLineOption("ref-threads <maxthreads>","Run multi-threaded ref/unref and observer_ptr lock throughput tests with 1 up to maxthreads threads.");
+    arguments.getApplicationUsage()->addCommandLineOption("cull-threads <maxthreads>","Compare serial and parallel cull times of a wide Group with 2 up to maxthreads threads.");
+    arguments.getApplicationUsage()->addCommandLineOption("mdi <columns>","Compare RenderBin and MultiDrawIndirectBin rendering of a columns x columns grid into a pbuffer.");
+    arguments.getApplicationUsage()->addCommandLineOption("osgb-read <tiles>","Write tiles .osgb files and compare their read time through ifstream and memory mapping.");
+    arguments.getApplicationUsage()->addCommandLineOption("optimizer-threads <maxthreads>","Compare serial and parallel Optimizer results and pass timings with 2 up to maxthreads threads.");
+    arguments.getApplicationUsage()->addCommandLineOption("kdtree <size>","Compare midpoint and surface area heuristic KdTree builds and single and packet intersections on a size x size terrain grid.");
+    arguments.getApplicationUsage()->addCommandLineOption("kdtree-build <maxthreads>","Time KdTree builds of a large mesh and of many small meshes with 1 to maxthreads threads and check they match.");
+    arguments.getApplicationUsage()->addCommandLineOption("state-stack <frames>","Time osg::State push, pop and apply of StateSets in the order of a state sorted draw traversal.");
+    arguments.getApplicationUsage()->addCommandLineOption("image-kernels <size>","Time the image kernels of each supported instruction set on images of size x size and check they match the per pixel code.");
+    arguments.getApplicationUsage()->addCommandLineOption("texture-prepare <size>","Time generating mipmaps and block compressing size x size images, as the DatabasePager does for loaded textures, and check the results.");
+    arguments.getApplicationUsage()->addCommandLineOption("buffer-streaming <vertices>","Time animating a grid of vertices streamed by glBufferSubData and by a persistently mapped ring buffer, and check they render the same.");
+    arguments.getApplicationUsage()->addCommandLineOption("buffer-pool <tiles>","Page tiles of vertex and index buffers in and out with separate and sub-allocated buffer objects, report pool hits, misses and waste, and check they render the same after compaction.");
+    arguments.getApplicationUsage()->addCommandLineOption("program-binary-cache <programs>","Check the on disk program binary cache, then time a cold and a warm start of a scene with the given number of programs and check they render the same.");
+    arguments.getApplicationUsage()->addCommandLineOption("shader-compositions <compositions>","Check collecting and evicting ShaderComposer programs, then time the first frame of a scene with the given number of shader compositions with and without precompiling them on the IncrementalCompileOperation, and check precompiling them on a compile context.");
+    arguments.getApplicationUsage()->addCommandLineOption("gl-memory-budget <textures>","Render a scene with the given number of textures on a GL memory budget too small for all of them, check the textures out of view are evicted and render the same once back in view.");
+    arguments.getApplicationUsage()->addCommandLineOption("compile-contexts <subgraphs>","Time the frames while the given number of subgraphs are compiled by the IncrementalCompileOperation on the draw thread and then on a compile context, and check they render the same.");
+    arguments.getApplicationUsage()->addCommandLineOption("matrix-kernels <num>","Time Matrixd and Matrixf multiply and invert of num matrices and the transform of arrays of num Vec3's against the per element code, and check they match bit for bit.");
+    arguments.getApplicationUsage()->addCommandLineOption("osga-read <maxthreads>","Time reading tiles from an .osga archive from 1 up to maxthreads threads, memory mapped and through the serialized ifstream, and check they match what was written.");
+    arguments.getApplicationUsage()->addCommandLineOption("zip-read <maxthreads>","Time looking up and reading tiles from a .zip archive from 1 up to maxthreads threads and check they match what was written.");
+    arguments.getApplicationUsage()->addCommandLineOption("object-cache <maxthreads>","Check the ObjectCache keeps within its size budget, evicting the least recently used objects, and time lookups from 1 up to maxthreads threads against a single mutex cache.");
+    arguments.getApplicationUsage()->addCommandLineOption("obj-read <maxthreads>","Check the numbers of an .obj file parse as sscanf reads them, and time reading a large .obj file through a stream and memory mapped with 1 up to maxthreads parse threads, checking each gives the same scene graph.");
+    arguments.getApplicationUsage()->addCommandLineOption("mesh-read <gridsize>","Time reading a grid of gridsize x gridsize cells from ascii, big and little endian .ply files and a binary .stl file, checking the .ply files read the same and the .stl facets are welded.");
+    arguments.getApplicationUsage()->addCommandLineOption("render-leaf-sort <leaves>","Check the RenderBin depth and traversal order sorts of fewer than 256 and of the given number of leaves order them as std::sort does, and time them against std::sort with the old comparators.");
+    arguments.getApplicationUsage()->addCommandLineOption("pager-work-stealing <requests>","Check an idle DatabasePager local file thread reads requests from the http queue only when work stealing is enabled, and time reading the given number of slow http requests with it off and on.");
+    arguments.getApplicationUsage()->addCommandLineOption("pager-request-queue <requests>","Check the DatabasePager RequestQueue heap hands out the given number of requests, some reprioritised, removed or out of date, in the same order as the old sort-based list, and time both.");
  
 
     if (arguments.argc()<=1)
@@ -598,6 +646,81 @@ int main( int argc, char** argv )
     int numReadThreads = 0; 
     while (arguments.read("read-threads", numReadThreads)) {}
 
+    int maxNumRefThreads = 0;
+    while (arguments.read("ref-threads", maxNumRefThreads)) {}
+
+    int maxNumCullThreads = 0;
+    while (arguments.read("cull-threads", maxNumCullThreads)) {}
+
+    int numMultiDrawIndirectColumns = 0;
+    while (arguments.read("mdi", numMultiDrawIndirectColumns)) {}
+
+    int numOsgbReadTiles = 0;
+    while (arguments.read("osgb-read", numOsgbReadTiles)) {}
+
+    int maxNumOptimizerThreads = 0;
+    while (arguments.read("optimizer-threads", maxNumOptimizerThreads)) {}
+
+    int kdTreeGridSize = 0;
+    while (arguments.read("kdtree", kdTreeGridSize)) {}
+
+    int maxNumKdTreeBuildThreads = 0;
+    while (arguments.read("kdtree-build", maxNumKdTreeBuildThreads)) {}
+
+    int numStateStackFrames = 0;
+    while (arguments.read("state-stack", numStateStackFrames)) {}
+
+    int imageKernelsSize = 0;
+    while (arguments.read("image-kernels", imageKernelsSize)) {}
+
+    int texturePrepareSize = 0;
+    while (arguments.read("texture-prepare", texturePrepareSize)) {}
+
+    int numBufferStreamingVertices = 0;
+    while (arguments.read("buffer-streaming", numBufferStreamingVertices)) {}
+
+    int numBufferPoolTiles = 0;
+    while (arguments.read("buffer-pool", numBufferPoolTiles)) {}
+
+    int numProgramBinaryCachePrograms = 0;
+    while (arguments.read("program-binary-cache", numProgramBinaryCachePrograms)) {}
+
+    int numShaderCompositions = 0;
+    while (arguments.read("shader-compositions", numShaderCompositions)) {}
+
+    int numGLMemoryBudgetTextures = 0;
+    while (arguments.read("gl-memory-budget", numGLMemoryBudgetTextures)) {}
+
+    int numCompileContextSubgraphs = 0;
+    while (arguments.read("compile-contexts", numCompileContextSubgraphs)) {}
+
+    int numMatrixKernels = 0;
+    while (arguments.read("matrix-kernels", numMatrixKernels)) {}
+
+    int numOsgaRead = 0;
+    while (arguments.read("osga-read", numOsgaRead)) {}
+
+    int numZipRead = 0;
+    while (arguments.read("zip-read", numZipRead)) {}
+
+    int numObjectCache = 0;
+    while (arguments.read("object-cache", numObjectCache)) {}
+
+    int numObjRead = 0;
+    while (arguments.read("obj-read", numObjRead)) {}
+
+    int numMeshRead = 0;
+    while (arguments.read("mesh-read", numMeshRead)) {}
+
+    int numRenderLeafSortLeaves = 0;
+    while (arguments.read("render-leaf-sort", numRenderLeafSortLeaves)) {}
+
+    int numWorkStealingRequests = 0;
+    while (arguments.read("pager-work-stealing", numWorkStealingRequests)) {}
+
+    int numRequestQueueRequests = 0;
+    while (arguments.read("pager-request-queue", numRequestQueueRequests)) {}
+
     bool printPolytopeTest = false; 
     while (arguments.read("polytope")) printPolytopeTest = true;
     
@@ -680,6 +803,131 @@ int main( int argc, char** argv )
         runPerformanceTests();
     }
 
+    if (maxNumRefThreads>0)
+    {
+        runReferencedThreadTests(maxNumRefThreads);
+    }
+
+    if (maxNumCullThreads>0)
+    {
+        runParallelCullTests(maxNumCullThreads);
+    }
+
+    if (numMultiDrawIndirectColumns>0)
+    {
+        runMultiDrawIndirectTests(numMultiDrawIndirectColumns);
+    }
+
+    if (numOsgbReadTiles>0)
+    {
+        runOsgbReadTests(numOsgbReadTiles);
+    }
+
+    if (maxNumOptimizerThreads>0)
+    {
+        runOptimizerThreadTests(maxNumOptimizerThreads);
+    }
+
+    if (kdTreeGridSize>0)
+    {
+        runKdTreeTests(kdTreeGridSize);
+    }
+
+    if (maxNumKdTreeBuildThreads>0)
+    {
+        runKdTreeBuildTests(maxNumKdTreeBuildThreads);
+    }
+
+    if (numStateStackFrames>0)
+    {
+        runStateStackTests(numStateStackFrames);
+    }
+
+    if (imageKernelsSize>0)
+    {
+        runImageKernelsTests(imageKernelsSize);
+    }
+
+    if (texturePrepareSize>0)
+    {
+        runTexturePrepareTests(texturePrepareSize);
+    }
+
+    if (numBufferStreamingVertices>0)
+    {
+        runBufferStreamingTests(numBufferStreamingVertices);
+    }
+
+    if (numBufferPoolTiles>0)
+    {
+        runBufferPoolTests(numBufferPoolTiles);
+    }
+
+    if (numProgramBinaryCachePrograms>0)
+    {
+        runProgramBinaryCacheTests(numProgramBinaryCachePrograms);
+    }
+
+    if (numShaderCompositions>0)
+    {
+        runShaderCompositionTests(numShaderCompositions);
+    }
+
+    if (numGLMemoryBudgetTextures>0)
+    {
+        runGLMemoryBudgetTests(numGLMemoryBudgetTextures);
+    }
+
+    if (numCompileContextSubgraphs>0)
+    {
+        runCompileContextTests(numCompileContextSubgraphs);
+    }
+
+    if (numMatrixKernels>0)
+    {
+        runMatrixKernelsTests(numMatrixKernels);
+    }
+
+    if (numOsgaRead>0)
+    {
+        runOsgaReadTests(numOsgaRead);
+    }
+
+    if (numZipRead>0)
+    {
+        runZipReadTests(numZipRead);
+    }
+
+    if (numObjectCache>0)
+    {
+        runObjectCacheTests(numObjectCache);
+    }
+
+    if (numObjRead>0)
+    {
+        runObjReadTests(numObjRead);
+    }
+
+    if (numMeshRead>0)
+    {
+        runMeshReadTests(numMeshRead);
+    }
+
+    if (numRenderLeafSortLeaves>0)
+    {
+        runRenderLeafSortTests(numRenderLeafSortLeaves);
+    }
+
+    if (numWorkStealingRequests>0)
+    {
+        runWorkStealingTests(numWorkStealingRequests);
+    }
+
+    if (numRequestQueueRequests>0)
+    {
+        runRequestQueueTests(numRequestQueueRequests);
+    }
+
     if (numReadThreads>0)
     {
         runMultiThreadReadTests(numReadThreads, arguments);
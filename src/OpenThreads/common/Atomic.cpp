@@ -122,6 +122,19 @@ Atomic::exchange(unsigned value)
 #endif
 }
 
+bool
+Atomic::assign(unsigned newValue, unsigned oldValue)
+{
+#if defined(_OPENTHREADS_ATOMIC_USE_GCC_BUILTINS)
+    return __sync_bool_compare_and_swap(&_value, oldValue, newValue);
+#elif defined(_OPENTHREADS_ATOMIC_USE_WIN32_INTERLOCKED)
+    return static_cast<long>(oldValue) == InterlockedCompareExchange(&_value, static_cast<long>(newValue), static_cast<long>(oldValue));
+#elif defined(_OPENTHREADS_ATOMIC_USE_BSD_ATOMIC)
+    return OSAtomicCompareAndSwap32(static_cast<int32_t>(oldValue), static_cast<int32_t>(newValue), &_value);
+#else
+# error This implementation should happen inline in the include file
+#endif
+}
 
 Atomic::operator unsigned() const
 {
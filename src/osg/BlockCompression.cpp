@@ -0,0 +1,402 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/ImageUtils>
+#include <osg/Math>
+#include <osg/Texture>
+
+#include <algorithm>
+#include <float.h>
+#include <limits.h>
+
+#include "ImageKernels.h"
+
+using namespace osg;
+
+namespace
+{
+
+// Index of the source component that each of R, G, B and A is taken from when a pixel is expanded to RGBA, -1 for an A of 255.
+bool getRGBAComponents(GLenum pixelFormat, int* components)
+{
+    switch(pixelFormat)
+    {
+        case(GL_LUMINANCE):         components[0] = 0; components[1] = 0; components[2] = 0; components[3] = -1; return true;
+        case(GL_LUMINANCE_ALPHA):   components[0] = 0; components[1] = 0; components[2] = 0; components[3] = 1; return true;
+        case(GL_RGB):               components[0] = 0; components[1] = 1; components[2] = 2; components[3] = -1; return true;
+        case(GL_BGR):               components[0] = 2; components[1] = 1; components[2] = 0; components[3] = -1; return true;
+        case(GL_RGBA):              components[0] = 0; components[1] = 1; components[2] = 2; components[3] = 3; return true;
+        case(GL_BGRA):              components[0] = 2; components[1] = 1; components[2] = 0; components[3] = 3; return true;
+        default:                    return false;
+    }
+}
+
+unsigned int getCompressedBlockSize(GLenum compressedPixelFormat)
+{
+    switch(compressedPixelFormat)
+    {
+        case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):      return 8;
+        case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):     return 16;
+        case(GL_COMPRESSED_RED_RGTC1_EXT):          return 8;
+        case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):    return 16;
+        default:                                    return 0;
+    }
+}
+
+inline unsigned int packRGB565(int r, int g, int b)
+{
+    return (((r*31+127)/255)<<11) | (((g*63+127)/255)<<5) | ((b*31+127)/255);
+}
+
+inline void unpackRGB565(unsigned int colour, int* rgb)
+{
+    int r = (colour>>11)&31;
+    int g = (colour>>5)&63;
+    int b = colour&31;
+    rgb[0] = (r<<3)|(r>>2);
+    rgb[1] = (g<<2)|(g>>4);
+    rgb[2] = (b<<3)|(b>>2);
+}
+
+inline int clampToByte(float value)
+{
+    int v = int(value+0.5f);
+    return v<0 ? 0 : (v>255 ? 255 : v);
+}
+
+// Choose the nearest of the four colours of a BC1 block in four colour mode for each pixel, returning the packed indices and the total squared error.
+unsigned int computeColourIndices(const unsigned char pixels[16][4], unsigned int colour0, unsigned int colour1, unsigned int& indices)
+{
+    int palette[4][3];
+    unpackRGB565(colour0, palette[0]);
+    unpackRGB565(colour1, palette[1]);
+    for(int c=0; c<3; ++c)
+    {
+        palette[2][c] = (2*palette[0][c] + palette[1][c])/3;
+        palette[3][c] = (palette[0][c] + 2*palette[1][c])/3;
+    }
+
+    unsigned int error = 0;
+    indices = 0;
+    for(int i=0; i<16; ++i)
+    {
+        int bestIndex = 0;
+        int bestError = INT_MAX;
+        for(int p=0; p<4; ++p)
+        {
+            int dr = int(pixels[i][0]) - palette[p][0];
+            int dg = int(pixels[i][1]) - palette[p][1];
+            int db = int(pixels[i][2]) - palette[p][2];
+            int e = dr*dr + dg*dg + db*db;
+            if (e<bestError) { bestError = e; bestIndex = p; }
+        }
+        indices |= static_cast<unsigned int>(bestIndex)<<(i*2);
+        error += static_cast<unsigned int>(bestError);
+    }
+    return error;
+}
+
+// Least squares fit of the two end point colours to the pixels given the palette entry each pixel has been assigned.
+bool refineColourEndPoints(const unsigned char pixels[16][4], unsigned int indices, unsigned int& colour0, unsigned int& colour1)
+{
+    static const float s_weights0[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ap[3] = { 0.0f, 0.0f, 0.0f };
+    float bp[3] = { 0.0f, 0.0f, 0.0f };
+    for(int i=0; i<16; ++i)
+    {
+        float a = s_weights0[(indices>>(i*2))&3];
+        float b = 1.0f-a;
+        aa += a*a;
+        bb += b*b;
+        ab += a*b;
+        for(int c=0; c<3; ++c)
+        {
+            ap[c] += a*float(pixels[i][c]);
+            bp[c] += b*float(pixels[i][c]);
+        }
+    }
+
+    float determinant = aa*bb - ab*ab;
+    if (osg::absolute(determinant)<1e-6f) return false;
+
+    float inverse = 1.0f/determinant;
+    int end0[3], end1[3];
+    for(int c=0; c<3; ++c)
+    {
+        end0[c] = clampToByte((ap[c]*bb - bp[c]*ab)*inverse);
+        end1[c] = clampToByte((bp[c]*aa - ap[c]*ab)*inverse);
+    }
+    colour0 = packRGB565(end0[0], end0[1], end0[2]);
+    colour1 = packRGB565(end1[0], end1[1], end1[2]);
+    return true;
+}
+
+inline void writeColourBlock(unsigned int colour0, unsigned int colour1, unsigned int indices, unsigned char* block)
+{
+    block[0] = static_cast<unsigned char>(colour0 & 0xff);
+    block[1] = static_cast<unsigned char>(colour0 >> 8);
+    block[2] = static_cast<unsigned char>(colour1 & 0xff);
+    block[3] = static_cast<unsigned char>(colour1 >> 8);
+    block[4] = static_cast<unsigned char>(indices & 0xff);
+    block[5] = static_cast<unsigned char>((indices >> 8) & 0xff);
+    block[6] = static_cast<unsigned char>((indices >> 16) & 0xff);
+    block[7] = static_cast<unsigned char>(indices >> 24);
+}
+
+// Encode the RGB of 16 pixels as a BC1 colour block in four colour mode, with end points along the principal axis of the colours.
+void encodeColourBlock(const unsigned char pixels[16][4], unsigned char* block)
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    int minColour[3] = { 255, 255, 255 };
+    int maxColour[3] = { 0, 0, 0 };
+    for(int i=0; i<16; ++i)
+    {
+        for(int c=0; c<3; ++c)
+        {
+            mean[c] += float(pixels[i][c]);
+            minColour[c] = osg::minimum(minColour[c], int(pixels[i][c]));
+            maxColour[c] = osg::maximum(maxColour[c], int(pixels[i][c]));
+        }
+    }
+
+    if (minColour[0]==maxColour[0] && minColour[1]==maxColour[1] && minColour[2]==maxColour[2])
+    {
+        unsigned int colour = packRGB565(minColour[0], minColour[1], minColour[2]);
+        writeColourBlock(colour, colour, 0, block);
+        return;
+    }
+
+    for(int c=0; c<3; ++c) mean[c] /= 16.0f;
+
+    float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    for(int i=0; i<16; ++i)
+    {
+        float r = float(pixels[i][0])-mean[0];
+        float g = float(pixels[i][1])-mean[1];
+        float b = float(pixels[i][2])-mean[2];
+        covariance[0] += r*r;
+        covariance[1] += r*g;
+        covariance[2] += r*b;
+        covariance[3] += g*g;
+        covariance[4] += g*b;
+        covariance[5] += b*b;
+    }
+
+    // power iteration from the diagonal of the bounding box.
+    float axis[3] = { float(maxColour[0]-minColour[0]), float(maxColour[1]-minColour[1]), float(maxColour[2]-minColour[2]) };
+    for(int iteration=0; iteration<4; ++iteration)
+    {
+        float r = axis[0]*covariance[0] + axis[1]*covariance[1] + axis[2]*covariance[2];
+        float g = axis[0]*covariance[1] + axis[1]*covariance[3] + axis[2]*covariance[4];
+        float b = axis[0]*covariance[2] + axis[1]*covariance[4] + axis[2]*covariance[5];
+        float length = osg::maximum(osg::absolute(r), osg::maximum(osg::absolute(g), osg::absolute(b)));
+        if (length<1e-6f) break;
+        axis[0] = r/length;
+        axis[1] = g/length;
+        axis[2] = b/length;
+    }
+
+    int minPixel = 0, maxPixel = 0;
+    float minProjection = FLT_MAX, maxProjection = -FLT_MAX;
+    for(int i=0; i<16; ++i)
+    {
+        float projection = float(pixels[i][0])*axis[0] + float(pixels[i][1])*axis[1] + float(pixels[i][2])*axis[2];
+        if (projection<minProjection) { minProjection = projection; minPixel = i; }
+        if (projection>maxProjection) { maxProjection = projection; maxPixel = i; }
+    }
+
+    unsigned int colour0 = packRGB565(pixels[maxPixel][0], pixels[maxPixel][1], pixels[maxPixel][2]);
+    unsigned int colour1 = packRGB565(pixels[minPixel][0], pixels[minPixel][1], pixels[minPixel][2]);
+
+    unsigned int indices;
+    unsigned int error = computeColourIndices(pixels, colour0, colour1, indices);
+
+    unsigned int refined0 = colour0, refined1 = colour1;
+    if (error>0 && refineColourEndPoints(pixels, indices, refined0, refined1))
+    {
+        unsigned int refinedIndices;
+        unsigned int refinedError = computeColourIndices(pixels, refined0, refined1, refinedIndices);
+        if (refinedError<error)
+        {
+            colour0 = refined0;
+            colour1 = refined1;
+            indices = refinedIndices;
+        }
+    }
+
+    // colour0 must be the greater for the decoder to use four colour mode, swapping the end points swaps indices 0 and 1 and 2 and 3.
+    if (colour0<colour1)
+    {
+        std::swap(colour0, colour1);
+        indices ^= 0x55555555;
+    }
+    else if (colour0==colour1)
+    {
+        indices = 0;
+    }
+
+    writeColourBlock(colour0, colour1, indices, block);
+}
+
+// Encode 16 values, with a stride of 4 bytes, as a BC4 block, which is also the alpha block of BC3, in eight value mode.
+void encodeValueBlock(const unsigned char* values, unsigned char* block)
+{
+    int minValue = 255, maxValue = 0;
+    for(int i=0; i<16; ++i)
+    {
+        minValue = osg::minimum(minValue, int(values[i*4]));
+        maxValue = osg::maximum(maxValue, int(values[i*4]));
+    }
+
+    block[0] = static_cast<unsigned char>(maxValue);
+    block[1] = static_cast<unsigned char>(minValue);
+
+    // with the end points equal every index of 0 decodes to the value exactly.
+    unsigned long long indices = 0;
+    if (maxValue>minValue)
+    {
+        const int range = maxValue-minValue;
+        for(int i=0; i<16; ++i)
+        {
+            // position 0 to 7 along the ramp from the minimum to the maximum, position 7 is index 0, position 0 index 1, and position p index 8-p.
+            int position = ((int(values[i*4])-minValue)*14 + range)/(range*2);
+            unsigned long long index = (position==7) ? 0 : ((position==0) ? 1 : 8-position);
+            indices |= index<<(i*3);
+        }
+    }
+
+    for(int i=0; i<6; ++i)
+    {
+        block[2+i] = static_cast<unsigned char>((indices>>(i*8)) & 0xff);
+    }
+}
+
+struct CompressBlockRowsOperation : public ImageRowOperation
+{
+    CompressBlockRowsOperation(GLenum pixelFormat, GLenum compressedPixelFormat,
+                               unsigned int width, unsigned int height, const unsigned char* source, unsigned int rowSize,
+                               unsigned char* dest):
+        _compressedPixelFormat(compressedPixelFormat),
+        _numComponents(Image::computeNumComponents(pixelFormat)),
+        _blockSize(getCompressedBlockSize(compressedPixelFormat)),
+        _width(width),
+        _height(height),
+        _source(source),
+        _rowSize(rowSize),
+        _dest(dest)
+    {
+        getRGBAComponents(pixelFormat, _components);
+    }
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        const unsigned int numBlocksWide = (_width+3)/4;
+        unsigned char pixels[16][4];
+        for(unsigned int blockRow=beginRow; blockRow<endRow; ++blockRow)
+        {
+            unsigned char* block = _dest + blockRow*numBlocksWide*_blockSize;
+            for(unsigned int blockColumn=0; blockColumn<numBlocksWide; ++blockColumn)
+            {
+                // the pixels of blocks that overhang the edge of the image are ignored by the decoder, so repeat the edge pixels.
+                for(unsigned int y=0; y<4; ++y)
+                {
+                    const unsigned char* row = _source + osg::minimum(blockRow*4+y, _height-1)*_rowSize;
+                    for(unsigned int x=0; x<4; ++x)
+                    {
+                        const unsigned char* pixel = row + osg::minimum(blockColumn*4+x, _width-1)*_numComponents;
+                        for(unsigned int c=0; c<4; ++c)
+                        {
+                            pixels[y*4+x][c] = _components[c]>=0 ? pixel[_components[c]] : 255;
+                        }
+                    }
+                }
+
+                switch(_compressedPixelFormat)
+                {
+                    case(GL_COMPRESSED_RGB_S3TC_DXT1_EXT):
+                        encodeColourBlock(pixels, block);
+                        break;
+                    case(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT):
+                        encodeValueBlock(&pixels[0][3], block);
+                        encodeColourBlock(pixels, block+8);
+                        break;
+                    case(GL_COMPRESSED_RED_RGTC1_EXT):
+                        encodeValueBlock(&pixels[0][0], block);
+                        break;
+                    case(GL_COMPRESSED_RED_GREEN_RGTC2_EXT):
+                        encodeValueBlock(&pixels[0][0], block);
+                        encodeValueBlock(&pixels[0][1], block+8);
+                        break;
+                }
+                block += _blockSize;
+            }
+        }
+    }
+
+    GLenum                  _compressedPixelFormat;
+    int                     _components[4];
+    unsigned int            _numComponents;
+    unsigned int            _blockSize;
+    unsigned int            _width;
+    unsigned int            _height;
+    const unsigned char*    _source;
+    unsigned int            _rowSize;
+    unsigned char*          _dest;
+};
+
+}
+
+bool osg::compressImage(osg::Image* image, GLenum compressedPixelFormat)
+{
+    if (!image || !image->data()) return false;
+
+    int components[4];
+    unsigned int blockSize = getCompressedBlockSize(compressedPixelFormat);
+    if (blockSize==0 || image->getDataType()!=GL_UNSIGNED_BYTE || image->r()!=1 || !getRGBAComponents(image->getPixelFormat(), components)) return false;
+
+    const unsigned int numLevels = image->getNumMipmapLevels();
+    osg::Image::MipmapDataType mipmapData;
+    unsigned int totalSize = 0;
+    for(unsigned int level=0; level<numLevels; ++level)
+    {
+        if (level>0) mipmapData.push_back(totalSize);
+        unsigned int width = osg::maximum(image->s()>>level, 1);
+        unsigned int height = osg::maximum(image->t()>>level, 1);
+        totalSize += ((width+3)/4)*((height+3)/4)*blockSize;
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+
+    const unsigned int numComponents = Image::computeNumComponents(image->getPixelFormat());
+    for(unsigned int level=0; level<numLevels; ++level)
+    {
+        unsigned int width = osg::maximum(image->s()>>level, 1);
+        unsigned int height = osg::maximum(image->t()>>level, 1);
+        unsigned int rowSize = (level==0) ? image->getRowStepInBytes() :
+                                            Image::computeRowWidthInBytes(width, image->getPixelFormat(), GL_UNSIGNED_BYTE, image->getPacking());
+
+        CompressBlockRowsOperation operation(image->getPixelFormat(), compressedPixelFormat, width, height,
+                                             image->getMipmapData(level), rowSize,
+                                             data + (level>0 ? mipmapData[level-1] : 0));
+        runImageKernelRows(operation, (height+3)/4, width*4*numComponents);
+    }
+
+    image->setImage(image->s(), image->t(), 1,
+                    compressedPixelFormat, compressedPixelFormat, GL_UNSIGNED_BYTE,
+                    data, osg::Image::USE_NEW_DELETE, 1);
+    image->setMipmapLevels(mipmapData);
+
+    return true;
+}
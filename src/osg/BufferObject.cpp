@@ -12,6 +12,7 @@
  * OpenSceneGraph Public License for more details.
 */
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 
@@ -24,6 +25,7 @@
 #include <osg/State>
 #include <osg/PrimitiveSet>
 #include <osg/Array>
+#include <osg/GLObjects>
 
 #include <OpenThreads/ScopedLock>
 #include <OpenThreads/Mutex>
@@ -54,14 +56,24 @@ GLBufferObject::GLBufferObject(unsigned int contextID, BufferObject* bufferObjec
     _glObjectID(glObjectID),
     _profile(0,0,0),
     _allocatedSize(0),
+    _usedSize(0),
     _dirty(true),
     _bufferObject(0),
+    _persistentMappingFailed(false),
+    _mappedData(0),
+    _regionSize(0),
+    _currentRegion(0),
+    _regionOffset(0),
     _set(0),
     _previous(0),
     _next(0),
     _frameLastUsed(0),
+    _sharedBuffer(0),
+    _sharedBufferOffset(0),
     _extensions(0)
 {
+    for(unsigned int i=0; i<NUM_STREAMING_REGIONS; ++i) _regionFences[i] = 0;
+
     assign(bufferObject);
 
     _extensions = GLBufferObject::getExtensions(contextID, true);
@@ -103,6 +115,8 @@ void GLBufferObject::assign(BufferObject* bufferObject)
         // clear all previous entries;
         _bufferEntries.clear();
     }
+
+    _usedSize = 0;
 }
 
 void GLBufferObject::clear()
@@ -182,13 +196,13 @@ void GLBufferObject::compileBuffer()
         _bufferEntries.erase(_bufferEntries.begin()+i, _bufferEntries.end());
     }
 
-    _extensions->glBindBuffer(_profile._target, _glObjectID);
+    _usedSize = newTotalSize;
 
     if (newTotalSize > _profile._size)
     {
         OSG_INFO<<"newTotalSize="<<newTotalSize<<", _profile._size="<<_profile._size<<std::endl;
 
-        _profile._size = newTotalSize;
+        _profile._size = GLBufferObjectManager::computeSizeClass(newTotalSize);
 
         if (_set)
         {
@@ -197,10 +211,39 @@ void GLBufferObject::compileBuffer()
 
     }
 
+    // bind after any move to a new set as a sub-allocated GLBufferObject will have changed shared buffer.
+    _extensions->glBindBuffer(_profile._target, _glObjectID);
+
+    if (usePersistentMapping())
+    {
+        if (_mappedData && _regionSize>=_profile._size)
+        {
+            streamBuffer();
+            return;
+        }
+
+        if (allocatePersistentStorage())
+        {
+            for(BufferEntries::iterator itr = _bufferEntries.begin(); itr != _bufferEntries.end(); ++itr)
+            {
+                itr->modifiedCount = 0xffffff;
+            }
+
+            streamBuffer();
+            return;
+        }
+    }
+    else if (_mappedData)
+    {
+        // the BufferObject no longer asks for persistent mapping, or this GLBufferObject has been reused by another.
+        releasePersistentStorage();
+    }
+
     if (_allocatedSize != _profile._size)
     {
+        // the storage of a sub-allocated GLBufferObject belongs to the shared buffer, which is allocated by the GLBufferObjectSet.
         _allocatedSize = _profile._size;
-        _extensions->glBufferData(_profile._target, _profile._size, NULL, _profile._usage);
+        if (!_sharedBuffer) _extensions->glBufferData(_profile._target, _profile._size, NULL, _profile._usage);
         compileAll = true;
     }
 
@@ -218,7 +261,7 @@ void GLBufferObject::compileBuffer()
             const osg::Image* image = entry.dataSource->asImage();
             if (image && !(image->isDataContiguous()))
             {
-                unsigned int offset = entry.offset;
+                unsigned int offset = _sharedBufferOffset + entry.offset;
                 for(osg::Image::DataIterator img_itr(image); img_itr.valid(); ++img_itr)
                 {
                     //OSG_NOTICE<<"Copying to buffer object using DataIterator, offset="<<offset<<", size="<<img_itr.size()<<", data="<<(void*)img_itr.data()<<std::endl;
@@ -228,20 +271,181 @@ void GLBufferObject::compileBuffer()
             }
             else
             {
-                _extensions->glBufferSubData(_profile._target, (GLintptrARB)entry.offset, (GLsizeiptrARB)entry.dataSize, entry.dataSource->getDataPointer());
+                _extensions->glBufferSubData(_profile._target, (GLintptrARB)(_sharedBufferOffset + entry.offset), (GLsizeiptrARB)entry.dataSize, entry.dataSource->getDataPointer());
             }
         }
     }
 }
 
+bool GLBufferObject::usePersistentMapping() const
+{
+    return _bufferObject && _bufferObject->getUsePersistentMapping() &&
+           !_persistentMappingFailed &&
+           (_profile._target==GL_ARRAY_BUFFER_ARB || _profile._target==GL_ELEMENT_ARRAY_BUFFER_ARB) &&
+           _extensions->isBufferStorageSupported();
+}
+
+bool GLBufferObject::allocatePersistentStorage()
+{
+    if (_sharedBuffer)
+    {
+        // recycled from a slot of a shared buffer, buffer storage needs a buffer object of its own.
+        _set->releaseSharedBufferSlot(this);
+        _extensions->glGenBuffers(1, &_glObjectID);
+        _extensions->glBindBuffer(_profile._target, _glObjectID);
+    }
+
+    // buffer storage is immutable, so a new buffer object is required each time the size changes.
+    releasePersistentStorage();
+
+    _regionSize = computeBufferAlignment(_profile._size, 64);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    _extensions->glBufferStorage(_profile._target, _regionSize*NUM_STREAMING_REGIONS, NULL, flags);
+    _mappedData = static_cast<unsigned char*>(_extensions->glMapBufferRange(_profile._target, 0, _regionSize*NUM_STREAMING_REGIONS, flags));
+
+    if (!_mappedData)
+    {
+        OSG_NOTICE<<"Warning: GLBufferObject unable to persistently map buffer, falling back to glBufferSubData."<<std::endl;
+
+        _persistentMappingFailed = true;
+
+        // immutable storage may have been created, so glBufferData needs a fresh buffer object.
+        _extensions->glDeleteBuffers(1, &_glObjectID);
+        _extensions->glGenBuffers(1, &_glObjectID);
+        _extensions->glBindBuffer(_profile._target, _glObjectID);
+
+        _allocatedSize = 0;
+        _regionSize = 0;
+        return false;
+    }
+
+    _allocatedSize = _regionSize*NUM_STREAMING_REGIONS;
+    if (_set) _set->getParent()->getCurrGLBufferObjectPoolSize() += getStreamingRegionsSize();
+
+    // the first update is written to the first region.
+    _currentRegion = NUM_STREAMING_REGIONS-1;
+    _regionOffset = 0;
+
+    return true;
+}
+
+void GLBufferObject::releasePersistentStorage()
+{
+    deleteFences();
+
+    if (_mappedData)
+    {
+        if (_set) _set->getParent()->getCurrGLBufferObjectPoolSize() -= getStreamingRegionsSize();
+
+        // deleting the buffer unmaps it, and a fresh name is needed for glBufferData to be usable again.
+        _extensions->glDeleteBuffers(1, &_glObjectID);
+        _extensions->glGenBuffers(1, &_glObjectID);
+        _extensions->glBindBuffer(_profile._target, _glObjectID);
+
+        _mappedData = 0;
+        _allocatedSize = 0;
+        _regionSize = 0;
+        _regionOffset = 0;
+    }
+}
+
+void GLBufferObject::deleteFences()
+{
+    for(unsigned int i=0; i<NUM_STREAMING_REGIONS; ++i)
+    {
+        if (_regionFences[i])
+        {
+            _extensions->glDeleteSync(_regionFences[i]);
+            _regionFences[i] = 0;
+        }
+    }
+}
+
+void GLBufferObject::streamBuffer()
+{
+    bool modified = false;
+    for(BufferEntries::iterator itr = _bufferEntries.begin(); itr != _bufferEntries.end() && !modified; ++itr)
+    {
+        modified = itr->dataSource && itr->modifiedCount != itr->dataSource->getModifiedCount();
+    }
+
+    if (!modified) return;
+
+    GLBufferObjectManager* manager = GLBufferObjectManager::getGLBufferObjectManager(_contextID).get();
+
+    // fence the region drawn from since the last update, then move on to the next one, waiting for the GPU
+    // to finish reading the data written to it NUM_STREAMING_REGIONS updates ago.
+    _regionFences[_currentRegion] = _extensions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _currentRegion = (_currentRegion+1) % NUM_STREAMING_REGIONS;
+
+    GLsync fence = _regionFences[_currentRegion];
+    if (fence)
+    {
+        GLenum result = _extensions->glClientWaitSync(fence, 0, 0);
+        if (result==GL_TIMEOUT_EXPIRED)
+        {
+            ++(manager->getNumberStreamingStalls());
+
+            const GLuint64 oneSecond = 1000000000;
+            do
+            {
+                result = _extensions->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, oneSecond);
+            } while(result==GL_TIMEOUT_EXPIRED);
+        }
+
+        _extensions->glDeleteSync(fence);
+        _regionFences[_currentRegion] = 0;
+    }
+
+    ++(manager->getNumberStreamingUpdates());
+
+    _regionOffset = _currentRegion*_regionSize;
+
+    // the region holds the data of NUM_STREAMING_REGIONS updates ago, so all the entries are copied, not just the modified ones.
+    unsigned char* region = _mappedData + _regionOffset;
+    for(BufferEntries::iterator itr = _bufferEntries.begin(); itr != _bufferEntries.end(); ++itr)
+    {
+        BufferEntry& entry = *itr;
+        if (!entry.dataSource) continue;
+
+        entry.numRead = 0;
+        entry.modifiedCount = entry.dataSource->getModifiedCount();
+
+        const osg::Image* image = entry.dataSource->asImage();
+        if (image && !(image->isDataContiguous()))
+        {
+            unsigned int offset = entry.offset;
+            for(osg::Image::DataIterator img_itr(image); img_itr.valid(); ++img_itr)
+            {
+                memcpy(region + offset, img_itr.data(), img_itr.size());
+                offset += img_itr.size();
+            }
+        }
+        else
+        {
+            memcpy(region + entry.offset, entry.dataSource->getDataPointer(), entry.dataSize);
+        }
+    }
+}
+
 void GLBufferObject::deleteGLObject()
 {
     OSG_INFO<<"GLBufferObject::deleteGLObject() "<<_glObjectID<<std::endl;
     if (_glObjectID!=0)
     {
-        _extensions->glDeleteBuffers(1, &_glObjectID);
+        deleteFences();
+
+        if (_mappedData && _set) _set->getParent()->getCurrGLBufferObjectPoolSize() -= getStreamingRegionsSize();
+
+        if (_sharedBuffer) _set->releaseSharedBufferSlot(this);
+        else _extensions->glDeleteBuffers(1, &_glObjectID);
         _glObjectID = 0;
 
+        _mappedData = 0;
+        _regionSize = 0;
+        _regionOffset = 0;
+
         _allocatedSize = 0;
         _bufferEntries.clear();
     }
@@ -305,7 +509,19 @@ GLBufferObject::Extensions::Extensions(const Extensions& rhs):
     _glBindBufferRange = rhs._glBindBufferRange;
     _glBindBufferBase = rhs._glBindBufferBase;
     _glTexBuffer = rhs._glTexBuffer;
+    _glMultiDrawElementsIndirect = rhs._glMultiDrawElementsIndirect;
+    _glBufferStorage = rhs._glBufferStorage;
+    _glMapBufferRange = rhs._glMapBufferRange;
+    _glFenceSync = rhs._glFenceSync;
+    _glClientWaitSync = rhs._glClientWaitSync;
+    _glDeleteSync = rhs._glDeleteSync;
+    _glCopyBufferSubData = rhs._glCopyBufferSubData;
 
+    _isPBOSupported = rhs._isPBOSupported;
+    _isUniformBufferObjectSupported = rhs._isUniformBufferObjectSupported;
+    _isTBOSupported = rhs._isTBOSupported;
+    _isShaderStorageBufferObjectSupported = rhs._isShaderStorageBufferObjectSupported;
+    _isShaderDrawParametersSupported = rhs._isShaderDrawParametersSupported;
 }
 
 
@@ -325,10 +541,19 @@ void GLBufferObject::Extensions::lowestCommonDenominator(const Extensions& rhs)
     if (!rhs._glBindBufferRange) _glBindBufferRange = rhs._glBindBufferRange;
     if (!rhs._glBindBufferBase) _glBindBufferBase = rhs._glBindBufferBase;
     if (!rhs._glTexBuffer) _glTexBuffer = rhs._glTexBuffer;
+    if (!rhs._glMultiDrawElementsIndirect) _glMultiDrawElementsIndirect = rhs._glMultiDrawElementsIndirect;
+    if (!rhs._glBufferStorage) _glBufferStorage = rhs._glBufferStorage;
+    if (!rhs._glMapBufferRange) _glMapBufferRange = rhs._glMapBufferRange;
+    if (!rhs._glFenceSync) _glFenceSync = rhs._glFenceSync;
+    if (!rhs._glClientWaitSync) _glClientWaitSync = rhs._glClientWaitSync;
+    if (!rhs._glDeleteSync) _glDeleteSync = rhs._glDeleteSync;
+    if (!rhs._glCopyBufferSubData) _glCopyBufferSubData = rhs._glCopyBufferSubData;
 
     _isPBOSupported = rhs._isPBOSupported;
     _isUniformBufferObjectSupported = rhs._isUniformBufferObjectSupported;
     _isTBOSupported = rhs._isTBOSupported;
+    if (!rhs._isShaderStorageBufferObjectSupported) _isShaderStorageBufferObjectSupported = false;
+    if (!rhs._isShaderDrawParametersSupported) _isShaderDrawParametersSupported = false;
 }
 
 void GLBufferObject::Extensions::setupGLExtensions(unsigned int contextID)
@@ -347,10 +572,19 @@ void GLBufferObject::Extensions::setupGLExtensions(unsigned int contextID)
     setGLExtensionFuncPtr(_glBindBufferRange, "glBindBufferRange");
     setGLExtensionFuncPtr(_glBindBufferBase, "glBindBufferBase");
     setGLExtensionFuncPtr(_glTexBuffer, "glTexBuffer","glTexBufferARB" );
+    setGLExtensionFuncPtr(_glMultiDrawElementsIndirect, "glMultiDrawElementsIndirect","glMultiDrawElementsIndirectARB");
+    setGLExtensionFuncPtr(_glBufferStorage, "glBufferStorage","glBufferStorageEXT");
+    setGLExtensionFuncPtr(_glMapBufferRange, "glMapBufferRange","glMapBufferRangeEXT");
+    setGLExtensionFuncPtr(_glFenceSync, "glFenceSync","glFenceSyncAPPLE");
+    setGLExtensionFuncPtr(_glClientWaitSync, "glClientWaitSync","glClientWaitSyncAPPLE");
+    setGLExtensionFuncPtr(_glDeleteSync, "glDeleteSync","glDeleteSyncAPPLE");
+    setGLExtensionFuncPtr(_glCopyBufferSubData, "glCopyBufferSubData","glCopyBufferSubDataNV");
 
     _isPBOSupported = OSG_GL3_FEATURES || osg::isGLExtensionSupported(contextID,"GL_ARB_pixel_buffer_object");
     _isUniformBufferObjectSupported = osg::isGLExtensionSupported(contextID, "GL_ARB_uniform_buffer_object");
     _isTBOSupported = osg::isGLExtensionSupported(contextID,"GL_ARB_texture_buffer_object");
+    _isShaderStorageBufferObjectSupported = osg::isGLExtensionSupported(contextID,"GL_ARB_shader_storage_buffer_object");
+    _isShaderDrawParametersSupported = osg::isGLExtensionSupported(contextID,"GL_ARB_shader_draw_parameters");
 }
 
 void GLBufferObject::Extensions::glGenBuffers(GLsizei n, GLuint *buffers) const
@@ -449,6 +683,60 @@ void GLBufferObject::Extensions::glTexBuffer( GLenum target, GLenum internalForm
     else OSG_WARN<<"Error: glTexBuffer not supported by OpenGL driver\n";
 }
 
+void GLBufferObject::Extensions::glMultiDrawElementsIndirect( GLenum mode, GLenum type, const GLvoid* indirect, GLsizei drawcount, GLsizei stride ) const
+{
+    if ( _glMultiDrawElementsIndirect ) _glMultiDrawElementsIndirect( mode, type, indirect, drawcount, stride );
+    else OSG_WARN<<"Error: glMultiDrawElementsIndirect not supported by OpenGL driver\n";
+}
+
+void GLBufferObject::Extensions::glBufferStorage(GLenum target, GLsizeiptrARB size, const GLvoid *data, GLbitfield flags) const
+{
+    if (_glBufferStorage) _glBufferStorage(target, size, data, flags);
+    else OSG_WARN<<"Error: glBufferStorage not supported by OpenGL driver"<<std::endl;
+}
+
+GLvoid* GLBufferObject::Extensions::glMapBufferRange(GLenum target, GLintptrARB offset, GLsizeiptrARB length, GLbitfield access) const
+{
+    if (_glMapBufferRange) return _glMapBufferRange(target, offset, length, access);
+    else
+    {
+        OSG_WARN<<"Error: glMapBufferRange not supported by OpenGL driver"<<std::endl;
+        return 0;
+    }
+}
+
+GLsync GLBufferObject::Extensions::glFenceSync(GLenum condition, GLbitfield flags) const
+{
+    if (_glFenceSync) return _glFenceSync(condition, flags);
+    else
+    {
+        OSG_WARN<<"Error: glFenceSync not supported by OpenGL driver"<<std::endl;
+        return 0;
+    }
+}
+
+GLenum GLBufferObject::Extensions::glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) const
+{
+    if (_glClientWaitSync) return _glClientWaitSync(sync, flags, timeout);
+    else
+    {
+        OSG_WARN<<"Error: glClientWaitSync not supported by OpenGL driver"<<std::endl;
+        return GL_WAIT_FAILED;
+    }
+}
+
+void GLBufferObject::Extensions::glDeleteSync(GLsync sync) const
+{
+    if (_glDeleteSync) _glDeleteSync(sync);
+    else OSG_WARN<<"Error: glDeleteSync not supported by OpenGL driver"<<std::endl;
+}
+
+void GLBufferObject::Extensions::glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptrARB readOffset, GLintptrARB writeOffset, GLsizeiptrARB size) const
+{
+    if (_glCopyBufferSubData) _glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+    else OSG_WARN<<"Error: glCopyBufferSubData not supported by OpenGL driver"<<std::endl;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // GLBufferObjectSet
@@ -597,6 +885,8 @@ void GLBufferObjectSet::discardAllGLBufferObjects()
 {
     // OSG_NOTICE<<"GLBufferObjectSet::discardAllGLBufferObjects()"<<std::endl;
 
+    unsigned int streamingRegionsSize = 0;
+
     GLBufferObject* to = _head;
     while(to!=0)
     {
@@ -604,6 +894,8 @@ void GLBufferObjectSet::discardAllGLBufferObjects()
 
         to = to->_next;
 
+        streamingRegionsSize += glbo->getStreamingRegionsSize();
+
         ref_ptr<BufferObject> original_BufferObject = glbo->getBufferObject();
         if (original_BufferObject.valid())
         {
@@ -612,6 +904,13 @@ void GLBufferObjectSet::discardAllGLBufferObjects()
         }
     }
 
+    for(GLBufferObjectList::iterator itr = _orphanedGLBufferObjects.begin();
+        itr != _orphanedGLBufferObjects.end();
+        ++itr)
+    {
+        streamingRegionsSize += (*itr)->getStreamingRegionsSize();
+    }
+
     // the linked list should now be empty
     _head = 0;
     _tail = 0;
@@ -619,11 +918,21 @@ void GLBufferObjectSet::discardAllGLBufferObjects()
     _pendingOrphanedGLBufferObjects.clear();
     _orphanedGLBufferObjects.clear();
 
+    // the shared buffers went with the graphics context, taking their free slots out of the pool.
+    unsigned int freeSlotsSize = 0;
+    for(GLSharedBufferList::iterator itr = _sharedBuffers.begin();
+        itr != _sharedBuffers.end();
+        ++itr)
+    {
+        freeSlotsSize += itr->freeSlots.size()*_profile._size;
+    }
+    _sharedBuffers.clear();
+
     unsigned int numDeleted = _numOfGLBufferObjects;
     _numOfGLBufferObjects = 0;
 
     // update the GLBufferObjectManager's running total of current pool size
-    _parent->getCurrGLBufferObjectPoolSize() -= numDeleted*_profile._size;
+    _parent->getCurrGLBufferObjectPoolSize() -= numDeleted*_profile._size + streamingRegionsSize + freeSlotsSize;
     _parent->getNumberOrphanedGLBufferObjects() -= numDeleted;
     _parent->getNumberDeleted() += numDeleted;
 }
@@ -672,11 +981,20 @@ void GLBufferObjectSet::discardAllDeletedGLBufferObjects()
     }
 
     unsigned int numDiscarded = _orphanedGLBufferObjects.size();
+    unsigned int streamingRegionsSize = 0;
+
+    for(GLBufferObjectList::iterator itr = _orphanedGLBufferObjects.begin();
+        itr != _orphanedGLBufferObjects.end();
+        ++itr)
+    {
+        if ((*itr)->_sharedBuffer) releaseSharedBufferSlot(itr->get(), false);
+        streamingRegionsSize += (*itr)->getStreamingRegionsSize();
+    }
 
     _numOfGLBufferObjects -= numDiscarded;
 
     // update the GLBufferObjectManager's running total of current pool size
-    _parent->setCurrGLBufferObjectPoolSize( _parent->getCurrGLBufferObjectPoolSize() - numDiscarded*_profile._size );
+    _parent->setCurrGLBufferObjectPoolSize( _parent->getCurrGLBufferObjectPoolSize() - numDiscarded*_profile._size - streamingRegionsSize );
 
     // update the number of active and orphaned GLBufferObjects
     _parent->getNumberOrphanedGLBufferObjects() -= numDiscarded;
@@ -704,6 +1022,12 @@ void GLBufferObjectSet::flushDeletedGLBufferObjects(double /*currentTime*/, doub
         return;
     }
 
+    // free slots count towards the pool size, so only spend the frame's time compacting once the pool is over budget.
+    if (_sharedBuffers.size()>1 && availableTime>0.0)
+    {
+        compactSharedBuffers(availableTime);
+    }
+
     // if nothing to delete return
     if (_orphanedGLBufferObjects.empty()) return;
 
@@ -768,6 +1092,15 @@ bool GLBufferObjectSet::makeSpace(unsigned int& size)
     return size==0;
 }
 
+void GLBufferObjectSet::collectGLBufferObjectsUnusedSince(unsigned int frameNumber, std::vector<GLBufferObject*>& list) const
+{
+    // the active list runs from least to most recently used, GLBufferObjects that are pending orphaning no longer have a BufferObject.
+    for(GLBufferObject* glbo = _head; glbo!=0 && glbo->_frameLastUsed<frameNumber; glbo = glbo->_next)
+    {
+        if (glbo->getBufferObject()) list.push_back(glbo);
+    }
+}
+
 GLBufferObject* GLBufferObjectSet::takeFromOrphans(BufferObject* bufferObject)
 {
     // take front of orphaned list.
@@ -801,12 +1134,14 @@ GLBufferObject* GLBufferObjectSet::takeOrGenerate(BufferObject* bufferObject)
         if (!_pendingOrphanedGLBufferObjects.empty())
         {
             handlePendingOrphandedGLBufferObjects();
+            ++(_parent->getNumberPoolHits());
             return takeFromOrphans(bufferObject);
         }
     }
 
     if (!_orphanedGLBufferObjects.empty())
     {
+        ++(_parent->getNumberPoolHits());
         return takeFromOrphans(bufferObject);
     }
 
@@ -842,13 +1177,22 @@ GLBufferObject* GLBufferObjectSet::takeOrGenerate(BufferObject* bufferObject)
         glbo->setBufferObject(bufferObject);
         glbo->setProfile(_profile);
 
+        ++(_parent->getNumberPoolHits());
+
         return glbo.release();
     }
 
-    //
-    GLBufferObject* glbo = new GLBufferObject(_contextID, const_cast<BufferObject*>(bufferObject));
+    ++(_parent->getNumberPoolMisses());
+
+    // small buffers are placed in a slot of a shared buffer rather than given a buffer object of their own.
+    unsigned int sharedBufferOffset = 0;
+    GLSharedBuffer* sharedBuffer = useSharedBuffers(bufferObject) ? takeSharedBufferSlot(sharedBufferOffset) : 0;
+
+    GLBufferObject* glbo = new GLBufferObject(_contextID, const_cast<BufferObject*>(bufferObject), sharedBuffer ? sharedBuffer->glObjectID : 0);
     glbo->setProfile(_profile);
     glbo->_set = this;
+    glbo->_sharedBuffer = sharedBuffer;
+    glbo->_sharedBufferOffset = sharedBufferOffset;
     ++_numOfGLBufferObjects;
 
     // update the current texture pool size
@@ -864,6 +1208,8 @@ GLBufferObject* GLBufferObjectSet::takeOrGenerate(BufferObject* bufferObject)
 
 void GLBufferObjectSet::moveToBack(GLBufferObject* to)
 {
+    ScopedGLObjectsLock lock(_parent->getGLObjectsMutex());
+
 #if 0
     OSG_NOTICE<<"GLBufferObjectSet::moveToBack("<<to<<")"<<std::endl;
     OSG_NOTICE<<"    before _head = "<<_head<<std::endl;
@@ -1002,6 +1348,8 @@ void GLBufferObjectSet::remove(GLBufferObject* to)
 
 void GLBufferObjectSet::moveToSet(GLBufferObject* to, GLBufferObjectSet* set)
 {
+    ScopedGLObjectsLock lock(_parent->getGLObjectsMutex());
+
     if (set==this) return;
     if (!set) return;
 
@@ -1009,10 +1357,24 @@ void GLBufferObjectSet::moveToSet(GLBufferObject* to, GLBufferObjectSet* set)
     --_numOfGLBufferObjects;
     remove(to);
 
+    // the slots of the new set's shared buffers are the size of the new profile, so a sub-allocated 'to' moves to one of them.
+    if (to->_sharedBuffer)
+    {
+        releaseSharedBufferSlot(to);
+        if (!set->assignSharedBufferSlot(to))
+        {
+            to->_extensions->glGenBuffers(1, &(to->getGLObjectID()));
+        }
+    }
+
     // register 'to' with new set.
     to->_set = set;
     ++set->_numOfGLBufferObjects;
     set->addToBack(to);
+
+    // update the GLBufferObjectManager's running total of current pool size for the change of size class
+    _parent->getCurrGLBufferObjectPoolSize() -= _profile._size;
+    _parent->getCurrGLBufferObjectPoolSize() += set->_profile._size;
 }
 
 unsigned int GLBufferObjectSet::computeNumGLBufferObjectsInList() const
@@ -1027,13 +1389,229 @@ unsigned int GLBufferObjectSet::computeNumGLBufferObjectsInList() const
     return num;
 }
 
+bool GLBufferObjectSet::useSharedBuffers(const BufferObject* bufferObject) const
+{
+    // persistently mapped buffers need buffer storage of their own.
+    return (_profile._target==GL_ARRAY_BUFFER_ARB || _profile._target==GL_ELEMENT_ARRAY_BUFFER_ARB) &&
+           _profile._size>0 && _profile._size*16<=_parent->getSharedBufferSize() &&
+           !(bufferObject && bufferObject->getUsePersistentMapping());
+}
+
+GLSharedBuffer* GLBufferObjectSet::takeSharedBufferSlot(unsigned int& offset, const GLSharedBuffer* excludedSharedBuffer)
+{
+    // take from the fullest shared buffer with a free slot so that the others empty and can be deleted.
+    GLSharedBuffer* sharedBuffer = 0;
+    unsigned int numSlots = 0;
+    for(GLSharedBufferList::iterator itr = _sharedBuffers.begin();
+        itr != _sharedBuffers.end();
+        ++itr)
+    {
+        numSlots += itr->numSlots;
+
+        if (&(*itr)==excludedSharedBuffer || itr->freeSlots.empty()) continue;
+        if (!sharedBuffer || itr->freeSlots.size()<sharedBuffer->freeSlots.size()) sharedBuffer = &(*itr);
+    }
+
+    if (!sharedBuffer)
+    {
+        if (excludedSharedBuffer) return 0;
+
+        // double the number of slots each time a shared buffer is added, up to the shared buffer size.
+        unsigned int maxNumSlots = _parent->getSharedBufferSize()/_profile._size;
+        numSlots = osg::clampBetween(numSlots, 16u, maxNumSlots);
+
+        GLBufferObject::Extensions* extensions = GLBufferObject::getExtensions(_contextID, true);
+
+        _sharedBuffers.push_back(GLSharedBuffer());
+        sharedBuffer = &(_sharedBuffers.back());
+        sharedBuffer->numSlots = numSlots;
+
+        extensions->glGenBuffers(1, &(sharedBuffer->glObjectID));
+        extensions->glBindBuffer(_profile._target, sharedBuffer->glObjectID);
+        extensions->glBufferData(_profile._target, numSlots*_profile._size, NULL, _profile._usage);
+
+        // fill in reverse so that slots are taken from the start of the buffer.
+        sharedBuffer->freeSlots.reserve(numSlots);
+        for(unsigned int i=numSlots; i>0; --i)
+        {
+            sharedBuffer->freeSlots.push_back(i-1);
+        }
+
+        // the free slots are held by the pool, each GLBufferObject given a slot counts its own size.
+        _parent->getCurrGLBufferObjectPoolSize() += numSlots*_profile._size;
+
+        OSG_INFO<<"GLBufferObjectSet="<<this<<": Created shared buffer "<<sharedBuffer->glObjectID<<" of "<<numSlots<<" slots, size="<<_profile._size<<std::endl;
+    }
+
+    offset = sharedBuffer->freeSlots.back()*_profile._size;
+    sharedBuffer->freeSlots.pop_back();
+    _parent->getCurrGLBufferObjectPoolSize() -= _profile._size;
+
+    return sharedBuffer;
+}
+
+bool GLBufferObjectSet::assignSharedBufferSlot(GLBufferObject* to, const GLSharedBuffer* excludedSharedBuffer)
+{
+    if (!useSharedBuffers(to->getBufferObject())) return false;
+
+    unsigned int offset = 0;
+    GLSharedBuffer* sharedBuffer = takeSharedBufferSlot(offset, excludedSharedBuffer);
+    if (!sharedBuffer) return false;
+
+    to->getGLObjectID() = sharedBuffer->glObjectID;
+    to->_sharedBuffer = sharedBuffer;
+    to->_sharedBufferOffset = offset;
+
+    // the data will need to be downloaded to the new slot.
+    to->setAllocatedSize(0);
+
+    return true;
+}
+
+void GLBufferObjectSet::releaseSharedBufferSlot(GLBufferObject* to, bool deleteGLObjects)
+{
+    ScopedGLObjectsLock lock(_parent->getGLObjectsMutex());
+
+    GLSharedBuffer* sharedBuffer = to->_sharedBuffer;
+    unsigned int slot = to->_sharedBufferOffset/_profile._size;
+
+    to->getGLObjectID() = 0;
+    to->_sharedBuffer = 0;
+    to->_sharedBufferOffset = 0;
+    to->setAllocatedSize(0);
+
+    for(GLSharedBufferList::iterator itr = _sharedBuffers.begin();
+        itr != _sharedBuffers.end();
+        ++itr)
+    {
+        if (&(*itr)!=sharedBuffer) continue;
+
+        sharedBuffer->freeSlots.push_back(slot);
+        _parent->getCurrGLBufferObjectPoolSize() += _profile._size;
+
+        if (sharedBuffer->freeSlots.size()==sharedBuffer->numSlots)
+        {
+            OSG_INFO<<"GLBufferObjectSet="<<this<<": Deleting empty shared buffer "<<sharedBuffer->glObjectID<<std::endl;
+
+            _parent->getCurrGLBufferObjectPoolSize() -= sharedBuffer->numSlots*_profile._size;
+
+            if (deleteGLObjects) to->_extensions->glDeleteBuffers(1, &(sharedBuffer->glObjectID));
+            _sharedBuffers.erase(itr);
+        }
+        return;
+    }
+
+    OSG_NOTICE<<"Warning: GLBufferObjectSet::releaseSharedBufferSlot(..) shared buffer not found."<<std::endl;
+}
+
+void GLBufferObjectSet::compactSharedBuffers(double& availableTime)
+{
+    GLBufferObject::Extensions* extensions = GLBufferObject::getExtensions(_contextID, true);
+    if (!extensions->isCopyBufferSupported()) return;
+
+    // find the most sparsely used shared buffer, and only compact if its slots in use would fit in the free slots of the others.
+    GLSharedBuffer* sparsest = 0;
+    unsigned int numFreeSlots = 0;
+    for(GLSharedBufferList::iterator itr = _sharedBuffers.begin();
+        itr != _sharedBuffers.end();
+        ++itr)
+    {
+        numFreeSlots += itr->freeSlots.size();
+        if (!sparsest || itr->freeSlots.size()>sparsest->freeSlots.size()) sparsest = &(*itr);
+    }
+
+    if (!sparsest) return;
+
+    unsigned int numSlotsToMove = sparsest->numSlots - sparsest->freeSlots.size();
+    if (numSlotsToMove > numFreeSlots - sparsest->freeSlots.size()) return;
+
+    ElapsedTime timer;
+
+    // gather the GLBufferObjects to move, orphans don't hold any data that needs keeping so just move their slot.
+    std::vector<GLBufferObject*> toMove;
+    for(GLBufferObject* to = _head; to!=0; to = to->_next)
+    {
+        if (to->_sharedBuffer==sparsest) toMove.push_back(to);
+    }
+
+    for(GLBufferObjectList::iterator itr = _orphanedGLBufferObjects.begin();
+        itr != _orphanedGLBufferObjects.end();
+        ++itr)
+    {
+        if ((*itr)->_sharedBuffer==sparsest) toMove.push_back(itr->get());
+    }
+
+    GLuint readBuffer = sparsest->glObjectID;
+    unsigned int numMoved = 0;
+    for(std::vector<GLBufferObject*>::iterator itr = toMove.begin();
+        itr != toMove.end() && timer.elapsedTime()<availableTime;
+        ++itr)
+    {
+        GLBufferObject* to = *itr;
+        bool isOrphan = (to->getBufferObject()==0);
+        unsigned int readOffset = to->_sharedBufferOffset;
+        unsigned int allocatedSize = to->getAllocatedSize();
+
+        // releasing the last slot deletes the sparse shared buffer, so take the new slot before releasing the old one.
+        unsigned int offset = 0;
+        GLSharedBuffer* sharedBuffer = takeSharedBufferSlot(offset, sparsest);
+        if (!sharedBuffer) break;
+
+        if (!isOrphan)
+        {
+            extensions->glBindBuffer(GL_COPY_READ_BUFFER, readBuffer);
+            extensions->glBindBuffer(GL_COPY_WRITE_BUFFER, sharedBuffer->glObjectID);
+            extensions->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, readOffset, offset, _profile._size);
+        }
+
+        releaseSharedBufferSlot(to);
+
+        to->getGLObjectID() = sharedBuffer->glObjectID;
+        to->_sharedBuffer = sharedBuffer;
+        to->_sharedBufferOffset = offset;
+        to->setAllocatedSize(isOrphan ? 0 : allocatedSize);
+
+        ++numMoved;
+    }
+
+    extensions->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    extensions->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    OSG_INFO<<"GLBufferObjectSet="<<this<<": Compacted "<<numMoved<<" of "<<toMove.size()<<" GLBufferObjects out of shared buffer "<<readBuffer<<std::endl;
+
+    _parent->getNumberCompactionMoves() += numMoved;
+
+    availableTime -= timer.elapsedTime();
+}
+
+unsigned int GLBufferObjectSet::computeNumBytesWasted() const
+{
+    unsigned int numBytesWasted = 0;
+    for(GLBufferObject* to = _head; to!=0; to = to->_next)
+    {
+        if (to->getUsedSize()<_profile._size) numBytesWasted += _profile._size - to->getUsedSize();
+    }
+
+    // orphans are the pool's reserve rather than waste, so only add the free slots of the shared buffers.
+    for(GLSharedBufferList::const_iterator itr = _sharedBuffers.begin();
+        itr != _sharedBuffers.end();
+        ++itr)
+    {
+        numBytesWasted += itr->freeSlots.size()*_profile._size;
+    }
+
+    return numBytesWasted;
+}
+
 
 GLBufferObjectManager::GLBufferObjectManager(unsigned int contextID):
     _contextID(contextID),
+    _glObjectsMutex(GLObjectsMutex::getGLObjectsMutex(contextID)),
     _numActiveGLBufferObjects(0),
     _numOrphanedGLBufferObjects(0),
     _currGLBufferObjectPoolSize(0),
     _maxGLBufferObjectPoolSize(0),
+    _sharedBufferSize(1024*1024),
     _frameNumber(0),
     _numFrames(0),
     _numDeleted(0),
@@ -1041,7 +1619,12 @@ GLBufferObjectManager::GLBufferObjectManager(unsigned int contextID):
     _numGenerated(0),
     _generateTime(0.0),
     _numApplied(0),
-    _applyTime(0.0)
+    _applyTime(0.0),
+    _numStreamingUpdates(0),
+    _numStreamingStalls(0),
+    _numPoolHits(0),
+    _numPoolMisses(0),
+    _numCompactionMoves(0)
 {
 }
 
@@ -1059,6 +1642,8 @@ void GLBufferObjectManager::setMaxGLBufferObjectPoolSize(unsigned int size)
 
 bool GLBufferObjectManager::makeSpace(unsigned int size)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
         itr != _glBufferObjectSetMap.end() && size>0;
         ++itr)
@@ -1069,13 +1654,34 @@ bool GLBufferObjectManager::makeSpace(unsigned int size)
     return size==0;
 }
 
+void GLBufferObjectManager::collectGLBufferObjectsUnusedSince(unsigned int frameNumber, std::vector<GLBufferObject*>& list) const
+{
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
+    for(GLBufferObjectSetMap::const_iterator itr = _glBufferObjectSetMap.begin();
+        itr != _glBufferObjectSetMap.end();
+        ++itr)
+    {
+        (*itr).second->collectGLBufferObjectsUnusedSince(frameNumber, list);
+    }
+}
+
+
+unsigned int GLBufferObjectManager::computeSizeClass(unsigned int size)
+{
+    unsigned int sizeClass = 256;
+    while(sizeClass<size && sizeClass<0x80000000u) sizeClass <<= 1;
+    return sizeClass<size ? size : sizeClass;
+}
 
 GLBufferObject* GLBufferObjectManager::generateGLBufferObject(const BufferObject* bufferObject)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     ElapsedTime elapsedTime(&(getGenerateTime()));
     ++getNumberGenerated();
 
-    BufferObjectProfile profile(bufferObject->getTarget(), bufferObject->getUsage(), bufferObject->computeRequiredBufferSize());
+    BufferObjectProfile profile(bufferObject->getTarget(), bufferObject->getUsage(), computeSizeClass(bufferObject->computeRequiredBufferSize()));
 
     // OSG_NOTICE<<"GLBufferObjectManager::generateGLBufferObject size="<<bufferObject->computeRequiredBufferSize()<<std::endl;
 
@@ -1092,6 +1698,8 @@ GLBufferObjectSet* GLBufferObjectManager::getGLBufferObjectSet(const BufferObjec
 
 void GLBufferObjectManager::handlePendingOrphandedGLBufferObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
         itr != _glBufferObjectSetMap.end();
         ++itr)
@@ -1102,6 +1710,8 @@ void GLBufferObjectManager::handlePendingOrphandedGLBufferObjects()
 
 void GLBufferObjectManager::deleteAllGLBufferObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     ElapsedTime elapsedTime(&(getDeleteTime()));
 
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
@@ -1114,6 +1724,8 @@ void GLBufferObjectManager::deleteAllGLBufferObjects()
 
 void GLBufferObjectManager::discardAllGLBufferObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
         itr != _glBufferObjectSetMap.end();
         ++itr)
@@ -1124,6 +1736,8 @@ void GLBufferObjectManager::discardAllGLBufferObjects()
 
 void GLBufferObjectManager::flushAllDeletedGLBufferObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     ElapsedTime elapsedTime(&(getDeleteTime()));
 
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
@@ -1136,6 +1750,8 @@ void GLBufferObjectManager::flushAllDeletedGLBufferObjects()
 
 void GLBufferObjectManager::discardAllDeletedGLBufferObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
         itr != _glBufferObjectSetMap.end();
         ++itr)
@@ -1146,6 +1762,8 @@ void GLBufferObjectManager::discardAllDeletedGLBufferObjects()
 
 void GLBufferObjectManager::flushDeletedGLBufferObjects(double currentTime, double& availableTime)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     ElapsedTime elapsedTime(&(getDeleteTime()));
 
     for(GLBufferObjectSetMap::iterator itr = _glBufferObjectSetMap.begin();
@@ -1165,6 +1783,8 @@ void GLBufferObjectManager::releaseGLBufferObject(GLBufferObject* to)
 
 void GLBufferObjectManager::newFrame(osg::FrameStamp* fs)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     if (fs) _frameNumber = fs->getFrameNumber();
     else ++_frameNumber;
 
@@ -1179,6 +1799,8 @@ void GLBufferObjectManager::reportStats(std::ostream& out)
     out<<"   total _numGenerated="<<_numGenerated<<", _generateTime="<<_generateTime<<", averagePerFrame="<<_generateTime/numFrames*1000.0<<"ms"<<std::endl;
     out<<"   total _numDeleted="<<_numDeleted<<", _deleteTime="<<_deleteTime<<", averagePerFrame="<<_deleteTime/numFrames*1000.0<<"ms"<<std::endl;
     out<<"   total _numApplied="<<_numApplied<<", _applyTime="<<_applyTime<<", averagePerFrame="<<_applyTime/numFrames*1000.0<<"ms"<<std::endl;
+    out<<"   total _numStreamingUpdates="<<_numStreamingUpdates<<", _numStreamingStalls="<<_numStreamingStalls<<std::endl;
+    out<<"   total _numPoolHits="<<_numPoolHits<<", _numPoolMisses="<<_numPoolMisses<<", _numCompactionMoves="<<_numCompactionMoves<<", bytes wasted="<<computeNumBytesWasted()<<std::endl;
     out<<"   getMaxGLBufferObjectPoolSize()="<<getMaxGLBufferObjectPoolSize()<<" current/max size = "<<double(_currGLBufferObjectPoolSize)/double(getMaxGLBufferObjectPoolSize())<<std::endl;;
 
     recomputeStats(out);
@@ -1196,6 +1818,25 @@ void GLBufferObjectManager::resetStats()
 
     _numApplied = 0;
     _applyTime = 0;
+
+    _numStreamingUpdates = 0;
+    _numStreamingStalls = 0;
+
+    _numPoolHits = 0;
+    _numPoolMisses = 0;
+    _numCompactionMoves = 0;
+}
+
+unsigned int GLBufferObjectManager::computeNumBytesWasted() const
+{
+    unsigned int numBytesWasted = 0;
+    for(GLBufferObjectSetMap::const_iterator itr = _glBufferObjectSetMap.begin();
+        itr != _glBufferObjectSetMap.end();
+        ++itr)
+    {
+        numBytesWasted += itr->second->computeNumBytesWasted();
+    }
+    return numBytesWasted;
 }
 
 void GLBufferObjectManager::recomputeStats(std::ostream& out)
@@ -1217,6 +1858,7 @@ void GLBufferObjectManager::recomputeStats(std::ostream& out)
          numPendingOrphans += os->getNumPendingOrphans();
          currentSize += os->getProfile()._size * (os->computeNumGLBufferObjectsInList()+os->getNumOrphans());
          out<<"   size="<<os->getProfile()._size
+           <<", os->getNumSharedBuffers()"<<os->getNumSharedBuffers()
            <<", os->computeNumGLBufferObjectsInList()"<<os->computeNumGLBufferObjectsInList()
            <<", os->getNumOfGLBufferObjects()"<<os->getNumOfGLBufferObjects()
            <<", os->getNumOrphans()"<<os->getNumOrphans()
@@ -1278,13 +1920,15 @@ void GLBufferObject::releaseGLBufferObject(unsigned int contextID, GLBufferObjec
 // BufferObject
 //
 BufferObject::BufferObject():
-    _copyDataAndReleaseGLBufferObject(false)
+    _copyDataAndReleaseGLBufferObject(false),
+    _usePersistentMapping(false)
 {
 }
 
 BufferObject::BufferObject(const BufferObject& bo,const CopyOp& copyop):
     Object(bo,copyop),
-    _copyDataAndReleaseGLBufferObject(bo._copyDataAndReleaseGLBufferObject)
+    _copyDataAndReleaseGLBufferObject(bo._copyDataAndReleaseGLBufferObject),
+    _usePersistentMapping(bo._usePersistentMapping)
 {
 }
 
@@ -1745,3 +2389,43 @@ AtomicCounterBufferObject::AtomicCounterBufferObject(const AtomicCounterBufferOb
 AtomicCounterBufferObject::~AtomicCounterBufferObject()
 {
 }
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//
+//  DrawIndirectBufferObject
+//
+DrawIndirectBufferObject::DrawIndirectBufferObject()
+{
+    setTarget(GL_DRAW_INDIRECT_BUFFER);
+    setUsage(GL_STREAM_DRAW_ARB);
+}
+
+DrawIndirectBufferObject::DrawIndirectBufferObject(const DrawIndirectBufferObject& dibo, const CopyOp& copyop)
+    : BufferObject(dibo, copyop)
+{
+}
+
+DrawIndirectBufferObject::~DrawIndirectBufferObject()
+{
+}
+
+
+//////////////////////////////////////////////////////////////////////////////////
+//
+//  ShaderStorageBufferObject
+//
+ShaderStorageBufferObject::ShaderStorageBufferObject()
+{
+    setTarget(GL_SHADER_STORAGE_BUFFER);
+    setUsage(GL_STREAM_DRAW_ARB);
+}
+
+ShaderStorageBufferObject::ShaderStorageBufferObject(const ShaderStorageBufferObject& ssbo, const CopyOp& copyop)
+    : BufferObject(ssbo, copyop)
+{
+}
+
+ShaderStorageBufferObject::~ShaderStorageBufferObject()
+{
+}
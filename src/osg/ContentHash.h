@@ -0,0 +1,68 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSG_CONTENTHASH_H
+#define OSG_CONTENTHASH_H 1
+
+#include <string>
+#include <stdio.h>
+
+namespace osg
+{
+
+/** 64 bit FNV-1a hash of the content of objects, used for keys that have to stay the same between runs
+  * of an application or for objects with equal content, such as ProgramBinaryCache entries.*/
+struct ContentHash
+{
+#ifdef _WIN32
+    typedef unsigned __int64 Value;
+#else
+    typedef unsigned long long int Value;
+#endif
+
+    ContentHash(): _value(14695981039346656037ULL) {}
+
+    void add(const void* data, unsigned int size)
+    {
+        const unsigned char* ptr = static_cast<const unsigned char*>(data);
+        for(unsigned int i=0; i<size; ++i)
+        {
+            _value ^= ptr[i];
+            _value *= 1099511628211ULL;
+        }
+    }
+
+    void add(unsigned int value) { add(&value, sizeof(value)); }
+
+    void add(float value) { add(&value, sizeof(value)); }
+
+    void add(const std::string& str)
+    {
+        add(static_cast<unsigned int>(str.size()));
+        add(str.data(), static_cast<unsigned int>(str.size()));
+    }
+
+    /** Return the hash as 16 hexadecimal digits.*/
+    std::string str() const
+    {
+        char buffer[17];
+        sprintf(buffer, "%08x%08x", static_cast<unsigned int>(_value>>32), static_cast<unsigned int>(_value & 0xffffffff));
+        return std::string(buffer);
+    }
+
+    Value _value;
+};
+
+}
+
+#endif
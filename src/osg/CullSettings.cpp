@@ -44,6 +44,9 @@ void CullSettings::setDefaults()
     _cullMaskLeft = 0xffffffff;
     _cullMaskRight = 0xffffffff;
 
+    _parallelCullThreshold = 0;
+    _numParallelCullThreads = 0;
+
     // override during testing
     //_computeNearFar = COMPUTE_NEAR_FAR_USING_PRIMITIVES;
     //_nearFarRatio = 0.00005f;
@@ -69,6 +72,9 @@ void CullSettings::setCullSettings(const CullSettings& rhs)
     _cullMask = rhs._cullMask;
     _cullMaskLeft = rhs._cullMaskLeft;
     _cullMaskRight =  rhs._cullMaskRight;
+
+    _parallelCullThreshold = rhs._parallelCullThreshold;
+    _numParallelCullThreads = rhs._numParallelCullThreads;
 }
 
 
@@ -87,11 +93,18 @@ void CullSettings::inheritCullSettings(const CullSettings& settings, unsigned in
     if (inheritanceMask & LOD_SCALE) _LODScale = settings._LODScale;
     if (inheritanceMask & SMALL_FEATURE_CULLING_PIXEL_SIZE) _smallFeatureCullingPixelSize = settings._smallFeatureCullingPixelSize;
     if (inheritanceMask & CLAMP_PROJECTION_MATRIX_CALLBACK) _clampProjectionMatrixCallback = settings._clampProjectionMatrixCallback;
+    if (inheritanceMask & PARALLEL_CULL)
+    {
+        _parallelCullThreshold = settings._parallelCullThreshold;
+        _numParallelCullThreads = settings._numParallelCullThreads;
+    }
 }
 
 
 static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_COMPUTE_NEAR_FAR_MODE <mode>","DO_NOT_COMPUTE_NEAR_FAR | COMPUTE_NEAR_FAR_USING_BOUNDING_VOLUMES | COMPUTE_NEAR_FAR_USING_PRIMITIVES");
 static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e1(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NEAR_FAR_RATIO <float>","Set the ratio between near and far planes - must greater than 0.0 but less than 1.0.");
+static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e2(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_PARALLEL_CULL_THRESHOLD <int>","Set the minimum number of children of a Group for them to be culled in parallel, 0 disables parallel culling.");
+static ApplicationUsageProxy ApplicationUsageProxyCullSettings_e3(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_NUM_PARALLEL_CULL_THREADS <int>","Set the number of threads used for parallel culling, 0 uses the number of processors.");
 
 void CullSettings::readEnvironmentalVariables()
 {
@@ -116,6 +129,20 @@ void CullSettings::readEnvironmentalVariables()
         OSG_INFO<<"Set near/far ratio to "<<_nearFarRatio<<std::endl;
     }
 
+    if ((ptr = getenv("OSG_PARALLEL_CULL_THRESHOLD")) != 0)
+    {
+        _parallelCullThreshold = atoi(ptr);
+
+        OSG_INFO<<"Set parallel cull threshold to "<<_parallelCullThreshold<<std::endl;
+    }
+
+    if ((ptr = getenv("OSG_NUM_PARALLEL_CULL_THREADS")) != 0)
+    {
+        _numParallelCullThreads = atoi(ptr);
+
+        OSG_INFO<<"Set number of parallel cull threads to "<<_numParallelCullThreads<<std::endl;
+    }
+
 }
 
 void CullSettings::readCommandLine(ArgumentParser& arguments)
@@ -125,6 +152,8 @@ void CullSettings::readCommandLine(ArgumentParser& arguments)
     {
         arguments.getApplicationUsage()->addCommandLineOption("--COMPUTE_NEAR_FAR_MODE <mode>","DO_NOT_COMPUTE_NEAR_FAR | COMPUTE_NEAR_FAR_USING_BOUNDING_VOLUMES | COMPUTE_NEAR_FAR_USING_PRIMITIVES");
         arguments.getApplicationUsage()->addCommandLineOption("--NEAR_FAR_RATIO <float>","Set the ratio between near and far planes - must greater than 0.0 but less than 1.0.");
+        arguments.getApplicationUsage()->addCommandLineOption("--PARALLEL_CULL_THRESHOLD <int>","Set the minimum number of children of a Group for them to be culled in parallel, 0 disables parallel culling.");
+        arguments.getApplicationUsage()->addCommandLineOption("--NUM_PARALLEL_CULL_THREADS <int>","Set the number of threads used for parallel culling, 0 uses the number of processors.");
     }
 
     std::string str;
@@ -145,6 +174,21 @@ void CullSettings::readCommandLine(ArgumentParser& arguments)
         OSG_INFO<<"Set near/far ratio to "<<_nearFarRatio<<std::endl;
     }
 
+    unsigned int numValue;
+    while(arguments.read("--PARALLEL_CULL_THRESHOLD",numValue))
+    {
+        _parallelCullThreshold = numValue;
+
+        OSG_INFO<<"Set parallel cull threshold to "<<_parallelCullThreshold<<std::endl;
+    }
+
+    while(arguments.read("--NUM_PARALLEL_CULL_THREADS",numValue))
+    {
+        _numParallelCullThreads = numValue;
+
+        OSG_INFO<<"Set number of parallel cull threads to "<<_numParallelCullThreads<<std::endl;
+    }
+
 }
 
 void CullSettings::write(std::ostream& out)
@@ -166,6 +210,8 @@ void CullSettings::write(std::ostream& out)
     out<<"    _cullMask = "<<_cullMask<<std::endl;
     out<<"    _cullMaskLeft = "<<_cullMaskLeft<<std::endl;
     out<<"    _cullMaskRight = "<<_cullMaskRight<<std::endl;
+    out<<"    _parallelCullThreshold = "<<_parallelCullThreshold<<std::endl;
+    out<<"    _numParallelCullThreads = "<<_numParallelCullThreads<<std::endl;
 
     out<<"{"<<std::endl;
 }
@@ -89,6 +89,51 @@ void CullStack::reset()
 }
 
 
+void CullStack::pushCullStackState(const CullStack& cs)
+{
+    _viewportStack.push_back(cs._viewportStack.back());
+    _projectionStack.push_back(cs._projectionStack.back());
+    _projectionCullingStack.push_back(cs._projectionCullingStack.back());
+    _modelviewStack.push_back(cs._modelviewStack.back());
+
+    _eyePointStack.push_back(cs._eyePointStack.back());
+    _referenceViewPoints.push_back(cs._referenceViewPoints.back());
+    _viewPointStack.push_back(cs._viewPointStack.back());
+
+    _MVPW_Stack.push_back(0L);
+
+    if (_index_modelviewCullingStack>=_modelviewCullingStack.size())
+    {
+        _modelviewCullingStack.push_back(CullingSet());
+    }
+
+    _modelviewCullingStack[_index_modelviewCullingStack++].set(cs.getCurrentCullingSet());
+    _back_modelviewCullingStack = &_modelviewCullingStack[_index_modelviewCullingStack-1];
+
+    _frustumVolume = cs._frustumVolume;
+    _bbCornerNear = cs._bbCornerNear;
+    _bbCornerFar = cs._bbCornerFar;
+}
+
+void CullStack::popCullStackState()
+{
+    _viewportStack.pop_back();
+    _projectionStack.pop_back();
+    _projectionCullingStack.pop_back();
+    _modelviewStack.pop_back();
+
+    _eyePointStack.pop_back();
+    _referenceViewPoints.pop_back();
+    _viewPointStack.pop_back();
+
+    _MVPW_Stack.pop_back();
+
+    --_index_modelviewCullingStack;
+    _back_modelviewCullingStack = _index_modelviewCullingStack>0 ? &_modelviewCullingStack[_index_modelviewCullingStack-1] : 0;
+
+    _frustumVolume = -1.0f;
+}
+
 void CullStack::pushCullingSet()
 {
     _MVPW_Stack.push_back(0L);
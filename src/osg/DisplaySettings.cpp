@@ -88,6 +88,7 @@ void DisplaySettings::setDisplaySettings(const DisplaySettings& vs)
 
     _maxTexturePoolSize = vs._maxTexturePoolSize;
     _maxBufferObjectPoolSize = vs._maxBufferObjectPoolSize;
+    _maxGLMemorySize = vs._maxGLMemorySize;
 
     _implicitBufferAttachmentRenderMask = vs._implicitBufferAttachmentRenderMask;
     _implicitBufferAttachmentResolveMask = vs._implicitBufferAttachmentResolveMask;
@@ -129,6 +130,7 @@ void DisplaySettings::merge(const DisplaySettings& vs)
 
     if (vs._maxTexturePoolSize>_maxTexturePoolSize) _maxTexturePoolSize = vs._maxTexturePoolSize;
     if (vs._maxBufferObjectPoolSize>_maxBufferObjectPoolSize) _maxBufferObjectPoolSize = vs._maxBufferObjectPoolSize;
+    if (vs._maxGLMemorySize>_maxGLMemorySize) _maxGLMemorySize = vs._maxGLMemorySize;
 
     // these are bit masks so merging them is like logical or
     _implicitBufferAttachmentRenderMask |= vs._implicitBufferAttachmentRenderMask;
@@ -210,6 +212,7 @@ void DisplaySettings::setDefaults()
 
     _maxTexturePoolSize = 0;
     _maxBufferObjectPoolSize = 0;
+    _maxGLMemorySize = 0;
 
     _implicitBufferAttachmentRenderMask = DEFAULT_IMPLICIT_BUFFER_ATTACHMENT;
     _implicitBufferAttachmentResolveMask = DEFAULT_IMPLICIT_BUFFER_ATTACHMENT;
@@ -337,6 +340,9 @@ static ApplicationUsageProxy DisplaySetting_e29(ApplicationUsage::ENVIRONMENTAL_
 static ApplicationUsageProxy DisplaySetting_e30(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
         "OSG_MENUBAR_BEHAVIOR <behavior>",
         "OSX Only : Specify the behavior of the menubar (AUTO_HIDE, FORCE_HIDE, FORCE_SHOW)");
+static ApplicationUsageProxy DisplaySetting_e31(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
+        "OSG_MAX_GL_MEMORY_SIZE <int>",
+        "Set the number of bytes of texture and buffer objects to keep resident, evicting the least recently drawn beyond it.");
 
 void DisplaySettings::readEnvironmentalVariables()
 {
@@ -557,6 +563,11 @@ void DisplaySettings::readEnvironmentalVariables()
         _maxBufferObjectPoolSize = atoi(ptr);
     }
 
+    if( (ptr = getenv("OSG_MAX_GL_MEMORY_SIZE")) != 0)
+    {
+        _maxGLMemorySize = strtoul(ptr, 0, 10);
+    }
+
 
     {  // Read implicit buffer attachments combinations for both render and resolve mask
         const char * variable[] = {
@@ -808,6 +819,7 @@ void DisplaySettings::readCommandLine(ArgumentParser& arguments)
 
     while(arguments.read("--texture-pool-size",_maxTexturePoolSize)) {}
     while(arguments.read("--buffer-object-pool-size",_maxBufferObjectPoolSize)) {}
+    while(arguments.read("--max-gl-memory-size",_maxGLMemorySize)) {}
 
     {  // Read implicit buffer attachments combinations for both render and resolve mask
         const char* option[] = {
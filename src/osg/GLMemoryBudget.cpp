@@ -0,0 +1,274 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osg/GLMemoryBudget>
+#include <osg/Texture>
+#include <osg/BufferObject>
+#include <osg/State>
+#include <osg/FrameStamp>
+#include <osg/buffered_value>
+#include <osg/Notify>
+#include <osg/GLObjects>
+
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+
+using namespace osg;
+
+namespace
+{
+
+typedef osg::buffered_object< ref_ptr<GLMemoryBudget> > GLMemoryBudgetBuffer;
+
+OpenThreads::Mutex s_glMemoryBudgetMutex;
+GLMemoryBudgetBuffer s_glMemoryBudgets;
+
+// a texture can only be evicted if all its images are still there to download again.
+bool isReloadable(const Texture* texture)
+{
+    if (texture->getNumImages()==0) return false;
+
+    for(unsigned int i=0; i<texture->getNumImages(); ++i)
+    {
+        const Image* image = texture->getImage(i);
+        if (!image || !image->data()) return false;
+    }
+    return true;
+}
+
+// persistently mapped buffers are updated every frame so aren't worth evicting. A sub-allocated buffer
+// releases its slot of the shared buffer, the pool counting each slot at the set's profile size.
+bool isReloadable(const GLBufferObject* glbo)
+{
+    const BufferObject* bufferObject = const_cast<GLBufferObject*>(glbo)->getBufferObject();
+    if (!bufferObject || glbo->isPersistentlyMapped()) return false;
+    if (bufferObject->getNumBufferData()==0) return false;
+
+    for(unsigned int i=0; i<bufferObject->getNumBufferData(); ++i)
+    {
+        const BufferData* bufferData = bufferObject->getBufferData(i);
+        if (!bufferData || !bufferData->getDataPointer()) return false;
+    }
+    return true;
+}
+
+struct EvictionCandidate
+{
+    EvictionCandidate(Texture::TextureObject* to):
+        frameLastUsed(to->_frameLastUsed),
+        textureObject(to),
+        glBufferObject(0) {}
+
+    EvictionCandidate(GLBufferObject* glbo):
+        frameLastUsed(glbo->_frameLastUsed),
+        textureObject(0),
+        glBufferObject(glbo) {}
+
+    bool operator < (const EvictionCandidate& rhs) const { return frameLastUsed < rhs.frameLastUsed; }
+
+    unsigned int                frameLastUsed;
+    Texture::TextureObject*     textureObject;
+    GLBufferObject*             glBufferObject;
+};
+
+}
+
+ref_ptr<GLMemoryBudget>& GLMemoryBudget::getGLMemoryBudget(unsigned int contextID)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_glMemoryBudgetMutex);
+    if (!s_glMemoryBudgets[contextID]) s_glMemoryBudgets[contextID] = new GLMemoryBudget(contextID);
+    return s_glMemoryBudgets[contextID];
+}
+
+bool GLMemoryBudget::isAnyOverBudget()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_glMemoryBudgetMutex);
+    for(unsigned int i=0; i<s_glMemoryBudgets.size(); ++i)
+    {
+        if (s_glMemoryBudgets[i].valid() && s_glMemoryBudgets[i]->isEnabled() && s_glMemoryBudgets[i]->isOverBudget()) return true;
+    }
+    return false;
+}
+
+double GLMemoryBudget::computeMaxFractionOverBudget()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_glMemoryBudgetMutex);
+    double maxFraction = 0.0;
+    for(unsigned int i=0; i<s_glMemoryBudgets.size(); ++i)
+    {
+        if (!s_glMemoryBudgets[i].valid() || !s_glMemoryBudgets[i]->isEnabled()) continue;
+
+        double numBytesOverBudget = s_glMemoryBudgets[i]->getNumBytesOverBudget();
+        double fraction = numBytesOverBudget/(numBytesOverBudget+double(s_glMemoryBudgets[i]->getMaxSize()));
+        if (fraction>maxFraction) maxFraction = fraction;
+    }
+    return maxFraction;
+}
+
+GLMemoryBudget::GLMemoryBudget(unsigned int contextID):
+    _contextID(contextID),
+    _maxSize(0),
+    _minimumNumberOfFramesUnused(2),
+    _frameNumber(0),
+    _numBytesOverBudget(0),
+    _numBytesResident(0),
+    _numBytesEvicted(0),
+    _numObjectsEvicted(0),
+    _numFrames(0),
+    _numFramesOverBudget(0),
+    _totalBytesEvicted(0.0),
+    _totalObjectsEvicted(0)
+{
+}
+
+GLMemoryBudget::~GLMemoryBudget()
+{
+}
+
+unsigned int GLMemoryBudget::computeNumBytesResident() const
+{
+    return Texture::getTextureObjectManager(_contextID)->getCurrTexturePoolSize() +
+           GLBufferObjectManager::getGLBufferObjectManager(_contextID)->getCurrGLBufferObjectPoolSize();
+}
+
+void GLMemoryBudget::newFrame(const osg::FrameStamp* fs)
+{
+    unsigned int frameNumber = fs ? fs->getFrameNumber() : _frameNumber+1;
+
+    // each camera drawing to the context starts the frame, keep the counts of the first.
+    if (frameNumber==_frameNumber && _numFrames>0) return;
+
+    _frameNumber = frameNumber;
+    ++_numFrames;
+
+    _numBytesOverBudget.exchange(0);
+    _numBytesEvicted = 0;
+    _numObjectsEvicted = 0;
+}
+
+void GLMemoryBudget::enforce(osg::State& state)
+{
+    _numBytesResident = computeNumBytesResident();
+    if (_maxSize==0 || _numBytesResident<=_maxSize) return;
+
+    ++_numFramesOverBudget;
+
+    evict(state);
+
+    // only the bytes eviction couldn't free are left for the DatabasePager to release by expiring PagedLOD children.
+    _numBytesOverBudget.exchange(_numBytesResident>_maxSize ? _numBytesResident-_maxSize : 0);
+}
+
+void GLMemoryBudget::evict(osg::State& state)
+{
+    // keeps a compile context from generating objects while the candidates for eviction are collected and released.
+    ScopedGLObjectsLock lock(GLObjectsMutex::getGLObjectsMutex(_contextID));
+
+    Texture::TextureObjectManager* tom = Texture::getTextureObjectManager(_contextID).get();
+    GLBufferObjectManager* bom = GLBufferObjectManager::getGLBufferObjectManager(_contextID).get();
+
+    // orphaned objects are only held for reuse so go first.
+    tom->makeSpace(_numBytesResident-_maxSize);
+    _numBytesResident = computeNumBytesResident();
+    if (_numBytesResident>_maxSize) bom->makeSpace(_numBytesResident-_maxSize);
+
+    _numBytesResident = computeNumBytesResident();
+    if (_numBytesResident<=_maxSize || _frameNumber<_minimumNumberOfFramesUnused) return;
+
+    unsigned int usedSince = _frameNumber-_minimumNumberOfFramesUnused;
+
+    std::vector<Texture::TextureObject*> textureObjects;
+    tom->collectTextureObjectsUnusedSince(usedSince, textureObjects);
+
+    std::vector<GLBufferObject*> glBufferObjects;
+    bom->collectGLBufferObjectsUnusedSince(usedSince, glBufferObjects);
+
+    typedef std::vector<EvictionCandidate> EvictionCandidates;
+    EvictionCandidates candidates;
+    candidates.reserve(textureObjects.size()+glBufferObjects.size());
+    candidates.insert(candidates.end(), textureObjects.begin(), textureObjects.end());
+    candidates.insert(candidates.end(), glBufferObjects.begin(), glBufferObjects.end());
+
+    // each set's list is already in least recently used order so keep it for objects last used in the same frame.
+    std::stable_sort(candidates.begin(), candidates.end());
+
+    unsigned int numBytesToEvict = _numBytesResident-_maxSize;
+    unsigned int numBytesEvicted = 0;
+    bool glBufferObjectsEvicted = false;
+    for(EvictionCandidates::iterator itr = candidates.begin();
+        itr != candidates.end() && numBytesEvicted<numBytesToEvict;
+        ++itr)
+    {
+        if (itr->textureObject)
+        {
+            Texture::TextureObject* to = itr->textureObject;
+            Texture* texture = to->getTexture();
+            if (texture->getTextureObject(_contextID)!=to || !isReloadable(texture)) continue;
+
+            numBytesEvicted += to->size();
+
+            // orphans the TextureObject, the Texture will create a new one and download its images when next applied.
+            texture->releaseGLObjects(&state);
+        }
+        else
+        {
+            GLBufferObject* glbo = itr->glBufferObject;
+            BufferObject* bufferObject = glbo->getBufferObject();
+            if (bufferObject->getGLBufferObject(_contextID)!=glbo || !isReloadable(glbo)) continue;
+
+            numBytesEvicted += glbo->getProfile()._size;
+
+            // orphans the GLBufferObject, a new one is created and downloads the BufferData when next drawn.
+            bufferObject->releaseGLObjects(&state);
+            glBufferObjectsEvicted = true;
+        }
+
+        ++_numObjectsEvicted;
+    }
+
+    if (glBufferObjectsEvicted)
+    {
+        // the released GLBufferObjects may still be recorded as the ones bound.
+        state.unbindVertexBufferObject();
+        state.unbindElementBufferObject();
+    }
+
+    // delete the GL objects of the now orphaned objects.
+    tom->makeSpace(numBytesEvicted);
+    bom->makeSpace(numBytesEvicted);
+
+    _numBytesEvicted += numBytesEvicted;
+    _totalBytesEvicted += double(numBytesEvicted);
+    _totalObjectsEvicted += _numObjectsEvicted;
+
+    _numBytesResident = computeNumBytesResident();
+
+    OSG_INFO<<"GLMemoryBudget::enforce() evicted "<<_numObjectsEvicted<<" objects, "<<numBytesEvicted<<" bytes, "<<_numBytesResident<<" bytes resident of "<<_maxSize<<std::endl;
+}
+
+void GLMemoryBudget::resetStats()
+{
+    _numFrames = 0;
+    _numFramesOverBudget = 0;
+    _totalBytesEvicted = 0.0;
+    _totalObjectsEvicted = 0;
+}
+
+void GLMemoryBudget::reportStats(std::ostream& out)
+{
+    double numFrames(_numFrames==0 ? 1.0 : _numFrames);
+    out<<"GLMemoryBudget::reportStats() contextID="<<_contextID<<std::endl;
+    out<<"   _maxSize="<<_maxSize<<", _numBytesResident="<<_numBytesResident<<", _numFramesOverBudget="<<_numFramesOverBudget<<" of "<<_numFrames<<std::endl;
+    out<<"   total _totalObjectsEvicted="<<_totalObjectsEvicted<<", _totalBytesEvicted="<<_totalBytesEvicted<<", averagePerFrame="<<_totalBytesEvicted/numFrames<<" bytes"<<std::endl;
+}
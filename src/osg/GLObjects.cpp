@@ -20,6 +20,9 @@
 #include <osg/FrameBufferObject>
 #include <osg/Drawable>
 #include <osg/OcclusionQueryNode>
+#include <osg/buffered_value>
+
+#include <OpenThreads/ScopedLock>
 
 void osg::flushDeletedGLObjects(unsigned int contextID, double currentTime, double& availableTime)
 {
@@ -111,3 +114,18 @@ void osg::discardAllGLObjects(unsigned int contextID)
     osg::Shader::discardDeletedGlShaders(contextID);
     osg::OcclusionQueryNode::discardDeletedQueryObjects(contextID);
 }
+
+namespace
+{
+
+OpenThreads::Mutex s_glObjectsMutexesMutex;
+osg::buffered_object< osg::ref_ptr<osg::GLObjectsMutex> > s_glObjectsMutexes;
+
+}
+
+osg::GLObjectsMutex* osg::GLObjectsMutex::getGLObjectsMutex(unsigned int contextID)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(s_glObjectsMutexesMutex);
+    if (!s_glObjectsMutexes[contextID]) s_glObjectsMutexes[contextID] = new GLObjectsMutex;
+    return s_glObjectsMutexes[contextID].get();
+}
@@ -0,0 +1,228 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSG_IMAGEKERNELTEMPLATES_H
+#define OSG_IMAGEKERNELTEMPLATES_H 1
+
+#include <osg/GL>
+
+#include <float.h>
+
+// Row kernels shared by the instruction sets, written against a vector class V providing NUM_LANES float lanes:
+//
+//   Float set1(float), Float load(const T*), void store(T*, Float) for T float, unsigned char and unsigned short,
+//   Float add(Float, Float), mul, div, minimum(value, current) and maximum(value, current).
+//
+// Stores to integer types truncate and keep the low bits, as the scalar float to integer conversions do on x86.
+// The operations are done in the same order as the per pixel code so the results are identical. This file is
+// included by the translation unit of each instruction set, so everything in it has internal linkage.
+
+namespace
+{
+
+template<class V, typename SRC, typename DEST>
+void convertRowTo(const SRC* src, DEST* dest, unsigned int num, float scale, bool divide)
+{
+    const unsigned int N = V::NUM_LANES;
+    const typename V::Float s = V::set1(scale);
+
+    unsigned int i = 0;
+    if (divide)
+    {
+        for(; i+N<=num; i+=N) V::store(dest+i, V::div(V::load(src+i), s));
+        for(; i<num; ++i) dest[i] = DEST(float(src[i])/scale);
+    }
+    else if (scale!=1.0f)
+    {
+        for(; i+N<=num; i+=N) V::store(dest+i, V::mul(V::load(src+i), s));
+        for(; i<num; ++i) dest[i] = DEST(float(src[i])*scale);
+    }
+    else
+    {
+        for(; i+N<=num; i+=N) V::store(dest+i, V::load(src+i));
+        for(; i<num; ++i) dest[i] = DEST(src[i]);
+    }
+}
+
+template<class V, typename SRC>
+void convertRowFrom(const SRC* src, unsigned char* dest, GLenum destDataType, unsigned int num, float scale, bool divide)
+{
+    switch(destDataType)
+    {
+        case(GL_UNSIGNED_BYTE):     convertRowTo<V>(src, dest, num, scale, divide); break;
+        case(GL_UNSIGNED_SHORT):    convertRowTo<V>(src, (unsigned short*)dest, num, scale, divide); break;
+        case(GL_FLOAT):             convertRowTo<V>(src, (float*)dest, num, scale, divide); break;
+    }
+}
+
+template<class V>
+void convertRow(const unsigned char* src, GLenum srcDataType, unsigned char* dest, GLenum destDataType, unsigned int num, float scale, bool divide)
+{
+    switch(srcDataType)
+    {
+        case(GL_UNSIGNED_BYTE):     convertRowFrom<V>(src, dest, destDataType, num, scale, divide); break;
+        case(GL_UNSIGNED_SHORT):    convertRowFrom<V>((const unsigned short*)src, dest, destDataType, num, scale, divide); break;
+        case(GL_FLOAT):             convertRowFrom<V>((const float*)src, dest, destDataType, num, scale, divide); break;
+    }
+}
+
+// Blocks of C vectors hold a whole number of pixels, so lane l of vector b of every block is component (b*N+l)%C.
+
+template<class V, typename T, unsigned int C>
+void minMaxRow(const T* data, unsigned int num, float* minValues, float* maxValues)
+{
+    const unsigned int N = V::NUM_LANES;
+    const unsigned int numElements = num*C;
+
+    unsigned int i = 0;
+    if (numElements>=N*C)
+    {
+        typename V::Float minBlock[C];
+        typename V::Float maxBlock[C];
+        for(unsigned int b=0; b<C; ++b)
+        {
+            minBlock[b] = V::set1(FLT_MAX);
+            maxBlock[b] = V::set1(-FLT_MAX);
+        }
+
+        for(; i+N*C<=numElements; i+=N*C)
+        {
+            for(unsigned int b=0; b<C; ++b)
+            {
+                typename V::Float value = V::load(data+i+b*N);
+                minBlock[b] = V::minimum(value, minBlock[b]);
+                maxBlock[b] = V::maximum(value, maxBlock[b]);
+            }
+        }
+
+        float lanes[N];
+        for(unsigned int b=0; b<C; ++b)
+        {
+            V::store(lanes, minBlock[b]);
+            for(unsigned int l=0; l<N; ++l)
+            {
+                float& minValue = minValues[(b*N+l)%C];
+                if (lanes[l]<minValue) minValue = lanes[l];
+            }
+
+            V::store(lanes, maxBlock[b]);
+            for(unsigned int l=0; l<N; ++l)
+            {
+                float& maxValue = maxValues[(b*N+l)%C];
+                if (lanes[l]>maxValue) maxValue = lanes[l];
+            }
+        }
+    }
+
+    for(; i<numElements; ++i)
+    {
+        float value = float(data[i]);
+        float& minValue = minValues[i%C];
+        float& maxValue = maxValues[i%C];
+        if (value<minValue) minValue = value;
+        if (value>maxValue) maxValue = value;
+    }
+}
+
+template<class V, typename T>
+void minMaxRowOfType(const T* data, unsigned int num, unsigned int numComponents, float* minValues, float* maxValues)
+{
+    switch(numComponents)
+    {
+        case(1): minMaxRow<V,T,1>(data, num, minValues, maxValues); break;
+        case(2): minMaxRow<V,T,2>(data, num, minValues, maxValues); break;
+        case(3): minMaxRow<V,T,3>(data, num, minValues, maxValues); break;
+        case(4): minMaxRow<V,T,4>(data, num, minValues, maxValues); break;
+    }
+}
+
+template<class V>
+void minMaxRow(const unsigned char* data, GLenum dataType, unsigned int num, unsigned int numComponents, float* minValues, float* maxValues)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):     minMaxRowOfType<V>(data, num, numComponents, minValues, maxValues); break;
+        case(GL_UNSIGNED_SHORT):    minMaxRowOfType<V>((const unsigned short*)data, num, numComponents, minValues, maxValues); break;
+        case(GL_FLOAT):             minMaxRowOfType<V>((const float*)data, num, numComponents, minValues, maxValues); break;
+    }
+}
+
+template<class V, typename T, unsigned int C>
+void offsetAndScaleRow(T* data, unsigned int num, const float* offsets, const float* scales, float typeScale)
+{
+    const unsigned int N = V::NUM_LANES;
+    const unsigned int numElements = num*C;
+    const float invTypeScale = 1.0f/typeScale;
+
+    unsigned int i = 0;
+    if (numElements>=N*C)
+    {
+        typename V::Float offsetBlock[C];
+        typename V::Float scaleBlock[C];
+        float lanes[N];
+        for(unsigned int b=0; b<C; ++b)
+        {
+            for(unsigned int l=0; l<N; ++l) lanes[l] = offsets[(b*N+l)%C];
+            offsetBlock[b] = V::load(lanes);
+
+            for(unsigned int l=0; l<N; ++l) lanes[l] = scales[(b*N+l)%C];
+            scaleBlock[b] = V::load(lanes);
+        }
+
+        const typename V::Float ts = V::set1(typeScale);
+        const typename V::Float its = V::set1(invTypeScale);
+        for(; i+N*C<=numElements; i+=N*C)
+        {
+            for(unsigned int b=0; b<C; ++b)
+            {
+                typename V::Float value = V::mul(V::load(data+i+b*N), ts);
+                value = V::add(offsetBlock[b], V::mul(value, scaleBlock[b]));
+                V::store(data+i+b*N, V::mul(value, its));
+            }
+        }
+    }
+
+    for(; i<numElements; ++i)
+    {
+        float value = float(data[i])*typeScale;
+        value = offsets[i%C] + value*scales[i%C];
+        data[i] = T(value*invTypeScale);
+    }
+}
+
+template<class V, typename T>
+void offsetAndScaleRowOfType(T* data, unsigned int num, unsigned int numComponents, const float* offsets, const float* scales, float typeScale)
+{
+    switch(numComponents)
+    {
+        case(1): offsetAndScaleRow<V,T,1>(data, num, offsets, scales, typeScale); break;
+        case(2): offsetAndScaleRow<V,T,2>(data, num, offsets, scales, typeScale); break;
+        case(3): offsetAndScaleRow<V,T,3>(data, num, offsets, scales, typeScale); break;
+        case(4): offsetAndScaleRow<V,T,4>(data, num, offsets, scales, typeScale); break;
+    }
+}
+
+template<class V>
+void offsetAndScaleRow(unsigned char* data, GLenum dataType, unsigned int num, unsigned int numComponents, const float* offsets, const float* scales, float typeScale)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):     offsetAndScaleRowOfType<V>(data, num, numComponents, offsets, scales, typeScale); break;
+        case(GL_UNSIGNED_SHORT):    offsetAndScaleRowOfType<V>((unsigned short*)data, num, numComponents, offsets, scales, typeScale); break;
+        case(GL_FLOAT):             offsetAndScaleRowOfType<V>((float*)data, num, numComponents, offsets, scales, typeScale); break;
+    }
+}
+
+}
+
+#endif
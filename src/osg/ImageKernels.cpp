@@ -0,0 +1,955 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "ImageKernels.h"
+
+#include <osg/ImageUtils>
+#include <osg/GLU>
+#include <osg/ApplicationUsage>
+#include <osg/Notify>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+#include <OpenThreads/Condition>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+
+#if defined(OSG_IMAGE_KERNELS_USE_SSE2)
+    #include <emmintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+    #include "ImageKernelTemplates.h"
+#endif
+
+using namespace osg;
+
+static ApplicationUsageProxy ApplicationUsageProxyImageKernels_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_IMAGE_KERNELS <mode>","GENERIC | SSE2 | AVX2, set the most capable instruction set the image kernels may use, GENERIC uses the original per pixel code.");
+static ApplicationUsageProxy ApplicationUsageProxyImageKernels_e1(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_IMAGE_KERNEL_THREADS <int>","Set the number of threads the image kernels split large images between, 0 uses the number of processors.");
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SSE2 kernels
+
+#if defined(OSG_IMAGE_KERNELS_USE_SSE2)
+
+namespace
+{
+
+struct SSE2
+{
+    enum { NUM_LANES = 4 };
+
+    typedef __m128 Float;
+
+    static Float set1(float value) { return _mm_set1_ps(value); }
+
+    static Float load(const float* ptr) { return _mm_loadu_ps(ptr); }
+
+    static Float load(const unsigned char* ptr)
+    {
+        int bytes;
+        memcpy(&bytes, ptr, sizeof(bytes));
+        __m128i zero = _mm_setzero_si128();
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+    }
+
+    static Float load(const unsigned short* ptr)
+    {
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)ptr), _mm_setzero_si128()));
+    }
+
+    static void store(float* ptr, Float value) { _mm_storeu_ps(ptr, value); }
+
+    static void store(unsigned char* ptr, Float value)
+    {
+        __m128i integers = _mm_and_si128(_mm_cvttps_epi32(value), _mm_set1_epi32(0xff));
+        __m128i shorts = _mm_packs_epi32(integers, integers);
+        int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(shorts, shorts));
+        memcpy(ptr, &bytes, sizeof(bytes));
+    }
+
+    static void store(unsigned short* ptr, Float value)
+    {
+        // sign extend the low 16 bits so the saturating pack leaves them untouched.
+        __m128i integers = _mm_srai_epi32(_mm_slli_epi32(_mm_cvttps_epi32(value), 16), 16);
+        _mm_storel_epi64((__m128i*)ptr, _mm_packs_epi32(integers, integers));
+    }
+
+    static Float add(Float lhs, Float rhs) { return _mm_add_ps(lhs, rhs); }
+    static Float mul(Float lhs, Float rhs) { return _mm_mul_ps(lhs, rhs); }
+    static Float div(Float lhs, Float rhs) { return _mm_div_ps(lhs, rhs); }
+
+    // value<current ? value : current, as osg::minimum(value, current)
+    static Float minimum(Float value, Float current) { return _mm_min_ps(value, current); }
+    static Float maximum(Float value, Float current) { return _mm_max_ps(value, current); }
+};
+
+// pack two vectors of 32 bit values in the range 0 to 65535 into unsigned shorts.
+inline __m128i packUnsignedShorts(__m128i lhs, __m128i rhs)
+{
+    const __m128i bias = _mm_set1_epi32(32768);
+    return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lhs, bias), _mm_sub_epi32(rhs, bias)), _mm_set1_epi16(short(0x8000)));
+}
+
+void halveRowSSE2(unsigned int numComponents, unsigned int width, const unsigned short* row0, const unsigned short* row1, unsigned short* dest)
+{
+    const unsigned int num = width*numComponents;
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int i = 0;
+    if (numComponents==4)
+    {
+        // two pixels from each row make each output pixel, four output pixels are done at a time.
+        const __m128i rounding = _mm_set1_epi32(2);
+        for(; i+8<=num; i+=8)
+        {
+            __m128i a0 = _mm_loadu_si128((const __m128i*)(row0+i*2));
+            __m128i a1 = _mm_loadu_si128((const __m128i*)(row0+i*2+8));
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(row1+i*2));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(row1+i*2+8));
+
+            __m128i first = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpackhi_epi16(a0, zero)),
+                                          _mm_add_epi32(_mm_unpacklo_epi16(b0, zero), _mm_unpackhi_epi16(b0, zero)));
+            __m128i second = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpackhi_epi16(a1, zero)),
+                                           _mm_add_epi32(_mm_unpacklo_epi16(b1, zero), _mm_unpackhi_epi16(b1, zero)));
+
+            first = _mm_srli_epi32(_mm_add_epi32(first, rounding), 2);
+            second = _mm_srli_epi32(_mm_add_epi32(second, rounding), 2);
+            _mm_storeu_si128((__m128i*)(dest+i), packUnsignedShorts(first, second));
+        }
+    }
+    else if (numComponents==1)
+    {
+        // pairs of neighbouring values are summed with a multiply add, which is signed so the values are first biased by -32768.
+        const __m128i sign = _mm_set1_epi16(short(0x8000));
+        const __m128i ones = _mm_set1_epi16(1);
+        const __m128i rounding = _mm_set1_epi32(4*32768+2);
+        for(; i+8<=num; i+=8)
+        {
+            __m128i a0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(row0+i*2)), sign);
+            __m128i a1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(row0+i*2+8)), sign);
+            __m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(row1+i*2)), sign);
+            __m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(row1+i*2+8)), sign);
+
+            __m128i first = _mm_add_epi32(_mm_madd_epi16(a0, ones), _mm_madd_epi16(b0, ones));
+            __m128i second = _mm_add_epi32(_mm_madd_epi16(a1, ones), _mm_madd_epi16(b1, ones));
+
+            first = _mm_srli_epi32(_mm_add_epi32(first, rounding), 2);
+            second = _mm_srli_epi32(_mm_add_epi32(second, rounding), 2);
+            _mm_storeu_si128((__m128i*)(dest+i), packUnsignedShorts(first, second));
+        }
+    }
+
+    for(; i<num; ++i)
+    {
+        const unsigned int t = (i/numComponents)*numComponents*2 + i%numComponents;
+        dest[i] = (row0[t] + row0[t+numComponents] + row1[t] + row1[t+numComponents] + 2) / 4;
+    }
+}
+
+void scaleRowSSE2(unsigned int numComponents, const ImageScaleTaps& xTaps, const ImageScaleTaps& yTaps, unsigned int row,
+                  const unsigned short* datain, unsigned int widthin, unsigned short* dataout)
+{
+    const unsigned int beginY = yTaps._offsets[row];
+    const unsigned int endY = yTaps._offsets[row+1];
+    const unsigned int widthout = static_cast<unsigned int>(xTaps._offsets.size())-1;
+    const unsigned int rowSize = widthin*numComponents;
+    unsigned short* out = dataout + row*widthout*numComponents;
+
+    if (numComponents>=3)
+    {
+        // the components of a pixel share a vector, for three components the lane beyond is ignored.
+        for(unsigned int j=0; j<widthout; ++j)
+        {
+            const unsigned int beginX = xTaps._offsets[j];
+            const unsigned int endX = xTaps._offsets[j+1];
+
+            __m128 totals = _mm_setzero_ps();
+            float area = 0.0f;
+            for(unsigned int ty=beginY; ty<endY; ++ty)
+            {
+                const unsigned short* in = datain + yTaps._indices[ty]*rowSize;
+                const float ypercent = yTaps._percents[ty];
+                for(unsigned int tx=beginX; tx<endX; ++tx)
+                {
+                    float percent = xTaps._percents[tx] * ypercent;
+                    area += percent;
+                    totals = _mm_add_ps(totals, _mm_mul_ps(SSE2::load(in + xTaps._indices[tx]*numComponents), _mm_set1_ps(percent)));
+                }
+            }
+
+            float values[4];
+            _mm_storeu_ps(values, totals);
+            for(unsigned int k=0; k<numComponents; ++k)
+            {
+                out[j*numComponents+k] = GLushort((values[k]+0.5)/area);
+            }
+        }
+    }
+    else
+    {
+        // each lane is a different output pixel, the pixels of a group are filtered together.
+        const unsigned int numGroups = static_cast<unsigned int>(xTaps._groupOffsets.size())-1;
+        for(unsigned int g=0; g<numGroups; ++g)
+        {
+            const unsigned int beginX = xTaps._groupOffsets[g];
+            const unsigned int endX = xTaps._groupOffsets[g+1];
+
+            __m128 totals[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+            __m128 area = _mm_setzero_ps();
+            for(unsigned int ty=beginY; ty<endY; ++ty)
+            {
+                const unsigned short* in = datain + yTaps._indices[ty]*rowSize;
+                const __m128 ypercent = _mm_set1_ps(yTaps._percents[ty]);
+                for(unsigned int tx=beginX; tx<endX; ++tx)
+                {
+                    const int* indices = &xTaps._groupIndices[tx*4];
+                    __m128 percent = _mm_mul_ps(_mm_loadu_ps(&xTaps._groupPercents[tx*4]), ypercent);
+                    area = _mm_add_ps(area, percent);
+                    for(unsigned int k=0; k<numComponents; ++k)
+                    {
+                        __m128 value = _mm_setr_ps(in[indices[0]*numComponents+k], in[indices[1]*numComponents+k],
+                                                   in[indices[2]*numComponents+k], in[indices[3]*numComponents+k]);
+                        totals[k] = _mm_add_ps(totals[k], _mm_mul_ps(value, percent));
+                    }
+                }
+            }
+
+            float areas[4];
+            float values[2][4];
+            _mm_storeu_ps(areas, area);
+            _mm_storeu_ps(values[0], totals[0]);
+            _mm_storeu_ps(values[1], totals[1]);
+            for(unsigned int l=0; l<4 && g*4+l<widthout; ++l)
+            {
+                for(unsigned int k=0; k<numComponents; ++k)
+                {
+                    out[(g*4+l)*numComponents+k] = GLushort((values[k][l]+0.5)/areas[l]);
+                }
+            }
+        }
+    }
+}
+
+// (r+g+b)*0.3333333 is done in double precision, as the scalar operators do.
+inline __m128 multiplyByThird(__m128 value)
+{
+    const __m128d third = _mm_set1_pd(0.3333333);
+    __m128 low = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(value), third));
+    __m128 high = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(value, value)), third));
+    return _mm_movelh_ps(low, high);
+}
+
+template<typename T>
+void colorSpaceRowSSE2(T* data, unsigned int num, bool bgra, int operation, const float* colour, float typeScale)
+{
+    const float invTypeScale = 1.0f/typeScale;
+    const unsigned int r = bgra ? 2 : 0;
+    const unsigned int b = bgra ? 0 : 2;
+
+    unsigned int i = 0;
+    if (num>=4)
+    {
+        const __m128 ts = _mm_set1_ps(typeScale);
+        const __m128 its = _mm_set1_ps(invTypeScale);
+        const __m128 cr = _mm_set1_ps(colour[0]);
+        const __m128 cg = _mm_set1_ps(colour[1]);
+        const __m128 cb = _mm_set1_ps(colour[2]);
+        const __m128 ca = _mm_set1_ps(colour[3]);
+        for(; i+4<=num; i+=4)
+        {
+            // transpose four pixels into a vector per component.
+            T* ptr = data + i*4;
+            __m128 c[4];
+            for(unsigned int p=0; p<4; ++p) c[p] = SSE2::load(ptr+p*4);
+            _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+            for(unsigned int k=0; k<4; ++k) c[k] = _mm_mul_ps(c[k], ts);
+
+            switch(operation)
+            {
+                case(MODULATE_ALPHA_BY_LUMINANCE):
+                    c[3] = _mm_mul_ps(c[3], multiplyByThird(_mm_add_ps(_mm_add_ps(c[r], c[1]), c[b])));
+                    break;
+                case(MODULATE_ALPHA_BY_COLOR):
+                    c[3] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c[r], cr), _mm_mul_ps(c[1], cg)), _mm_mul_ps(c[b], cb)), _mm_mul_ps(c[3], ca));
+                    break;
+                case(REPLACE_ALPHA_WITH_LUMINANCE):
+                    c[3] = multiplyByThird(_mm_add_ps(_mm_add_ps(c[r], c[1]), c[b]));
+                    break;
+            }
+
+            for(unsigned int k=0; k<4; ++k) c[k] = _mm_mul_ps(c[k], its);
+            _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+            for(unsigned int p=0; p<4; ++p) SSE2::store(ptr+p*4, c[p]);
+        }
+    }
+
+    for(; i<num; ++i)
+    {
+        T* ptr = data + i*4;
+        float c[4];
+        for(unsigned int k=0; k<4; ++k) c[k] = float(ptr[k])*typeScale;
+
+        switch(operation)
+        {
+            case(MODULATE_ALPHA_BY_LUMINANCE): { float l = (c[r]+c[1]+c[b])*0.3333333; c[3] *= l; break; }
+            case(MODULATE_ALPHA_BY_COLOR): c[3] = (c[r]*colour[0]+c[1]*colour[1]+c[b]*colour[2]+c[3]*colour[3]); break;
+            case(REPLACE_ALPHA_WITH_LUMINANCE): { float l = (c[r]+c[1]+c[b])*0.3333333; c[3] = l; break; }
+        }
+
+        for(unsigned int k=0; k<4; ++k) ptr[k] = T(c[k]*invTypeScale);
+    }
+}
+
+void colorSpaceRowSSE2(unsigned char* data, GLenum dataType, unsigned int num, bool bgra, int operation, const float* colour)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):     colorSpaceRowSSE2(data, num, bgra, operation, colour, 1.0f/255.0f); break;
+        case(GL_UNSIGNED_SHORT):    colorSpaceRowSSE2((unsigned short*)data, num, bgra, operation, colour, 1.0f/65535.0f); break;
+        case(GL_FLOAT):             colorSpaceRowSSE2((float*)data, num, bgra, operation, colour, 1.0f); break;
+    }
+}
+
+const ImageKernelFunctions s_sse2ImageKernelFunctions =
+{
+    convertRow<SSE2>,
+    minMaxRow<SSE2>,
+    offsetAndScaleRow<SSE2>,
+    colorSpaceRowSSE2,
+    halveRowSSE2,
+    scaleRowSSE2
+};
+
+#if defined(_MSC_VER)
+bool cpuSupportsAVX2()
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0]<7) return false;
+
+    // AVX2 needs the operating system to save the upper halves of the ymm registers.
+    __cpuid(info, 1);
+    if ((info[2] & (1<<27))==0 || (info[2] & (1<<28))==0) return false;
+    if ((_xgetbv(0) & 6)!=6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1<<5))!=0;
+}
+#else
+bool cpuSupportsAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2")!=0;
+}
+#endif
+
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Instruction set selection and threading
+
+namespace
+{
+
+ImageKernelInstructionSet computeSupportedInstructionSet()
+{
+#if defined(OSG_IMAGE_KERNELS_USE_SSE2)
+    if (getAVX2ImageKernelFunctions() && cpuSupportsAVX2()) return IMAGE_KERNELS_AVX2;
+    return IMAGE_KERNELS_SSE2;
+#else
+    return IMAGE_KERNELS_GENERIC;
+#endif
+}
+
+struct ImageKernelSettings
+{
+    ImageKernelSettings():
+        _supportedInstructionSet(computeSupportedInstructionSet()),
+        _instructionSet(_supportedInstructionSet),
+        _numThreads(1)
+    {
+#if defined(OSG_IMAGE_KERNELS_USE_SSE2)
+        _sse2Functions = s_sse2ImageKernelFunctions;
+
+        // the kernels without an AVX2 version fall back to SSE2.
+        _avx2Functions = s_sse2ImageKernelFunctions;
+        if (const ImageKernelFunctions* avx2 = getAVX2ImageKernelFunctions())
+        {
+            if (avx2->convertRow) _avx2Functions.convertRow = avx2->convertRow;
+            if (avx2->minMaxRow) _avx2Functions.minMaxRow = avx2->minMaxRow;
+            if (avx2->offsetAndScaleRow) _avx2Functions.offsetAndScaleRow = avx2->offsetAndScaleRow;
+            if (avx2->colorSpaceRow) _avx2Functions.colorSpaceRow = avx2->colorSpaceRow;
+            if (avx2->halveRow) _avx2Functions.halveRow = avx2->halveRow;
+            if (avx2->scaleRow) _avx2Functions.scaleRow = avx2->scaleRow;
+        }
+#endif
+
+        const char* str = getenv("OSG_IMAGE_KERNELS");
+        if (str)
+        {
+            if (strcmp(str,"GENERIC")==0) setInstructionSet(IMAGE_KERNELS_GENERIC);
+            else if (strcmp(str,"SSE2")==0) setInstructionSet(IMAGE_KERNELS_SSE2);
+            else if (strcmp(str,"AVX2")==0) setInstructionSet(IMAGE_KERNELS_AVX2);
+            else OSG_NOTICE<<"Warning: OSG_IMAGE_KERNELS set to unrecognized value "<<str<<", expected GENERIC, SSE2 or AVX2."<<std::endl;
+        }
+
+        str = getenv("OSG_IMAGE_KERNEL_THREADS");
+        if (str) _numThreads = static_cast<unsigned int>(atoi(str));
+    }
+
+    void setInstructionSet(ImageKernelInstructionSet instructionSet)
+    {
+        _instructionSet = instructionSet<_supportedInstructionSet ? instructionSet : _supportedInstructionSet;
+    }
+
+    const ImageKernelFunctions* getFunctions() const
+    {
+        switch(_instructionSet)
+        {
+            case(IMAGE_KERNELS_SSE2): return &_sse2Functions;
+            case(IMAGE_KERNELS_AVX2): return &_avx2Functions;
+            default: return 0;
+        }
+    }
+
+    ImageKernelInstructionSet   _supportedInstructionSet;
+    ImageKernelInstructionSet   _instructionSet;
+    unsigned int                _numThreads;
+    ImageKernelFunctions        _sse2Functions;
+    ImageKernelFunctions        _avx2Functions;
+};
+
+ImageKernelSettings s_imageKernelSettings;
+
+// images with fewer elements than this are quicker to process on a single thread.
+const unsigned int s_minimumNumElementsToSplit = 1024*1024;
+
+// each thread takes blocks of rows in turn, there are a few blocks per thread to even out the load.
+const unsigned int s_numRowBlocksPerThread = 4;
+
+// The rows of one call to runImageKernelRows(), split into blocks taken in turn by the calling thread and any pool
+// threads free to help. The calling thread waits for all the blocks to complete, but the pool threads may still hold
+// the job once their last block is done, so it is reference counted.
+class RowBlockJob : public osg::Referenced
+{
+public:
+
+    RowBlockJob(ImageRowOperation& operation, unsigned int numBlocks, unsigned int numRows):
+        _operation(operation),
+        _numBlocks(numBlocks),
+        _numRows(numRows),
+        _numBlocksRemaining(numBlocks) {}
+
+    // run blocks until there are none left to take.
+    void runBlocks()
+    {
+        for(unsigned int block = (++_nextBlock)-1; block<_numBlocks; block = (++_nextBlock)-1)
+        {
+            _operation((block*_numRows)/_numBlocks, ((block+1)*_numRows)/_numBlocks);
+
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            if (--_numBlocksRemaining==0) _condition.broadcast();
+        }
+    }
+
+    void waitForBlocks()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        while(_numBlocksRemaining>0) _condition.wait(&_mutex);
+    }
+
+protected:
+
+    virtual ~RowBlockJob() {}
+
+    RowBlockJob& operator = (const RowBlockJob&) { return *this; }
+
+    ImageRowOperation&      _operation;
+    unsigned int            _numBlocks;
+    unsigned int            _numRows;
+    OpenThreads::Atomic     _nextBlock;
+
+    OpenThreads::Mutex      _mutex;
+    OpenThreads::Condition  _condition;
+    unsigned int            _numBlocksRemaining;
+};
+
+class RowBlockThreadPool;
+
+class RowBlockThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    RowBlockThread(RowBlockThreadPool& pool): _pool(pool) {}
+
+    virtual void run();
+
+protected:
+
+    virtual ~RowBlockThread() {}
+
+    RowBlockThread& operator = (const RowBlockThread&) { return *this; }
+
+    RowBlockThreadPool&     _pool;
+};
+
+// Threads kept for the life of the application rather than started and joined on each call, as images are split between
+// threads by the DatabasePager's threads while preparing textures as well as by the application. The threads are started
+// as they are first needed, and take jobs from a queue shared by all the threads calling runImageKernelRows().
+class RowBlockThreadPool
+{
+public:
+
+    RowBlockThreadPool(): _done(false) {}
+
+    ~RowBlockThreadPool()
+    {
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            _done = true;
+            _condition.broadcast();
+        }
+
+        for(Threads::iterator itr = _threads.begin();
+            itr != _threads.end();
+            ++itr)
+        {
+            (*itr)->join();
+        }
+    }
+
+    void run(ImageRowOperation& operation, unsigned int numBlocks, unsigned int numRows, unsigned int numThreads)
+    {
+        osg::ref_ptr<RowBlockJob> job = new RowBlockJob(operation, numBlocks, numRows);
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+            // the calling thread takes blocks as well, so one less thread is needed from the pool.
+            while(_threads.size()+1<numThreads)
+            {
+                osg::ref_ptr<RowBlockThread> thread = new RowBlockThread(*this);
+                if (thread->startThread()!=0) break;
+                _threads.push_back(thread);
+            }
+
+            _jobs.push_back(job);
+            _condition.broadcast();
+        }
+
+        job->runBlocks();
+        removeJob(job.get());
+
+        // blocks taken by the pool threads may still be running.
+        job->waitForBlocks();
+    }
+
+    // called by the pool threads, returning the next job with blocks to take, or 0 once the pool is being destroyed.
+    osg::ref_ptr<RowBlockJob> takeJob()
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        while(!_done && _jobs.empty()) _condition.wait(&_mutex);
+        if (_done) return 0;
+        return _jobs.front();
+    }
+
+    // called once all the blocks of the job have been taken.
+    void removeJob(RowBlockJob* job)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        Jobs::iterator itr = std::find(_jobs.begin(), _jobs.end(), job);
+        if (itr!=_jobs.end()) _jobs.erase(itr);
+    }
+
+protected:
+
+    typedef std::vector< osg::ref_ptr<RowBlockThread> > Threads;
+    typedef std::deque< osg::ref_ptr<RowBlockJob> > Jobs;
+
+    OpenThreads::Mutex      _mutex;
+    OpenThreads::Condition  _condition;
+    bool                    _done;
+    Threads                 _threads;
+    Jobs                    _jobs;
+};
+
+void RowBlockThread::run()
+{
+    for(osg::ref_ptr<RowBlockJob> job = _pool.takeJob(); job.valid(); job = _pool.takeJob())
+    {
+        job->runBlocks();
+        _pool.removeJob(job.get());
+    }
+}
+
+RowBlockThreadPool s_rowBlockThreadPool;
+
+}
+
+void osg::setImageKernelInstructionSet(ImageKernelInstructionSet instructionSet)
+{
+    s_imageKernelSettings.setInstructionSet(instructionSet);
+}
+
+ImageKernelInstructionSet osg::getImageKernelInstructionSet()
+{
+    return s_imageKernelSettings._instructionSet;
+}
+
+void osg::setImageKernelNumThreads(unsigned int numThreads)
+{
+    s_imageKernelSettings._numThreads = numThreads;
+}
+
+unsigned int osg::getImageKernelNumThreads()
+{
+    return s_imageKernelSettings._numThreads;
+}
+
+const ImageKernelFunctions* osg::getImageKernelFunctions()
+{
+    return s_imageKernelSettings.getFunctions();
+}
+
+void osg::runImageKernelRows(ImageRowOperation& operation, unsigned int numRows, unsigned int numElementsPerRow)
+{
+    unsigned int numThreads = s_imageKernelSettings._numThreads;
+    if (numThreads==0)
+    {
+        int numProcessors = OpenThreads::GetNumberOfProcessors();
+        numThreads = numProcessors>1 ? static_cast<unsigned int>(numProcessors) : 1;
+    }
+
+    if (numThreads<=1 || numRows<2 || static_cast<double>(numRows)*numElementsPerRow<s_minimumNumElementsToSplit)
+    {
+        operation(0, numRows);
+        return;
+    }
+
+    unsigned int numBlocks = numThreads*s_numRowBlocksPerThread;
+    if (numBlocks>numRows) numBlocks = numRows;
+
+    s_rowBlockThreadPool.run(operation, numBlocks, numRows, numThreads);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// ImageScaleTaps, the arithmetic matches scale_internal() in mipmap.cpp step for step
+
+void ImageScaleTaps::compute(int sizein, int sizeout)
+{
+    _offsets.resize(sizeout+1);
+    _indices.clear();
+    _percents.clear();
+
+    float conv = (float) sizein/sizeout;
+    float halfconv = conv/2;
+    for(int i=0; i<sizeout; ++i)
+    {
+        _offsets[i] = static_cast<unsigned int>(_indices.size());
+
+        float low, high;
+        float x = conv * (i+0.5);
+        if (sizein > sizeout)
+        {
+            high = x + halfconv;
+            low = x - halfconv;
+        }
+        else
+        {
+            high = x + 0.5;
+            low = x - 0.5;
+        }
+
+        x = low;
+        int xint = int(floor(x));
+        while (x < high)
+        {
+            _indices.push_back((xint + sizein) % sizein);
+            if (high < xint+1)
+            {
+                _percents.push_back(high - x);
+            }
+            else
+            {
+                _percents.push_back(xint+1 - x);
+            }
+
+            xint++;
+            x = xint;
+        }
+    }
+    _offsets[sizeout] = static_cast<unsigned int>(_indices.size());
+}
+
+void ImageScaleTaps::computeGroups(unsigned int numLanes)
+{
+    const unsigned int sizeout = static_cast<unsigned int>(_offsets.size())-1;
+    const unsigned int numGroups = (sizeout+numLanes-1)/numLanes;
+
+    _groupOffsets.resize(numGroups+1);
+    _groupIndices.clear();
+    _groupPercents.clear();
+
+    unsigned int numGroupTaps = 0;
+    for(unsigned int g=0; g<numGroups; ++g)
+    {
+        _groupOffsets[g] = numGroupTaps;
+
+        unsigned int maxNumTaps = 0;
+        for(unsigned int l=0; l<numLanes && g*numLanes+l<sizeout; ++l)
+        {
+            unsigned int numTaps = _offsets[g*numLanes+l+1]-_offsets[g*numLanes+l];
+            if (numTaps>maxNumTaps) maxNumTaps = numTaps;
+        }
+
+        for(unsigned int t=0; t<maxNumTaps; ++t)
+        {
+            for(unsigned int l=0; l<numLanes; ++l)
+            {
+                unsigned int i = g*numLanes+l;
+                if (i<sizeout && _offsets[i]+t<_offsets[i+1])
+                {
+                    _groupIndices.push_back(_indices[_offsets[i]+t]);
+                    _groupPercents.push_back(_percents[_offsets[i]+t]);
+                }
+                else
+                {
+                    _groupIndices.push_back(0);
+                    _groupPercents.push_back(0.0f);
+                }
+            }
+        }
+        numGroupTaps += maxNumTaps;
+    }
+    _groupOffsets[numGroups] = numGroupTaps;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// gluScaleImage, done in the same three passes as the original: the input is converted to GLushort,
+// box filtered and converted to the output type. Each pass is split between threads by rows.
+
+namespace
+{
+
+unsigned int computeElementSize(GLenum type)
+{
+    switch(type)
+    {
+        case(GL_UNSIGNED_BYTE):     return 1;
+        case(GL_UNSIGNED_SHORT):    return 2;
+        case(GL_FLOAT):             return 4;
+        default:                    return 0;
+    }
+}
+
+unsigned int computeRowSize(GLint rowLength, GLint alignment, GLsizei width, unsigned int groupSize)
+{
+    unsigned int rowSize = (rowLength>0 ? rowLength : width)*groupSize;
+    unsigned int padding = rowSize % alignment;
+    if (padding) rowSize += alignment - padding;
+    return rowSize;
+}
+
+struct FillRowsOperation : public ImageRowOperation
+{
+    FillRowsOperation(const ImageKernelFunctions& kernels, GLenum type, const unsigned char* start, unsigned int rowSize, unsigned int numElements, GLushort* image):
+        _kernels(kernels), _type(type), _start(start), _rowSize(rowSize), _numElements(numElements), _image(image) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        for(unsigned int i=beginRow; i<endRow; ++i)
+        {
+            const unsigned char* src = _start + i*_rowSize;
+            unsigned char* dest = reinterpret_cast<unsigned char*>(_image + i*_numElements);
+            switch(_type)
+            {
+                case(GL_UNSIGNED_BYTE):     _kernels.convertRow(src, _type, dest, GL_UNSIGNED_SHORT, _numElements, 257.0f, false); break;
+                case(GL_UNSIGNED_SHORT):    memcpy(dest, src, _numElements*sizeof(GLushort)); break;
+                case(GL_FLOAT):             _kernels.convertRow(src, _type, dest, GL_UNSIGNED_SHORT, _numElements, 65535.0f, false); break;
+            }
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    GLenum                      _type;
+    const unsigned char*        _start;
+    unsigned int                _rowSize;
+    unsigned int                _numElements;
+    GLushort*                   _image;
+};
+
+struct EmptyRowsOperation : public ImageRowOperation
+{
+    EmptyRowsOperation(const ImageKernelFunctions& kernels, GLenum type, const GLushort* image, unsigned int numElements, unsigned char* start, unsigned int rowSize):
+        _kernels(kernels), _type(type), _image(image), _numElements(numElements), _start(start), _rowSize(rowSize) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        for(unsigned int i=beginRow; i<endRow; ++i)
+        {
+            const unsigned char* src = reinterpret_cast<const unsigned char*>(_image + i*_numElements);
+            unsigned char* dest = _start + i*_rowSize;
+            switch(_type)
+            {
+                case(GL_UNSIGNED_BYTE):     _kernels.convertRow(src, GL_UNSIGNED_SHORT, dest, _type, _numElements, 1.0f/256.0f, false); break;
+                case(GL_UNSIGNED_SHORT):    memcpy(dest, src, _numElements*sizeof(GLushort)); break;
+                case(GL_FLOAT):             _kernels.convertRow(src, GL_UNSIGNED_SHORT, dest, _type, _numElements, 65535.0f, true); break;
+            }
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    GLenum                      _type;
+    const GLushort*             _image;
+    unsigned int                _numElements;
+    unsigned char*              _start;
+    unsigned int                _rowSize;
+};
+
+struct HalveRowsOperation : public ImageRowOperation
+{
+    HalveRowsOperation(const ImageKernelFunctions& kernels, unsigned int numComponents, unsigned int widthin, const GLushort* datain, GLushort* dataout):
+        _kernels(kernels), _numComponents(numComponents), _widthin(widthin), _datain(datain), _dataout(dataout) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        const unsigned int numIn = _widthin*_numComponents;
+        const unsigned int numOut = (_widthin/2)*_numComponents;
+        for(unsigned int i=beginRow; i<endRow; ++i)
+        {
+            _kernels.halveRow(_numComponents, _widthin/2, _datain + (i*2)*numIn, _datain + (i*2+1)*numIn, _dataout + i*numOut);
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    unsigned int                _numComponents;
+    unsigned int                _widthin;
+    const GLushort*             _datain;
+    GLushort*                   _dataout;
+};
+
+struct ScaleRowsOperation : public ImageRowOperation
+{
+    ScaleRowsOperation(const ImageKernelFunctions& kernels, unsigned int numComponents, const ImageScaleTaps& xTaps, const ImageScaleTaps& yTaps,
+                       const GLushort* datain, unsigned int widthin, GLushort* dataout):
+        _kernels(kernels), _numComponents(numComponents), _xTaps(xTaps), _yTaps(yTaps), _datain(datain), _widthin(widthin), _dataout(dataout) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        for(unsigned int i=beginRow; i<endRow; ++i)
+        {
+            _kernels.scaleRow(_numComponents, _xTaps, _yTaps, i, _datain, _widthin, _dataout);
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    unsigned int                _numComponents;
+    const ImageScaleTaps&       _xTaps;
+    const ImageScaleTaps&       _yTaps;
+    const GLushort*             _datain;
+    unsigned int                _widthin;
+    GLushort*                   _dataout;
+};
+
+}
+
+bool osg::scaleImageWithKernels(const PixelStorageModes* psm, GLenum format, GLsizei widthin, GLsizei heightin,
+                                GLenum typein, const void* datain,
+                                GLsizei widthout, GLsizei heightout, GLenum typeout,
+                                void* dataout)
+{
+    const ImageKernelFunctions* kernels = getImageKernelFunctions();
+    if (!kernels) return false;
+
+    // the index formats aren't filtered so are left to the original code.
+    unsigned int numComponents = 0;
+    switch(format)
+    {
+        case(GL_RED):
+        case(GL_GREEN):
+        case(GL_BLUE):
+        case(GL_ALPHA):
+        case(GL_LUMINANCE):
+        case(GL_DEPTH_COMPONENT):   numComponents = 1; break;
+        case(GL_LUMINANCE_ALPHA):   numComponents = 2; break;
+        case(GL_RGB):
+        case(GL_BGR):               numComponents = 3; break;
+        case(GL_RGBA):
+        case(GL_BGRA):              numComponents = 4; break;
+        default:                    return false;
+    }
+
+    unsigned int elementSizeIn = computeElementSize(typein);
+    unsigned int elementSizeOut = computeElementSize(typeout);
+    if (elementSizeIn==0 || elementSizeOut==0) return false;
+    if ((psm->unpack_swap_bytes && elementSizeIn>1) || (psm->pack_swap_bytes && elementSizeOut>1)) return false;
+
+    const unsigned int numIn = widthin*numComponents;
+    const unsigned int numOut = widthout*numComponents;
+
+    // an extra pixel at the end lets the kernels read a whole vector from the last pixel.
+    GLushort* beforeImage = (GLushort*) malloc((numIn*heightin + 4)*sizeof(GLushort));
+    GLushort* afterImage = (GLushort*) malloc(numOut*heightout*sizeof(GLushort));
+    if (beforeImage == NULL || afterImage == NULL)
+    {
+        free(beforeImage);
+        free(afterImage);
+        return false;
+    }
+    memset(beforeImage + numIn*heightin, 0, 4*sizeof(GLushort));
+
+    unsigned int rowSizeIn = computeRowSize(psm->unpack_row_length, psm->unpack_alignment, widthin, elementSizeIn*numComponents);
+    const unsigned char* startIn = static_cast<const unsigned char*>(datain) + psm->unpack_skip_rows*rowSizeIn + psm->unpack_skip_pixels*elementSizeIn*numComponents;
+    FillRowsOperation fill(*kernels, typein, startIn, rowSizeIn, numIn, beforeImage);
+    runImageKernelRows(fill, heightin, numIn);
+
+    if (widthin == widthout*2 && heightin == heightout*2)
+    {
+        HalveRowsOperation halve(*kernels, numComponents, widthin, beforeImage, afterImage);
+        runImageKernelRows(halve, heightout, numIn*2);
+    }
+    else
+    {
+        ImageScaleTaps xTaps, yTaps;
+        xTaps.compute(widthin, widthout);
+        yTaps.compute(heightin, heightout);
+        if (numComponents<3) xTaps.computeGroups(4);
+
+        ScaleRowsOperation scale(*kernels, numComponents, xTaps, yTaps, beforeImage, widthin, afterImage);
+        unsigned int numElementsPerRow = (numIn*heightin)/heightout;
+        runImageKernelRows(scale, heightout, numElementsPerRow>numOut ? numElementsPerRow : numOut);
+    }
+
+    unsigned int rowSizeOut = computeRowSize(psm->pack_row_length, psm->pack_alignment, widthout, elementSizeOut*numComponents);
+    unsigned char* startOut = static_cast<unsigned char*>(dataout) + psm->pack_skip_rows*rowSizeOut + psm->pack_skip_pixels*elementSizeOut*numComponents;
+    EmptyRowsOperation empty(*kernels, typeout, afterImage, numOut, startOut, rowSizeOut);
+    runImageKernelRows(empty, heightout, numOut);
+
+    free(beforeImage);
+    free(afterImage);
+
+    return true;
+}
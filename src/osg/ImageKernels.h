@@ -0,0 +1,101 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSG_IMAGEKERNELS_H
+#define OSG_IMAGEKERNELS_H 1
+
+#include <osg/GL>
+
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define OSG_IMAGE_KERNELS_USE_SSE2
+#endif
+
+namespace osg
+{
+
+struct PixelStorageModes;
+
+/** Box filter taps along one axis of a gluScaleImage, output pixel i is made from the input pixels
+  * _indices[_offsets[i]] to _indices[_offsets[i+1]-1] weighted by the matching _percents.*/
+struct ImageScaleTaps
+{
+    void compute(int sizein, int sizeout);
+
+    /** Regroup the taps of groups of numLanes output pixels so that a group can be filtered together, the taps
+      * of the pixels with fewer taps than others in their group are padded out with zero weights.*/
+    void computeGroups(unsigned int numLanes);
+
+    std::vector<unsigned int>   _offsets;
+    std::vector<int>            _indices;
+    std::vector<float>          _percents;
+
+    std::vector<unsigned int>   _groupOffsets;
+    std::vector<int>            _groupIndices;
+    std::vector<float>          _groupPercents;
+};
+
+/** Row kernels for one instruction set. The data types supported are GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT
+  * and GL_FLOAT, and each kernel gives bit for bit the same results as the per pixel code it stands in for.*/
+struct ImageKernelFunctions
+{
+    /** Convert num elements as DEST(float(src)*scale), or as DEST(float(src)/scale) if divide is true.*/
+    void (*convertRow)(const unsigned char* src, GLenum srcDataType, unsigned char* dest, GLenum destDataType, unsigned int num, float scale, bool divide);
+
+    /** Fold float(value) of each component of num pixels into minValues and maxValues, as FindRangeOperator does.*/
+    void (*minMaxRow)(const unsigned char* data, GLenum dataType, unsigned int num, unsigned int numComponents, float* minValues, float* maxValues);
+
+    /** Set each component c of num pixels to T((offsets[c] + (float(value)*typeScale)*scales[c])*(1.0f/typeScale)), as
+      * modifyRow() with OffsetAndScaleOperator does.*/
+    void (*offsetAndScaleRow)(unsigned char* data, GLenum dataType, unsigned int num, unsigned int numComponents, const float* offsets, const float* scales, float typeScale);
+
+    /** Apply a ColorSpaceOperation to num RGBA pixels, BGRA if bgra is true, as colorSpaceConversion() does.*/
+    void (*colorSpaceRow)(unsigned char* data, GLenum dataType, unsigned int num, bool bgra, int operation, const float* colour);
+
+    /** Halve two rows of numComponents GLushort pixels into width pixels, as halveImage() in mipmap.cpp does.*/
+    void (*halveRow)(unsigned int numComponents, unsigned int width, const unsigned short* row0, const unsigned short* row1, unsigned short* dest);
+
+    /** Box filter output row of dataout from datain, as scale_internal() in mipmap.cpp does. datain must be followed by a
+      * pixel of padding as whole vectors are read from the last pixel.*/
+    void (*scaleRow)(unsigned int numComponents, const ImageScaleTaps& xTaps, const ImageScaleTaps& yTaps, unsigned int row,
+                     const unsigned short* datain, unsigned int widthin, unsigned short* dataout);
+};
+
+/** Return the kernels of the instruction set selected by setImageKernelInstructionSet(),
+  * or 0 if the original per pixel code is to be used.*/
+extern const ImageKernelFunctions* getImageKernelFunctions();
+
+/** Return the AVX2 kernels, 0 if they weren't compiled in. Kernels without an AVX2 version are left as 0.*/
+extern const ImageKernelFunctions* getAVX2ImageKernelFunctions();
+
+/** Operation on a range of rows run by runImageKernelRows().*/
+struct ImageRowOperation
+{
+    virtual ~ImageRowOperation() {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow) = 0;
+};
+
+/** Run operation over numRows rows, splitting them between the image kernel threads when there are enough elements to make it worthwhile.*/
+extern void runImageKernelRows(ImageRowOperation& operation, unsigned int numRows, unsigned int numElementsPerRow);
+
+/** gluScaleImage using the image kernels, returns false without touching dataout if the formats or pixel storage modes aren't supported.*/
+extern bool scaleImageWithKernels(const PixelStorageModes* psm, GLenum format, GLsizei widthin, GLsizei heightin,
+                                  GLenum typein, const void* datain,
+                                  GLsizei widthout, GLsizei heightout, GLenum typeout,
+                                  void* dataout);
+
+}
+
+#endif
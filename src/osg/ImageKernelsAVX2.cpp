@@ -0,0 +1,159 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+// This file is compiled with AVX2 code generation enabled, see src/osg/CMakeLists.txt, and its kernels
+// are only called once the CPU has been checked for AVX2 support. To keep code that could run on any CPU
+// out of it nothing here calls inline functions from other headers.
+
+#include "ImageKernels.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+#include <string.h>
+
+#include "ImageKernelTemplates.h"
+
+namespace
+{
+
+struct AVX2
+{
+    enum { NUM_LANES = 8 };
+
+    typedef __m256 Float;
+
+    static Float set1(float value) { return _mm256_set1_ps(value); }
+
+    static Float load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+    static Float load(const unsigned char* ptr) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)ptr))); }
+    static Float load(const unsigned short* ptr) { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)ptr))); }
+
+    static void store(float* ptr, Float value) { _mm256_storeu_ps(ptr, value); }
+
+    static void store(unsigned char* ptr, Float value)
+    {
+        __m256i integers = _mm256_and_si256(_mm256_cvttps_epi32(value), _mm256_set1_epi32(0xff));
+        __m128i shorts = _mm_packs_epi32(_mm256_castsi256_si128(integers), _mm256_extracti128_si256(integers, 1));
+        _mm_storel_epi64((__m128i*)ptr, _mm_packus_epi16(shorts, shorts));
+    }
+
+    static void store(unsigned short* ptr, Float value)
+    {
+        // sign extend the low 16 bits so the saturating pack leaves them untouched.
+        __m256i integers = _mm256_srai_epi32(_mm256_slli_epi32(_mm256_cvttps_epi32(value), 16), 16);
+        _mm_storeu_si128((__m128i*)ptr, _mm_packs_epi32(_mm256_castsi256_si128(integers), _mm256_extracti128_si256(integers, 1)));
+    }
+
+    static Float add(Float lhs, Float rhs) { return _mm256_add_ps(lhs, rhs); }
+    static Float mul(Float lhs, Float rhs) { return _mm256_mul_ps(lhs, rhs); }
+    static Float div(Float lhs, Float rhs) { return _mm256_div_ps(lhs, rhs); }
+
+    // value<current ? value : current, as osg::minimum(value, current)
+    static Float minimum(Float value, Float current) { return _mm256_min_ps(value, current); }
+    static Float maximum(Float value, Float current) { return _mm256_max_ps(value, current); }
+};
+
+// pack two vectors of 32 bit values in the range 0 to 65535 into unsigned shorts, in order.
+inline __m256i packUnsignedShorts(__m256i lhs, __m256i rhs)
+{
+    const __m256i bias = _mm256_set1_epi32(32768);
+    __m256i packed = _mm256_packs_epi32(_mm256_sub_epi32(lhs, bias), _mm256_sub_epi32(rhs, bias));
+
+    // the pack works within each 128 bit lane, so swap the middle two quarters back into order.
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    return _mm256_xor_si256(packed, _mm256_set1_epi16(short(0x8000)));
+}
+
+void halveRowAVX2(unsigned int numComponents, unsigned int width, const unsigned short* row0, const unsigned short* row1, unsigned short* dest)
+{
+    const unsigned int num = width*numComponents;
+    const __m256i zero = _mm256_setzero_si256();
+
+    unsigned int i = 0;
+    if (numComponents==4)
+    {
+        // each 128 bit lane holds two pixels that make one output pixel, eight output pixels are done at a time.
+        const __m256i rounding = _mm256_set1_epi32(2);
+        for(; i+16<=num; i+=16)
+        {
+            __m256i a0 = _mm256_loadu_si256((const __m256i*)(row0+i*2));
+            __m256i a1 = _mm256_loadu_si256((const __m256i*)(row0+i*2+16));
+            __m256i b0 = _mm256_loadu_si256((const __m256i*)(row1+i*2));
+            __m256i b1 = _mm256_loadu_si256((const __m256i*)(row1+i*2+16));
+
+            __m256i first = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(a0, zero), _mm256_unpackhi_epi16(a0, zero)),
+                                             _mm256_add_epi32(_mm256_unpacklo_epi16(b0, zero), _mm256_unpackhi_epi16(b0, zero)));
+            __m256i second = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(a1, zero), _mm256_unpackhi_epi16(a1, zero)),
+                                              _mm256_add_epi32(_mm256_unpacklo_epi16(b1, zero), _mm256_unpackhi_epi16(b1, zero)));
+
+            first = _mm256_srli_epi32(_mm256_add_epi32(first, rounding), 2);
+            second = _mm256_srli_epi32(_mm256_add_epi32(second, rounding), 2);
+            _mm256_storeu_si256((__m256i*)(dest+i), packUnsignedShorts(first, second));
+        }
+    }
+    else if (numComponents==1)
+    {
+        // pairs of neighbouring values are summed with a multiply add, which is signed so the values are first biased by -32768.
+        const __m256i sign = _mm256_set1_epi16(short(0x8000));
+        const __m256i ones = _mm256_set1_epi16(1);
+        const __m256i rounding = _mm256_set1_epi32(4*32768+2);
+        for(; i+16<=num; i+=16)
+        {
+            __m256i a0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(row0+i*2)), sign);
+            __m256i a1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(row0+i*2+16)), sign);
+            __m256i b0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(row1+i*2)), sign);
+            __m256i b1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(row1+i*2+16)), sign);
+
+            __m256i first = _mm256_add_epi32(_mm256_madd_epi16(a0, ones), _mm256_madd_epi16(b0, ones));
+            __m256i second = _mm256_add_epi32(_mm256_madd_epi16(a1, ones), _mm256_madd_epi16(b1, ones));
+
+            first = _mm256_srli_epi32(_mm256_add_epi32(first, rounding), 2);
+            second = _mm256_srli_epi32(_mm256_add_epi32(second, rounding), 2);
+            _mm256_storeu_si256((__m256i*)(dest+i), packUnsignedShorts(first, second));
+        }
+    }
+
+    for(; i<num; ++i)
+    {
+        const unsigned int t = (i/numComponents)*numComponents*2 + i%numComponents;
+        dest[i] = (row0[t] + row0[t+numComponents] + row1[t] + row1[t+numComponents] + 2) / 4;
+    }
+}
+
+// colorSpaceRow and scaleRow gain little from the wider vectors, so use the SSE2 versions.
+const osg::ImageKernelFunctions s_avx2ImageKernelFunctions =
+{
+    convertRow<AVX2>,
+    minMaxRow<AVX2>,
+    offsetAndScaleRow<AVX2>,
+    0,
+    halveRowAVX2,
+    0
+};
+
+}
+
+const osg::ImageKernelFunctions* osg::getAVX2ImageKernelFunctions()
+{
+    return &s_avx2ImageKernelFunctions;
+}
+
+#else
+
+const osg::ImageKernelFunctions* osg::getAVX2ImageKernelFunctions()
+{
+    return 0;
+}
+
+#endif
@@ -19,6 +19,13 @@
 #include <osg/ImageUtils>
 #include <osg/Texture>
 
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include <limits>
+
+#include "ImageKernels.h"
+
 namespace osg
 {
 
@@ -87,12 +94,117 @@ struct OffsetAndScaleOperator
     }
 };
 
+// Rows are numbered through all the slices of an image.
+inline unsigned char* _imageRow(osg::Image* image, unsigned int row) { return image->data(0, row % image->t(), row / image->t()); }
+inline const unsigned char* _imageRow(const osg::Image* image, unsigned int row) { return image->data(0, row % image->t(), row / image->t()); }
+
+inline bool _isKernelDataType(GLenum dataType)
+{
+    return dataType==GL_UNSIGNED_BYTE || dataType==GL_UNSIGNED_SHORT || dataType==GL_FLOAT;
+}
+
+struct MinMaxRowsOperation : public ImageRowOperation
+{
+    MinMaxRowsOperation(const ImageKernelFunctions& kernels, const osg::Image* image, unsigned int numComponents):
+        _kernels(kernels),
+        _image(image),
+        _numComponents(numComponents)
+    {
+        for(unsigned int c=0; c<4; ++c)
+        {
+            _minValues[c] = FLT_MAX;
+            _maxValues[c] = -FLT_MAX;
+        }
+    }
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        float minValues[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+        float maxValues[4] = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for(unsigned int row=beginRow; row<endRow; ++row)
+        {
+            _kernels.minMaxRow(_imageRow(_image, row), _image->getDataType(), _image->s(), _numComponents, minValues, maxValues);
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+        for(unsigned int c=0; c<_numComponents; ++c)
+        {
+            if (minValues[c]<_minValues[c]) _minValues[c] = minValues[c];
+            if (maxValues[c]>_maxValues[c]) _maxValues[c] = maxValues[c];
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    const osg::Image*           _image;
+    unsigned int                _numComponents;
+    OpenThreads::Mutex          _mutex;
+    float                       _minValues[4];
+    float                       _maxValues[4];
+};
+
+// Pass the smallest and largest value of each component to operation as a row of two pixels, which for
+// FindRangeOperator has the same result as passing it every pixel in the image.
+template<typename T, class O>
+void _readMinMaxRow(GLenum pixelFormat, unsigned int numComponents, const float* minValues, const float* maxValues, O& operation)
+{
+    T row[8];
+    for(unsigned int c=0; c<numComponents; ++c)
+    {
+        if (minValues[c]<=maxValues[c])
+        {
+            row[c] = T(minValues[c]);
+            row[numComponents+c] = T(maxValues[c]);
+        }
+        else
+        {
+            // only a component of a float image made up entirely of NaN has no range, NaN is ignored by the operator.
+            row[c] = row[numComponents+c] = T(std::numeric_limits<float>::quiet_NaN());
+        }
+    }
+    _readRow(2, pixelFormat, row, operation);
+}
+
+bool _readImageWithKernels(const osg::Image* image, FindRangeOperator& rangeOp)
+{
+    const ImageKernelFunctions* kernels = getImageKernelFunctions();
+    if (!kernels || !_isKernelDataType(image->getDataType())) return false;
+
+    switch(image->getPixelFormat())
+    {
+        case(GL_INTENSITY):
+        case(GL_LUMINANCE):
+        case(GL_ALPHA):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_RGB):
+        case(GL_RGBA):
+        case(GL_BGR):
+        case(GL_BGRA):
+            break;
+        default:
+            return false;
+    }
+
+    if (image->s()<=0 || image->t()<=0 || image->r()<=0) return true;
+
+    unsigned int numComponents = osg::Image::computeNumComponents(image->getPixelFormat());
+    MinMaxRowsOperation operation(*kernels, image, numComponents);
+    runImageKernelRows(operation, image->t()*image->r(), image->s()*numComponents);
+
+    switch(image->getDataType())
+    {
+        case(GL_UNSIGNED_BYTE):     _readMinMaxRow<unsigned char>(image->getPixelFormat(), numComponents, operation._minValues, operation._maxValues, rangeOp); break;
+        case(GL_UNSIGNED_SHORT):    _readMinMaxRow<unsigned short>(image->getPixelFormat(), numComponents, operation._minValues, operation._maxValues, rangeOp); break;
+        case(GL_FLOAT):             _readMinMaxRow<float>(image->getPixelFormat(), numComponents, operation._minValues, operation._maxValues, rangeOp); break;
+    }
+    return true;
+}
+
 bool computeMinMax(const osg::Image* image, osg::Vec4& minValue, osg::Vec4& maxValue)
 {
     if (!image) return false;
 
     osg::FindRangeOperator rangeOp;
-    readImage(image, rangeOp);
+    if (!_readImageWithKernels(image, rangeOp)) readImage(image, rangeOp);
     minValue.r() = rangeOp._rmin;
     minValue.g() = rangeOp._gmin;
     minValue.b() = rangeOp._bmin;
@@ -109,11 +221,89 @@ bool computeMinMax(const osg::Image* image, osg::Vec4& minValue, osg::Vec4& maxV
            minValue.a()<=maxValue.a();
 }
 
+// Return the number of components of pixelFormat and the index into a Vec4 that _modifyRow() maps each one to,
+// 0 for the pixel formats _modifyRow() doesn't handle.
+unsigned int _getModifiedComponents(GLenum pixelFormat, unsigned int* components)
+{
+    switch(pixelFormat)
+    {
+        case(GL_LUMINANCE):         components[0] = 0; return 1;
+        case(GL_ALPHA):             components[0] = 3; return 1;
+        case(GL_LUMINANCE_ALPHA):   components[0] = 0; components[1] = 3; return 2;
+        case(GL_RGB):               components[0] = 0; components[1] = 1; components[2] = 2; return 3;
+        case(GL_RGBA):              components[0] = 0; components[1] = 1; components[2] = 2; components[3] = 3; return 4;
+        case(GL_BGR):               components[0] = 2; components[1] = 1; components[2] = 0; return 3;
+        case(GL_BGRA):              components[0] = 2; components[1] = 1; components[2] = 0; components[3] = 3; return 4;
+        default:                    return 0;
+    }
+}
+
+// The scale modifyRow() applies to each data type before passing the values to the operator.
+float _getModifyScale(GLenum dataType)
+{
+    switch(dataType)
+    {
+        case(GL_UNSIGNED_BYTE):     return 1.0f/255.0f;
+        case(GL_UNSIGNED_SHORT):    return 1.0f/65535.0f;
+        default:                    return 1.0f;
+    }
+}
+
+struct OffsetAndScaleRowsOperation : public ImageRowOperation
+{
+    OffsetAndScaleRowsOperation(const ImageKernelFunctions& kernels, osg::Image* image, unsigned int numComponents, const float* offsets, const float* scales):
+        _kernels(kernels),
+        _image(image),
+        _numComponents(numComponents),
+        _offsets(offsets),
+        _scales(scales) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        const float typeScale = _getModifyScale(_image->getDataType());
+        for(unsigned int row=beginRow; row<endRow; ++row)
+        {
+            _kernels.offsetAndScaleRow(_imageRow(_image, row), _image->getDataType(), _image->s(), _numComponents, _offsets, _scales, typeScale);
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    osg::Image*                 _image;
+    unsigned int                _numComponents;
+    const float*                _offsets;
+    const float*                _scales;
+};
+
+bool _offsetAndScaleImageWithKernels(osg::Image* image, const osg::Vec4& offset, const osg::Vec4& scale)
+{
+    const ImageKernelFunctions* kernels = getImageKernelFunctions();
+    if (!kernels || !_isKernelDataType(image->getDataType())) return false;
+
+    unsigned int components[4];
+    unsigned int numComponents = _getModifiedComponents(image->getPixelFormat(), components);
+    if (numComponents==0) return false;
+
+    float offsets[4];
+    float scales[4];
+    for(unsigned int c=0; c<numComponents; ++c)
+    {
+        offsets[c] = offset[components[c]];
+        scales[c] = scale[components[c]];
+    }
+
+    OffsetAndScaleRowsOperation operation(*kernels, image, numComponents, offsets, scales);
+    runImageKernelRows(operation, image->t()*image->r(), image->s()*numComponents);
+    return true;
+}
+
 bool offsetAndScaleImage(osg::Image* image, const osg::Vec4& offset, const osg::Vec4& scale)
 {
     if (!image) return false;
 
-    modifyImage(image,OffsetAndScaleOperator(offset, scale));
+    if (!_offsetAndScaleImageWithKernels(image, offset, scale))
+    {
+        modifyImage(image,OffsetAndScaleOperator(offset, scale));
+    }
 
     return true;
 }
@@ -197,6 +387,54 @@ struct WriteRowOperator
     inline void rgba(float& r,float& g,float& b,float& a) const {  r = _colours[_pos].r(); g = _colours[_pos].g(); b = _colours[_pos].b(); a = _colours[_pos++].a(); }
 };
 
+struct CopyRowsAndScaleOperation : public ImageRowOperation
+{
+    CopyRowsAndScaleOperation(const ImageKernelFunctions& kernels, const osg::Image* srcImage, int src_s, int src_t, int src_r,
+                              osg::Image* destImage, int dest_s, int dest_t, int dest_r, int width, int height, float scale):
+        _kernels(kernels),
+        _srcImage(srcImage), _src_s(src_s), _src_t(src_t), _src_r(src_r),
+        _destImage(destImage), _dest_s(dest_s), _dest_t(dest_t), _dest_r(dest_r),
+        _width(width), _height(height), _scale(scale) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        unsigned int numComponents = osg::Image::computeNumComponents(_destImage->getPixelFormat());
+        for(unsigned int i=beginRow; i<endRow; ++i)
+        {
+            int row = i % _height;
+            int slice = i / _height;
+            const unsigned char* srcData = _srcImage->data(_src_s, _src_t+row, _src_r+slice);
+            unsigned char* destData = _destImage->data(_dest_s, _dest_t+row, _dest_r+slice);
+            _kernels.convertRow(srcData, _srcImage->getDataType(), destData, _destImage->getDataType(), _width*numComponents, _scale, false);
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    const osg::Image*           _srcImage;
+    int                         _src_s, _src_t, _src_r;
+    osg::Image*                 _destImage;
+    int                         _dest_s, _dest_t, _dest_r;
+    int                         _width, _height;
+    float                       _scale;
+};
+
+struct CopyRowsConvertingPixelFormatOperation : public ImageRowOperation
+{
+    CopyRowsConvertingPixelFormatOperation(const osg::Image* srcImage, int src_s, int src_t, int src_r,
+                                           osg::Image* destImage, int dest_s, int dest_t, int dest_r, int width, int height):
+        _srcImage(srcImage), _src_s(src_s), _src_t(src_t), _src_r(src_r),
+        _destImage(destImage), _dest_s(dest_s), _dest_t(dest_t), _dest_r(dest_r),
+        _width(width), _height(height) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow);
+
+    const osg::Image*   _srcImage;
+    int                 _src_s, _src_t, _src_r;
+    osg::Image*         _destImage;
+    int                 _dest_s, _dest_t, _dest_r;
+    int                 _width, _height;
+};
+
 bool copyImage(const osg::Image* srcImage, int src_s, int src_t, int src_r, int width, int height, int depth,
                osg::Image* destImage, int dest_s, int dest_t, int dest_r, bool doRescale)
 {
@@ -271,6 +509,14 @@ bool copyImage(const osg::Image* srcImage, int src_s, int src_t, int src_r, int
         else
         {
             //OSG_NOTICE<<"   Compatible pixelFormat and incompatible dataType."<<std::endl;
+            const ImageKernelFunctions* kernels = getImageKernelFunctions();
+            if (kernels && _isKernelDataType(srcImage->getDataType()) && _isKernelDataType(destImage->getDataType()))
+            {
+                CopyRowsAndScaleOperation operation(*kernels, srcImage, src_s, src_t, src_r, destImage, dest_s, dest_t, dest_r, width, height, scale);
+                runImageKernelRows(operation, height*depth, width*osg::Image::computeNumComponents(destImage->getPixelFormat()));
+                return true;
+            }
+
             for(int slice = 0; slice<depth; ++slice)
             {
                 for(int row = 0; row<height; ++row)
@@ -291,6 +537,14 @@ bool copyImage(const osg::Image* srcImage, int src_s, int src_t, int src_r, int
         //OSG_NOTICE<<"copyImage("<<srcImage<<", "<<src_s<<", "<< src_t<<", "<<src_r<<", "<<width<<", "<<height<<", "<<depth<<std::endl;
         //OSG_NOTICE<<"          "<<destImage<<", "<<dest_s<<", "<< dest_t<<", "<<dest_r<<", "<<doRescale<<")"<<std::endl;
 
+        if (getImageKernelFunctions())
+        {
+            // the rows are independent so large images are split between the image kernel threads.
+            CopyRowsConvertingPixelFormatOperation operation(srcImage, src_s, src_t, src_r, destImage, dest_s, dest_t, dest_r, width, height);
+            runImageKernelRows(operation, height*depth, width*osg::Image::computeNumComponents(destImage->getPixelFormat()));
+            return true;
+        }
+
         RecordRowOperator readOp(width);
         WriteRowOperator writeOp;
 
@@ -321,6 +575,29 @@ bool copyImage(const osg::Image* srcImage, int src_s, int src_t, int src_r, int
 
 }
 
+void CopyRowsConvertingPixelFormatOperation::operator () (unsigned int beginRow, unsigned int endRow)
+{
+    RecordRowOperator readOp(_width);
+    WriteRowOperator writeOp;
+
+    for(unsigned int i=beginRow; i<endRow; ++i)
+    {
+        int row = i % _height;
+        int slice = i / _height;
+
+        readOp._pos = 0;
+        writeOp._pos = 0;
+
+        readRow(_width, _srcImage->getPixelFormat(), _srcImage->getDataType(), _srcImage->data(_src_s,_src_t+row,_src_r+slice), readOp);
+
+        writeOp._colours.swap(readOp._colours);
+
+        modifyRow(_width, _destImage->getPixelFormat(), _destImage->getDataType(), _destImage->data(_dest_s, _dest_t+row,_dest_r+slice), writeOp);
+
+        writeOp._colours.swap(readOp._colours);
+    }
+}
+
 
 struct SetToColourOperator
 {
@@ -641,6 +918,41 @@ struct ReplaceAlphaWithLuminanceOperator
     inline void rgba(float& r,float& g,float& b,float& a) const { float l = (r+g+b)*0.3333333; a = l; }
 };
 
+struct ColorSpaceRowsOperation : public ImageRowOperation
+{
+    ColorSpaceRowsOperation(const ImageKernelFunctions& kernels, osg::Image* image, ColorSpaceOperation op, const osg::Vec4& colour):
+        _kernels(kernels),
+        _image(image),
+        _op(op),
+        _colour(colour) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        bool bgra = _image->getPixelFormat()==GL_BGRA;
+        for(unsigned int row=beginRow; row<endRow; ++row)
+        {
+            _kernels.colorSpaceRow(_imageRow(_image, row), _image->getDataType(), _image->s(), bgra, _op, _colour.ptr());
+        }
+    }
+
+    const ImageKernelFunctions& _kernels;
+    osg::Image*                 _image;
+    ColorSpaceOperation         _op;
+    osg::Vec4                   _colour;
+};
+
+// The operators only change RGBA and BGRA images when applied by modifyImage(), so these are the formats the kernels handle.
+bool _colorSpaceConversionWithKernels(ColorSpaceOperation op, osg::Image* image, const osg::Vec4& colour)
+{
+    const ImageKernelFunctions* kernels = getImageKernelFunctions();
+    if (!kernels || !_isKernelDataType(image->getDataType())) return false;
+    if (image->getPixelFormat()!=GL_RGBA && image->getPixelFormat()!=GL_BGRA) return false;
+
+    ColorSpaceRowsOperation operation(*kernels, image, op, colour);
+    runImageKernelRows(operation, image->t()*image->r(), image->s()*4);
+    return true;
+}
+
 osg::Image* colorSpaceConversion(ColorSpaceOperation op, osg::Image* image, const osg::Vec4& colour)
 {
     GLenum requiredPixelFormat = image->getPixelFormat();
@@ -673,19 +985,19 @@ osg::Image* colorSpaceConversion(ColorSpaceOperation op, osg::Image* image, cons
         case (MODULATE_ALPHA_BY_LUMINANCE):
         {
             OSG_NOTICE<<"doing conversion MODULATE_ALPHA_BY_LUMINANCE"<<std::endl;
-            osg::modifyImage(image, ModulateAlphaByLuminanceOperator());
+            if (!_colorSpaceConversionWithKernels(op, image, colour)) osg::modifyImage(image, ModulateAlphaByLuminanceOperator());
             return image;
         }
         case (MODULATE_ALPHA_BY_COLOR):
         {
             OSG_NOTICE<<"doing conversion MODULATE_ALPHA_BY_COLOUR"<<std::endl;
-            osg::modifyImage(image, ModulateAlphaByColorOperator(colour));
+            if (!_colorSpaceConversionWithKernels(op, image, colour)) osg::modifyImage(image, ModulateAlphaByColorOperator(colour));
             return image;
         }
         case (REPLACE_ALPHA_WITH_LUMINANCE):
         {
             OSG_NOTICE<<"doing conversion REPLACE_ALPHA_WITH_LUMINANCE"<<std::endl;
-            osg::modifyImage(image, ReplaceAlphaWithLuminanceOperator());
+            if (!_colorSpaceConversionWithKernels(op, image, colour)) osg::modifyImage(image, ReplaceAlphaWithLuminanceOperator());
             return image;
         }
         case (REPLACE_RGB_WITH_LUMINANCE):
@@ -699,7 +1011,253 @@ osg::Image* colorSpaceConversion(ColorSpaceOperation op, osg::Image* image, cons
     }
 }
 
+bool _isMipmapSourcePixelFormat(GLenum pixelFormat)
+{
+    switch(pixelFormat)
+    {
+        case(GL_LUMINANCE):
+        case(GL_ALPHA):
+        case(GL_LUMINANCE_ALPHA):
+        case(GL_RGB):
+        case(GL_BGR):
+        case(GL_RGBA):
+        case(GL_BGRA):
+            return true;
+        default:
+            return false;
+    }
+}
+
+struct BoxMipmapRowsOperation : public ImageRowOperation
+{
+    BoxMipmapRowsOperation(unsigned int numComponents, unsigned int sourceWidth, unsigned int sourceHeight, const unsigned char* source, unsigned int width, unsigned char* dest):
+        _numComponents(numComponents),
+        _sourceWidth(sourceWidth),
+        _sourceHeight(sourceHeight),
+        _source(source),
+        _width(width),
+        _dest(dest) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        const unsigned int C = _numComponents;
+        for(unsigned int row=beginRow; row<endRow; ++row)
+        {
+            // a source dimension of 1 isn't halved, so its pixels are used twice.
+            const unsigned char* row0 = _source + osg::minimum(row*2, _sourceHeight-1)*_sourceWidth*C;
+            const unsigned char* row1 = _source + osg::minimum(row*2+1, _sourceHeight-1)*_sourceWidth*C;
+            unsigned char* dest = _dest + row*_width*C;
+            for(unsigned int x=0; x<_width; ++x)
+            {
+                const unsigned int x0 = osg::minimum(x*2, _sourceWidth-1)*C;
+                const unsigned int x1 = osg::minimum(x*2+1, _sourceWidth-1)*C;
+                for(unsigned int c=0; c<C; ++c)
+                {
+                    *dest++ = static_cast<unsigned char>((row0[x0+c] + row0[x1+c] + row1[x0+c] + row1[x1+c] + 2) >> 2);
+                }
+            }
+        }
+    }
+
+    unsigned int            _numComponents;
+    unsigned int            _sourceWidth;
+    unsigned int            _sourceHeight;
+    const unsigned char*    _source;
+    unsigned int            _width;
+    unsigned char*          _dest;
+};
+
+// Weights of the source pixels 2*i-5 to 2*i+6 that make destination pixel i, a Kaiser windowed sinc three destination
+// pixels wide with an alpha of 4.
+struct KaiserMipmapWeights
+{
+    enum { NUM_TAPS = 12, FIRST_TAP = -5 };
+
+    KaiserMipmapWeights()
+    {
+        const double width = 3.0;
+        const double alpha = 4.0;
+
+        double weights[NUM_TAPS];
+        double total = 0.0;
+        for(int t=0; t<NUM_TAPS; ++t)
+        {
+            // distance in destination pixels from the centre of the destination pixel to the centre of the source pixel
+            double x = (double(t+FIRST_TAP) - 0.5)*0.5;
+            double sinc = sin(osg::PI*x)/(osg::PI*x);
+            double window = x/width;
+            weights[t] = (window*window<1.0) ? sinc*besselI0(alpha*sqrt(1.0-window*window))/besselI0(alpha) : 0.0;
+            total += weights[t];
+        }
+
+        for(int t=0; t<NUM_TAPS; ++t) _weights[t] = float(weights[t]/total);
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for(int k=1; k<32; ++k)
+        {
+            term *= (x*0.5/double(k))*(x*0.5/double(k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    float _weights[NUM_TAPS];
+};
+
+static const KaiserMipmapWeights s_kaiserMipmapWeights;
 
+inline int _clampTap(int index, int size) { return index<0 ? 0 : (index>=size ? size-1 : index); }
 
+// Filter the rows of the source horizontally into a float image of the destination width, a source width of 1 is copied.
+struct KaiserMipmapColumnsOperation : public ImageRowOperation
+{
+    KaiserMipmapColumnsOperation(unsigned int numComponents, unsigned int sourceWidth, const unsigned char* source, unsigned int width, float* dest):
+        _numComponents(numComponents),
+        _sourceWidth(sourceWidth),
+        _source(source),
+        _width(width),
+        _dest(dest) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        const unsigned int C = _numComponents;
+        for(unsigned int row=beginRow; row<endRow; ++row)
+        {
+            const unsigned char* source = _source + row*_sourceWidth*C;
+            float* dest = _dest + row*_width*C;
+            for(unsigned int x=0; x<_width; ++x)
+            {
+                for(unsigned int c=0; c<C; ++c)
+                {
+                    float value = 0.0f;
+                    if (_sourceWidth==1) value = float(source[c]);
+                    else
+                    {
+                        for(int t=0; t<KaiserMipmapWeights::NUM_TAPS; ++t)
+                        {
+                            int index = _clampTap(int(x*2)+t+KaiserMipmapWeights::FIRST_TAP, int(_sourceWidth));
+                            value += s_kaiserMipmapWeights._weights[t]*float(source[index*C+c]);
+                        }
+                    }
+                    *dest++ = value;
+                }
+            }
+        }
+    }
+
+    unsigned int            _numComponents;
+    unsigned int            _sourceWidth;
+    const unsigned char*    _source;
+    unsigned int            _width;
+    float*                  _dest;
+};
+
+// Filter the columns of the horizontally filtered image into the destination rows, a source height of 1 is copied.
+struct KaiserMipmapRowsOperation : public ImageRowOperation
+{
+    KaiserMipmapRowsOperation(unsigned int numComponents, unsigned int sourceHeight, const float* source, unsigned int width, unsigned char* dest):
+        _numComponents(numComponents),
+        _sourceHeight(sourceHeight),
+        _source(source),
+        _width(width),
+        _dest(dest) {}
+
+    virtual void operator () (unsigned int beginRow, unsigned int endRow)
+    {
+        const unsigned int numElements = _width*_numComponents;
+        for(unsigned int row=beginRow; row<endRow; ++row)
+        {
+            unsigned char* dest = _dest + row*numElements;
+            for(unsigned int i=0; i<numElements; ++i)
+            {
+                float value = 0.0f;
+                if (_sourceHeight==1) value = _source[i];
+                else
+                {
+                    for(int t=0; t<KaiserMipmapWeights::NUM_TAPS; ++t)
+                    {
+                        int index = _clampTap(int(row*2)+t+KaiserMipmapWeights::FIRST_TAP, int(_sourceHeight));
+                        value += s_kaiserMipmapWeights._weights[t]*_source[index*numElements+i];
+                    }
+                }
+
+                // the negative lobes of the sinc can take values out of range.
+                int v = int(value+0.5f);
+                dest[i] = static_cast<unsigned char>(v<0 ? 0 : (v>255 ? 255 : v));
+            }
+        }
+    }
+
+    unsigned int            _numComponents;
+    unsigned int            _sourceHeight;
+    const float*            _source;
+    unsigned int            _width;
+    unsigned char*          _dest;
+};
+
+bool generateMipmaps(osg::Image* image, MipmapFilter filter)
+{
+    if (!image || !image->data()) return false;
+    if (image->isMipmap()) return true;
+    if (image->getDataType()!=GL_UNSIGNED_BYTE || image->r()!=1 || !_isMipmapSourcePixelFormat(image->getPixelFormat())) return false;
+
+    const unsigned int C = osg::Image::computeNumComponents(image->getPixelFormat());
+    const unsigned int numLevels = osg::Image::computeNumberOfMipmapLevels(image->s(), image->t());
+
+    osg::Image::MipmapDataType mipmapData;
+    unsigned int totalSize = 0;
+    for(unsigned int level=0; level<numLevels; ++level)
+    {
+        if (level>0) mipmapData.push_back(totalSize);
+        totalSize += osg::maximum(image->s()>>level, 1)*osg::maximum(image->t()>>level, 1)*C;
+    }
+
+    unsigned char* data = new unsigned char[totalSize];
+
+    // the levels are packed without padding, so copy the rows of the first level in case the image pads them.
+    unsigned int rowSize = image->s()*C;
+    for(int row=0; row<image->t(); ++row)
+    {
+        memcpy(data + row*rowSize, image->data(0,row), rowSize);
+    }
+
+    std::vector<float> columns;
+    for(unsigned int level=1; level<numLevels; ++level)
+    {
+        const unsigned int sourceWidth = osg::maximum(image->s()>>(level-1), 1);
+        const unsigned int sourceHeight = osg::maximum(image->t()>>(level-1), 1);
+        const unsigned int width = osg::maximum(image->s()>>level, 1);
+        const unsigned int height = osg::maximum(image->t()>>level, 1);
+        const unsigned char* source = data + (level>1 ? mipmapData[level-2] : 0);
+        unsigned char* dest = data + mipmapData[level-1];
+
+        if (filter==MIPMAP_KAISER_FILTER)
+        {
+            columns.resize(width*sourceHeight*C);
+
+            KaiserMipmapColumnsOperation columnsOperation(C, sourceWidth, source, width, &columns.front());
+            runImageKernelRows(columnsOperation, sourceHeight, width*C*KaiserMipmapWeights::NUM_TAPS);
+
+            KaiserMipmapRowsOperation rowsOperation(C, sourceHeight, &columns.front(), width, dest);
+            runImageKernelRows(rowsOperation, height, width*C*KaiserMipmapWeights::NUM_TAPS);
+        }
+        else
+        {
+            BoxMipmapRowsOperation operation(C, sourceWidth, sourceHeight, source, width, dest);
+            runImageKernelRows(operation, height, sourceWidth*C*2);
+        }
+    }
+
+    image->setImage(image->s(), image->t(), 1,
+                    image->getInternalTextureFormat(), image->getPixelFormat(), GL_UNSIGNED_BYTE,
+                    data, osg::Image::USE_NEW_DELETE, 1);
+    image->setMipmapLevels(mipmapData);
+
+    return true;
 }
 
+}
@@ -15,9 +15,22 @@
 #include <osg/Geode>
 #include <osg/TriangleIndexFunctor>
 #include <osg/Timer>
+#include <osg/ApplicationUsage>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
 
 #include <osg/io_utils>
 
+#include <algorithm>
+#include <float.h>
+#include <stdlib.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=1)
+    #define OSG_KDTREE_USE_SSE
+    #include <xmmintrin.h>
+#endif
+
 using namespace osg;
 
 //#define VERBOSE_OUTPUT
@@ -39,7 +52,90 @@ struct BuildKdTree
 
     void computeDivisions(KdTree::BuildOptions& options);
 
-    int divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
+    /** Subtree whose division has been deferred so that it can be run in parallel with the others, its nodes
+      * are added to a list of their own and then merged into the KdTree.*/
+    struct SubtreeTask
+    {
+        SubtreeTask():
+            nodeIndex(0),
+            level(0) {}
+
+        int                 nodeIndex;
+        osg::BoundingBox    bb;
+        unsigned int        level;
+        KdTree::KdNodeList  nodes;
+    };
+
+    typedef std::vector<SubtreeTask> SubtreeTasks;
+
+    /** Per thread state of divide(), the list nodes are added to and the working data of computeSurfaceAreaSplit().*/
+    struct DivideState
+    {
+        DivideState(KdTree::KdNodeList& nodeList):
+            nodes(nodeList),
+            subtreeTasks(0),
+            subtreeLevel(0) {}
+
+        int addNode(const KdTree::KdNode& node)
+        {
+            int num = static_cast<int>(nodes.size());
+            nodes.push_back(node);
+            return num;
+        }
+
+        KdTree::KdNodeList&             nodes;
+
+        // when set, leaves that still need dividing at subtreeLevel are deferred to subtreeTasks.
+        SubtreeTasks*                   subtreeTasks;
+        unsigned int                    subtreeLevel;
+
+        std::vector<osg::BoundingBox>   binBBs;
+        std::vector<int>                binCounts;
+        std::vector<float>              rightAreas;
+        std::vector<int>                rightCounts;
+
+    protected:
+
+        DivideState& operator = (const DivideState&) { return *this; }
+    };
+
+    int divide(DivideState& state, KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
+
+    void divideSubtrees(KdTree::BuildOptions& options, SubtreeTasks& subtreeTasks, unsigned int numThreads);
+
+    void computeBound(int nodeIndex);
+
+    struct SurfaceAreaSplit
+    {
+        SurfaceAreaSplit():
+            axis(0),
+            bin(0),
+            minimum(0.0f),
+            scale(0.0f),
+            numBins(0) {}
+
+        inline int binOf(float center) const
+        {
+            int b = static_cast<int>((center-minimum)*scale);
+            return b<0 ? 0 : (b>=numBins ? numBins-1 : b);
+        }
+
+        int     axis;
+        int     bin;
+        float   minimum;
+        float   scale;
+        int     numBins;
+    };
+
+    bool computeSurfaceAreaSplit(DivideState& state, KdTree::BuildOptions& options, int istart, int iend, SurfaceAreaSplit& split);
+
+    inline void expandByTriangle(osg::BoundingBox& bb, unsigned int primitiveIndex) const
+    {
+        const KdTree::Triangle& tri = _kdTree.getTriangle(primitiveIndex);
+        bb.expandBy((*_kdTree.getVertices())[tri.p0]);
+        bb.expandBy((*_kdTree.getVertices())[tri.p1]);
+        bb.expandBy((*_kdTree.getVertices())[tri.p2]);
+    }
 
     KdTree&             _kdTree;
 
@@ -94,6 +190,87 @@ struct TriangleIndicesCollector
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Support for running the build of KdTrees and subtrees over several threads
+
+namespace
+{
+
+// meshes with fewer triangles than this are quicker to divide on a single thread.
+const unsigned int s_minimumNumTrianglesToDivideInParallel = 65536;
+
+unsigned int computeNumThreads(const KdTree::BuildOptions& options)
+{
+    if (options._numThreads>0) return options._numThreads;
+
+    int numProcessors = OpenThreads::GetNumberOfProcessors();
+    return numProcessors>1 ? static_cast<unsigned int>(numProcessors) : 1;
+}
+
+struct ParallelOperation
+{
+    virtual ~ParallelOperation() {}
+
+    virtual void operator () (unsigned int index) = 0;
+};
+
+void runParallelOperation(ParallelOperation& operation, OpenThreads::Atomic& nextIndex, unsigned int numItems)
+{
+    for(unsigned int index = (++nextIndex)-1; index<numItems; index = (++nextIndex)-1)
+    {
+        operation(index);
+    }
+}
+
+class ParallelOperationThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    ParallelOperationThread(ParallelOperation& operation, OpenThreads::Atomic& nextIndex, unsigned int numItems):
+        _operation(operation),
+        _nextIndex(nextIndex),
+        _numItems(numItems) {}
+
+    virtual void run() { runParallelOperation(_operation, _nextIndex, _numItems); }
+
+protected:
+
+    virtual ~ParallelOperationThread() {}
+
+    ParallelOperationThread& operator = (const ParallelOperationThread&) { return *this; }
+
+    ParallelOperation&      _operation;
+    OpenThreads::Atomic&    _nextIndex;
+    unsigned int            _numItems;
+};
+
+/** Run operation on items 0 to numItems-1, sharing them between numThreads threads in index order,
+  * the calling thread being one of them. Returns once all items are done.*/
+void runParallel(ParallelOperation& operation, unsigned int numItems, unsigned int numThreads)
+{
+    OpenThreads::Atomic nextIndex;
+
+    typedef std::vector< osg::ref_ptr<ParallelOperationThread> > Threads;
+    Threads threads;
+    for(unsigned int i=1; i<numThreads && i<numItems; ++i)
+    {
+        threads.push_back(new ParallelOperationThread(operation, nextIndex, numItems));
+        threads.back()->startThread();
+    }
+
+    runParallelOperation(operation, nextIndex, numItems);
+
+    for(Threads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+    }
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // BuildKdTree Implementation
@@ -142,8 +319,29 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
 
     int nodeNum = _kdTree.addNode(node);
 
+    DivideState state(_kdTree.getNodes());
+
+    // divide the top levels of large meshes here, then their subtrees in parallel.
+    unsigned int numThreads = computeNumThreads(options);
+    SubtreeTasks subtreeTasks;
+    if (numThreads>1 && _primitiveIndices.size()>=s_minimumNumTrianglesToDivideInParallel)
+    {
+        // aim for several subtrees per thread to even out the load.
+        unsigned int subtreeLevel = 0;
+        while((1u<<subtreeLevel)<numThreads*4) ++subtreeLevel;
+
+        state.subtreeTasks = &subtreeTasks;
+        state.subtreeLevel = osg::minimum(subtreeLevel, static_cast<unsigned int>(_axisStack.size()));
+    }
+
     osg::BoundingBox bb = _bb;
-    nodeNum = divide(options, bb, nodeNum, 0);
+    nodeNum = divide(state, options, bb, nodeNum, 0);
+
+    if (!subtreeTasks.empty())
+    {
+        divideSubtrees(options, subtreeTasks, numThreads);
+        computeBound(nodeNum);
+    }
 
     // now reorder the triangle list so that it's in order as per the primitiveIndex list.
     KdTree::TriangleList triangleList(_kdTree.getTriangles().size());
@@ -203,13 +401,217 @@ void BuildKdTree::computeDivisions(KdTree::BuildOptions& options)
 #endif
 }
 
-int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level)
+namespace
+{
+
+struct DivideSubtreeOperation : public ParallelOperation
+{
+    DivideSubtreeOperation(BuildKdTree& buildKdTree, KdTree::BuildOptions& options, BuildKdTree::SubtreeTasks& subtreeTasks):
+        _buildKdTree(buildKdTree),
+        _options(options),
+        _subtreeTasks(subtreeTasks) {}
+
+    virtual void operator () (unsigned int index)
+    {
+        BuildKdTree::SubtreeTask& task = _subtreeTasks[index];
+
+        // local node 0 is left unused as an index of 0 means no child, the subtree's root goes in at 1.
+        task.nodes.push_back(KdTree::KdNode());
+        task.nodes.push_back(_buildKdTree._kdTree.getNode(task.nodeIndex));
+
+        BuildKdTree::DivideState state(task.nodes);
+        osg::BoundingBox bb = task.bb;
+        _buildKdTree.divide(state, _options, bb, 1, task.level);
+    }
+
+    BuildKdTree&                _buildKdTree;
+    KdTree::BuildOptions&       _options;
+    BuildKdTree::SubtreeTasks&  _subtreeTasks;
+
+protected:
+
+    DivideSubtreeOperation& operator = (const DivideSubtreeOperation&) { return *this; }
+};
+
+}
+
+void BuildKdTree::divideSubtrees(KdTree::BuildOptions& options, SubtreeTasks& subtreeTasks, unsigned int numThreads)
+{
+    DivideSubtreeOperation operation(*this, options, subtreeTasks);
+    runParallel(operation, subtreeTasks.size(), numThreads);
+
+    // append the nodes of each subtree in turn, so the tree doesn't depend on the order the threads finished in.
+    KdTree::KdNodeList& nodes = _kdTree.getNodes();
+    for(SubtreeTasks::iterator itr = subtreeTasks.begin();
+        itr != subtreeTasks.end();
+        ++itr)
+    {
+        SubtreeTask& task = *itr;
+
+        int offset = static_cast<int>(nodes.size())-2;
+        for(unsigned int i=1; i<task.nodes.size(); ++i)
+        {
+            KdTree::KdNode node = task.nodes[i];
+            if (node.first>0) node.first += offset;
+            if (node.first>=0 && node.second>0) node.second += offset;
+
+            if (i==1) nodes[task.nodeIndex] = node;
+            else nodes.push_back(node);
+        }
+
+        KdTree::KdNodeList().swap(task.nodes);
+    }
+}
+
+void BuildKdTree::computeBound(int nodeIndex)
 {
     KdTree::KdNode& node = _kdTree.getNode(nodeIndex);
+    if (node.first<0) return;
+
+    // interior nodes above the subtrees were given spatial bounds, so recompute them from their children.
+    node.bb.init();
+    if (node.first>0)
+    {
+        computeBound(node.first);
+        node.bb.expandBy(_kdTree.getNode(node.first).bb);
+    }
+    if (node.second>0)
+    {
+        computeBound(node.second);
+        node.bb.expandBy(_kdTree.getNode(node.second).bb);
+    }
+}
+
+inline float surfaceArea(const osg::BoundingBox& bb)
+{
+    if (!bb.valid()) return 0.0f;
+    float dx = bb.xMax()-bb.xMin();
+    float dy = bb.yMax()-bb.yMin();
+    float dz = bb.zMax()-bb.zMin();
+    return 2.0f*(dx*dy+dy*dz+dz*dx);
+}
+
+bool BuildKdTree::computeSurfaceAreaSplit(DivideState& state, KdTree::BuildOptions& options, int istart, int iend, SurfaceAreaSplit& split)
+{
+    int numBins = osg::clampBetween(static_cast<int>(options._numSurfaceAreaBins), 2, 256);
+    int numTriangles = iend-istart+1;
+
+    osg::BoundingBox centerBB;
+    for(int i=istart; i<=iend; ++i)
+    {
+        centerBB.expandBy(_centers[_primitiveIndices[i]]);
+    }
+
+    // cost estimates relative to testing a single triangle.
+    const float traversalCost = 1.0f;
+
+    std::vector<osg::BoundingBox>& binBBs = state.binBBs;
+    std::vector<int>& binCounts = state.binCounts;
+    std::vector<float>& rightAreas = state.rightAreas;
+    std::vector<int>& rightCounts = state.rightCounts;
+
+    binBBs.resize(numBins);
+    binCounts.resize(numBins);
+    rightAreas.resize(numBins);
+    rightCounts.resize(numBins);
+
+    float bestCost = FLT_MAX;
+    float nodeArea = 0.0f;
+
+    for(int axis=0; axis<3; ++axis)
+    {
+        float extent = centerBB._max[axis]-centerBB._min[axis];
+        if (extent<=0.0f) continue;
+
+        SurfaceAreaSplit candidate;
+        candidate.axis = axis;
+        candidate.minimum = centerBB._min[axis];
+        candidate.scale = float(numBins)/extent;
+        candidate.numBins = numBins;
+
+        for(int b=0; b<numBins; ++b)
+        {
+            binBBs[b].init();
+            binCounts[b] = 0;
+        }
+
+        for(int i=istart; i<=iend; ++i)
+        {
+            unsigned int primitiveIndex = _primitiveIndices[i];
+            int b = candidate.binOf(_centers[primitiveIndex][axis]);
+            expandByTriangle(binBBs[b], primitiveIndex);
+            ++binCounts[b];
+        }
+
+        // sweep from the right to accumulate the area and count of everything to the right of each split.
+        osg::BoundingBox bb;
+        int count = 0;
+        for(int b=numBins-1; b>0; --b)
+        {
+            bb.expandBy(binBBs[b]);
+            count += binCounts[b];
+            rightAreas[b] = surfaceArea(bb);
+            rightCounts[b] = count;
+        }
+        bb.expandBy(binBBs[0]);
+        nodeArea = surfaceArea(bb);
+
+        // then sweep from the left, the split after bin b puts bins 0 to b on the left.
+        bb.init();
+        count = 0;
+        for(int b=0; b<numBins-1; ++b)
+        {
+            bb.expandBy(binBBs[b]);
+            count += binCounts[b];
+            if (count==0 || rightCounts[b+1]==0) continue;
+
+            float cost = surfaceArea(bb)*float(count) + rightAreas[b+1]*float(rightCounts[b+1]);
+            if (cost<bestCost)
+            {
+                bestCost = cost;
+                split = candidate;
+                split.bin = b;
+            }
+        }
+    }
+
+    if (bestCost==FLT_MAX) return false;
+
+    // only split when the estimated cost of visiting both children beats testing every triangle in this node.
+    return traversalCost*nodeArea + bestCost < float(numTriangles)*nodeArea;
+}
+
+int BuildKdTree::divide(DivideState& state, KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level)
+{
+    KdTree::KdNode& node = state.nodes[nodeIndex];
 
     bool needToDivide = level < _axisStack.size() &&
                         (node.first<0 && static_cast<unsigned int>(node.second)>options._targetNumTrianglesPerLeaf);
 
+    if (needToDivide && state.subtreeTasks && level==state.subtreeLevel)
+    {
+        // leave the subtree to be divided in parallel with the others, the spatial bound stands in
+        // for the leaf's bound until computeBound() is run on the completed tree.
+        node.bb = bb;
+
+        SubtreeTask task;
+        task.nodeIndex = nodeIndex;
+        task.bb = bb;
+        task.level = level;
+        state.subtreeTasks->push_back(task);
+
+        return nodeIndex;
+    }
+
+    bool useSurfaceAreaSplit = needToDivide && options._buildMethod==KdTree::BuildOptions::SURFACE_AREA_HEURISTIC;
+
+    SurfaceAreaSplit split;
+    if (useSurfaceAreaSplit)
+    {
+        int istart = -node.first-1;
+        needToDivide = computeSurfaceAreaSplit(state, options, istart, istart+node.second-1, split);
+    }
+
     if (!needToDivide)
     {
         if (node.first<0)
@@ -260,7 +662,7 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
     }
 
-    int axis = _axisStack[level];
+    int axis = useSurfaceAreaSplit ? split.axis : _axisStack[level];
 
 #ifdef VERBOSE_OUTPUT
     OSG_NOTICE<<"divide("<<nodeIndex<<", "<<level<< "), axis="<<axis<<std::endl;
@@ -278,7 +680,8 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
         float original_min = bb._min[axis];
         float original_max = bb._max[axis];
 
-        float mid = (original_min+original_max)*0.5f;
+        float mid = useSurfaceAreaSplit ? split.minimum+float(split.bin+1)/split.scale :
+                                          (original_min+original_max)*0.5f;
 
         int originalLeftChildIndex = 0;
         int originalRightChildIndex = 0;
@@ -289,26 +692,42 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
             int left = istart;
             int right = iend;
 
-            while(left<right)
+            if (useSurfaceAreaSplit)
             {
-                while(left<right && (_centers[_primitiveIndices[left]][axis]<=mid)) { ++left; }
+                // partition on the same bins that the split was chosen from, so neither side can end up empty.
+                while(left<=right)
+                {
+                    if (split.binOf(_centers[_primitiveIndices[left]][axis])<=split.bin) ++left;
+                    else
+                    {
+                        std::swap(_primitiveIndices[left], _primitiveIndices[right]);
+                        --right;
+                    }
+                }
+            }
+            else
+            {
+                while(left<right)
+                {
+                    while(left<right && (_centers[_primitiveIndices[left]][axis]<=mid)) { ++left; }
 
-                while(left<right && (_centers[_primitiveIndices[right]][axis]>mid)) { --right; }
+                    while(left<right && (_centers[_primitiveIndices[right]][axis]>mid)) { --right; }
 
-                while(left<right && (_centers[_primitiveIndices[right]][axis]>mid)) { --right; }
+                    while(left<right && (_centers[_primitiveIndices[right]][axis]>mid)) { --right; }
 
-                if (left<right)
-                {
-                    std::swap(_primitiveIndices[left], _primitiveIndices[right]);
-                    ++left;
-                    --right;
+                    if (left<right)
+                    {
+                        std::swap(_primitiveIndices[left], _primitiveIndices[right]);
+                        ++left;
+                        --right;
+                    }
                 }
-            }
 
-            if (left==right)
-            {
-                if (_centers[_primitiveIndices[left]][axis]<=mid) ++left;
-                else --right;
+                if (left==right)
+                {
+                    if (_centers[_primitiveIndices[left]][axis]<=mid) ++left;
+                    else --right;
+                }
             }
 
             KdTree::KdNode leftLeaf(-istart-1, (right-istart)+1);
@@ -352,8 +771,8 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
             }
             else
             {
-                originalLeftChildIndex = _kdTree.addNode(leftLeaf);
-                originalRightChildIndex = _kdTree.addNode(rightLeaf);
+                originalLeftChildIndex = state.addNode(leftLeaf);
+                originalRightChildIndex = state.addNode(rightLeaf);
             }
         }
 
@@ -362,7 +781,7 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
         bb._max[axis] = mid;
 
         //OSG_NOTICE<<"  divide leftLeaf "<<kdTree.getNode(nodeNum).first<<std::endl;
-        int leftChildIndex = originalLeftChildIndex!=0 ? divide(options, bb, originalLeftChildIndex, level+1) : 0;
+        int leftChildIndex = originalLeftChildIndex!=0 ? divide(state, options, bb, originalLeftChildIndex, level+1) : 0;
 
         bb._max[axis] = restore;
 
@@ -370,7 +789,7 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
         bb._min[axis] = mid;
 
         //OSG_NOTICE<<"  divide rightLeaf "<<kdTree.getNode(nodeNum).second<<std::endl;
-        int rightChildIndex = originalRightChildIndex!=0 ? divide(options, bb, originalRightChildIndex, level+1) : 0;
+        int rightChildIndex = originalRightChildIndex!=0 ? divide(state, options, bb, originalRightChildIndex, level+1) : 0;
 
         bb._min[axis] = restore;
 
@@ -379,7 +798,7 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
         {
             // take a second reference to node we are working on as the std::vector<> resize could
             // have invalidate the previous node ref.
-            KdTree::KdNode& newNodeRef = _kdTree.getNode(nodeIndex);
+            KdTree::KdNode& newNodeRef = state.nodes[nodeIndex];
 
             newNodeRef.first = leftChildIndex;
             newNodeRef.second = rightChildIndex;
@@ -387,8 +806,8 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
             insitueDivision = true;
 
             newNodeRef.bb.init();
-            if (leftChildIndex!=0) newNodeRef.bb.expandBy(_kdTree.getNode(leftChildIndex).bb);
-            if (rightChildIndex!=0) newNodeRef.bb.expandBy(_kdTree.getNode(rightChildIndex).bb);
+            if (leftChildIndex!=0) newNodeRef.bb.expandBy(state.nodes[leftChildIndex].bb);
+            if (rightChildIndex!=0) newNodeRef.bb.expandBy(state.nodes[rightChildIndex].bb);
 
             if (!newNodeRef.bb.valid())
             {
@@ -401,13 +820,13 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
                 if (leftChildIndex!=0)
                 {
-                    OSG_NOTICE<<"  getNode(leftChildIndex).bb min = "<<_kdTree.getNode(leftChildIndex).bb._min<<std::endl;
-                    OSG_NOTICE<<"                                 max = "<<_kdTree.getNode(leftChildIndex).bb._max<<std::endl;
+                    OSG_NOTICE<<"  getNode(leftChildIndex).bb min = "<<state.nodes[leftChildIndex].bb._min<<std::endl;
+                    OSG_NOTICE<<"                                 max = "<<state.nodes[leftChildIndex].bb._max<<std::endl;
                 }
                 if (rightChildIndex!=0)
                 {
-                    OSG_NOTICE<<"  getNode(rightChildIndex).bb min = "<<_kdTree.getNode(rightChildIndex).bb._min<<std::endl;
-                    OSG_NOTICE<<"                              max = "<<_kdTree.getNode(rightChildIndex).bb._max<<std::endl;
+                    OSG_NOTICE<<"  getNode(rightChildIndex).bb min = "<<state.nodes[rightChildIndex].bb._min<<std::endl;
+                    OSG_NOTICE<<"                              max = "<<state.nodes[rightChildIndex].bb._max<<std::endl;
                 }
             }
         }
@@ -421,6 +840,277 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Float4 - four floats processed together, using SSE when the compiler targets it
+//
+namespace
+{
+
+#ifdef OSG_KDTREE_USE_SSE
+
+struct Float4
+{
+    Float4() {}
+    explicit Float4(__m128 value): v(value) {}
+    explicit Float4(float value): v(_mm_set1_ps(value)) {}
+    Float4(float a, float b, float c, float d): v(_mm_setr_ps(a, b, c, d)) {}
+
+    void store(float* values) const { _mm_storeu_ps(values, v); }
+
+    __m128 v;
+};
+
+struct Bool4
+{
+    Bool4() {}
+    explicit Bool4(__m128 value): v(value) {}
+
+    /** return the lanes that are true as a bit mask, lane 0 in bit 0.*/
+    int mask() const { return _mm_movemask_ps(v); }
+
+    __m128 v;
+};
+
+inline Float4 operator + (const Float4& lhs, const Float4& rhs) { return Float4(_mm_add_ps(lhs.v, rhs.v)); }
+inline Float4 operator - (const Float4& lhs, const Float4& rhs) { return Float4(_mm_sub_ps(lhs.v, rhs.v)); }
+inline Float4 operator * (const Float4& lhs, const Float4& rhs) { return Float4(_mm_mul_ps(lhs.v, rhs.v)); }
+inline Float4 operator / (const Float4& lhs, const Float4& rhs) { return Float4(_mm_div_ps(lhs.v, rhs.v)); }
+
+inline Bool4 operator < (const Float4& lhs, const Float4& rhs) { return Bool4(_mm_cmplt_ps(lhs.v, rhs.v)); }
+inline Bool4 operator > (const Float4& lhs, const Float4& rhs) { return Bool4(_mm_cmpgt_ps(lhs.v, rhs.v)); }
+inline Bool4 operator <= (const Float4& lhs, const Float4& rhs) { return Bool4(_mm_cmple_ps(lhs.v, rhs.v)); }
+
+inline Bool4 operator & (const Bool4& lhs, const Bool4& rhs) { return Bool4(_mm_and_ps(lhs.v, rhs.v)); }
+inline Bool4 operator | (const Bool4& lhs, const Bool4& rhs) { return Bool4(_mm_or_ps(lhs.v, rhs.v)); }
+
+/** lhs and not rhs.*/
+inline Bool4 andNot(const Bool4& lhs, const Bool4& rhs) { return Bool4(_mm_andnot_ps(rhs.v, lhs.v)); }
+
+inline Float4 select(const Bool4& condition, const Float4& lhs, const Float4& rhs) { return Float4(_mm_or_ps(_mm_and_ps(condition.v, lhs.v), _mm_andnot_ps(condition.v, rhs.v))); }
+
+inline Float4 minimum(const Float4& lhs, const Float4& rhs) { return Float4(_mm_min_ps(lhs.v, rhs.v)); }
+inline Float4 maximum(const Float4& lhs, const Float4& rhs) { return Float4(_mm_max_ps(lhs.v, rhs.v)); }
+
+#else
+
+struct Float4
+{
+    Float4() {}
+    explicit Float4(float value) { v[0] = v[1] = v[2] = v[3] = value; }
+    Float4(float a, float b, float c, float d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+
+    void store(float* values) const { for(int i=0; i<4; ++i) values[i] = v[i]; }
+
+    float v[4];
+};
+
+struct Bool4
+{
+    Bool4() {}
+    explicit Bool4(int mask) { for(int i=0; i<4; ++i) v[i] = (mask & (1<<i))!=0; }
+
+    /** return the lanes that are true as a bit mask, lane 0 in bit 0.*/
+    int mask() const { return (v[0] ? 1 : 0) | (v[1] ? 2 : 0) | (v[2] ? 4 : 0) | (v[3] ? 8 : 0); }
+
+    bool v[4];
+};
+
+#define OSG_KDTREE_FLOAT4_OPERATOR(RESULT, OP) \
+    inline RESULT operator OP (const Float4& lhs, const Float4& rhs) \
+    { \
+        RESULT result; \
+        for(int i=0; i<4; ++i) result.v[i] = lhs.v[i] OP rhs.v[i]; \
+        return result; \
+    }
+
+OSG_KDTREE_FLOAT4_OPERATOR(Float4, +)
+OSG_KDTREE_FLOAT4_OPERATOR(Float4, -)
+OSG_KDTREE_FLOAT4_OPERATOR(Float4, *)
+OSG_KDTREE_FLOAT4_OPERATOR(Float4, /)
+OSG_KDTREE_FLOAT4_OPERATOR(Bool4, <)
+OSG_KDTREE_FLOAT4_OPERATOR(Bool4, >)
+OSG_KDTREE_FLOAT4_OPERATOR(Bool4, <=)
+
+#undef OSG_KDTREE_FLOAT4_OPERATOR
+
+inline Bool4 operator & (const Bool4& lhs, const Bool4& rhs) { return Bool4(lhs.mask() & rhs.mask()); }
+inline Bool4 operator | (const Bool4& lhs, const Bool4& rhs) { return Bool4(lhs.mask() | rhs.mask()); }
+
+/** lhs and not rhs.*/
+inline Bool4 andNot(const Bool4& lhs, const Bool4& rhs) { return Bool4(lhs.mask() & ~rhs.mask()); }
+
+inline Float4 select(const Bool4& condition, const Float4& lhs, const Float4& rhs)
+{
+    Float4 result;
+    for(int i=0; i<4; ++i) result.v[i] = condition.v[i] ? lhs.v[i] : rhs.v[i];
+    return result;
+}
+
+// same NaN handling as the SSE minps and maxps instructions, rhs is returned when either is NaN.
+inline Float4 minimum(const Float4& lhs, const Float4& rhs)
+{
+    Float4 result;
+    for(int i=0; i<4; ++i) result.v[i] = lhs.v[i]<rhs.v[i] ? lhs.v[i] : rhs.v[i];
+    return result;
+}
+
+inline Float4 maximum(const Float4& lhs, const Float4& rhs)
+{
+    Float4 result;
+    for(int i=0; i<4; ++i) result.v[i] = lhs.v[i]>rhs.v[i] ? lhs.v[i] : rhs.v[i];
+    return result;
+}
+
+#endif
+
+struct Vec3x4
+{
+    Vec3x4() {}
+    Vec3x4(const Float4& ix, const Float4& iy, const Float4& iz): x(ix), y(iy), z(iz) {}
+    explicit Vec3x4(const osg::Vec3& v): x(v.x()), y(v.y()), z(v.z()) {}
+    Vec3x4(const osg::Vec3& a, const osg::Vec3& b, const osg::Vec3& c, const osg::Vec3& d):
+        x(a.x(), b.x(), c.x(), d.x()),
+        y(a.y(), b.y(), c.y(), d.y()),
+        z(a.z(), b.z(), c.z(), d.z()) {}
+
+    Float4 x;
+    Float4 y;
+    Float4 z;
+};
+
+inline Vec3x4 operator - (const Vec3x4& lhs, const Vec3x4& rhs) { return Vec3x4(lhs.x-rhs.x, lhs.y-rhs.y, lhs.z-rhs.z); }
+
+// same order of operations as osg::Vec3 operator * and operator ^, so results match the scalar code exactly.
+inline Float4 dot(const Vec3x4& lhs, const Vec3x4& rhs) { return lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z; }
+
+inline Vec3x4 cross(const Vec3x4& lhs, const Vec3x4& rhs)
+{
+    return Vec3x4(lhs.y*rhs.z - lhs.z*rhs.y,
+                  lhs.z*rhs.x - lhs.x*rhs.z,
+                  lhs.x*rhs.y - lhs.y*rhs.x);
+}
+
+const float intersectionEpsilon = 1e-10f;
+
+/** Ray/triangle test of the ray starting at s along the unit direction d, returns true when the triangle is hit
+  * within length, setting r to the ratio along the ray and r0, r1 and r2 to the barycentric coordinates of the hit.*/
+inline bool intersectTriangle(const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2,
+                              const osg::Vec3& s, const osg::Vec3& d, float length, float inverse_length,
+                              float& r, float& r0, float& r1, float& r2)
+{
+    osg::Vec3 T = s - v0;
+    osg::Vec3 E2 = v2 - v0;
+    osg::Vec3 E1 = v1 - v0;
+
+    osg::Vec3 P =  d ^ E2;
+
+    float det = P * E1;
+
+    if (det>intersectionEpsilon)
+    {
+        float u = (P*T);
+        if (u<0.0 || u>det) return false;
+
+        osg::Vec3 Q = T ^ E1;
+        float v = (Q*d);
+        if (v<0.0 || v>det) return false;
+
+        if ((u+v)> det) return false;
+
+        float inv_det = 1.0f/det;
+        float t = (Q*E2)*inv_det;
+        if (t<0.0 || t>length) return false;
+
+        u *= inv_det;
+        v *= inv_det;
+
+        r0 = 1.0f-u-v;
+        r1 = u;
+        r2 = v;
+        r = t * inverse_length;
+    }
+    else if (det<-intersectionEpsilon)
+    {
+
+        float u = (P*T);
+        if (u>0.0 || u<det) return false;
+
+        osg::Vec3 Q = T ^ E1;
+        float v = (Q*d);
+        if (v>0.0 || v<det) return false;
+
+        if ((u+v) < det) return false;
+
+        float inv_det = 1.0f/det;
+        float t = (Q*E2)*inv_det;
+        if (t<0.0 || t>length) return false;
+
+        u *= inv_det;
+        v *= inv_det;
+
+        r0 = 1.0f-u-v;
+        r1 = u;
+        r2 = v;
+        r = t * inverse_length;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/** Four ray/triangle tests at once, lane by lane the same arithmetic and result as intersectTriangle(),
+  * returns the lanes that hit with the distance along each ray in t.*/
+inline Bool4 intersectTriangles(const Vec3x4& v0, const Vec3x4& v1, const Vec3x4& v2,
+                                const Vec3x4& s, const Vec3x4& d, const Float4& length, Float4& t)
+{
+    Vec3x4 T = s - v0;
+    Vec3x4 E2 = v2 - v0;
+    Vec3x4 E1 = v1 - v0;
+
+    Vec3x4 P = cross(d, E2);
+    Float4 det = dot(P, E1);
+    Float4 u = dot(P, T);
+
+    Vec3x4 Q = cross(T, E1);
+    Float4 v = dot(Q, d);
+
+    t = dot(Q, E2)*(Float4(1.0f)/det);
+
+    Float4 zero(0.0f);
+    Float4 uv = u+v;
+    Bool4 outside = (t<zero) | (t>length);
+    Bool4 positive = andNot(det>Float4(intersectionEpsilon), outside | (u<zero) | (u>det) | (v<zero) | (v>det) | (uv>det));
+    Bool4 negative = andNot(det<Float4(-intersectionEpsilon), outside | (u>zero) | (u<det) | (v>zero) | (v<det) | (uv<det));
+    return positive | negative;
+}
+
+void setIntersection(KdTree::LineSegmentIntersection& intersection, const KdTree::Triangle& tri, unsigned int primitiveIndex,
+                     const osg::Vec3& v0, const osg::Vec3& v1, const osg::Vec3& v2,
+                     float r, float r0, float r1, float r2)
+{
+    osg::Vec3 in = v0*r0 + v1*r1 + v2*r2;
+    osg::Vec3 normal = (v1-v0)^(v2-v0);
+    normal.normalize();
+
+    intersection.ratio = r;
+    intersection.primitiveIndex = primitiveIndex;
+    intersection.intersectionPoint = in;
+    intersection.intersectionNormal = normal;
+
+    intersection.p0 = tri.p0;
+    intersection.p1 = tri.p1;
+    intersection.p2 = tri.p2;
+    intersection.r0 = r0;
+    intersection.r1 = r1;
+    intersection.r2 = r2;
+}
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // IntersectKdTree
@@ -447,10 +1137,15 @@ struct IntersectKdTree
         _d_invX = _d.x()!=0.0f ? _d/_d.x() : osg::Vec3(0.0f,0.0f,0.0f);
         _d_invY = _d.y()!=0.0f ? _d/_d.y() : osg::Vec3(0.0f,0.0f,0.0f);
         _d_invZ = _d.z()!=0.0f ? _d/_d.z() : osg::Vec3(0.0f,0.0f,0.0f);
+
+        _s4 = Vec3x4(_s);
+        _d4 = Vec3x4(_d);
+        _length4 = Float4(_length);
     }
 
     void intersect(const KdTree::KdNode& node, const osg::Vec3& s, const osg::Vec3& e) const;
     bool intersectAndClip(osg::Vec3& s, osg::Vec3& e, const osg::BoundingBox& bb) const;
+    void intersectTriangle(unsigned int i) const;
 
     const osg::Vec3Array&               _vertices;
     const KdTree::KdNodeList&           _kdNodes;
@@ -468,12 +1163,29 @@ struct IntersectKdTree
     osg::Vec3 _d_invY;
     osg::Vec3 _d_invZ;
 
+    Vec3x4    _s4;
+    Vec3x4    _d4;
+    Float4    _length4;
 
 protected:
 
     IntersectKdTree& operator = (const IntersectKdTree&) { return *this; }
 };
 
+void IntersectKdTree::intersectTriangle(unsigned int i) const
+{
+    const KdTree::Triangle& tri = _triangles[i];
+
+    const osg::Vec3& v0 = _vertices[tri.p0];
+    const osg::Vec3& v1 = _vertices[tri.p1];
+    const osg::Vec3& v2 = _vertices[tri.p2];
+
+    float r,r0,r1,r2;
+    if (!::intersectTriangle(v0, v1, v2, _s, _d, _length, _inverse_length, r, r0, r1, r2)) return;
+
+    _intersections.push_back(KdTree::LineSegmentIntersection());
+    setIntersection(_intersections.back(), tri, i, v0, v1, v2, r, r0, r1, r2);
+}
 
 void IntersectKdTree::intersect(const KdTree::KdNode& node, const osg::Vec3& ls, const osg::Vec3& le) const
 {
@@ -481,105 +1193,34 @@ void IntersectKdTree::intersect(const KdTree::KdNode& node, const osg::Vec3& ls,
     {
         // treat as a leaf
 
-        //OSG_NOTICE<<"KdTree::intersect("<<&leaf<<")"<<std::endl;
         int istart = -node.first-1;
         int iend = istart + node.second;
 
-        for(int i=istart; i<iend; ++i)
+        // reject four triangles at a time, only running the full test on the ones that are hit.
+        for(int i=istart; i<iend; i+=4)
         {
-            //const Triangle& tri = _triangles[_primitiveIndices[i]];
-            const KdTree::Triangle& tri = _triangles[i];
-            // OSG_NOTICE<<"   tri("<<tri.p1<<","<<tri.p2<<","<<tri.p3<<")"<<std::endl;
-
-            const osg::Vec3& v0 = _vertices[tri.p0];
-            const osg::Vec3& v1 = _vertices[tri.p1];
-            const osg::Vec3& v2 = _vertices[tri.p2];
-
-            osg::Vec3 T = _s - v0;
-            osg::Vec3 E2 = v2 - v0;
-            osg::Vec3 E1 = v1 - v0;
-
-            osg::Vec3 P =  _d ^ E2;
-
-            float det = P * E1;
-
-            float r,r0,r1,r2;
-
-            const float esplison = 1e-10f;
-            if (det>esplison)
+            int num = osg::minimum(4, iend-i);
+            if (num==1)
             {
-                float u = (P*T);
-                if (u<0.0 || u>det) continue;
-
-                osg::Vec3 Q = T ^ E1;
-                float v = (Q*_d);
-                if (v<0.0 || v>det) continue;
-
-                if ((u+v)> det) continue;
-
-                float inv_det = 1.0f/det;
-                float t = (Q*E2)*inv_det;
-                if (t<0.0 || t>_length) continue;
-
-                u *= inv_det;
-                v *= inv_det;
-
-                r0 = 1.0f-u-v;
-                r1 = u;
-                r2 = v;
-                r = t * _inverse_length;
+                intersectTriangle(i);
+                continue;
             }
-            else if (det<-esplison)
-            {
-
-                float u = (P*T);
-                if (u>0.0 || u<det) continue;
-
-                osg::Vec3 Q = T ^ E1;
-                float v = (Q*_d);
-                if (v>0.0 || v<det) continue;
 
-                if ((u+v) < det) continue;
+            const KdTree::Triangle& t0 = _triangles[i];
+            const KdTree::Triangle& t1 = _triangles[i+1];
+            const KdTree::Triangle& t2 = _triangles[i+osg::minimum(2, num-1)];
+            const KdTree::Triangle& t3 = _triangles[i+num-1];
 
-                float inv_det = 1.0f/det;
-                float t = (Q*E2)*inv_det;
-                if (t<0.0 || t>_length) continue;
+            Vec3x4 v0(_vertices[t0.p0], _vertices[t1.p0], _vertices[t2.p0], _vertices[t3.p0]);
+            Vec3x4 v1(_vertices[t0.p1], _vertices[t1.p1], _vertices[t2.p1], _vertices[t3.p1]);
+            Vec3x4 v2(_vertices[t0.p2], _vertices[t1.p2], _vertices[t2.p2], _vertices[t3.p2]);
 
-                u *= inv_det;
-                v *= inv_det;
-
-                r0 = 1.0f-u-v;
-                r1 = u;
-                r2 = v;
-                r = t * _inverse_length;
-            }
-            else
+            Float4 t;
+            int hits = intersectTriangles(v0, v1, v2, _s4, _d4, _length4, t).mask() & ((1<<num)-1);
+            for(int lane=0; hits!=0; ++lane, hits>>=1)
             {
-                continue;
+                if (hits&1) intersectTriangle(i+lane);
             }
-
-            osg::Vec3 in = v0*r0 + v1*r1 + v2*r2;
-            osg::Vec3 normal = E1^E2;
-            normal.normalize();
-
-#if 1
-            _intersections.push_back(KdTree::LineSegmentIntersection());
-            KdTree::LineSegmentIntersection& intersection = _intersections.back();
-
-            intersection.ratio = r;
-            intersection.primitiveIndex = i;
-            intersection.intersectionPoint = in;
-            intersection.intersectionNormal = normal;
-
-            intersection.p0 = tri.p0;
-            intersection.p1 = tri.p1;
-            intersection.p2 = tri.p2;
-            intersection.r0 = r0;
-            intersection.r1 = r1;
-            intersection.r2 = r2;
-
-#endif
-            // OSG_NOTICE<<"  got intersection ("<<in<<") ratio="<<r<<std::endl;
         }
     }
     else
@@ -731,14 +1372,226 @@ bool IntersectKdTree::intersectAndClip(osg::Vec3& s, osg::Vec3& e, const osg::Bo
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// IntersectKdTreePacket - nearest intersection of up to four line segments
+//
+struct IntersectKdTreePacket
+{
+    IntersectKdTreePacket(const osg::Vec3Array& vertices,
+                          const KdTree::KdNodeList& nodes,
+                          const KdTree::TriangleList& triangles,
+                          const KdTree::LineSegment* segments,
+                          int numSegments):
+                            _vertices(vertices),
+                            _kdNodes(nodes),
+                            _triangles(triangles),
+                            _numSegments(numSegments)
+    {
+        float sx[4], sy[4], sz[4], dx[4], dy[4], dz[4], invX[4], invY[4], invZ[4];
+        for(int lane=0; lane<4; ++lane)
+        {
+            // unused lanes repeat the first segment and are masked off.
+            const KdTree::LineSegment& segment = segments[lane<numSegments ? lane : 0];
+
+            // same set up as IntersectKdTree so that the hits match.
+            osg::Vec3 d = segment.end - segment.start;
+            _lengths[lane] = d.length();
+            _inverse_lengths[lane] = _lengths[lane]!=0.0f ? 1.0f/_lengths[lane] : 0.0;
+            d *= _inverse_lengths[lane];
+
+            _starts[lane] = segment.start;
+            _directions[lane] = d;
+
+            sx[lane] = _starts[lane].x(); sy[lane] = _starts[lane].y(); sz[lane] = _starts[lane].z();
+            dx[lane] = d.x(); dy[lane] = d.y(); dz[lane] = d.z();
+
+            // keep the reciprocals finite so the slab tests never compute 0*inf.
+            invX[lane] = reciprocal(d.x());
+            invY[lane] = reciprocal(d.y());
+            invZ[lane] = reciprocal(d.z());
+
+            _nearestTriangles[lane] = -1;
+        }
+
+        _s = Vec3x4(Float4(sx[0], sx[1], sx[2], sx[3]), Float4(sy[0], sy[1], sy[2], sy[3]), Float4(sz[0], sz[1], sz[2], sz[3]));
+        _d = Vec3x4(Float4(dx[0], dx[1], dx[2], dx[3]), Float4(dy[0], dy[1], dy[2], dy[3]), Float4(dz[0], dz[1], dz[2], dz[3]));
+        _inverseD = Vec3x4(Float4(invX[0], invX[1], invX[2], invX[3]), Float4(invY[0], invY[1], invY[2], invY[3]), Float4(invZ[0], invZ[1], invZ[2], invZ[3]));
+        _length = Float4(_lengths[0], _lengths[1], _lengths[2], _lengths[3]);
+        _nearest = _length;
+        _active = Float4(0.0f, 1.0f, 2.0f, 3.0f) < Float4(float(numSegments));
+        _found = Float4(0.0f) < Float4(0.0f);
+    }
+
+    static float reciprocal(float value)
+    {
+        const float minimum = 1e-20f;
+        if (value>=0.0f) return value>minimum ? 1.0f/value : 1.0f/minimum;
+        else return value<-minimum ? 1.0f/value : -1.0f/minimum;
+    }
+
+    /** return the lanes whose segment, up to the nearest hit so far, passes through bb, with the entry distances in entry.*/
+    inline Bool4 intersectBox(const osg::BoundingBox& bb, Float4& entry) const
+    {
+        Float4 x0 = (Float4(bb.xMin())-_s.x)*_inverseD.x;
+        Float4 x1 = (Float4(bb.xMax())-_s.x)*_inverseD.x;
+        Float4 y0 = (Float4(bb.yMin())-_s.y)*_inverseD.y;
+        Float4 y1 = (Float4(bb.yMax())-_s.y)*_inverseD.y;
+        Float4 z0 = (Float4(bb.zMin())-_s.z)*_inverseD.z;
+        Float4 z1 = (Float4(bb.zMax())-_s.z)*_inverseD.z;
+
+        entry = maximum(maximum(minimum(x0, x1), minimum(y0, y1)), maximum(minimum(z0, z1), Float4(0.0f)));
+        Float4 exit = minimum(minimum(maximum(x0, x1), maximum(y0, y1)), minimum(maximum(z0, z1), _nearest));
+        return _active & (entry<=exit);
+    }
+
+    void intersect(const KdTree::KdNode& node);
+
+    int getNearestIntersections(KdTree::LineSegmentIntersection* intersections) const;
+
+    const osg::Vec3Array&               _vertices;
+    const KdTree::KdNodeList&           _kdNodes;
+    const KdTree::TriangleList&         _triangles;
+    int                                 _numSegments;
+
+    osg::Vec3   _starts[4];
+    osg::Vec3   _directions[4];
+    float       _lengths[4];
+    float       _inverse_lengths[4];
+    int         _nearestTriangles[4];
+
+    Vec3x4      _s;
+    Vec3x4      _d;
+    Vec3x4      _inverseD;
+    Float4      _length;
+    Float4      _nearest;
+    Bool4       _active;
+    Bool4       _found;
+
+protected:
+
+    IntersectKdTreePacket& operator = (const IntersectKdTreePacket&) { return *this; }
+};
+
+void IntersectKdTreePacket::intersect(const KdTree::KdNode& node)
+{
+    if (node.first<0)
+    {
+        int istart = -node.first-1;
+        int iend = istart + node.second;
+
+        // each triangle is tested against all four segments at once.
+        for(int i=istart; i<iend; ++i)
+        {
+            const KdTree::Triangle& tri = _triangles[i];
+
+            Float4 t;
+            Bool4 hits = _active & intersectTriangles(Vec3x4(_vertices[tri.p0]), Vec3x4(_vertices[tri.p1]), Vec3x4(_vertices[tri.p2]),
+                                                      _s, _d, _length, t);
+
+            // keep the hit unless a nearer one has already been found.
+            Bool4 nearer = andNot(hits, andNot(_found, t<_nearest));
+
+            int mask = nearer.mask();
+            if (mask==0) continue;
+
+            _nearest = select(nearer, t, _nearest);
+            _found = _found | nearer;
+            for(int lane=0; mask!=0; ++lane, mask>>=1)
+            {
+                if (mask&1) _nearestTriangles[lane] = i;
+            }
+        }
+        return;
+    }
+
+    Float4 firstEntry, secondEntry;
+    int firstMask = node.first>0 ? intersectBox(_kdNodes[node.first].bb, firstEntry).mask() : 0;
+    int secondMask = node.second>0 ? intersectBox(_kdNodes[node.second].bb, secondEntry).mask() : 0;
+
+    if (firstMask!=0 && secondMask!=0)
+    {
+        // visit the child the segments enter first, so the nearest hits found there can cull the other child.
+        float firstEntries[4], secondEntries[4];
+        firstEntry.store(firstEntries);
+        secondEntry.store(secondEntries);
+
+        float firstNearest = FLT_MAX, secondNearest = FLT_MAX;
+        for(int lane=0; lane<4; ++lane)
+        {
+            if (firstMask&(1<<lane)) firstNearest = osg::minimum(firstNearest, firstEntries[lane]);
+            if (secondMask&(1<<lane)) secondNearest = osg::minimum(secondNearest, secondEntries[lane]);
+        }
+
+        int nearChild = firstNearest<=secondNearest ? node.first : node.second;
+        int farChild = firstNearest<=secondNearest ? node.second : node.first;
+
+        intersect(_kdNodes[nearChild]);
+
+        Float4 entry;
+        if (intersectBox(_kdNodes[farChild].bb, entry).mask()!=0) intersect(_kdNodes[farChild]);
+    }
+    else if (firstMask!=0)
+    {
+        intersect(_kdNodes[node.first]);
+    }
+    else if (secondMask!=0)
+    {
+        intersect(_kdNodes[node.second]);
+    }
+}
+
+int IntersectKdTreePacket::getNearestIntersections(KdTree::LineSegmentIntersection* intersections) const
+{
+    int numHits = 0;
+    for(int lane=0; lane<_numSegments; ++lane)
+    {
+        int i = _nearestTriangles[lane];
+        if (i<0) continue;
+
+        const KdTree::Triangle& tri = _triangles[i];
+        const osg::Vec3& v0 = _vertices[tri.p0];
+        const osg::Vec3& v1 = _vertices[tri.p1];
+        const osg::Vec3& v2 = _vertices[tri.p2];
+
+        float r,r0,r1,r2;
+        if (intersectTriangle(v0, v1, v2, _starts[lane], _directions[lane], _lengths[lane], _inverse_lengths[lane], r, r0, r1, r2))
+        {
+            setIntersection(intersections[lane], tri, i, v0, v1, v2, r, r0, r1, r2);
+            ++numHits;
+        }
+    }
+    return numHits;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTree::BuildOptions
 
+static ApplicationUsageProxy ApplicationUsageProxyKdTree_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_KDTREE_BUILD_THREADS <int>","Set the number of threads used to build KdTrees, 0 uses the number of processors.");
+
+static unsigned int readNumKdTreeBuildThreads()
+{
+    const char* str = getenv("OSG_KDTREE_BUILD_THREADS");
+    return str ? static_cast<unsigned int>(atoi(str)) : 1;
+}
+
+// read once rather than on each construction, as BuildOptions are created for every KdTree built. Held in a function
+// so that it is read on first use, the Registry's KdTreeBuilder may be constructed during static initialization.
+static unsigned int getNumKdTreeBuildThreads()
+{
+    static unsigned int s_numKdTreeBuildThreads = readNumKdTreeBuildThreads();
+    return s_numKdTreeBuildThreads;
+}
+
 KdTree::BuildOptions::BuildOptions():
         _numVerticesProcessed(0),
         _targetNumTrianglesPerLeaf(4),
-        _maxNumLevels(32)
+        _maxNumLevels(32),
+        _buildMethod(SPATIAL_MIDPOINT),
+        _numSurfaceAreaBins(16),
+        _numThreads(getNumKdTreeBuildThreads())
 {
 }
 
@@ -785,11 +1638,43 @@ bool KdTree::intersect(const osg::Vec3d& start, const osg::Vec3d& end, LineSegme
     return numIntersectionsBefore != intersections.size();
 }
 
+unsigned int KdTree::intersect(const LineSegmentList& segments, LineSegmentIntersections& nearestIntersections) const
+{
+    nearestIntersections.clear();
+    nearestIntersections.resize(segments.size());
+
+    if (_kdNodes.empty())
+    {
+        OSG_NOTICE<<"Warning: _kdTree is empty"<<std::endl;
+        return 0;
+    }
+
+    unsigned int numHits = 0;
+    for(unsigned int i=0; i<segments.size(); i+=4)
+    {
+        int numSegments = static_cast<int>(osg::minimum(segments.size()-i, static_cast<LineSegmentList::size_type>(4)));
+
+        IntersectKdTreePacket intersector(*_vertices,
+                                          _kdNodes,
+                                          _triangles,
+                                          &segments[i],
+                                          numSegments);
+
+        Float4 entry;
+        if (intersector.intersectBox(getNode(0).bb, entry).mask()!=0) intersector.intersect(getNode(0));
+
+        numHits += intersector.getNearestIntersections(&nearestIntersections[i]);
+    }
+
+    return numHits;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // KdTreeBuilder
 KdTreeBuilder::KdTreeBuilder():
-    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    _buildInParallel(false)
 {
     _kdTreePrototype = new osg::KdTree;
 }
@@ -797,7 +1682,8 @@ KdTreeBuilder::KdTreeBuilder():
 KdTreeBuilder::KdTreeBuilder(const KdTreeBuilder& rhs):
     osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
     _buildOptions(rhs._buildOptions),
-    _kdTreePrototype(rhs._kdTreePrototype)
+    _kdTreePrototype(rhs._kdTreePrototype),
+    _buildInParallel(rhs._buildInParallel)
 {
 }
 
@@ -812,13 +1698,162 @@ void KdTreeBuilder::apply(osg::Geode& geode)
             osg::KdTree* previous = dynamic_cast<osg::KdTree*>(geom->getShape());
             if (previous) continue;
 
-            osg::ref_ptr<osg::Object> obj = _kdTreePrototype->cloneType();
-            osg::ref_ptr<osg::KdTree> kdTree = dynamic_cast<osg::KdTree*>(obj.get());
+            if (_buildInParallel) _geometries.push_back(geom);
+            else buildKdTree(_buildOptions, geom);
+        }
+    }
+}
+
+void KdTreeBuilder::buildKdTree(KdTree::BuildOptions& buildOptions, osg::Geometry* geom)
+{
+    osg::ref_ptr<osg::Object> obj = _kdTreePrototype->cloneType();
+    osg::ref_ptr<osg::KdTree> kdTree = dynamic_cast<osg::KdTree*>(obj.get());
+
+    if (kdTree->build(buildOptions, geom))
+    {
+        geom->setShape(kdTree.get());
+    }
+}
+
+namespace
+{
 
-            if (kdTree->build(_buildOptions, geom))
+unsigned int getNumTriangles(const osg::Geometry* geometry)
+{
+    unsigned int numTriangles = 0;
+    for(unsigned int i=0; i<geometry->getNumPrimitiveSets(); ++i)
+    {
+        const osg::PrimitiveSet* primitiveSet = geometry->getPrimitiveSet(i);
+        unsigned int numIndices = primitiveSet->getNumIndices();
+        switch(primitiveSet->getMode())
+        {
+            case(osg::PrimitiveSet::TRIANGLES):
+                numTriangles += numIndices/3;
+                break;
+            case(osg::PrimitiveSet::QUADS):
+                numTriangles += (numIndices/4)*2;
+                break;
+            case(osg::PrimitiveSet::TRIANGLE_STRIP):
+            case(osg::PrimitiveSet::TRIANGLE_FAN):
+            case(osg::PrimitiveSet::QUAD_STRIP):
+            case(osg::PrimitiveSet::POLYGON):
             {
-                geom->setShape(kdTree.get());
+                // each strip, fan or polygon has two fewer triangles than indices.
+                unsigned int numPrimitives = primitiveSet->getNumPrimitives();
+                if (numIndices>2*numPrimitives) numTriangles += numIndices-2*numPrimitives;
+                break;
             }
+            default:
+                break;
         }
     }
+    return numTriangles;
+}
+
+struct GeometryTriangles
+{
+    GeometryTriangles(osg::Geometry* g): geometry(g), numTriangles(getNumTriangles(g)) {}
+
+    osg::ref_ptr<osg::Geometry> geometry;
+    unsigned int                numTriangles;
+};
+
+struct LargestGeometryFirst
+{
+    bool operator () (const GeometryTriangles& lhs, const GeometryTriangles& rhs) const
+    {
+        if (lhs.numTriangles!=rhs.numTriangles) return lhs.numTriangles>rhs.numTriangles;
+        return lhs.geometry.get()<rhs.geometry.get();
+    }
+};
+
+struct BuildKdTreeOperation : public ParallelOperation
+{
+    typedef std::vector< osg::ref_ptr<osg::Geometry> > GeometryList;
+    typedef std::vector< osg::ref_ptr<osg::KdTree> > KdTreeList;
+    typedef std::vector< KdTree::BuildOptions > BuildOptionsList;
+
+    BuildKdTreeOperation(const osg::KdTree* kdTreePrototype, const KdTree::BuildOptions& buildOptions, const GeometryList& geometries, unsigned int start):
+        _kdTreePrototype(kdTreePrototype),
+        _geometries(geometries),
+        _start(start),
+        _kdTrees(geometries.size()-start),
+        _buildOptions(geometries.size()-start, buildOptions)
+    {
+        // these meshes are too small to be divided in parallel, and each is built by a single thread.
+        for(BuildOptionsList::iterator itr = _buildOptions.begin();
+            itr != _buildOptions.end();
+            ++itr)
+        {
+            itr->_numVerticesProcessed = 0;
+            itr->_numThreads = 1;
+        }
+    }
+
+    virtual void operator () (unsigned int index)
+    {
+        osg::ref_ptr<osg::Object> obj = _kdTreePrototype->cloneType();
+        osg::ref_ptr<osg::KdTree> kdTree = dynamic_cast<osg::KdTree*>(obj.get());
+
+        if (kdTree->build(_buildOptions[index], _geometries[_start+index].get()))
+        {
+            _kdTrees[index] = kdTree;
+        }
+    }
+
+    const osg::KdTree*      _kdTreePrototype;
+    const GeometryList&     _geometries;
+    unsigned int            _start;
+    KdTreeList              _kdTrees;
+    BuildOptionsList        _buildOptions;
+
+protected:
+
+    BuildKdTreeOperation& operator = (const BuildKdTreeOperation&) { return *this; }
+};
+
+}
+
+void KdTreeBuilder::buildKdTrees()
+{
+    if (_geometries.empty()) return;
+
+    // sort largest first, which also brings together any Geometry shared between Geodes so it's only built once.
+    std::vector<GeometryTriangles> sorted(_geometries.begin(), _geometries.end());
+    std::sort(sorted.begin(), sorted.end(), LargestGeometryFirst());
+
+    _geometries.clear();
+    unsigned int numLarge = 0;
+    for(std::vector<GeometryTriangles>::iterator itr = sorted.begin();
+        itr != sorted.end();
+        ++itr)
+    {
+        if (!_geometries.empty() && _geometries.back()==itr->geometry) continue;
+
+        _geometries.push_back(itr->geometry);
+        if (itr->numTriangles>=s_minimumNumTrianglesToDivideInParallel) ++numLarge;
+    }
+
+    // large meshes are built one after another, each divided in parallel.
+    unsigned int numThreads = computeNumThreads(_buildOptions);
+    unsigned int start = 0;
+    for(; start<numLarge; ++start)
+    {
+        buildKdTree(_buildOptions, _geometries[start].get());
+    }
+
+    // the rest are shared between the threads, largest first so that the last few are quick to complete.
+    if (start<_geometries.size())
+    {
+        BuildKdTreeOperation operation(_kdTreePrototype.get(), _buildOptions, _geometries, start);
+        runParallel(operation, operation._kdTrees.size(), numThreads);
+
+        for(unsigned int i=0; i<operation._kdTrees.size(); ++i)
+        {
+            if (operation._kdTrees[i].valid()) _geometries[start+i]->setShape(operation._kdTrees[i].get());
+            _buildOptions._numVerticesProcessed += operation._buildOptions[i]._numVerticesProcessed;
+        }
+    }
+
+    _geometries.clear();
 }
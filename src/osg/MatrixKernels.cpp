@@ -0,0 +1,328 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include "MatrixKernels.h"
+
+#include <osg/Vec3f>
+#include <osg/Vec3d>
+
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2) && defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+using namespace osg;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Per vector code, the reference the kernels have to match.
+
+namespace
+{
+
+// the same expressions as Matrixd::preMult(const Vec3f&) and friends, with d held as T so it is rounded as value_type d is there.
+template<typename T, class V>
+void transformPointsGeneric(const T basis[4][4], const V* src, V* dest, unsigned int num)
+{
+    for(unsigned int i=0; i<num; ++i)
+    {
+        V v = src[i];
+        T d = 1.0f/(basis[0][3]*v.x() + basis[1][3]*v.y() + basis[2][3]*v.z() + basis[3][3]);
+        dest[i].set((basis[0][0]*v.x() + basis[1][0]*v.y() + basis[2][0]*v.z() + basis[3][0])*d,
+                    (basis[0][1]*v.x() + basis[1][1]*v.y() + basis[2][1]*v.z() + basis[3][1])*d,
+                    (basis[0][2]*v.x() + basis[1][2]*v.y() + basis[2][2]*v.z() + basis[3][2])*d);
+    }
+}
+
+template<typename T, class V>
+void transformVectorsGeneric(const T basis[4][4], const V* src, V* dest, unsigned int num)
+{
+    for(unsigned int i=0; i<num; ++i)
+    {
+        V v = src[i];
+        dest[i].set(basis[0][0]*v.x() + basis[1][0]*v.y() + basis[2][0]*v.z(),
+                    basis[0][1]*v.x() + basis[1][1]*v.y() + basis[2][1]*v.z(),
+                    basis[0][2]*v.x() + basis[1][2]*v.y() + basis[2][2]*v.z());
+    }
+}
+
+}
+
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SSE2 kernels
+
+namespace
+{
+
+// store the first three components of a, as dest may be the last vector of the array.
+inline void storeVec3(float* dest, __m128 a)
+{
+    _mm_storel_epi64((__m128i*)dest, _mm_castps_si128(a));
+    _mm_store_ss(dest+2, _mm_movehl_ps(a, a));
+}
+
+void transformPointsd3fSSE2(const double basis[4][4], const float* src, float* dest, unsigned int num)
+{
+    __m128d b0a = _mm_loadu_pd(basis[0]), b0b = _mm_loadu_pd(basis[0]+2);
+    __m128d b1a = _mm_loadu_pd(basis[1]), b1b = _mm_loadu_pd(basis[1]+2);
+    __m128d b2a = _mm_loadu_pd(basis[2]), b2b = _mm_loadu_pd(basis[2]+2);
+    __m128d b3a = _mm_loadu_pd(basis[3]), b3b = _mm_loadu_pd(basis[3]+2);
+    __m128d one = _mm_set1_pd(1.0);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m128d x = _mm_set1_pd(src[0]);
+        __m128d y = _mm_set1_pd(src[1]);
+        __m128d z = _mm_set1_pd(src[2]);
+
+        __m128d a = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b0a, x), _mm_mul_pd(b1a, y)), _mm_mul_pd(b2a, z)), b3a);
+        __m128d b = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b0b, x), _mm_mul_pd(b1b, y)), _mm_mul_pd(b2b, z)), b3b);
+
+        __m128d d = _mm_div_pd(one, _mm_unpackhi_pd(b, b));
+
+        storeVec3(dest, _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(a, d)), _mm_cvtpd_ps(_mm_mul_pd(b, d))));
+    }
+}
+
+void transformPointsd3dSSE2(const double basis[4][4], const double* src, double* dest, unsigned int num)
+{
+    __m128d b0a = _mm_loadu_pd(basis[0]), b0b = _mm_loadu_pd(basis[0]+2);
+    __m128d b1a = _mm_loadu_pd(basis[1]), b1b = _mm_loadu_pd(basis[1]+2);
+    __m128d b2a = _mm_loadu_pd(basis[2]), b2b = _mm_loadu_pd(basis[2]+2);
+    __m128d b3a = _mm_loadu_pd(basis[3]), b3b = _mm_loadu_pd(basis[3]+2);
+    __m128d one = _mm_set1_pd(1.0);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m128d x = _mm_set1_pd(src[0]);
+        __m128d y = _mm_set1_pd(src[1]);
+        __m128d z = _mm_set1_pd(src[2]);
+
+        __m128d a = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b0a, x), _mm_mul_pd(b1a, y)), _mm_mul_pd(b2a, z)), b3a);
+        __m128d b = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b0b, x), _mm_mul_pd(b1b, y)), _mm_mul_pd(b2b, z)), b3b);
+
+        __m128d d = _mm_div_pd(one, _mm_unpackhi_pd(b, b));
+
+        _mm_storeu_pd(dest, _mm_mul_pd(a, d));
+        _mm_store_sd(dest+2, _mm_mul_pd(b, d));
+    }
+}
+
+void transformPointsf3fSSE2(const float basis[4][4], const float* src, float* dest, unsigned int num)
+{
+    __m128 b0 = _mm_loadu_ps(basis[0]);
+    __m128 b1 = _mm_loadu_ps(basis[1]);
+    __m128 b2 = _mm_loadu_ps(basis[2]);
+    __m128 b3 = _mm_loadu_ps(basis[3]);
+    __m128 one = _mm_set1_ps(1.0f);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m128 x = _mm_set1_ps(src[0]);
+        __m128 y = _mm_set1_ps(src[1]);
+        __m128 z = _mm_set1_ps(src[2]);
+
+        __m128 a = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, x), _mm_mul_ps(b1, y)), _mm_mul_ps(b2, z)), b3);
+        __m128 d = _mm_div_ps(one, _mm_shuffle_ps(a, a, _MM_SHUFFLE(3,3,3,3)));
+
+        storeVec3(dest, _mm_mul_ps(a, d));
+    }
+}
+
+void transformVectorsd3fSSE2(const double basis[4][4], const float* src, float* dest, unsigned int num)
+{
+    __m128d b0a = _mm_loadu_pd(basis[0]), b0b = _mm_load_sd(basis[0]+2);
+    __m128d b1a = _mm_loadu_pd(basis[1]), b1b = _mm_load_sd(basis[1]+2);
+    __m128d b2a = _mm_loadu_pd(basis[2]), b2b = _mm_load_sd(basis[2]+2);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m128d x = _mm_set1_pd(src[0]);
+        __m128d y = _mm_set1_pd(src[1]);
+        __m128d z = _mm_set1_pd(src[2]);
+
+        __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(b0a, x), _mm_mul_pd(b1a, y)), _mm_mul_pd(b2a, z));
+        __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(b0b, x), _mm_mul_pd(b1b, y)), _mm_mul_pd(b2b, z));
+
+        storeVec3(dest, _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b)));
+    }
+}
+
+void transformVectorsd3dSSE2(const double basis[4][4], const double* src, double* dest, unsigned int num)
+{
+    __m128d b0a = _mm_loadu_pd(basis[0]), b0b = _mm_load_sd(basis[0]+2);
+    __m128d b1a = _mm_loadu_pd(basis[1]), b1b = _mm_load_sd(basis[1]+2);
+    __m128d b2a = _mm_loadu_pd(basis[2]), b2b = _mm_load_sd(basis[2]+2);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m128d x = _mm_set1_pd(src[0]);
+        __m128d y = _mm_set1_pd(src[1]);
+        __m128d z = _mm_set1_pd(src[2]);
+
+        __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(b0a, x), _mm_mul_pd(b1a, y)), _mm_mul_pd(b2a, z));
+        __m128d b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(b0b, x), _mm_mul_pd(b1b, y)), _mm_mul_pd(b2b, z));
+
+        _mm_storeu_pd(dest, a);
+        _mm_store_sd(dest+2, b);
+    }
+}
+
+void transformVectorsf3fSSE2(const float basis[4][4], const float* src, float* dest, unsigned int num)
+{
+    __m128 b0 = _mm_loadu_ps(basis[0]);
+    __m128 b1 = _mm_loadu_ps(basis[1]);
+    __m128 b2 = _mm_loadu_ps(basis[2]);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m128 x = _mm_set1_ps(src[0]);
+        __m128 y = _mm_set1_ps(src[1]);
+        __m128 z = _mm_set1_ps(src[2]);
+
+        storeVec3(dest, _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, x), _mm_mul_ps(b1, y)), _mm_mul_ps(b2, z)));
+    }
+}
+
+const MatrixKernelFunctions s_sse2MatrixKernelFunctions =
+{
+    transformPointsd3fSSE2,
+    transformPointsd3dSSE2,
+    transformPointsf3fSSE2,
+    transformVectorsd3fSSE2,
+    transformVectorsd3dSSE2,
+    transformVectorsf3fSSE2
+};
+
+#if defined(_MSC_VER)
+bool cpuSupportsAVX()
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0]<1) return false;
+
+    // AVX needs the operating system to save the upper halves of the ymm registers.
+    __cpuid(info, 1);
+    if ((info[2] & (1<<27))==0 || (info[2] & (1<<28))==0) return false;
+    return (_xgetbv(0) & 6)==6;
+}
+#else
+bool cpuSupportsAVX()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx")!=0;
+}
+#endif
+
+MatrixKernelFunctions computeMatrixKernelFunctions()
+{
+    MatrixKernelFunctions functions = s_sse2MatrixKernelFunctions;
+
+    // the kernels without an AVX version stay SSE2.
+    const MatrixKernelFunctions* avx = getAVXMatrixKernelFunctions();
+    if (avx && cpuSupportsAVX())
+    {
+        if (avx->transformPointsd3f) functions.transformPointsd3f = avx->transformPointsd3f;
+        if (avx->transformPointsd3d) functions.transformPointsd3d = avx->transformPointsd3d;
+        if (avx->transformPointsf3f) functions.transformPointsf3f = avx->transformPointsf3f;
+        if (avx->transformVectorsd3f) functions.transformVectorsd3f = avx->transformVectorsd3f;
+        if (avx->transformVectorsd3d) functions.transformVectorsd3d = avx->transformVectorsd3d;
+        if (avx->transformVectorsf3f) functions.transformVectorsf3f = avx->transformVectorsf3f;
+    }
+    return functions;
+}
+
+const MatrixKernelFunctions& getMatrixKernelFunctions()
+{
+    static MatrixKernelFunctions s_matrixKernelFunctions = computeMatrixKernelFunctions();
+    return s_matrixKernelFunctions;
+}
+
+}
+
+void osg::transformPoints(const double basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    getMatrixKernelFunctions().transformPointsd3f(basis, reinterpret_cast<const float*>(src), reinterpret_cast<float*>(dest), num);
+}
+
+void osg::transformPoints(const double basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num)
+{
+    getMatrixKernelFunctions().transformPointsd3d(basis, reinterpret_cast<const double*>(src), reinterpret_cast<double*>(dest), num);
+}
+
+void osg::transformPoints(const float basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    getMatrixKernelFunctions().transformPointsf3f(basis, reinterpret_cast<const float*>(src), reinterpret_cast<float*>(dest), num);
+}
+
+void osg::transformVectors(const double basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    getMatrixKernelFunctions().transformVectorsd3f(basis, reinterpret_cast<const float*>(src), reinterpret_cast<float*>(dest), num);
+}
+
+void osg::transformVectors(const double basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num)
+{
+    getMatrixKernelFunctions().transformVectorsd3d(basis, reinterpret_cast<const double*>(src), reinterpret_cast<double*>(dest), num);
+}
+
+void osg::transformVectors(const float basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    getMatrixKernelFunctions().transformVectorsf3f(basis, reinterpret_cast<const float*>(src), reinterpret_cast<float*>(dest), num);
+}
+
+#else
+
+void osg::transformPoints(const double basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    transformPointsGeneric(basis, src, dest, num);
+}
+
+void osg::transformPoints(const double basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num)
+{
+    transformPointsGeneric(basis, src, dest, num);
+}
+
+void osg::transformPoints(const float basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    transformPointsGeneric(basis, src, dest, num);
+}
+
+void osg::transformVectors(const double basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    transformVectorsGeneric(basis, src, dest, num);
+}
+
+void osg::transformVectors(const double basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num)
+{
+    transformVectorsGeneric(basis, src, dest, num);
+}
+
+void osg::transformVectors(const float basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num)
+{
+    transformVectorsGeneric(basis, src, dest, num);
+}
+
+#endif
+
+// Matrixf with Vec3d mixes float and double arithmetic, which isn't worth a kernel of its own.
+void osg::transformPoints(const float basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num)
+{
+    transformPointsGeneric(basis, src, dest, num);
+}
+
+void osg::transformVectors(const float basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num)
+{
+    transformVectorsGeneric(basis, src, dest, num);
+}
@@ -0,0 +1,152 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSG_MATRIXKERNELS_H
+#define OSG_MATRIXKERNELS_H 1
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+    #define OSG_MATRIX_KERNELS_USE_SSE2
+#endif
+
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+    #include <emmintrin.h>
+#endif
+
+namespace osg
+{
+
+class Vec3f;
+class Vec3d;
+
+/** Kernels transforming arrays of 3 component vectors by a 4x4 basis, each vector v giving basis[0]*v[0] + basis[1]*v[1] + basis[2]*v[2],
+  * summed in that order. The points kernels add basis[3] and divide the first three components of the sum by its fourth, as
+  * Matrixd::preMult(const Vec3f&) does with the matrix rows as the basis and postMult(const Vec3f&) with its columns, the vectors
+  * kernels stop after the third basis vector as transform3x3() does. The first letter of the suffix is the precision of the basis,
+  * so of the arithmetic, the rest the type of the vectors. src and dest may be the same array.*/
+struct MatrixKernelFunctions
+{
+    void (*transformPointsd3f)(const double basis[4][4], const float* src, float* dest, unsigned int num);
+    void (*transformPointsd3d)(const double basis[4][4], const double* src, double* dest, unsigned int num);
+    void (*transformPointsf3f)(const float basis[4][4], const float* src, float* dest, unsigned int num);
+
+    void (*transformVectorsd3f)(const double basis[4][4], const float* src, float* dest, unsigned int num);
+    void (*transformVectorsd3d)(const double basis[4][4], const double* src, double* dest, unsigned int num);
+    void (*transformVectorsf3f)(const float basis[4][4], const float* src, float* dest, unsigned int num);
+};
+
+/** Return the AVX kernels, 0 if they weren't compiled in. Kernels without an AVX version are left as 0.*/
+extern const MatrixKernelFunctions* getAVXMatrixKernelFunctions();
+
+/** Transform num points by basis using the kernels of the most capable instruction set the CPU supports,
+  * giving bit for bit the same results as the Matrixd and Matrixf preMult() and postMult() of a single Vec3.*/
+extern void transformPoints(const double basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num);
+extern void transformPoints(const double basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num);
+extern void transformPoints(const float basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num);
+extern void transformPoints(const float basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num);
+
+/** Transform num vectors by the upper 3x3 of basis, as the Matrixd and Matrixf transform3x3() of a single Vec3 do.*/
+extern void transformVectors(const double basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num);
+extern void transformVectors(const double basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num);
+extern void transformVectors(const float basis[4][4], const Vec3f* src, Vec3f* dest, unsigned int num);
+extern void transformVectors(const float basis[4][4], const Vec3d* src, Vec3d* dest, unsigned int num);
+
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+
+/** Set result to lhs*rhs, each row of the result being lhs[r][0]*rhs[0] + lhs[r][1]*rhs[1] + lhs[r][2]*rhs[2] + lhs[r][3]*rhs[3]
+  * so each element is summed in the same order as Matrix_implementation::mult() does. result may be lhs or rhs.*/
+inline void multMatrix(const float lhs[4][4], const float rhs[4][4], float result[4][4])
+{
+    __m128 r0 = _mm_loadu_ps(rhs[0]);
+    __m128 r1 = _mm_loadu_ps(rhs[1]);
+    __m128 r2 = _mm_loadu_ps(rhs[2]);
+    __m128 r3 = _mm_loadu_ps(rhs[3]);
+
+    for(unsigned int r=0; r<4; ++r)
+    {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(lhs[r][0]), r0);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(lhs[r][1]), r1));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(lhs[r][2]), r2));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(lhs[r][3]), r3));
+        _mm_storeu_ps(result[r], sum);
+    }
+}
+
+inline void multMatrix(const double lhs[4][4], const double rhs[4][4], double result[4][4])
+{
+    __m128d r0a = _mm_loadu_pd(rhs[0]), r0b = _mm_loadu_pd(rhs[0]+2);
+    __m128d r1a = _mm_loadu_pd(rhs[1]), r1b = _mm_loadu_pd(rhs[1]+2);
+    __m128d r2a = _mm_loadu_pd(rhs[2]), r2b = _mm_loadu_pd(rhs[2]+2);
+    __m128d r3a = _mm_loadu_pd(rhs[3]), r3b = _mm_loadu_pd(rhs[3]+2);
+
+    for(unsigned int r=0; r<4; ++r)
+    {
+        __m128d l0 = _mm_set1_pd(lhs[r][0]);
+        __m128d l1 = _mm_set1_pd(lhs[r][1]);
+        __m128d l2 = _mm_set1_pd(lhs[r][2]);
+        __m128d l3 = _mm_set1_pd(lhs[r][3]);
+
+        __m128d a = _mm_mul_pd(l0, r0a);
+        __m128d b = _mm_mul_pd(l0, r0b);
+        a = _mm_add_pd(a, _mm_mul_pd(l1, r1a));
+        b = _mm_add_pd(b, _mm_mul_pd(l1, r1b));
+        a = _mm_add_pd(a, _mm_mul_pd(l2, r2a));
+        b = _mm_add_pd(b, _mm_mul_pd(l2, r2b));
+        a = _mm_add_pd(a, _mm_mul_pd(l3, r3a));
+        b = _mm_add_pd(b, _mm_mul_pd(l3, r3b));
+
+        _mm_storeu_pd(result[r], a);
+        _mm_storeu_pd(result[r]+2, b);
+    }
+}
+
+/** Row operations of the Gauss-Jordan elimination in Matrix_implementation::invert_4x4(), which does its arithmetic in double
+  * whatever the value_type, row[l] *= scale.*/
+inline void scaleMatrixRow(double row[4], double scale)
+{
+    __m128d s = _mm_set1_pd(scale);
+    _mm_storeu_pd(row, _mm_mul_pd(_mm_loadu_pd(row), s));
+    _mm_storeu_pd(row+2, _mm_mul_pd(_mm_loadu_pd(row+2), s));
+}
+
+inline void scaleMatrixRow(float row[4], double scale)
+{
+    __m128d s = _mm_set1_pd(scale);
+    __m128 v = _mm_loadu_ps(row);
+    __m128 a = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(v), s));
+    __m128 b = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), s));
+    _mm_storeu_ps(row, _mm_movelh_ps(a, b));
+}
+
+/** row[l] -= pivotRow[l]*scale.*/
+inline void subtractScaledMatrixRow(double row[4], const double pivotRow[4], double scale)
+{
+    __m128d s = _mm_set1_pd(scale);
+    _mm_storeu_pd(row, _mm_sub_pd(_mm_loadu_pd(row), _mm_mul_pd(_mm_loadu_pd(pivotRow), s)));
+    _mm_storeu_pd(row+2, _mm_sub_pd(_mm_loadu_pd(row+2), _mm_mul_pd(_mm_loadu_pd(pivotRow+2), s)));
+}
+
+inline void subtractScaledMatrixRow(float row[4], const float pivotRow[4], double scale)
+{
+    __m128d s = _mm_set1_pd(scale);
+    __m128 v = _mm_loadu_ps(row);
+    __m128 p = _mm_loadu_ps(pivotRow);
+    __m128 a = _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(v), _mm_mul_pd(_mm_cvtps_pd(p), s)));
+    __m128 b = _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(p, p)), s)));
+    _mm_storeu_ps(row, _mm_movelh_ps(a, b));
+}
+
+#endif
+
+}
+
+#endif
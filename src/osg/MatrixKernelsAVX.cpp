@@ -0,0 +1,141 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+// This file is compiled with AVX code generation enabled, see src/osg/CMakeLists.txt, and its kernels
+// are only called once the CPU has been checked for AVX support. To keep code that could run on any CPU
+// out of it nothing here calls inline functions from other headers. FMA is deliberately not enabled, a
+// fused multiply-add rounds once where the per vector code rounds twice.
+
+#include "MatrixKernels.h"
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+namespace
+{
+
+// a whole row of the double basis fits one register, so each vector takes three multiplies and adds.
+void transformPointsd3fAVX(const double basis[4][4], const float* src, float* dest, unsigned int num)
+{
+    __m256d b0 = _mm256_loadu_pd(basis[0]);
+    __m256d b1 = _mm256_loadu_pd(basis[1]);
+    __m256d b2 = _mm256_loadu_pd(basis[2]);
+    __m256d b3 = _mm256_loadu_pd(basis[3]);
+    __m256d one = _mm256_set1_pd(1.0);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m256d x = _mm256_set1_pd(src[0]);
+        __m256d y = _mm256_set1_pd(src[1]);
+        __m256d z = _mm256_set1_pd(src[2]);
+
+        __m256d a = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(b0, x), _mm256_mul_pd(b1, y)), _mm256_mul_pd(b2, z)), b3);
+
+        // broadcast the fourth component to all lanes.
+        __m256d w = _mm256_permute2f128_pd(a, a, 0x11);
+        __m256d d = _mm256_div_pd(one, _mm256_permute_pd(w, 0xF));
+
+        __m128 result = _mm256_cvtpd_ps(_mm256_mul_pd(a, d));
+        _mm_storel_pi((__m64*)dest, result);
+        _mm_store_ss(dest+2, _mm_movehl_ps(result, result));
+    }
+}
+
+void transformPointsd3dAVX(const double basis[4][4], const double* src, double* dest, unsigned int num)
+{
+    __m256d b0 = _mm256_loadu_pd(basis[0]);
+    __m256d b1 = _mm256_loadu_pd(basis[1]);
+    __m256d b2 = _mm256_loadu_pd(basis[2]);
+    __m256d b3 = _mm256_loadu_pd(basis[3]);
+    __m256d one = _mm256_set1_pd(1.0);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m256d x = _mm256_set1_pd(src[0]);
+        __m256d y = _mm256_set1_pd(src[1]);
+        __m256d z = _mm256_set1_pd(src[2]);
+
+        __m256d a = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(b0, x), _mm256_mul_pd(b1, y)), _mm256_mul_pd(b2, z)), b3);
+
+        __m256d w = _mm256_permute2f128_pd(a, a, 0x11);
+        __m256d d = _mm256_div_pd(one, _mm256_permute_pd(w, 0xF));
+
+        __m256d result = _mm256_mul_pd(a, d);
+        _mm_storeu_pd(dest, _mm256_castpd256_pd128(result));
+        _mm_store_sd(dest+2, _mm256_extractf128_pd(result, 1));
+    }
+}
+
+void transformVectorsd3fAVX(const double basis[4][4], const float* src, float* dest, unsigned int num)
+{
+    __m256d b0 = _mm256_loadu_pd(basis[0]);
+    __m256d b1 = _mm256_loadu_pd(basis[1]);
+    __m256d b2 = _mm256_loadu_pd(basis[2]);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m256d x = _mm256_set1_pd(src[0]);
+        __m256d y = _mm256_set1_pd(src[1]);
+        __m256d z = _mm256_set1_pd(src[2]);
+
+        __m128 result = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(b0, x), _mm256_mul_pd(b1, y)), _mm256_mul_pd(b2, z)));
+        _mm_storel_pi((__m64*)dest, result);
+        _mm_store_ss(dest+2, _mm_movehl_ps(result, result));
+    }
+}
+
+void transformVectorsd3dAVX(const double basis[4][4], const double* src, double* dest, unsigned int num)
+{
+    __m256d b0 = _mm256_loadu_pd(basis[0]);
+    __m256d b1 = _mm256_loadu_pd(basis[1]);
+    __m256d b2 = _mm256_loadu_pd(basis[2]);
+
+    for(unsigned int i=0; i<num; ++i, src+=3, dest+=3)
+    {
+        __m256d x = _mm256_set1_pd(src[0]);
+        __m256d y = _mm256_set1_pd(src[1]);
+        __m256d z = _mm256_set1_pd(src[2]);
+
+        __m256d result = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(b0, x), _mm256_mul_pd(b1, y)), _mm256_mul_pd(b2, z));
+        _mm_storeu_pd(dest, _mm256_castpd256_pd128(result));
+        _mm_store_sd(dest+2, _mm256_extractf128_pd(result, 1));
+    }
+}
+
+// the float basis already fits a single SSE register, so the SSE2 kernels are used for Matrixf.
+const osg::MatrixKernelFunctions s_avxMatrixKernelFunctions =
+{
+    transformPointsd3fAVX,
+    transformPointsd3dAVX,
+    0,
+    transformVectorsd3fAVX,
+    transformVectorsd3dAVX,
+    0
+};
+
+}
+
+const osg::MatrixKernelFunctions* osg::getAVXMatrixKernelFunctions()
+{
+    return &s_avxMatrixKernelFunctions;
+}
+
+#else
+
+const osg::MatrixKernelFunctions* osg::getAVXMatrixKernelFunctions()
+{
+    return 0;
+}
+
+#endif
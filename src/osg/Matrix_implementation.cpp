@@ -18,6 +18,8 @@
 
 #include <osg/GL>
 
+#include "MatrixKernels.h"
+
 #include <limits>
 #include <stdlib.h>
 #include <float.h>
@@ -452,6 +454,10 @@ void Matrix_implementation::makeRotate( value_type angle1, const Vec3d& axis1,
 
 void Matrix_implementation::mult( const Matrix_implementation& lhs, const Matrix_implementation& rhs )
 {
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+    // the kernel reads all of rhs and each row of lhs before writing the row, so this may be lhs or rhs.
+    multMatrix(lhs._mat, rhs._mat, _mat);
+#else
     if (&lhs==this)
     {
         postMult(rhs);
@@ -481,6 +487,7 @@ void Matrix_implementation::mult( const Matrix_implementation& lhs, const Matrix
     _mat[3][1] = INNER_PRODUCT(lhs, rhs, 3, 1);
     _mat[3][2] = INNER_PRODUCT(lhs, rhs, 3, 2);
     _mat[3][3] = INNER_PRODUCT(lhs, rhs, 3, 3);
+#endif
 }
 
 void Matrix_implementation::preMult( const Matrix_implementation& other )
@@ -489,6 +496,9 @@ void Matrix_implementation::preMult( const Matrix_implementation& other )
     //Matrix_implementation tmp(other* *this);
     // *this = tmp;
 
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+    multMatrix(other._mat, _mat, _mat);
+#else
     // more efficient method just use a value_type[4] for temporary storage.
     value_type t[4];
     for(int col=0; col<4; ++col) {
@@ -501,6 +511,7 @@ void Matrix_implementation::preMult( const Matrix_implementation& other )
         _mat[2][col] = t[2];
         _mat[3][col] = t[3];
     }
+#endif
 
 }
 
@@ -510,6 +521,9 @@ void Matrix_implementation::postMult( const Matrix_implementation& other )
     //Matrix_implementation tmp(*this * other);
     // *this = tmp;
 
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+    multMatrix(_mat, other._mat, _mat);
+#else
     // more efficient method just use a value_type[4] for temporary storage.
     value_type t[4];
     for(int row=0; row<4; ++row)
@@ -520,10 +534,68 @@ void Matrix_implementation::postMult( const Matrix_implementation& other )
         t[3] = INNER_PRODUCT( *this, other, row, 3 );
         SET_ROW(row, t[0], t[1], t[2], t[3] )
     }
+#endif
 }
 
 #undef INNER_PRODUCT
 
+// the batched vector transforms, the kernels take the matrix rows as the basis for v*M and its columns for M*v.
+static inline void transposeMatrix(const Matrix_implementation::value_type mat[4][4], Matrix_implementation::value_type columns[4][4])
+{
+    for(int row=0; row<4; ++row)
+    {
+        for(int col=0; col<4; ++col) columns[col][row] = mat[row][col];
+    }
+}
+
+void Matrix_implementation::preMult( const Vec3f* src, Vec3f* dest, unsigned int num ) const
+{
+    transformPoints(_mat, src, dest, num);
+}
+
+void Matrix_implementation::preMult( const Vec3d* src, Vec3d* dest, unsigned int num ) const
+{
+    transformPoints(_mat, src, dest, num);
+}
+
+void Matrix_implementation::postMult( const Vec3f* src, Vec3f* dest, unsigned int num ) const
+{
+    value_type columns[4][4];
+    transposeMatrix(_mat, columns);
+    transformPoints(columns, src, dest, num);
+}
+
+void Matrix_implementation::postMult( const Vec3d* src, Vec3d* dest, unsigned int num ) const
+{
+    value_type columns[4][4];
+    transposeMatrix(_mat, columns);
+    transformPoints(columns, src, dest, num);
+}
+
+void Matrix_implementation::transform3x3( const Vec3f* src, Vec3f* dest, unsigned int num, const Matrix_implementation& m )
+{
+    transformVectors(m._mat, src, dest, num);
+}
+
+void Matrix_implementation::transform3x3( const Vec3d* src, Vec3d* dest, unsigned int num, const Matrix_implementation& m )
+{
+    transformVectors(m._mat, src, dest, num);
+}
+
+void Matrix_implementation::transform3x3( const Matrix_implementation& m, const Vec3f* src, Vec3f* dest, unsigned int num )
+{
+    value_type columns[4][4];
+    transposeMatrix(m._mat, columns);
+    transformVectors(columns, src, dest, num);
+}
+
+void Matrix_implementation::transform3x3( const Matrix_implementation& m, const Vec3d* src, Vec3d* dest, unsigned int num )
+{
+    value_type columns[4][4];
+    transposeMatrix(m._mat, columns);
+    transformVectors(columns, src, dest, num);
+}
+
 // orthoNormalize the 3x3 rotation matrix
 void Matrix_implementation::orthoNormalize(const Matrix_implementation& rhs)
 {
@@ -790,13 +862,21 @@ bool Matrix_implementation::invert_4x4( const Matrix_implementation& mat )
 
        pivinv = 1.0/operator()(icol,icol);
        operator()(icol,icol) = 1;
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+       scaleMatrixRow(_mat[icol], pivinv);
+#else
        for (l=0; l<4; l++) operator()(icol,l) *= pivinv;
+#endif
        for (ll=0; ll<4; ll++)
           if (ll != icol)
           {
              dum=operator()(ll,icol);
              operator()(ll,icol) = 0;
+#if defined(OSG_MATRIX_KERNELS_USE_SSE2)
+             subtractScaledMatrixRow(_mat[ll], _mat[icol], dum);
+#else
              for (l=0; l<4; l++) operator()(ll,l) -= operator()(icol,l)*dum;
+#endif
           }
     }
     for (int lx=4; lx>0; --lx)
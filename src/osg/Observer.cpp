@@ -14,6 +14,8 @@
 #include <osg/ObserverNodePath>
 #include <osg/Notify>
 
+#include <OpenThreads/Thread>
+
 using namespace osg;
 
 Observer::Observer()
@@ -51,6 +53,20 @@ void ObserverSet::removeObserver(Observer* observer)
 
 Referenced* ObserverSet::addRefLock()
 {
+#if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
+    // register as an active locker before looking at _observedObject, so that
+    // signalObjectDeleted() won't let the object be destructed under our feet.
+    ++_numActiveRefLocks;
+
+    Referenced* observedObject = _observedObject;
+
+    // only take a reference if the object isn't already on its way to being deleted.
+    if (observedObject && observedObject->ref_nonzero()==0) observedObject = 0;
+
+    --_numActiveRefLocks;
+
+    return observedObject;
+#else
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 
     if (!_observedObject) return 0;
@@ -66,6 +82,7 @@ Referenced* ObserverSet::addRefLock()
     }
 
     return _observedObject;
+#endif
 }
 
 void ObserverSet::signalObjectDeleted(void* ptr)
@@ -82,4 +99,12 @@ void ObserverSet::signalObjectDeleted(void* ptr)
 
     // reset the observed object so that we know that it's now detached.
     _observedObject = 0;
+
+#if defined(_OSG_REFERENCED_USE_ATOMIC_OPERATIONS)
+    // wait for any addRefLock() that picked up the object pointer before it was reset.
+    while(_numActiveRefLocks!=0)
+    {
+        OpenThreads::Thread::YieldCurrentThread();
+    }
+#endif
 }
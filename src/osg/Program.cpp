@@ -29,6 +29,7 @@
 #include <osg/buffered_value>
 #include <osg/ref_ptr>
 #include <osg/Program>
+#include <osg/ProgramBinaryCache>
 #include <osg/Shader>
 #include <osg/GL2Extensions>
 
@@ -96,6 +97,16 @@ void Program::discardDeletedGlPrograms(unsigned int contextID)
     pList.clear();
 }
 
+// return the ProgramBinaryCache if it is to be used for program, programs with a ProgramBinary
+// assigned by the application manage their binary themselves.
+static ProgramBinaryCache* getProgramBinaryCache(const Program* program, const GL2Extensions* extensions)
+{
+    ProgramBinaryCache* programBinaryCache = ProgramBinaryCache::instance().get();
+    if (!programBinaryCache || !programBinaryCache->isEnabled()) return 0;
+    if (program->getProgramBinary() || !extensions->isGetProgramBinarySupported()) return 0;
+    return programBinaryCache;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////
 // osg::Program::ProgramBinary
@@ -232,9 +243,13 @@ void Program::compileGLObjects( osg::State& state ) const
 
     const unsigned int contextID = state.getContextID();
 
-    for( unsigned int i=0; i < _shaderList.size(); ++i )
+    // with the ProgramBinaryCache the shaders are only compiled by linkProgram() when no cached binary is found.
+    if (!getProgramBinaryCache(this, GL2Extensions::Get(contextID,true)))
     {
-        _shaderList[i]->compileShader( state );
+        for( unsigned int i=0; i < _shaderList.size(); ++i )
+        {
+            _shaderList[i]->compileShader( state );
+        }
     }
 
     getPCP( contextID )->linkProgram(state);
@@ -631,17 +646,68 @@ void Program::PerContextProgram::linkProgram(osg::State& state)
             _extensions->glBindFragDataLocation( _glProgramHandle, itr->second, reinterpret_cast<const GLchar*>(itr->first.c_str()) );
         }
 
+        ProgramBinaryCache* programBinaryCache = getProgramBinaryCache(_program, _extensions.get());
+
         // if any program binary has been set then assume we want to retrieve a binary later.
-        if (programBinary)
+        if (programBinary || programBinaryCache)
         {
             _extensions->glProgramParameteri( _glProgramHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
         }
 
-        // link the glProgram
-        GLint linked = GL_FALSE;
-        _extensions->glLinkProgram( _glProgramHandle );
-        _extensions->glGetProgramiv( _glProgramHandle, GL_LINK_STATUS, &linked );
-        _isLinked = (linked == GL_TRUE);
+        // the shaders are attached and the bindings set even when a cached binary is loaded, so that
+        // a later relink, or a link after the driver rejects the binary, starts from a complete program.
+        std::string programBinaryKey;
+        if (programBinaryCache)
+        {
+            programBinaryKey = ProgramBinaryCache::computeKey(*_program, state);
+            const std::string& driver = programBinaryCache->getDriverString(_contextID);
+
+            osg::ref_ptr<ProgramBinary> cachedBinary = programBinaryCache->readProgramBinary(programBinaryKey, driver);
+            if (cachedBinary.valid())
+            {
+                GLint linked = GL_FALSE;
+                _extensions->glProgramBinary( _glProgramHandle, cachedBinary->getFormat(),
+                    reinterpret_cast<const GLvoid*>(cachedBinary->getData()), cachedBinary->getSize() );
+                _extensions->glGetProgramiv( _glProgramHandle, GL_LINK_STATUS, &linked );
+                _loadedBinary = _isLinked = (linked == GL_TRUE);
+
+                if (!_loadedBinary) programBinaryCache->rejectProgramBinary(programBinaryKey);
+            }
+        }
+
+        if (!_loadedBinary)
+        {
+            // Program::compileGLObjects() leaves compiling the shaders to us when the cache is used.
+            if (programBinaryCache)
+            {
+                for( unsigned int i=0; i < _program->_shaderList.size(); ++i )
+                {
+                    _program->_shaderList[i]->compileShader( state );
+                }
+            }
+
+            // link the glProgram
+            GLint linked = GL_FALSE;
+            _extensions->glLinkProgram( _glProgramHandle );
+            _extensions->glGetProgramiv( _glProgramHandle, GL_LINK_STATUS, &linked );
+            _isLinked = (linked == GL_TRUE);
+
+            if (_isLinked && programBinaryCache)
+            {
+                GLint binaryLength = 0;
+                _extensions->glGetProgramiv( _glProgramHandle, GL_PROGRAM_BINARY_LENGTH, &binaryLength );
+                if (binaryLength>0)
+                {
+                    osg::ref_ptr<ProgramBinary> linkedBinary = new ProgramBinary;
+                    linkedBinary->allocate(binaryLength);
+                    GLenum binaryFormat = 0;
+                    _extensions->glGetProgramBinary( _glProgramHandle, binaryLength, 0, &binaryFormat, reinterpret_cast<GLvoid*>(linkedBinary->getData()) );
+                    linkedBinary->setFormat(binaryFormat);
+
+                    programBinaryCache->writeProgramBinary(programBinaryKey, programBinaryCache->getDriverString(_contextID), *linkedBinary);
+                }
+            }
+        }
     }
 
     if( ! _isLinked )
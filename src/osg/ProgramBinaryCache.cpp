@@ -0,0 +1,345 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osg/ProgramBinaryCache>
+#include <osg/State>
+#include <osg/GL2Extensions>
+#include <osg/ApplicationUsage>
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+
+#include "ContentHash.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+    #include <sys/types.h>
+#endif
+
+using namespace osg;
+
+static ApplicationUsageProxy ApplicationUsageProxyProgramBinaryCache_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_PROGRAM_BINARY_CACHE <directory>","Set the directory that linked shader program binaries are cached in, so later runs can skip compiling them.");
+
+namespace
+{
+
+typedef ContentHash::Value HashValue;
+
+void addBindings(ContentHash& hash, const Program::AttribBindingList& bindings)
+{
+    hash.add(static_cast<unsigned int>(bindings.size()));
+    for(Program::AttribBindingList::const_iterator itr = bindings.begin();
+        itr != bindings.end();
+        ++itr)
+    {
+        hash.add(itr->first);
+        hash.add(itr->second);
+    }
+}
+
+// "OSGP" as the first four bytes of an entry.
+const unsigned int s_entryMagic = 0x5047534F;
+const unsigned int s_entryVersion = 1;
+
+bool makeDirectory(const std::string& path)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    return _mkdir(path.c_str())==0;
+#else
+    return mkdir(path.c_str(), 0755)==0;
+#endif
+}
+
+bool directoryExists(const std::string& path)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    struct _stat status;
+    return _stat(path.c_str(), &status)==0 && (status.st_mode & _S_IFDIR)!=0;
+#else
+    struct stat status;
+    return stat(path.c_str(), &status)==0 && S_ISDIR(status.st_mode);
+#endif
+}
+
+// create path and any of its parents that don't exist yet.
+bool makeDirectories(const std::string& path)
+{
+    if (path.empty() || directoryExists(path)) return true;
+
+    std::string::size_type separator = path.find_last_of("/\\");
+    if (separator!=std::string::npos && separator>0 && !makeDirectories(path.substr(0, separator))) return false;
+
+    return makeDirectory(path) || directoryExists(path);
+}
+
+template<typename T>
+void writeValue(std::ostream& fout, const T& value) { fout.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+template<typename T>
+bool readValue(std::istream& fin, T& value) { return fin.read(reinterpret_cast<char*>(&value), sizeof(T)).good(); }
+
+}
+
+ref_ptr<ProgramBinaryCache>& ProgramBinaryCache::instance()
+{
+    static ref_ptr<ProgramBinaryCache> s_programBinaryCache = new ProgramBinaryCache;
+    return s_programBinaryCache;
+}
+
+ProgramBinaryCache::ProgramBinaryCache():
+    Referenced(true),
+    _numHits(0),
+    _numMisses(0),
+    _numInvalidated(0),
+    _numWritten(0)
+{
+    const char* ptr = 0;
+    if ((ptr = getenv("OSG_PROGRAM_BINARY_CACHE")) != 0)
+    {
+        setDirectory(ptr);
+    }
+}
+
+ProgramBinaryCache::~ProgramBinaryCache()
+{
+}
+
+void ProgramBinaryCache::setDirectory(const std::string& directory)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _directory = directory;
+
+    // strip trailing separators so file names can be appended with a single one.
+    while(_directory.size()>1 && (_directory[_directory.size()-1]=='/' || _directory[_directory.size()-1]=='\\'))
+    {
+        _directory.erase(_directory.size()-1);
+    }
+
+    if (!_directory.empty() && !makeDirectories(_directory))
+    {
+        OSG_WARN<<"Warning: ProgramBinaryCache unable to create directory \""<<_directory<<"\", program binaries will not be cached."<<std::endl;
+        _directory.clear();
+    }
+}
+
+std::string ProgramBinaryCache::computeKey(const Program& program, State& state)
+{
+    ContentHash hash;
+
+    hash.add(program.getNumShaders());
+    for(unsigned int i=0; i<program.getNumShaders(); ++i)
+    {
+        const Shader* shader = program.getShader(i);
+        hash.add(static_cast<unsigned int>(shader->getType()));
+        hash.add(shader->getShaderSource());
+
+        const ShaderBinary* shaderBinary = shader->getShaderBinary();
+        hash.add(shaderBinary ? shaderBinary->getSize() : 0u);
+        if (shaderBinary && shaderBinary->getSize()) hash.add(shaderBinary->getData(), shaderBinary->getSize());
+    }
+
+    // the State settings that Shader::PerContextShader::compileShader() uses to convert vertex shaders
+    // and PerContextProgram::linkProgram() uses to bind the aliased vertex attributes.
+    hash.add(state.getUseVertexAttributeAliasing() ? 1u : 0u);
+    hash.add(state.getUseModelViewAndProjectionUniforms() ? 1u : 0u);
+    if (state.getUseVertexAttributeAliasing()) addBindings(hash, state.getAttributeBindingList());
+
+    addBindings(hash, program.getAttribBindingList());
+    addBindings(hash, program.getFragDataBindingList());
+
+    hash.add(static_cast<unsigned int>(program.getParameter(GL_GEOMETRY_VERTICES_OUT_EXT)));
+    hash.add(static_cast<unsigned int>(program.getParameter(GL_GEOMETRY_INPUT_TYPE_EXT)));
+    hash.add(static_cast<unsigned int>(program.getParameter(GL_GEOMETRY_OUTPUT_TYPE_EXT)));
+
+    return hash.str();
+}
+
+const std::string& ProgramBinaryCache::getDriverString(unsigned int contextID)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    std::string& driver = _driverStrings[contextID];
+    if (driver.empty())
+    {
+        const char* vendor = reinterpret_cast<const char*>(glGetString(GL_VENDOR));
+        const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+        driver = std::string(vendor ? vendor : "") + "; " + (renderer ? renderer : "") + "; " + (version ? version : "");
+    }
+    return driver;
+}
+
+std::string ProgramBinaryCache::getFileName(const std::string& key) const
+{
+    return _directory + "/" + key + ".osgpb";
+}
+
+Program::ProgramBinary* ProgramBinaryCache::readProgramBinary(const std::string& key, const std::string& driver)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    if (_directory.empty()) return 0;
+
+    std::ifstream fin(getFileName(key).c_str(), std::ios::in | std::ios::binary);
+    if (!fin)
+    {
+        ++_numMisses;
+        return 0;
+    }
+
+    unsigned int magic = 0, version = 0, driverSize = 0;
+    bool valid = readValue(fin, magic) && magic==s_entryMagic &&
+                 readValue(fin, version) && version==s_entryVersion &&
+                 readValue(fin, driverSize) && driverSize<65536;
+
+    std::string entryDriver;
+    if (valid)
+    {
+        entryDriver.resize(driverSize);
+        valid = driverSize==0 || fin.read(&entryDriver[0], driverSize).good();
+    }
+
+    ref_ptr<Program::ProgramBinary> programBinary;
+    if (valid && entryDriver==driver)
+    {
+        unsigned int format = 0, size = 0;
+        HashValue checksum = 0;
+        valid = readValue(fin, format) && readValue(fin, size) && size>0 && readValue(fin, checksum);
+        if (valid)
+        {
+            programBinary = new Program::ProgramBinary;
+            programBinary->allocate(size);
+            programBinary->setFormat(format);
+            valid = fin.read(reinterpret_cast<char*>(programBinary->getData()), size).good();
+
+            ContentHash hash;
+            if (valid) hash.add(programBinary->getData(), size);
+            valid = valid && hash._value==checksum;
+        }
+    }
+    else if (valid)
+    {
+        OSG_INFO<<"ProgramBinaryCache entry "<<key<<" was written by \""<<entryDriver<<"\", not \""<<driver<<"\", discarding it."<<std::endl;
+        valid = false;
+    }
+    fin.close();
+
+    if (!valid)
+    {
+        removeEntry(key);
+        ++_numInvalidated;
+        ++_numMisses;
+        return 0;
+    }
+
+    ++_numHits;
+    return programBinary.release();
+}
+
+bool ProgramBinaryCache::writeProgramBinary(const std::string& key, const std::string& driver, const Program::ProgramBinary& programBinary)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    if (_directory.empty() || programBinary.getSize()==0) return false;
+
+    ContentHash hash;
+    hash.add(programBinary.getData(), programBinary.getSize());
+
+    // write to a temporary file and rename it, so another application reading the cache never sees a partial entry.
+    std::string fileName = getFileName(key);
+    std::string tmpFileName = fileName + ".tmp";
+    {
+        std::ofstream fout(tmpFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!fout)
+        {
+            OSG_INFO<<"ProgramBinaryCache unable to write "<<tmpFileName<<std::endl;
+            return false;
+        }
+
+        writeValue(fout, s_entryMagic);
+        writeValue(fout, s_entryVersion);
+        writeValue(fout, static_cast<unsigned int>(driver.size()));
+        fout.write(driver.data(), driver.size());
+        writeValue(fout, static_cast<unsigned int>(programBinary.getFormat()));
+        writeValue(fout, programBinary.getSize());
+        writeValue(fout, hash._value);
+        fout.write(reinterpret_cast<const char*>(programBinary.getData()), programBinary.getSize());
+
+        if (!fout.good())
+        {
+            fout.close();
+            remove(tmpFileName.c_str());
+            return false;
+        }
+    }
+
+    // rename() doesn't replace an existing file on Windows.
+    remove(fileName.c_str());
+    if (rename(tmpFileName.c_str(), fileName.c_str())!=0)
+    {
+        remove(tmpFileName.c_str());
+        return false;
+    }
+
+    ++_numWritten;
+    return true;
+}
+
+void ProgramBinaryCache::rejectProgramBinary(const std::string& key)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    removeEntry(key);
+
+    // the lookup was counted as a hit when the entry was read.
+    if (_numHits>0) --_numHits;
+    ++_numMisses;
+    ++_numInvalidated;
+}
+
+void ProgramBinaryCache::removeEntry(const std::string& key)
+{
+    if (!_directory.empty()) remove(getFileName(key).c_str());
+}
+
+double ProgramBinaryCache::getHitRate() const
+{
+    unsigned int numLookups = _numHits + _numMisses;
+    return numLookups>0 ? double(_numHits)/double(numLookups) : 0.0;
+}
+
+void ProgramBinaryCache::resetStats()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _numHits = 0;
+    _numMisses = 0;
+    _numInvalidated = 0;
+    _numWritten = 0;
+}
+
+void ProgramBinaryCache::reportStats(std::ostream& out)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    out<<"ProgramBinaryCache::reportStats() directory=\""<<_directory<<"\""<<std::endl;
+    out<<"   total _numHits="<<_numHits<<", _numMisses="<<_numMisses<<", hit rate="<<getHitRate()<<std::endl;
+    out<<"   total _numInvalidated="<<_numInvalidated<<", _numWritten="<<_numWritten<<std::endl;
+}
@@ -17,17 +17,38 @@
  */
 
 #include <osg/ShaderComposer>
+#include <osg/ApplicationUsage>
 #include <osg/Notify>
 
+#include <OpenThreads/ScopedLock>
+
+#include <stdlib.h>
+
+#include "ContentHash.h"
+
 using namespace osg;
 
-ShaderComposer::ShaderComposer()
+static ApplicationUsageProxy ApplicationUsageProxyShaderComposer_e0(ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAXIMUM_COMPOSED_PROGRAMS <int>","Set the maximum number of Programs each ShaderComposer keeps, the least recently used are released once exceeded, 0 keeps all.");
+
+ShaderComposer::ShaderComposer():
+    _maximumNumberOfPrograms(0),
+    _numberOfProgramsEvicted(0),
+    _useCount(0)
 {
     OSG_INFO<<"ShaderComposer::ShaderComposer() "<<this<<std::endl;
+
+    const char* ptr = 0;
+    if ((ptr = getenv("OSG_MAXIMUM_COMPOSED_PROGRAMS")) != 0)
+    {
+        _maximumNumberOfPrograms = atoi(ptr);
+    }
 }
 
 ShaderComposer::ShaderComposer(const ShaderComposer& sa, const CopyOp& copyop):
-    Object(sa, copyop)
+    Object(sa, copyop),
+    _maximumNumberOfPrograms(sa._maximumNumberOfPrograms),
+    _numberOfProgramsEvicted(0),
+    _useCount(0)
 {
     OSG_INFO<<"ShaderComposer::ShaderComposer(const ShaderComposer&, const CopyOp& copyop) "<<this<<std::endl;
 }
@@ -39,19 +60,120 @@ ShaderComposer::~ShaderComposer()
 
 void ShaderComposer::releaseGLObjects(osg::State* state)
 {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _programEntryMap.clear();
     _programMap.clear();
     _shaderMainMap.clear();
 }
 
+std::string ShaderComposer::computeKey(const ShaderComponents& shaderComponents)
+{
+    ContentHash hash;
+    hash.add(static_cast<unsigned int>(shaderComponents.size()));
+    for(ShaderComponents::const_iterator itr = shaderComponents.begin();
+        itr != shaderComponents.end();
+        ++itr)
+    {
+        const ShaderComponent* sc = *itr;
+        hash.add(sc->getNumShaders());
+        for(unsigned int i=0; i<sc->getNumShaders(); ++i)
+        {
+            const Shader* shader = sc->getShader(i);
+            hash.add(static_cast<unsigned int>(shader->getType()));
+            hash.add(shader->getShaderSource());
+
+            const ShaderBinary* shaderBinary = shader->getShaderBinary();
+            hash.add(shaderBinary ? shaderBinary->getSize() : 0u);
+            if (shaderBinary && shaderBinary->getSize()) hash.add(shaderBinary->getData(), shaderBinary->getSize());
+
+            const Shader::CodeInjectionMap& cim = shader->getCodeInjectionMap();
+            hash.add(static_cast<unsigned int>(cim.size()));
+            for(Shader::CodeInjectionMap::const_iterator citr = cim.begin();
+                citr != cim.end();
+                ++citr)
+            {
+                hash.add(citr->first);
+                hash.add(citr->second);
+            }
+        }
+    }
+    return hash.str();
+}
+
+void ShaderComposer::setMaximumNumberOfPrograms(unsigned int maximum)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    _maximumNumberOfPrograms = maximum;
+    evictPrograms();
+}
+
 osg::Program* ShaderComposer::getOrCreateProgram(const ShaderComponents& shaderComponents)
 {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+    ++_useCount;
+
     ProgramMap::iterator itr = _programMap.find(shaderComponents);
-    if (itr != _programMap.end())
+    if (itr == _programMap.end())
+    {
+        itr = _programMap.insert(ProgramMap::value_type(shaderComponents, computeKey(shaderComponents))).first;
+    }
+
+    ProgramEntry& entry = _programEntryMap[itr->second];
+    entry._lastUsed = _useCount;
+    if (!entry._program)
+    {
+        entry._program = composeProgram(shaderComponents);
+
+        // the new entry is the most recently used so is never the one evicted.
+        evictPrograms();
+    }
+
+    return entry._program.get();
+}
+
+void ShaderComposer::evictPrograms()
+{
+    if (_maximumNumberOfPrograms==0 || _programEntryMap.size()<=_maximumNumberOfPrograms) return;
+
+    while(_programEntryMap.size()>_maximumNumberOfPrograms)
     {
-        // OSG_NOTICE<<"ShaderComposer::getOrCreateProgram(..) using cached Program"<<std::endl;
-        return itr->second.get();
+        ProgramEntryMap::iterator lru = _programEntryMap.begin();
+        for(ProgramEntryMap::iterator itr = _programEntryMap.begin();
+            itr != _programEntryMap.end();
+            ++itr)
+        {
+            if (itr->second._lastUsed < lru->second._lastUsed) lru = itr;
+        }
+
+        // forget the combinations of ShaderComponents that led to the evicted Program.
+        for(ProgramMap::iterator pitr = _programMap.begin();
+            pitr != _programMap.end();
+            )
+        {
+            if (pitr->second == lru->first) _programMap.erase(pitr++);
+            else ++pitr;
+        }
+
+        // the Program deletes its glPrograms once the last reference to it, such as from an osg::State, is gone.
+        _programEntryMap.erase(lru);
+        ++_numberOfProgramsEvicted;
     }
 
+    // release the main shaders that no remaining Program uses.
+    for(ShaderMainMap::iterator sitr = _shaderMainMap.begin();
+        sitr != _shaderMainMap.end();
+        )
+    {
+        if (sitr->second->referenceCount()==1) _shaderMainMap.erase(sitr++);
+        else ++sitr;
+    }
+}
+
+osg::Program* ShaderComposer::composeProgram(const ShaderComponents& shaderComponents)
+{
     // strip out vertex shaders
     Shaders vertexShaders;
     Shaders tessControlShaders;
@@ -120,12 +242,9 @@ osg::Program* ShaderComposer::getOrCreateProgram(const ShaderComponents& shaderC
         addShaderToProgram(program.get(), computeShaders);
     }
 
-    // assign newly created program to map.
-    _programMap[shaderComponents] = program;
-
     OSG_NOTICE<<"ShaderComposer::getOrCreateProgram(..) created new Program"<<std::endl;
 
-    return program.get();
+    return program.release();
 }
 
 void ShaderComposer::addShaderToProgram(Program* program, const Shaders& shaders)
@@ -12,6 +12,7 @@
 */
 #include <osg/State>
 #include <osg/Texture>
+#include <osg/GLMemoryBudget>
 #include <osg/Notify>
 #include <osg/GLU>
 #include <osg/GLExtensions>
@@ -117,6 +118,7 @@ State::State():
 
     _maxTexturePoolSize = 0;
     _maxBufferObjectPoolSize = 0;
+    _maxGLMemorySize = 0;
 
     _glBeginEndAdapter.setState(this);
     _arrayDispatchers.setState(this);
@@ -210,33 +212,32 @@ void State::reset()
 {
 
 #if 1
-    for(ModeMap::iterator mitr=_modeMap.begin();
-        mitr!=_modeMap.end();
-        ++mitr)
+    for(unsigned int slot=0; slot<_modeMap.size(); ++slot)
     {
-        ModeStack& ms = mitr->second;
+        ModeStack& ms = _modeMap.getStack(slot);
         ms.valueVec.clear();
         ms.last_applied_value = !ms.global_default_value;
         ms.changed = true;
+        _modeMap.addChangedSlot(slot);
     }
 #else
     _modeMap.clear();
 #endif
 
-    _modeMap[GL_DEPTH_TEST].global_default_value = true;
-    _modeMap[GL_DEPTH_TEST].changed = true;
+    ModeStack& depthTestStack = _modeMap.getChangedStack(GL_DEPTH_TEST);
+    depthTestStack.global_default_value = true;
+    depthTestStack.changed = true;
 
     // go through all active StateAttribute's, setting to change to force update,
     // the idea is to leave only the global defaults left.
-    for(AttributeMap::iterator aitr=_attributeMap.begin();
-        aitr!=_attributeMap.end();
-        ++aitr)
+    for(unsigned int slot=0; slot<_attributeMap.size(); ++slot)
     {
-        AttributeStack& as = aitr->second;
+        AttributeStack& as = _attributeMap.getStack(slot);
         as.attributeVec.clear();
         as.last_applied_attribute = NULL;
         as.last_applied_shadercomponent = NULL;
         as.changed = true;
+        _attributeMap.addChangedSlot(slot);
     }
 
     // we can do a straight clear, we arn't interested in GL_DEPTH_TEST defaults in texture modes.
@@ -254,15 +255,14 @@ void State::reset()
     {
         AttributeMap& attributeMap = *tamItr;
         // go through all active StateAttribute's, setting to change to force update.
-        for(AttributeMap::iterator aitr=attributeMap.begin();
-            aitr!=attributeMap.end();
-            ++aitr)
+        for(unsigned int slot=0; slot<attributeMap.size(); ++slot)
         {
-            AttributeStack& as = aitr->second;
+            AttributeStack& as = attributeMap.getStack(slot);
             as.attributeVec.clear();
             as.last_applied_attribute = NULL;
             as.last_applied_shadercomponent = NULL;
             as.changed = true;
+            attributeMap.addChangedSlot(slot);
         }
     }
 
@@ -304,11 +304,9 @@ void State::reset()
     // what about uniforms??? need to clear them too...
     // go through all active Unfirom's, setting to change to force update,
     // the idea is to leave only the global defaults left.
-    for(UniformMap::iterator uitr=_uniformMap.begin();
-        uitr!=_uniformMap.end();
-        ++uitr)
+    for(unsigned int slot=0; slot<_uniformMap.size(); ++slot)
     {
-        UniformStack& us = uitr->second;
+        UniformStack& us = _uniformMap.getStack(slot);
         us.uniformVec.clear();
     }
 
@@ -336,6 +334,13 @@ void State::setMaxBufferObjectPoolSize(unsigned int size)
     OSG_INFO<<"osg::State::_maxBufferObjectPoolSize="<<_maxBufferObjectPoolSize<<std::endl;
 }
 
+void State::setMaxGLMemorySize(unsigned int size)
+{
+    _maxGLMemorySize = size;
+    osg::GLMemoryBudget::getGLMemoryBudget(getContextID())->setMaxSize(_maxGLMemorySize);
+    OSG_INFO<<"osg::State::_maxGLMemorySize="<<_maxGLMemorySize<<std::endl;
+}
+
 void State::pushStateSet(const StateSet* dstate)
 {
 
@@ -643,7 +648,7 @@ void State::applyShaderComposition()
         if (_currentShaderCompositionProgram)
         {
             Program::PerContextProgram* pcp = _currentShaderCompositionProgram->getPCP(_contextID);
-            if (_lastAppliedProgramObject != pcp) applyAttribute(_currentShaderCompositionProgram);
+            if (_lastAppliedProgramObject != pcp) applyAttribute(_currentShaderCompositionProgram.get());
         }
     }
 }
@@ -715,7 +720,7 @@ const StateAttribute* State::getLastAppliedTextureAttribute(unsigned int unit,St
 
 void State::haveAppliedMode(ModeMap& modeMap,StateAttribute::GLMode mode,StateAttribute::GLModeValue value)
 {
-    ModeStack& ms = modeMap[mode];
+    ModeStack& ms = modeMap.getChangedStack(mode);
 
     ms.last_applied_value = value & StateAttribute::ON;
 
@@ -726,7 +731,7 @@ void State::haveAppliedMode(ModeMap& modeMap,StateAttribute::GLMode mode,StateAt
 /** mode has been set externally, update state to reflect this setting.*/
 void State::haveAppliedMode(ModeMap& modeMap,StateAttribute::GLMode mode)
 {
-    ModeStack& ms = modeMap[mode];
+    ModeStack& ms = modeMap.getChangedStack(mode);
 
     // don't know what last applied value is can't apply it.
     // assume that it has changed by toggle the value of last_applied_value.
@@ -741,7 +746,7 @@ void State::haveAppliedAttribute(AttributeMap& attributeMap,const StateAttribute
 {
     if (attribute)
     {
-        AttributeStack& as = attributeMap[attribute->getTypeMemberPair()];
+        AttributeStack& as = attributeMap.getChangedStack(attribute->getTypeMemberPair());
 
         as.last_applied_attribute = attribute;
 
@@ -753,10 +758,12 @@ void State::haveAppliedAttribute(AttributeMap& attributeMap,const StateAttribute
 void State::haveAppliedAttribute(AttributeMap& attributeMap,StateAttribute::Type type, unsigned int member)
 {
 
-    AttributeMap::iterator itr = attributeMap.find(StateAttribute::TypeMemberPair(type,member));
-    if (itr!=attributeMap.end())
+    unsigned int slot = attributeMap.getSlot(StateAttribute::TypeMemberPair(type,member));
+    if (slot!=AttributeMap::INVALID_SLOT)
     {
-        AttributeStack& as = itr->second;
+        attributeMap.addChangedSlot(slot);
+
+        AttributeStack& as = attributeMap.getStack(slot);
         as.last_applied_attribute = 0L;
 
         // will need to update this attribute on next apply so set it to changed.
@@ -794,13 +801,12 @@ const StateAttribute* State::getLastAppliedAttribute(const AttributeMap& attribu
 
 void State::dirtyAllModes()
 {
-    for(ModeMap::iterator mitr=_modeMap.begin();
-        mitr!=_modeMap.end();
-        ++mitr)
+    for(unsigned int slot=0; slot<_modeMap.size(); ++slot)
     {
-        ModeStack& ms = mitr->second;
+        ModeStack& ms = _modeMap.getStack(slot);
         ms.last_applied_value = !ms.last_applied_value;
         ms.changed = true;
+        _modeMap.addChangedSlot(slot);
 
     }
 
@@ -808,13 +814,12 @@ void State::dirtyAllModes()
         tmmItr!=_textureModeMapList.end();
         ++tmmItr)
     {
-        for(ModeMap::iterator mitr=tmmItr->begin();
-            mitr!=tmmItr->end();
-            ++mitr)
+        for(unsigned int slot=0; slot<tmmItr->size(); ++slot)
         {
-            ModeStack& ms = mitr->second;
+            ModeStack& ms = tmmItr->getStack(slot);
             ms.last_applied_value = !ms.last_applied_value;
             ms.changed = true;
+            tmmItr->addChangedSlot(slot);
 
         }
     }
@@ -822,13 +827,12 @@ void State::dirtyAllModes()
 
 void State::dirtyAllAttributes()
 {
-    for(AttributeMap::iterator aitr=_attributeMap.begin();
-        aitr!=_attributeMap.end();
-        ++aitr)
+    for(unsigned int slot=0; slot<_attributeMap.size(); ++slot)
     {
-        AttributeStack& as = aitr->second;
+        AttributeStack& as = _attributeMap.getStack(slot);
         as.last_applied_attribute = 0;
         as.changed = true;
+        _attributeMap.addChangedSlot(slot);
     }
 
 
@@ -837,13 +841,12 @@ void State::dirtyAllAttributes()
         ++tamItr)
     {
         AttributeMap& attributeMap = *tamItr;
-        for(AttributeMap::iterator aitr=attributeMap.begin();
-            aitr!=attributeMap.end();
-            ++aitr)
+        for(unsigned int slot=0; slot<attributeMap.size(); ++slot)
         {
-            AttributeStack& as = aitr->second;
+            AttributeStack& as = attributeMap.getStack(slot);
             as.last_applied_attribute = 0;
             as.changed = true;
+            attributeMap.addChangedSlot(slot);
         }
     }
 
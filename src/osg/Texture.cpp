@@ -21,6 +21,7 @@
 #include <osg/FrameBufferObject>
 #include <osg/TextureRectangle>
 #include <osg/Texture1D>
+#include <osg/GLObjects>
 
 #include <OpenThreads/ScopedLock>
 #include <OpenThreads/Mutex>
@@ -505,6 +506,15 @@ bool Texture::TextureObjectSet::makeSpace(unsigned int& size)
     return size==0;
 }
 
+void Texture::TextureObjectSet::collectTextureObjectsUnusedSince(unsigned int frameNumber, std::vector<TextureObject*>& list) const
+{
+    // the active list runs from least to most recently used, TextureObjects that are pending orphaning no longer have a Texture.
+    for(TextureObject* to = _head; to!=0 && to->_frameLastUsed<frameNumber; to = to->_next)
+    {
+        if (to->getTexture()) list.push_back(to);
+    }
+}
+
 Texture::TextureObject* Texture::TextureObjectSet::takeFromOrphans(Texture* texture)
 {
     // take front of orphaned list.
@@ -603,6 +613,8 @@ Texture::TextureObject* Texture::TextureObjectSet::takeOrGenerate(Texture* textu
 
 void Texture::TextureObjectSet::moveToBack(Texture::TextureObject* to)
 {
+    ScopedGLObjectsLock lock(_parent->getGLObjectsMutex());
+
 #if 0
     OSG_NOTICE<<"TextureObjectSet::moveToBack("<<to<<")"<<std::endl;
     OSG_NOTICE<<"    before _head = "<<_head<<std::endl;
@@ -747,6 +759,8 @@ void Texture::TextureObjectSet::remove(Texture::TextureObject* to)
 
 void Texture::TextureObjectSet::moveToSet(TextureObject* to, TextureObjectSet* set)
 {
+    ScopedGLObjectsLock lock(_parent->getGLObjectsMutex());
+
     if (set==this) return;
     if (!set) return;
 
@@ -775,6 +789,7 @@ unsigned int Texture::TextureObjectSet::computeNumTextureObjectsInList() const
 
 Texture::TextureObjectManager::TextureObjectManager(unsigned int contextID):
     _contextID(contextID),
+    _glObjectsMutex(GLObjectsMutex::getGLObjectsMutex(contextID)),
     _numActiveTextureObjects(0),
     _numOrphanedTextureObjects(0),
     _currTexturePoolSize(0),
@@ -804,6 +819,8 @@ void Texture::TextureObjectManager::setMaxTexturePoolSize(unsigned int size)
 
 bool Texture::TextureObjectManager::makeSpace(unsigned int size)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     for(TextureSetMap::iterator itr = _textureSetMap.begin();
         itr != _textureSetMap.end() && size>0;
         ++itr)
@@ -815,6 +832,18 @@ bool Texture::TextureObjectManager::makeSpace(unsigned int size)
 }
 
 
+void Texture::TextureObjectManager::collectTextureObjectsUnusedSince(unsigned int frameNumber, std::vector<TextureObject*>& list) const
+{
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
+    for(TextureSetMap::const_iterator itr = _textureSetMap.begin();
+        itr != _textureSetMap.end();
+        ++itr)
+    {
+        (*itr).second->collectTextureObjectsUnusedSince(frameNumber, list);
+    }
+}
+
 Texture::TextureObject* Texture::TextureObjectManager::generateTextureObject(const Texture* texture, GLenum target)
 {
     return generateTextureObject(texture, target, 0, 0, 0, 0, 0, 0);
@@ -829,6 +858,8 @@ Texture::TextureObject* Texture::TextureObjectManager::generateTextureObject(con
                                              GLsizei   depth,
                                              GLint     border)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     ElapsedTime elapsedTime(&(getGenerateTime()));
     ++getNumberGenerated();
 
@@ -846,6 +877,8 @@ Texture::TextureObjectSet* Texture::TextureObjectManager::getTextureObjectSet(co
 
 void Texture::TextureObjectManager::handlePendingOrphandedTextureObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     for(TextureSetMap::iterator itr = _textureSetMap.begin();
         itr != _textureSetMap.end();
         ++itr)
@@ -856,6 +889,8 @@ void Texture::TextureObjectManager::handlePendingOrphandedTextureObjects()
 
 void Texture::TextureObjectManager::deleteAllTextureObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     // OSG_NOTICE<<"Texture::TextureObjectManager::deleteAllTextureObjects() _contextID="<<_contextID<<std::endl;
 
     ElapsedTime elapsedTime(&(getDeleteTime()));
@@ -870,6 +905,8 @@ void Texture::TextureObjectManager::deleteAllTextureObjects()
 
 void Texture::TextureObjectManager::discardAllTextureObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     // OSG_NOTICE<<"Texture::TextureObjectManager::discardAllTextureObjects() _contextID="<<_contextID<<" _numActiveTextureObjects="<<_numActiveTextureObjects<<std::endl;
 
     for(TextureSetMap::iterator itr = _textureSetMap.begin();
@@ -882,6 +919,8 @@ void Texture::TextureObjectManager::discardAllTextureObjects()
 
 void Texture::TextureObjectManager::flushAllDeletedTextureObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     // OSG_NOTICE<<"Texture::TextureObjectManager::flushAllDeletedTextureObjects() _contextID="<<_contextID<<std::endl;
 
     ElapsedTime elapsedTime(&(getDeleteTime()));
@@ -896,6 +935,8 @@ void Texture::TextureObjectManager::flushAllDeletedTextureObjects()
 
 void Texture::TextureObjectManager::discardAllDeletedTextureObjects()
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     // OSG_NOTICE<<"Texture::TextureObjectManager::discardAllDeletedTextureObjects() _contextID="<<_contextID<<" _numActiveTextureObjects="<<_numActiveTextureObjects<<std::endl;
 
     for(TextureSetMap::iterator itr = _textureSetMap.begin();
@@ -908,6 +949,8 @@ void Texture::TextureObjectManager::discardAllDeletedTextureObjects()
 
 void Texture::TextureObjectManager::flushDeletedTextureObjects(double currentTime, double& availableTime)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     ElapsedTime elapsedTime(&(getDeleteTime()));
 
     for(TextureSetMap::iterator itr = _textureSetMap.begin();
@@ -927,6 +970,8 @@ void Texture::TextureObjectManager::releaseTextureObject(Texture::TextureObject*
 
 void Texture::TextureObjectManager::newFrame(osg::FrameStamp* fs)
 {
+    ScopedGLObjectsLock lock(_glObjectsMutex);
+
     if (fs) _frameNumber = fs->getFrameNumber();
     else ++_frameNumber;
 
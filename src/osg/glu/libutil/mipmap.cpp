@@ -50,6 +50,8 @@
 #include <math.h>
 #include <osg/Notify>
 
+#include "../../ImageKernels.h"
+
 namespace osg
 {
 
@@ -3548,6 +3550,10 @@ gluScaleImage(PixelStorageModes* psm, GLenum format, GLsizei widthin, GLsizei he
     if (!isLegalFormatForPackedPixelType(format, typeout)) {
        return GLU_INVALID_OPERATION;
     }
+    if (scaleImageWithKernels(psm, format, widthin, heightin, typein, datain,
+                              widthout, heightout, typeout, dataout)) {
+        return 0;
+    }
     beforeImage =
         (GLushort*) malloc(image_size(widthin, heightin, format, GL_UNSIGNED_SHORT));
     afterImage =
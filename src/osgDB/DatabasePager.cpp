@@ -20,6 +20,8 @@
 #include <osg/Geode>
 #include <osg/Timer>
 #include <osg/Texture>
+#include <osg/GraphicsContext>
+#include <osg/GLMemoryBudget>
 #include <osg/Notify>
 #include <osg/ProxyNode>
 #include <osg/ApplicationUsage>
@@ -31,6 +33,7 @@
 #include <set>
 #include <iterator>
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -47,6 +50,7 @@ static osg::ApplicationUsageProxy DatabasePager_e0(osg::ApplicationUsage::ENVIRO
 static osg::ApplicationUsageProxy DatabasePager_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_DRAWABLE <mode>","Set the drawable policy for setting of loaded drawable to specified type.  mode can be one of DoNotModify, DisplayList, VBO or VertexArrays>.");
 static osg::ApplicationUsageProxy DatabasePager_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_PRIORITY <mode>", "Set the thread priority to DEFAULT, MIN, LOW, NOMINAL, HIGH or MAX.");
 static osg::ApplicationUsageProxy DatabasePager_e11(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD <num>","Set the target maximum number of PagedLOD to maintain.");
+static osg::ApplicationUsageProxy DatabasePager_e13(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_WORK_STEALING <ON/OFF>","Set whether idle database threads may read requests queued for the other type of database thread.");
 static osg::ApplicationUsageProxy DatabasePager_e12(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_ASSIGN_PBO_TO_IMAGES <ON/OFF>","Set whether PixelBufferObjects should be assigned to Images to aid download to the GPU.");
 
 // Convert function objects that take pointer args into functions that a
@@ -294,11 +298,18 @@ public:
 class DatabasePager::FindCompileableGLObjectsVisitor : public osgUtil::StateToCompile
 {
 public:
-    FindCompileableGLObjectsVisitor(const DatabasePager* pager):
+    FindCompileableGLObjectsVisitor(const DatabasePager* pager, const Options* options):
             osgUtil::StateToCompile(osgUtil::GLObjectsVisitor::COMPILE_DISPLAY_LISTS|osgUtil::GLObjectsVisitor::COMPILE_STATE_ATTRIBUTES),
             _pager(pager),
             _changeAutoUnRef(false), _valueAutoUnRef(false),
-            _changeAnisotropy(false), _valueAnisotropy(1.0)
+            _changeAnisotropy(false), _valueAnisotropy(1.0),
+            _kdTreeBuildTime(0.0),
+            _prepareTexturesHint(Options::DO_NOT_PREPARE_TEXTURES),
+            _mipmapFilter(osg::MIPMAP_BOX_FILTER),
+            _s3tcSupported(false),
+            _rgtcSupported(false),
+            _numTexturesPrepared(0),
+            _texturePrepareTime(0.0)
     {
         _assignPBOToImages = _pager->_assignPBOToImages;
 
@@ -306,6 +317,14 @@ public:
         _valueAutoUnRef = _pager->_valueAutoUnRef;
         _changeAnisotropy = _pager->_changeAnisotropy;
         _valueAnisotropy = _pager->_valueAnisotropy;
+        _mipmapFilter = _pager->_mipmapFilter;
+
+        if (options) _prepareTexturesHint = options->getPrepareTexturesHint();
+
+        if (_prepareTexturesHint==Options::GENERATE_MIPMAPS_AND_COMPRESS)
+        {
+            getCompressionSupport(_s3tcSupported, _rgtcSupported);
+        }
 
         switch(_pager->_drawablePolicy)
         {
@@ -333,6 +352,7 @@ public:
             osgDB::Registry::instance()->getKdTreeBuilder())
         {
             _kdTreeBuilder = osgDB::Registry::instance()->getKdTreeBuilder()->clone();
+            _kdTreeBuilder->setBuildInParallel(true);
         }
     }
 
@@ -346,7 +366,20 @@ public:
 
         if (_kdTreeBuilder.valid())
         {
+            osg::Timer_t startTick = osg::Timer::instance()->tick();
             geode.accept(*_kdTreeBuilder);
+            _kdTreeBuildTime += osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+        }
+    }
+
+    /** Build the KdTrees that the KdTreeBuilder collected to build in parallel, call once the traversal is complete.*/
+    void buildKdTrees()
+    {
+        if (_kdTreeBuilder.valid())
+        {
+            osg::Timer_t startTick = osg::Timer::instance()->tick();
+            _kdTreeBuilder->buildKdTrees();
+            _kdTreeBuildTime += osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
         }
     }
 
@@ -363,6 +396,102 @@ public:
         {
             texture.setMaxAnisotropy(_valueAnisotropy);
         }
+
+        if (_prepareTexturesHint!=Options::DO_NOT_PREPARE_TEXTURES)
+        {
+            osg::Timer_t startTick = osg::Timer::instance()->tick();
+            if (prepareTexture(texture)) ++_numTexturesPrepared;
+            _texturePrepareTime += osg::Timer::instance()->delta_s(startTick, osg::Timer::instance()->tick());
+        }
+    }
+
+    /** Generate the mipmaps of the texture's image, and compress it if the texture asks for a compressed internal format,
+      * so the work is done here on the database thread rather than by the driver when the texture is compiled.*/
+    bool prepareTexture(osg::Texture& texture)
+    {
+        if (texture.getTextureTarget()!=GL_TEXTURE_2D || texture.getNumImages()!=1) return false;
+
+        osg::Image* image = texture.getImage(0);
+
+        // leave images that are shared through the object cache or another texture, or are updated after loading.
+        if (!image || !image->data() || image->referenceCount()!=1 ||
+            image->getDataVariance()==osg::Object::DYNAMIC || image->isCompressed()) return false;
+
+        // the driver resizes non power of two images before it builds the mipmaps, so leave those to it.
+        if (image->s()!=osg::Image::computeNearestPowerOfTwo(image->s()) ||
+            image->t()!=osg::Image::computeNearestPowerOfTwo(image->t())) return false;
+
+        bool prepared = false;
+
+        osg::Texture::FilterMode minFilter = texture.getFilter(osg::Texture::MIN_FILTER);
+        if (minFilter!=osg::Texture::LINEAR && minFilter!=osg::Texture::NEAREST && !image->isMipmap())
+        {
+            prepared = osg::generateMipmaps(image, _mipmapFilter);
+        }
+
+        if (_prepareTexturesHint==Options::GENERATE_MIPMAPS_AND_COMPRESS)
+        {
+            GLenum compressedFormat = getCompressedPixelFormat(texture.getInternalFormatMode(), image->getPixelFormat());
+            bool rgtc = (compressedFormat==GL_COMPRESSED_RED_RGTC1_EXT || compressedFormat==GL_COMPRESSED_RED_GREEN_RGTC2_EXT);
+            bool supported = rgtc ? _rgtcSupported : _s3tcSupported;
+            if (compressedFormat!=0 && supported && osg::compressImage(image, compressedFormat))
+            {
+                texture.setInternalFormatMode(osg::Texture::USE_IMAGE_DATA_FORMAT);
+                prepared = true;
+            }
+        }
+
+        return prepared;
+    }
+
+    /** Get whether every registered graphics context is known to support S3TC and RGTC compressed textures.  A context
+      * whose Texture::Extensions haven't been set up yet counts as unsupported, leaving the image uncompressed so that
+      * the driver compresses it, or falls back to an uncompressed format, when the texture is compiled.*/
+    static void getCompressionSupport(bool& s3tcSupported, bool& rgtcSupported)
+    {
+        osg::GraphicsContext::GraphicsContexts contexts = osg::GraphicsContext::getAllRegisteredGraphicsContexts();
+
+        s3tcSupported = !contexts.empty();
+        rgtcSupported = !contexts.empty();
+        for(osg::GraphicsContext::GraphicsContexts::iterator itr = contexts.begin();
+            itr != contexts.end();
+            ++itr)
+        {
+            osg::State* state = (*itr)->getState();
+            const osg::Texture::Extensions* extensions = state ? osg::Texture::getExtensions(state->getContextID(), false) : 0;
+            if (!extensions || !extensions->isCompressedTexImage2DSupported())
+            {
+                s3tcSupported = false;
+                rgtcSupported = false;
+                return;
+            }
+
+            if (!extensions->isTextureCompressionS3TCSupported()) s3tcSupported = false;
+            if (!extensions->isTextureCompressionRGTCSupported()) rgtcSupported = false;
+        }
+    }
+
+    /** Return the block compressed format the texture would have the driver compress the image to, or 0 if
+      * it isn't one that osg::compressImage() supports.*/
+    static GLenum getCompressedPixelFormat(osg::Texture::InternalFormatMode mode, GLenum pixelFormat)
+    {
+        bool hasAlpha = (pixelFormat==GL_RGBA || pixelFormat==GL_BGRA || pixelFormat==GL_LUMINANCE_ALPHA);
+        switch(mode)
+        {
+            case(osg::Texture::USE_S3TC_DXT1_COMPRESSION):
+            case(osg::Texture::USE_S3TC_DXT1c_COMPRESSION):
+                return hasAlpha ? 0 : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_ARB_COMPRESSION):
+            case(osg::Texture::USE_S3TC_DXT5_COMPRESSION):
+                return hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case(osg::Texture::USE_RGTC1_COMPRESSION):
+                return GL_COMPRESSED_RED_RGTC1_EXT;
+            case(osg::Texture::USE_RGTC2_COMPRESSION):
+                return GL_COMPRESSED_RED_GREEN_RGTC2_EXT;
+            default:
+                // DXT1a and DXT3 along with the non block formats are left to the driver.
+                return 0;
+        }
     }
 
     const DatabasePager*                    _pager;
@@ -371,6 +500,13 @@ public:
     bool                                    _changeAnisotropy;
     float                                   _valueAnisotropy;
     osg::ref_ptr<osg::KdTreeBuilder>        _kdTreeBuilder;
+    double                                  _kdTreeBuildTime;
+    Options::PrepareTexturesHint            _prepareTexturesHint;
+    osg::MipmapFilter                       _mipmapFilter;
+    bool                                    _s3tcSupported;
+    bool                                    _rgtcSupported;
+    unsigned int                            _numTexturesPrepared;
+    double                                  _texturePrepareTime;
 
 protected:
 
@@ -378,22 +514,6 @@ protected:
 };
 
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//
-//  SortFileRequestFunctor
-//
-struct DatabasePager::SortFileRequestFunctor
-{
-    bool operator() (const osg::ref_ptr<DatabasePager::DatabaseRequest>& lhs,const osg::ref_ptr<DatabasePager::DatabaseRequest>& rhs) const
-    {
-        if (lhs->_timestampLastRequest>rhs->_timestampLastRequest) return true;
-        else if (lhs->_timestampLastRequest<rhs->_timestampLastRequest) return false;
-        else return (lhs->_priorityLastRequest>rhs->_priorityLastRequest);
-    }
-};
-
-
-
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 //  DatabaseRequest
@@ -419,11 +539,12 @@ DatabasePager::RequestQueue::RequestQueue(DatabasePager* pager):
 DatabasePager::RequestQueue::~RequestQueue()
 {
     OSG_INFO<<"DatabasePager::RequestQueue::~RequestQueue() Destructing queue."<<std::endl;
-    for(RequestList::iterator itr = _requestList.begin();
-        itr != _requestList.end();
+    for(RequestHeap::iterator itr = _requestHeap.begin();
+        itr != _requestHeap.end();
         ++itr)
     {
-        invalidate(itr->get());
+        itr->_request->_requestQueue = 0;
+        invalidate(itr->_request.get());
     }
 }
 
@@ -441,6 +562,75 @@ void DatabasePager::RequestQueue::invalidate(DatabaseRequest* dr)
     dr->invalidate();
 }
 
+void DatabasePager::RequestQueue::setEntry(unsigned int index, const RequestHeapEntry& entry)
+{
+    _requestHeap[index] = entry;
+    entry._request->_heapIndex = index;
+}
+
+void DatabasePager::RequestQueue::siftUp(unsigned int index)
+{
+    RequestHeapEntry entry = _requestHeap[index];
+    while(index>0)
+    {
+        unsigned int parent = (index-1)/2;
+        if (!(entry > _requestHeap[parent])) break;
+
+        setEntry(index, _requestHeap[parent]);
+        index = parent;
+    }
+    setEntry(index, entry);
+}
+
+void DatabasePager::RequestQueue::siftDown(unsigned int index)
+{
+    unsigned int size = _requestHeap.size();
+    RequestHeapEntry entry = _requestHeap[index];
+    for(;;)
+    {
+        unsigned int child = index*2+1;
+        if (child>=size) break;
+
+        if (child+1<size && _requestHeap[child+1] > _requestHeap[child]) ++child;
+        if (!(_requestHeap[child] > entry)) break;
+
+        setEntry(index, _requestHeap[child]);
+        index = child;
+    }
+    setEntry(index, entry);
+}
+
+void DatabasePager::RequestQueue::eraseEntry(unsigned int index)
+{
+    _requestHeap[index]._request->_requestQueue = 0;
+
+    unsigned int last = _requestHeap.size()-1;
+    if (index!=last)
+    {
+        setEntry(index, _requestHeap[last]);
+        _requestHeap.pop_back();
+
+        if (index>0 && _requestHeap[index] > _requestHeap[(index-1)/2]) siftUp(index);
+        else siftDown(index);
+    }
+    else
+    {
+        _requestHeap.pop_back();
+    }
+}
+
+void DatabasePager::RequestQueue::rebuildHeap()
+{
+    for(unsigned int i=0; i<_requestHeap.size(); ++i)
+    {
+        _requestHeap[i]._request->_heapIndex = i;
+    }
+
+    for(unsigned int i=_requestHeap.size()/2; i>0; --i)
+    {
+        siftDown(i-1);
+    }
+}
 
 bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
 {
@@ -449,57 +639,68 @@ bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
     unsigned int frameNumber = _pager->_frameNumber;
     if (_frameNumberLastPruned != frameNumber)
     {
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+        RequestHeap::iterator end_itr = _requestHeap.begin();
+        for(RequestHeap::iterator citr = _requestHeap.begin();
+            citr != _requestHeap.end();
+            ++citr)
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-            if ((*citr)->isRequestCurrent(frameNumber))
+            if (citr->_request->isRequestCurrent(frameNumber))
             {
-                ++citr;
+                *(end_itr++) = *citr;
             }
             else
             {
-                invalidate(citr->get());
+                OSG_INFO<<"DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty(): Pruning "<<citr->_request.get()<<std::endl;
 
-                OSG_INFO<<"DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
+                citr->_request->_requestQueue = 0;
+                invalidate(citr->_request.get());
             }
         }
 
+        if (end_itr != _requestHeap.end())
+        {
+            _requestHeap.erase(end_itr, _requestHeap.end());
+            rebuildHeap();
+        }
+
         _frameNumberLastPruned = frameNumber;
 
         updateBlock();
     }
 
-    return _requestList.empty();
+    return _requestHeap.empty();
 }
 
 bool DatabasePager::RequestQueue::empty()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    return _requestList.empty();
+    return _requestHeap.empty();
 }
 
 unsigned int DatabasePager::RequestQueue::size()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    return _requestList.size();
+    return _requestHeap.size();
 }
 
 void DatabasePager::RequestQueue::clear()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
 
-    for(RequestList::iterator citr = _requestList.begin();
-        citr != _requestList.end();
-        ++citr)
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-        invalidate(citr->get());
+        for(RequestHeap::iterator citr = _requestHeap.begin();
+            citr != _requestHeap.end();
+            ++citr)
+        {
+            citr->_request->_requestQueue = 0;
+            invalidate(citr->_request.get());
+        }
     }
 
-    _requestList.clear();
+    _requestHeap.clear();
 
     _frameNumberLastPruned = _pager->_frameNumber;
 
@@ -518,79 +719,112 @@ void DatabasePager::RequestQueue::remove(DatabasePager::DatabaseRequest* databas
 {
     // OSG_NOTICE<<"DatabasePager::RequestQueue::remove(DatabaseRequest* databaseRequest)"<<std::endl;
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    for(RequestList::iterator citr = _requestList.begin();
-        citr != _requestList.end();
-        ++citr)
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+    if (databaseRequest->_requestQueue==this)
     {
-        if (citr->get()==databaseRequest)
-        {
-            // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
-            _requestList.erase(citr);
-            return;
-        }
+        // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
+        eraseEntry(databaseRequest->_heapIndex);
+        updateBlock();
     }
 }
 
 
 void DatabasePager::RequestQueue::addNoLock(DatabasePager::DatabaseRequest* databaseRequest)
 {
-    _requestList.push_back(databaseRequest);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+        if (databaseRequest->_requestQueue==this)
+        {
+            // already queued, just make sure it's in the right place
+            RequestHeapEntry entry(databaseRequest);
+            setEntry(databaseRequest->_heapIndex, entry);
+            siftUp(databaseRequest->_heapIndex);
+            siftDown(databaseRequest->_heapIndex);
+        }
+        else
+        {
+            databaseRequest->_requestQueue = this;
+            _requestHeap.push_back(RequestHeapEntry(databaseRequest));
+            databaseRequest->_heapIndex = _requestHeap.size()-1;
+            siftUp(databaseRequest->_heapIndex);
+        }
+    }
+
     updateBlock();
 }
 
-void DatabasePager::RequestQueue::swap(RequestList& requestList)
+void DatabasePager::RequestQueue::updatePriority(DatabasePager::DatabaseRequest* databaseRequest)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    _requestList.swap(requestList);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+
+    if (databaseRequest->_requestQueue!=this) return;
+
+    unsigned int index = databaseRequest->_heapIndex;
+    RequestHeapEntry entry(databaseRequest);
+    bool raised = entry > _requestHeap[index];
+    setEntry(index, entry);
+
+    if (raised) siftUp(index);
+    else siftDown(index);
 }
 
-void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
+void DatabasePager::RequestQueue::swap(RequestList& requestList)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
 
-    if (!_requestList.empty())
+    requestList.clear();
+    while(!_requestHeap.empty())
     {
-        DatabasePager::SortFileRequestFunctor highPriority;
+        requestList.push_back(_requestHeap.front()._request);
+        eraseEntry(0);
+    }
 
-        RequestQueue::RequestList::iterator selected_itr = _requestList.end();
+    updateBlock();
+}
+
+void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
 
+    if (!_requestHeap.empty())
+    {
         int frameNumber = _pager->_frameNumber;
 
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-            if ((*citr)->isRequestCurrent(frameNumber))
+
+            // the head of the heap is the most recently requested entry, so if it's no longer
+            // current it can be cancelled here before any thread gets to start reading it.
+            while(!_requestHeap.empty())
             {
-                if (selected_itr==_requestList.end() || highPriority(*citr, *selected_itr))
+                osg::ref_ptr<DatabaseRequest> head = _requestHeap.front()._request;
+                eraseEntry(0);
+
+                if (head->isRequestCurrent(frameNumber))
                 {
-                    selected_itr = citr;
+                    databaseRequest = head;
+                    break;
                 }
 
-                ++citr;
-            }
-            else
-            {
-                invalidate(citr->get());
+                invalidate(head.get());
 
-                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
+                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<head.get()<<std::endl;
             }
-
         }
 
-        _frameNumberLastPruned = frameNumber;
+        if (_requestHeap.empty()) _frameNumberLastPruned = frameNumber;
 
-        if (selected_itr != _requestList.end())
+        if (databaseRequest.valid())
         {
-            databaseRequest = *selected_itr;
-            _requestList.erase(selected_itr);
-            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestList.size()<<std::endl;
+            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestHeap.size()<<std::endl;
         }
         else
         {
-            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestList.size()<<std::endl;
+            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestHeap.size()<<std::endl;
         }
 
         updateBlock();
@@ -603,15 +837,23 @@ void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& datab
 //
 DatabasePager::ReadQueue::ReadQueue(DatabasePager* pager, const std::string& name):
     RequestQueue(pager),
-    _name(name)
+    _name(name),
+    _numRequestsQueued(0),
+    _hasChildrenToDelete(false)
 {
     _block = new osg::RefBlock;
 }
 
 void DatabasePager::ReadQueue::updateBlock()
 {
-    _block->set((!_requestList.empty() || !_childrenToDeleteList.empty()) &&
-                !_pager->_databasePagerThreadPaused);
+    // threads may take work from the other read queue, so the blocks of both
+    // queues have to be recomputed whenever either queue changes.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_pager->_readQueueBlockMutex);
+
+    _numRequestsQueued = _requestHeap.size();
+    _hasChildrenToDelete = !_childrenToDeleteList.empty();
+
+    _pager->updateReadQueueBlocks();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -688,6 +930,7 @@ void DatabasePager::DatabaseThread::run()
 
     osg::ref_ptr<DatabasePager::ReadQueue> read_queue;
     osg::ref_ptr<DatabasePager::ReadQueue> out_queue;
+    osg::ref_ptr<DatabasePager::ReadQueue> steal_queue;
 
     switch(_mode)
     {
@@ -697,9 +940,11 @@ void DatabasePager::DatabaseThread::run()
         case(HANDLE_NON_HTTP):
             read_queue = _pager->_fileRequestQueue;
             out_queue = _pager->_httpRequestQueue;
+            steal_queue = _pager->_httpRequestQueue;
             break;
         case(HANDLE_ONLY_HTTP):
             read_queue = _pager->_httpRequestQueue;
+            steal_queue = _pager->_fileRequestQueue;
             break;
     }
 
@@ -744,6 +989,20 @@ void DatabasePager::DatabaseThread::run()
         osg::ref_ptr<DatabaseRequest> databaseRequest;
         read_queue->takeFirst(databaseRequest);
 
+        // if our own queue is empty help out with the other queue, handling whatever
+        // we take as if this thread were handling all requests.
+        Mode mode = _mode;
+        if (!databaseRequest.valid() && steal_queue.valid() && _pager->_enableWorkStealing!=0)
+        {
+            steal_queue->takeFirst(databaseRequest);
+            if (databaseRequest.valid())
+            {
+                OSG_INFO<<_name<<": taking request from "<<steal_queue->_name<<std::endl;
+                ++(_pager->_numRequestsStolen);
+                mode = HANDLE_ALL_REQUESTS;
+            }
+        }
+
         bool readFromFileCache = false;
 
         osg::ref_ptr<FileCache> fileCache = osgDB::Registry::instance()->getFileCache();
@@ -782,7 +1041,7 @@ void DatabasePager::DatabaseThread::run()
             {
 
                 // now check to see if this request is appropriate for this thread
-                switch(_mode)
+                switch(mode)
                 {
                     case(HANDLE_ALL_REQUESTS):
                     {
@@ -882,9 +1141,13 @@ void DatabasePager::DatabaseThread::run()
                 loadedModel->getBound();
 
                 // find all the compileable rendering objects
-                DatabasePager::FindCompileableGLObjectsVisitor stateToCompile(_pager);
+                DatabasePager::FindCompileableGLObjectsVisitor stateToCompile(_pager, dr_loadOptions.get());
                 loadedModel->accept(stateToCompile);
 
+                stateToCompile.buildKdTrees();
+                if (stateToCompile._kdTreeBuilder.valid()) _pager->addKdTreeBuildTime(stateToCompile._kdTreeBuildTime);
+                if (stateToCompile._numTexturesPrepared>0) _pager->addTexturePrepareTime(stateToCompile._texturePrepareTime);
+
                 bool loadedObjectsNeedToBeCompiled = _pager->_doPreCompile &&
                                                      _pager->_incrementalCompileOperation.valid() &&
                                                      _pager->_incrementalCompileOperation->requiresCompile(stateToCompile);
@@ -1007,6 +1270,7 @@ DatabasePager::DatabasePager()
 
     _changeAnisotropy = false;
     _valueAnisotropy = 1.0f;
+    _mipmapFilter = osg::MIPMAP_BOX_FILTER;
 
 
     _deleteRemovedSubgraphsInDatabaseThread = true;
@@ -1032,6 +1296,15 @@ DatabasePager::DatabasePager()
                         strcmp(str,"on")==0 || strcmp(str,"ON")==0;
     }
 
+    // off by default, so that file and http threads only read the requests of their own queue unless asked otherwise.
+    _enableWorkStealing.exchange(0);
+    if( (str = getenv("OSG_DATABASE_PAGER_WORK_STEALING")) != 0)
+    {
+        bool enable = strcmp(str,"yes")==0 || strcmp(str,"YES")==0 ||
+                      strcmp(str,"on")==0 || strcmp(str,"ON")==0;
+        _enableWorkStealing.exchange(enable ? 1 : 0);
+    }
+
     // initialize the stats variables
     resetStats();
 
@@ -1098,6 +1371,7 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
     _valueAutoUnRef = rhs._valueAutoUnRef;
     _changeAnisotropy = rhs._changeAnisotropy;
     _valueAnisotropy = rhs._valueAnisotropy;
+    _mipmapFilter = rhs._mipmapFilter;
 
     _deleteRemovedSubgraphsInDatabaseThread = rhs._deleteRemovedSubgraphsInDatabaseThread;
 
@@ -1105,6 +1379,8 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
 
     _doPreCompile = rhs._doPreCompile;
 
+    _enableWorkStealing.exchange(rhs._enableWorkStealing);
+
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
 
@@ -1293,6 +1569,88 @@ void DatabasePager::resetStats()
     _maximumTimeToMergeTile = -DBL_MAX;
     _totalTimeToMergeTiles = 0.0;
     _numTilesMerges = 0;
+
+    _maximumLocalFileRequestListSize = 0;
+    _maximumHttpRequestListSize = 0;
+    _numRequestsStolen.exchange(0);
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_kdTreeStatsMutex);
+        _totalTimeToBuildKdTrees = 0.0;
+        _maximumTimeToBuildKdTrees = 0.0;
+        _numKdTreeBuilds = 0;
+    }
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureStatsMutex);
+        _totalTimeToPrepareTextures = 0.0;
+        _maximumTimeToPrepareTextures = 0.0;
+        _numTexturePreparations = 0;
+    }
+}
+
+void DatabasePager::addKdTreeBuildTime(double timeToBuild)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_kdTreeStatsMutex);
+    _totalTimeToBuildKdTrees += timeToBuild;
+    if (timeToBuild>_maximumTimeToBuildKdTrees) _maximumTimeToBuildKdTrees = timeToBuild;
+    ++_numKdTreeBuilds;
+}
+
+double DatabasePager::getTotalTimeToBuildKdTrees() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_kdTreeStatsMutex);
+    return _totalTimeToBuildKdTrees;
+}
+
+double DatabasePager::getMaximumTimeToBuildKdTrees() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_kdTreeStatsMutex);
+    return _maximumTimeToBuildKdTrees;
+}
+
+double DatabasePager::getAverageTimeToBuildKdTrees() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_kdTreeStatsMutex);
+    return (_numKdTreeBuilds > 0) ? _totalTimeToBuildKdTrees/static_cast<double>(_numKdTreeBuilds) : 0.0;
+}
+
+unsigned int DatabasePager::getNumKdTreeBuilds() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_kdTreeStatsMutex);
+    return _numKdTreeBuilds;
+}
+
+void DatabasePager::addTexturePrepareTime(double timeToPrepare)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureStatsMutex);
+    _totalTimeToPrepareTextures += timeToPrepare;
+    if (timeToPrepare>_maximumTimeToPrepareTextures) _maximumTimeToPrepareTextures = timeToPrepare;
+    ++_numTexturePreparations;
+}
+
+double DatabasePager::getTotalTimeToPrepareTextures() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureStatsMutex);
+    return _totalTimeToPrepareTextures;
+}
+
+double DatabasePager::getMaximumTimeToPrepareTextures() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureStatsMutex);
+    return _maximumTimeToPrepareTextures;
+}
+
+double DatabasePager::getAverageTimeToPrepareTextures() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureStatsMutex);
+    return (_numTexturePreparations > 0) ? _totalTimeToPrepareTextures/static_cast<double>(_numTexturePreparations) : 0.0;
+}
+
+unsigned int DatabasePager::getNumTexturePreparations() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_textureStatsMutex);
+    return _numTexturePreparations;
 }
 
 bool DatabasePager::getRequestsInProgress() const
@@ -1383,6 +1741,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
     {
         DatabaseRequest* databaseRequest = dynamic_cast<DatabaseRequest*>(databaseRequestRef.get());
         bool requeue = false;
+        osg::ref_ptr<RequestQueue> queuedIn;
         if (databaseRequest)
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
@@ -1402,6 +1761,8 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
                 databaseRequest->_priorityLastRequest = priority;
                 ++(databaseRequest->_numOfRequests);
 
+                queuedIn = databaseRequest->_requestQueue;
+
                 foundEntry = true;
 
                 if (databaseRequestRef->referenceCount()==1)
@@ -1421,6 +1782,8 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
         }
         if (requeue)
             _fileRequestQueue->add(databaseRequest);
+        else if (queuedIn.valid())
+            queuedIn->updatePriority(databaseRequest);
     }
 
     if (!foundEntry)
@@ -1521,6 +1884,34 @@ void DatabasePager::setDatabasePagerThreadPause(bool pause)
 }
 
 
+void DatabasePager::setEnableWorkStealing(bool flag)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_readQueueBlockMutex);
+    _enableWorkStealing.exchange(flag ? 1 : 0);
+    updateReadQueueBlocks();
+}
+
+void DatabasePager::updateReadQueueBlocks()
+{
+    // may be called from within the ReadQueue constructors, before the queues have been assigned.
+    if (!_fileRequestQueue || !_httpRequestQueue) return;
+
+    ReadQueue* fileQueue = _fileRequestQueue.get();
+    ReadQueue* httpQueue = _httpRequestQueue.get();
+
+    if (fileQueue->_numRequestsQueued>_maximumLocalFileRequestListSize) _maximumLocalFileRequestListSize = fileQueue->_numRequestsQueued;
+    if (httpQueue->_numRequestsQueued>_maximumHttpRequestListSize) _maximumHttpRequestListSize = httpQueue->_numRequestsQueued;
+
+    bool fileWork = fileQueue->_numRequestsQueued>0;
+    bool httpWork = httpQueue->_numRequestsQueued>0;
+
+    fileQueue->_block->set((fileWork || fileQueue->_hasChildrenToDelete || (_enableWorkStealing!=0 && httpWork)) &&
+                           !_databasePagerThreadPaused);
+
+    httpQueue->_block->set((httpWork || httpQueue->_hasChildrenToDelete || (_enableWorkStealing!=0 && fileWork)) &&
+                           !_databasePagerThreadPaused);
+}
+
 bool DatabasePager::requiresUpdateSceneGraph() const
 {
     return !(_dataToMergeList->empty());
@@ -1695,13 +2086,18 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
     if (s_total_max_stage_a<time_a) s_total_max_stage_a = time_a;
 
 
-    if (numPagedLODs <= _targetMaximumNumberOfPageLOD)
+    // when eviction couldn't bring a graphics context back within its GL memory budget, expire a share of the
+    // PagedLOD children that aren't being drawn in proportion to the bytes still over, assuming the PagedLODs
+    // hold similar amounts of GL memory, so their GL objects are deleted along with them.
+    int numToPruneForGLMemory = static_cast<int>(ceil(osg::GLMemoryBudget::computeMaxFractionOverBudget()*double(numPagedLODs)));
+
+    if (numPagedLODs <= _targetMaximumNumberOfPageLOD && numToPruneForGLMemory==0)
     {
         // nothing to do
         return;
     }
 
-    int numToPrune = numPagedLODs - _targetMaximumNumberOfPageLOD;
+    int numToPrune = osg::maximum(static_cast<int>(numPagedLODs) - static_cast<int>(_targetMaximumNumberOfPageLOD), numToPruneForGLMemory);
 
     ObjectList childrenRemoved;
 
@@ -569,15 +569,10 @@ osg::PrimitiveSet* InputStream::readPrimitiveSet()
         break;
     case ID_DRAWARRAY_LENGTH:
         {
-            int first = 0, value = 0; unsigned int size = 0;
-            *this >> first >> size >> BEGIN_BRACKET;
+            int first = 0;
+            *this >> first;
             osg::DrawArrayLengths* dl = new osg::DrawArrayLengths( mode.get(), first );
-            for ( unsigned int i=0; i<size; ++i )
-            {
-                *this >> value;
-                dl->push_back( value );
-            }
-            *this >> END_BRACKET;
+            readArrayImplementation( dl, 1, INT_SIZE );
             primitive = dl;
             primitive->setNumInstances( numInstances );
         }
@@ -585,14 +580,7 @@ osg::PrimitiveSet* InputStream::readPrimitiveSet()
     case ID_DRAWELEMENTS_UBYTE:
         {
             osg::DrawElementsUByte* de = new osg::DrawElementsUByte( mode.get() );
-            unsigned int size = 0; unsigned char value = 0;
-            *this >> size >> BEGIN_BRACKET;
-            for ( unsigned int i=0; i<size; ++i )
-            {
-                *this >> value;
-                de->push_back( value );
-            }
-            *this >> END_BRACKET;
+            readArrayImplementation( de, 1, CHAR_SIZE );
             primitive = de;
             primitive->setNumInstances( numInstances );
         }
@@ -600,14 +588,7 @@ osg::PrimitiveSet* InputStream::readPrimitiveSet()
     case ID_DRAWELEMENTS_USHORT:
         {
             osg::DrawElementsUShort* de = new osg::DrawElementsUShort( mode.get() );
-            unsigned int size = 0; unsigned short value = 0;
-            *this >> size >> BEGIN_BRACKET;
-            for ( unsigned int i=0; i<size; ++i )
-            {
-                *this >> value;
-                de->push_back( value );
-            }
-            *this >> END_BRACKET;
+            readArrayImplementation( de, 1, SHORT_SIZE );
             primitive = de;
             primitive->setNumInstances( numInstances );
         }
@@ -615,14 +596,7 @@ osg::PrimitiveSet* InputStream::readPrimitiveSet()
     case ID_DRAWELEMENTS_UINT:
         {
             osg::DrawElementsUInt* de = new osg::DrawElementsUInt( mode.get() );
-            unsigned int size = 0, value = 0;
-            *this >> size >> BEGIN_BRACKET;
-            for ( unsigned int i=0; i<size; ++i )
-            {
-                *this >> value;
-                de->push_back( value );
-            }
-            *this >> END_BRACKET;
+            readArrayImplementation( de, 1, INT_SIZE );
             primitive = de;
             primitive->setNumInstances( numInstances );
         }
@@ -0,0 +1,275 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osgDB/MappedFile>
+#include <osgDB/ConvertUTF>
+
+#include <osg/Config>
+#include <osg/Notify>
+
+#include <string.h>
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    #define WIN32_LEAN_AND_MEAN
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+using namespace osgDB;
+
+MappedFile::MappedFile():
+    _data(0),
+    _size(0)
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    ,_fileHandle(INVALID_HANDLE_VALUE),
+    _mappingHandle(0)
+#endif
+{
+}
+
+MappedFile::MappedFile(const std::string& filename):
+    _data(0),
+    _size(0)
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    ,_fileHandle(INVALID_HANDLE_VALUE),
+    _mappingHandle(0)
+#endif
+{
+    open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+#ifdef OSG_USE_UTF8_FILENAME
+    _fileHandle = CreateFileW(convertUTF8toUTF16(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+    _fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#endif
+    if (_fileHandle==INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_fileHandle, &fileSize) || fileSize.QuadPart==0 ||
+        static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<unsigned long long>(~std::size_t(0)))
+    {
+        close();
+        return false;
+    }
+
+    _mappingHandle = CreateFileMapping(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!_mappingHandle)
+    {
+        close();
+        return false;
+    }
+
+    _data = static_cast<const char*>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!_data)
+    {
+        OSG_INFO<<"MappedFile::open("<<filename<<") unable to map file."<<std::endl;
+        close();
+        return false;
+    }
+
+    _size = static_cast<std::size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data) UnmapViewOfFile(_data);
+    if (_mappingHandle) CloseHandle(_mappingHandle);
+    if (_fileHandle!=INVALID_HANDLE_VALUE) CloseHandle(_fileHandle);
+
+    _data = 0;
+    _size = 0;
+    _mappingHandle = 0;
+    _fileHandle = INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::adviseSequential()
+{
+}
+
+void MappedFile::adviseRandom()
+{
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd<0) return false;
+
+    struct stat fileStat;
+    if (::fstat(fd, &fileStat)!=0 || !S_ISREG(fileStat.st_mode) || fileStat.st_size==0 ||
+        static_cast<unsigned long long>(fileStat.st_size) > static_cast<unsigned long long>(~std::size_t(0)))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(fileStat.st_size);
+    void* data = ::mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps its own reference to the file.
+    ::close(fd);
+
+    if (data==MAP_FAILED)
+    {
+        OSG_INFO<<"MappedFile::open("<<filename<<") unable to map file."<<std::endl;
+        return false;
+    }
+
+    _data = static_cast<const char*>(data);
+    _size = size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (_data) ::munmap(const_cast<char*>(_data), _size);
+
+    _data = 0;
+    _size = 0;
+}
+
+void MappedFile::adviseSequential()
+{
+#if defined(POSIX_MADV_SEQUENTIAL)
+    if (_data) ::posix_madvise(const_cast<char*>(_data), _size, POSIX_MADV_SEQUENTIAL);
+#endif
+}
+
+void MappedFile::adviseRandom()
+{
+#if defined(POSIX_MADV_RANDOM)
+    if (_data) ::posix_madvise(const_cast<char*>(_data), _size, POSIX_MADV_RANDOM);
+#endif
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MappedFileStreamBuf
+//
+MappedFileStreamBuf::MappedFileStreamBuf(MappedFile* file):
+    _file(file)
+{
+    if (_file.valid() && _file->valid())
+    {
+        char* begin = const_cast<char*>(_file->data());
+        setg(begin, begin, begin+_file->size());
+    }
+}
+
+MappedFileStreamBuf::MappedFileStreamBuf(MappedFile* file, std::size_t offset, std::size_t size):
+    _file(file)
+{
+    if (_file.valid() && _file->valid() && offset<=_file->size() && size<=_file->size()-offset)
+    {
+        char* begin = const_cast<char*>(_file->data())+offset;
+        setg(begin, begin, begin+size);
+    }
+}
+
+MappedFileStreamBuf::pos_type MappedFileStreamBuf::seekoff(off_type off, std::ios_base::seekdir way, std::ios_base::openmode which)
+{
+    off_type base = 0;
+    switch(way)
+    {
+        case(std::ios_base::beg): base = 0; break;
+        case(std::ios_base::cur): base = gptr()-eback(); break;
+        case(std::ios_base::end): base = egptr()-eback(); break;
+        default: return pos_type(off_type(-1));
+    }
+    return seekpos(pos_type(base+off), which);
+}
+
+MappedFileStreamBuf::pos_type MappedFileStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+    off_type offset = off_type(pos);
+    if ((which & std::ios_base::in)==0 || offset<0 || offset>(egptr()-eback())) return pos_type(off_type(-1));
+
+    setg(eback(), eback()+offset, egptr());
+    return pos;
+}
+
+std::streamsize MappedFileStreamBuf::showmanyc()
+{
+    return gptr()<egptr() ? std::streamsize(egptr()-gptr()) : std::streamsize(-1);
+}
+
+std::streamsize MappedFileStreamBuf::xsgetn(char_type* s, std::streamsize n)
+{
+    std::streamsize available = egptr()-gptr();
+    if (n>available) n = available;
+    if (n<=0) return 0;
+
+    memcpy(s, gptr(), static_cast<std::size_t>(n));
+
+    // setg rather than gbump as gbump is limited to int sized steps.
+    setg(eback(), gptr()+n, egptr());
+    return n;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  MappedFileStream
+//
+MappedFileStream::MappedFileStream(MappedFile* file):
+    std::istream(0),
+    _buffer(file)
+{
+    rdbuf(&_buffer);
+    if (!is_open()) setstate(std::ios_base::failbit);
+}
+
+MappedFileStream::MappedFileStream(MappedFile* file, std::size_t offset, std::size_t size):
+    std::istream(0),
+    _buffer(file, offset, size)
+{
+    rdbuf(&_buffer);
+    if (!is_open() || offset>file->size() || size>file->size()-offset) setstate(std::ios_base::failbit);
+}
+
+MappedFileStream::MappedFileStream(const std::string& filename):
+    std::istream(0),
+    _buffer(new MappedFile(filename))
+{
+    rdbuf(&_buffer);
+    if (!is_open()) setstate(std::ios_base::failbit);
+}
+
+MappedFileStream::~MappedFileStream()
+{
+}
@@ -0,0 +1,516 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgDB/ObjectCache>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Image>
+#include <osg/NodeVisitor>
+#include <osg/Shader>
+#include <osg/Shape>
+#include <osg/Texture>
+
+#include <OpenThreads/ScopedLock>
+
+#include <set>
+
+using namespace osgDB;
+
+namespace
+{
+
+class ComputeObjectSizeVisitor : public osg::NodeVisitor
+{
+public:
+
+    ComputeObjectSizeVisitor():
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _size(0) {}
+
+    virtual void apply(osg::Node& node)
+    {
+        apply(node.getStateSet());
+        traverse(node);
+    }
+
+    virtual void apply(osg::Geode& geode)
+    {
+        apply(geode.getStateSet());
+
+        for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+        {
+            osg::Drawable* drawable = geode.getDrawable(i);
+            if (!drawable || !_visited.insert(drawable).second) continue;
+
+            apply(drawable->getStateSet());
+
+            osg::Geometry* geometry = drawable->asGeometry();
+            if (!geometry) continue;
+
+            add(geometry->getVertexArray());
+            add(geometry->getNormalArray());
+            add(geometry->getColorArray());
+            add(geometry->getSecondaryColorArray());
+            add(geometry->getFogCoordArray());
+            for(unsigned int t=0; t<geometry->getNumTexCoordArrays(); ++t) add(geometry->getTexCoordArray(t));
+            for(unsigned int a=0; a<geometry->getNumVertexAttribArrays(); ++a) add(geometry->getVertexAttribArray(a));
+            for(unsigned int p=0; p<geometry->getNumPrimitiveSets(); ++p) add(geometry->getPrimitiveSet(p));
+        }
+    }
+
+    void apply(osg::StateSet* stateset)
+    {
+        if (!stateset || !_visited.insert(stateset).second) return;
+
+        const osg::StateSet::TextureAttributeList& tal = stateset->getTextureAttributeList();
+        for(unsigned int unit=0; unit<tal.size(); ++unit)
+        {
+            const osg::Texture* texture = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+            if (!texture) continue;
+
+            for(unsigned int i=0; i<texture->getNumImages(); ++i) add(texture->getImage(i));
+        }
+    }
+
+    void add(const osg::BufferData* data)
+    {
+        if (data && _visited.insert(data).second) _size += data->getTotalDataSize();
+    }
+
+    unsigned long long          _size;
+    std::set<const void*>       _visited;
+};
+
+// FNV-1a, spreads the paths of neighbouring tiles, which differ in only a few characters, over the shards.
+// Those characters are towards the end of the path, so only the last few are hashed, keeping the hash cheap
+// next to the map search of each lookup.
+unsigned int hashFileName(const std::string& fileName)
+{
+    const std::string::size_type maxNumHashed = 16;
+    std::string::const_iterator itr = fileName.size()>maxNumHashed ? fileName.end()-maxNumHashed : fileName.begin();
+
+    unsigned int hash = 2166136261u;
+    for(; itr != fileName.end(); ++itr)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*itr)) * 16777619u;
+    }
+    return hash;
+}
+
+}
+
+ObjectCache::ObjectCache():
+    _maxSize(0),
+    _numBytes(0)
+{
+}
+
+ObjectCache::~ObjectCache()
+{
+}
+
+void ObjectCache::setMaxSize(unsigned long long size)
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_numBytesMutex);
+        _maxSize = size;
+    }
+
+    // sizes are only tracked while bounded, so compute those of the entries added while unbounded, or forget them all.
+    bool bounded = size!=0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+        if (shard._bounded==bounded) continue;
+
+        shard._bounded = bounded;
+        for(EntryMap::iterator itr = shard._entries.begin();
+            itr != shard._entries.end();
+            ++itr)
+        {
+            unsigned long long entrySize = bounded ? computeObjectSize(itr->second._object.get()) : 0;
+            addToNumBytes(entrySize, itr->second._size);
+            itr->second._size = entrySize;
+        }
+    }
+
+    if (bounded) evict();
+}
+
+unsigned long long ObjectCache::getMaxSize() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_numBytesMutex);
+    return _maxSize;
+}
+
+unsigned long long ObjectCache::computeObjectSize(const osg::Object* object)
+{
+    if (!object) return 0;
+
+    const osg::BufferData* data = dynamic_cast<const osg::BufferData*>(object);
+    if (data) return data->getTotalDataSize();
+
+    const osg::Node* node = dynamic_cast<const osg::Node*>(object);
+    if (node)
+    {
+        ComputeObjectSizeVisitor csv;
+        const_cast<osg::Node*>(node)->accept(csv);
+        return csv._size;
+    }
+
+    const osg::HeightField* heightField = dynamic_cast<const osg::HeightField*>(object);
+    if (heightField && heightField->getFloatArray()) return heightField->getFloatArray()->getTotalDataSize();
+
+    const osg::Shader* shader = dynamic_cast<const osg::Shader*>(object);
+    if (shader) return shader->getShaderSource().size();
+
+    return 0;
+}
+
+ObjectCache::Shard& ObjectCache::getShard(const std::string& fileName)
+{
+    return _shards[hashFileName(fileName) % NUM_SHARDS];
+}
+
+ObjectCache::Entry* ObjectCache::find(Shard& shard, const std::string& fileName)
+{
+    EntryMap::iterator itr = shard._entries.find(fileName);
+    if (itr==shard._entries.end())
+    {
+        ++shard._numMisses;
+        return 0;
+    }
+
+    ++shard._numHits;
+    if (shard._bounded)
+    {
+        shard._lru.splice(shard._lru.begin(), shard._lru, itr->second._lruPosition);
+        itr->second._lastUsed = _useCount;
+    }
+    return &(itr->second);
+}
+
+void ObjectCache::erase(Shard& shard, EntryMap::iterator itr)
+{
+    if (itr->second._size!=0) addToNumBytes(0, itr->second._size);
+    shard._lru.erase(itr->second._lruPosition);
+    shard._entries.erase(itr);
+    shard._noEvictionCandidate = false;
+}
+
+void ObjectCache::addToNumBytes(unsigned long long size, unsigned long long removedSize)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_numBytesMutex);
+    _numBytes = _numBytes + size - removedSize;
+}
+
+bool ObjectCache::isOverBudget() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_numBytesMutex);
+    return _maxSize!=0 && _numBytes>_maxSize;
+}
+
+ObjectCache::EntryPair* ObjectCache::findEvictionCandidate(Shard& shard)
+{
+    if (shard._noEvictionCandidate) return 0;
+
+    for(LRUList::reverse_iterator litr = shard._lru.rbegin();
+        litr != shard._lru.rend();
+        ++litr)
+    {
+        // an object referenced elsewhere would stay in memory, so leave it available to be shared.
+        if ((*litr)->second._object->referenceCount()==1) return *litr;
+    }
+
+    shard._noEvictionCandidate = true;
+    return 0;
+}
+
+void ObjectCache::evict()
+{
+    // one thread evicts at a time, so that threads adding entries together don't evict more than needed.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> evictLock(_evictMutex);
+
+    while(isOverBudget())
+    {
+        // the least recently used candidate of each shard is at the back of its LRU list, the oldest of those goes.
+        Shard* oldestShard = 0;
+        unsigned int oldestLastUsed = 0;
+        for(unsigned int i=0; i<NUM_SHARDS; ++i)
+        {
+            Shard& shard = _shards[i];
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+            EntryPair* candidate = findEvictionCandidate(shard);
+            if (candidate && (!oldestShard || candidate->second._lastUsed<oldestLastUsed))
+            {
+                oldestShard = &shard;
+                oldestLastUsed = candidate->second._lastUsed;
+            }
+        }
+
+        // everything left is referenced elsewhere.
+        if (!oldestShard) return;
+
+        // the shard was unlocked meanwhile, so evict whichever entry is now its candidate.
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(oldestShard->_mutex);
+        EntryPair* candidate = findEvictionCandidate(*oldestShard);
+        if (!candidate) continue;
+
+        ++(oldestShard->_numEvictions);
+        oldestShard->_numBytesEvicted += candidate->second._size;
+        erase(*oldestShard, oldestShard->_entries.find(candidate->first));
+    }
+}
+
+void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp)
+{
+    if (!object) return;
+
+    Shard& shard = getShard(filename);
+
+    // the size is only needed when bounded, compute it before locking the shard as it may traverse a whole subgraph.
+    bool bounded;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+        bounded = shard._bounded;
+    }
+    unsigned long long size = bounded ? computeObjectSize(object) : 0;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        // a maximum size was set meanwhile.
+        if (shard._bounded && !bounded)
+        {
+            bounded = true;
+            size = computeObjectSize(object);
+        }
+
+        EntryMap::iterator itr = shard._entries.find(filename);
+        if (itr==shard._entries.end())
+        {
+            itr = shard._entries.insert(EntryMap::value_type(filename, Entry())).first;
+            shard._lru.push_front(&(*itr));
+            itr->second._lruPosition = shard._lru.begin();
+        }
+        else if (bounded)
+        {
+            shard._lru.splice(shard._lru.begin(), shard._lru, itr->second._lruPosition);
+        }
+
+        if (bounded) addToNumBytes(size, itr->second._size);
+
+        itr->second._object = object;
+        itr->second._timestamp = timestamp;
+        itr->second._size = size;
+        itr->second._lastUsed = bounded ? ++_useCount : 0;
+        shard._noEvictionCandidate = false;
+    }
+
+    if (bounded) evict();
+}
+
+void ObjectCache::removeFromObjectCache(const std::string& fileName)
+{
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+    EntryMap::iterator itr = shard._entries.find(fileName);
+    if (itr!=shard._entries.end()) erase(shard, itr);
+}
+
+osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName)
+{
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+    Entry* entry = find(shard, fileName);
+    return entry ? entry->_object.get() : 0;
+}
+
+osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName)
+{
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+    Entry* entry = find(shard, fileName);
+    return entry ? entry->_object : 0;
+}
+
+void ObjectCache::updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        // objects may have been released since the shard was last searched for one to evict.
+        shard._noEvictionCandidate = false;
+
+        // look for objects with external references and update their time stamp.
+        for(EntryMap::iterator itr = shard._entries.begin();
+            itr != shard._entries.end();
+            ++itr)
+        {
+            // if ref count is greater the 1 the object has an external reference.
+            if (itr->second._object->referenceCount()>1)
+            {
+                itr->second._timestamp = referenceTime;
+            }
+        }
+    }
+}
+
+void ObjectCache::removeExpiredObjectsInCache(double expiryTime)
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        EntryMap::iterator itr = shard._entries.begin();
+        while(itr != shard._entries.end())
+        {
+            if (itr->second._timestamp<=expiryTime)
+            {
+                erase(shard, itr++);
+            }
+            else
+            {
+                ++itr;
+            }
+        }
+    }
+}
+
+void ObjectCache::clear()
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        for(EntryMap::iterator itr = shard._entries.begin();
+            itr != shard._entries.end();
+            ++itr)
+        {
+            if (itr->second._size!=0) addToNumBytes(0, itr->second._size);
+        }
+
+        shard._entries.clear();
+        shard._lru.clear();
+        shard._noEvictionCandidate = false;
+    }
+}
+
+void ObjectCache::releaseGLObjects(osg::State* state)
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+
+        for(EntryMap::iterator itr = shard._entries.begin();
+            itr != shard._entries.end();
+            ++itr)
+        {
+            itr->second._object->releaseGLObjects(state);
+        }
+    }
+}
+
+unsigned int ObjectCache::getNumObjects() const
+{
+    unsigned int numObjects = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i]._mutex);
+        numObjects += _shards[i]._entries.size();
+    }
+    return numObjects;
+}
+
+unsigned long long ObjectCache::getNumBytes() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_numBytesMutex);
+    return _numBytes;
+}
+
+unsigned int ObjectCache::getNumHits() const
+{
+    unsigned int numHits = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i]._mutex);
+        numHits += _shards[i]._numHits;
+    }
+    return numHits;
+}
+
+unsigned int ObjectCache::getNumMisses() const
+{
+    unsigned int numMisses = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i]._mutex);
+        numMisses += _shards[i]._numMisses;
+    }
+    return numMisses;
+}
+
+unsigned int ObjectCache::getNumEvictions() const
+{
+    unsigned int numEvictions = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i]._mutex);
+        numEvictions += _shards[i]._numEvictions;
+    }
+    return numEvictions;
+}
+
+unsigned long long ObjectCache::getNumBytesEvicted() const
+{
+    unsigned long long numBytesEvicted = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_shards[i]._mutex);
+        numBytesEvicted += _shards[i]._numBytesEvicted;
+    }
+    return numBytesEvicted;
+}
+
+void ObjectCache::resetStats()
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._mutex);
+        shard._numHits = 0;
+        shard._numMisses = 0;
+        shard._numEvictions = 0;
+        shard._numBytesEvicted = 0;
+    }
+}
+
+void ObjectCache::reportStats(std::ostream& out) const
+{
+    unsigned long long maxSize = getMaxSize();
+    out<<"ObjectCache objects "<<getNumObjects()<<", bytes "<<getNumBytes();
+    if (maxSize!=0) out<<" of "<<maxSize;
+    out<<", hits "<<getNumHits()<<", misses "<<getNumMisses()
+       <<", evictions "<<getNumEvictions()<<" ("<<getNumBytesEvicted()<<" bytes)"<<std::endl;
+}
@@ -23,6 +23,7 @@ Options::Options(const Options& options,const osg::CopyOp& copyop):
     _objectCacheHint(options._objectCacheHint),
     _precisionHint(options._precisionHint),
     _buildKdTreesHint(options._buildKdTreesHint),
+    _prepareTexturesHint(options._prepareTexturesHint),
     _pluginData(options._pluginData),
     _pluginStringData(options._pluginStringData),
     _findFileCallback(options._findFileCallback),
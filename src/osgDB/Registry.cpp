@@ -62,6 +62,7 @@ static osg::ApplicationUsageProxy Registry_e1(osg::ApplicationUsage::ENVIRONMENT
 #endif
 
 static osg::ApplicationUsageProxy Registry_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_BUILD_KDTREES on/off","Enable/disable the automatic building of KdTrees for each loaded Geometry.");
+static osg::ApplicationUsageProxy Registry_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_OBJECT_CACHE_SIZE <int>","Set the number of bytes of data the objects in the Registry's object cache may hold, evicting the least recently used beyond it.");
 
 
 // from MimeTypes.cpp
@@ -241,6 +242,13 @@ Registry::Registry()
         OSG_INFO<<"Registry : Expiry delay = "<<_expiryDelay<<std::endl;
     }
 
+    _objectCache = new ObjectCache;
+    if( (ptr = getenv("OSG_MAX_OBJECT_CACHE_SIZE")) != 0)
+    {
+        _objectCache->setMaxSize(static_cast<unsigned long long>(osg::asciiToDouble(ptr)));
+        OSG_INFO<<"Registry : Max object cache size = "<<_objectCache->getMaxSize()<<std::endl;
+    }
+
     const char* fileCachePath = getenv("OSG_FILE_CACHE");
     if (fileCachePath)
     {
@@ -1237,12 +1245,11 @@ ReaderWriter::ReadResult Registry::readImplementation(const ReadFunctor& readFun
     {
         // search for entry in the object cache.
         {
-            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-            ObjectCache::iterator oitr=_objectCache.find(file);
-            if (oitr!=_objectCache.end())
+            osg::ref_ptr<osg::Object> object = _objectCache->getRefFromObjectCache(file);
+            if (object.valid())
             {
                 OSG_INFO<<"returning cached instanced of "<<file<<std::endl;
-                if (readFunctor.isValid(oitr->second.first.get())) return ReaderWriter::ReadResult(oitr->second.first.get(), ReaderWriter::ReadResult::FILE_LOADED_FROM_CACHE);
+                if (readFunctor.isValid(object.get())) return ReaderWriter::ReadResult(object.get(), ReaderWriter::ReadResult::FILE_LOADED_FROM_CACHE);
                 else return ReaderWriter::ReadResult("Error file does not contain an osg::Object");
             }
         }
@@ -1580,76 +1587,38 @@ ReaderWriter::WriteResult Registry::writeShaderImplementation(const Shader& shad
 
 void Registry::addEntryToObjectCache(const std::string& filename, osg::Object* object, double timestamp)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache[filename]=ObjectTimeStampPair(object,timestamp);
+    _objectCache->addEntryToObjectCache(filename, object, timestamp);
 }
 
 osg::Object* Registry::getFromObjectCache(const std::string& fileName)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCache::iterator itr = _objectCache.find(fileName);
-    if (itr!=_objectCache.end()) return itr->second.first.get();
-    else return 0;
+    return _objectCache->getFromObjectCache(fileName);
 }
 
 osg::ref_ptr<osg::Object> Registry::getRefFromObjectCache(const std::string& fileName)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCache::iterator itr = _objectCache.find(fileName);
-    if (itr!=_objectCache.end()) return itr->second.first;
-    else return 0;
+    return _objectCache->getRefFromObjectCache(fileName);
 }
 
 void Registry::updateTimeStampOfObjectsInCacheWithExternalReferences(const osg::FrameStamp& frameStamp)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // look for objects with external references and update their time stamp.
-    for(ObjectCache::iterator itr=_objectCache.begin();
-        itr!=_objectCache.end();
-        ++itr)
-    {
-        // if ref count is greater the 1 the object has an external reference.
-        if (itr->second.first->referenceCount()>1)
-        {
-            // so update it time stamp.
-            itr->second.second = frameStamp.getReferenceTime();
-        }
-    }
+    _objectCache->updateTimeStampOfObjectsInCacheWithExternalReferences(frameStamp.getReferenceTime());
 }
 
 void Registry::removeExpiredObjectsInCache(const osg::FrameStamp& frameStamp)
 {
     double expiryTime = frameStamp.getReferenceTime() - _expiryDelay;
-
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // Remove expired entries from object cache
-    ObjectCache::iterator oitr = _objectCache.begin();
-    while(oitr != _objectCache.end())
-    {
-        if (oitr->second.second<=expiryTime)
-        {
-            _objectCache.erase(oitr++);
-        }
-        else
-        {
-            ++oitr;
-        }
-    }
+    _objectCache->removeExpiredObjectsInCache(expiryTime);
 }
 
 void Registry::removeFromObjectCache(const std::string& fileName)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCache::iterator itr = _objectCache.find(fileName);
-    if (itr!=_objectCache.end()) _objectCache.erase(itr);
+    _objectCache->removeFromObjectCache(fileName);
 }
 
 void Registry::clearObjectCache()
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache.clear();
+    if (_objectCache.valid()) _objectCache->clear();
 }
 
 void Registry::addToArchiveCache(const std::string& fileName, osgDB::Archive* archive)
@@ -1693,15 +1662,7 @@ void Registry::clearArchiveCache()
 
 void Registry::releaseGLObjects(osg::State* state)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    for(ObjectCache::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
-    {
-        osg::Object* object = itr->second.first.get();
-        object->releaseGLObjects(state);
-    }
+    _objectCache->releaseGLObjects(state);
 
     if (_sharedStateManager.valid())
     {
@@ -40,6 +40,7 @@
 #include <osgDB/ReadFile>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <osgDB/MappedFile>
 
 #include <osgUtil/TriStripVisitor>
 #include <osgUtil/SmoothingVisitor>
@@ -61,6 +62,8 @@ public:
         supportsOption("noTesselateLargePolygons","Do not do the default tesselation of large polygons");
         supportsOption("noTriStripPolygons","Do not do the default tri stripping of polygons");
         supportsOption("generateFacetNormals","generate facet normals for verticies without normals");
+        supportsOption("parseThreads=<num>","Set the number of threads used to parse the file, 0 for one per processor. Default is 1, as the DatabasePager may be reading several files at once");
+        supportsOption("NoMemoryMapping","Read the whole file into memory through a stream before parsing it, rather than memory mapping it");
 
         supportsOption("DIFFUSE=<unit>", "Set texture unit for diffuse texture");
         supportsOption("AMBIENT=<unit>", "Set texture unit for ambient texture");
@@ -138,6 +141,8 @@ protected:
         bool noTriStripPolygons;
         bool generateFacetNormals;
         bool fixBlackMaterials;
+        bool useMemoryMapping;
+        unsigned int numParseThreads;
         // This is the order in which the materials will be assigned to texture maps, unless
         // otherwise overriden
         typedef std::vector< std::pair<int,obj::Material::Map::TextureMapType> > TextureAllocationMap;
@@ -787,6 +792,8 @@ ReaderWriterOBJ::ObjOptionsStruct ReaderWriterOBJ::parseOptions(const osgDB::Rea
     localOptions.noTriStripPolygons = false;
     localOptions.generateFacetNormals = false;
     localOptions.fixBlackMaterials = true;
+    localOptions.useMemoryMapping = true;
+    localOptions.numParseThreads = 1;
 
     if (options!=NULL)
     {
@@ -825,6 +832,14 @@ ReaderWriterOBJ::ObjOptionsStruct ReaderWriterOBJ::parseOptions(const osgDB::Rea
             {
                 localOptions.generateFacetNormals = true;
             }
+            else if (pre_equals == "NoMemoryMapping")
+            {
+                localOptions.useMemoryMapping = false;
+            }
+            else if (pre_equals == "parseThreads" && post_equals.length()>0)
+            {
+                localOptions.numParseThreads = atoi(post_equals.c_str());
+            }
             else if (post_equals.length()>0)
             {
                 obj::Material::Map::TextureMapType type = obj::Material::Map::UNKNOWN;
@@ -861,19 +876,35 @@ osgDB::ReaderWriter::ReadResult ReaderWriterOBJ::readNode(const std::string& fil
     if (fileName.empty()) return ReadResult::FILE_NOT_FOUND;
 
 
-    osgDB::ifstream fin(fileName.c_str());
-    if (fin)
+    ObjOptionsStruct localOptions = parseOptions(options);
+
+    // code for setting up the database path so that internally referenced file are searched for on relative paths.
+    osg::ref_ptr<Options> local_opt = options ? static_cast<Options*>(options->clone(osg::CopyOp::SHALLOW_COPY)) : new Options;
+    local_opt->setDatabasePath(osgDB::getFilePath(fileName));
+
+    if (localOptions.useMemoryMapping)
     {
+        // the parser works straight from the mapped pages, without copying the file.
+        osg::ref_ptr<osgDB::MappedFile> mappedFile = new osgDB::MappedFile(fileName);
+        if (mappedFile->valid())
+        {
+            mappedFile->adviseSequential();
 
-        // code for setting up the database path so that internally referenced file are searched for on relative paths.
-        osg::ref_ptr<Options> local_opt = options ? static_cast<Options*>(options->clone(osg::CopyOp::SHALLOW_COPY)) : new Options;
-        local_opt->setDatabasePath(osgDB::getFilePath(fileName));
+            obj::Model model;
+            model.setDatabasePath(osgDB::getFilePath(fileName.c_str()));
+            model.readOBJ(mappedFile->data(), mappedFile->size(), local_opt.get(), localOptions.numParseThreads);
 
+            osg::Node* node = convertModelToSceneGraph(model, localOptions, options);
+            return node;
+        }
+    }
+
+    osgDB::ifstream fin(fileName.c_str());
+    if (fin)
+    {
         obj::Model model;
         model.setDatabasePath(osgDB::getFilePath(fileName.c_str()));
-        model.readOBJ(fin, local_opt.get());
-
-        ObjOptionsStruct localOptions = parseOptions(options);
+        model.readOBJ(fin, local_opt.get(), localOptions.numParseThreads);
 
         osg::Node* node = convertModelToSceneGraph(model, localOptions, options);
         return node;
@@ -888,11 +919,11 @@ osgDB::ReaderWriter::ReadResult ReaderWriterOBJ::readNode(std::istream& fin, con
     {
         fin.imbue(std::locale::classic());
 
-        obj::Model model;
-        model.readOBJ(fin, options);
-
         ObjOptionsStruct localOptions = parseOptions(options);
 
+        obj::Model model;
+        model.readOBJ(fin, options, localOptions.numParseThreads);
+
         osg::Node* node = convertModelToSceneGraph(model, localOptions, options);
         return node;
     }
@@ -19,11 +19,15 @@
 
 #include "obj.h"
 
+#include <osg/Math>
 #include <osg/Notify>
 
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 
+#include <OpenThreads/Thread>
+
+#include <float.h>
 #include <string.h>
 
 using namespace obj;
@@ -203,6 +207,79 @@ bool Model::readline(std::istream& fin, char* line, const int LINE_SIZE)
 }
 
 
+const char* Model::readline(const char* ptr, const char* end, char* line, const int LINE_SIZE)
+{
+    if (LINE_SIZE<1) return ptr;
+
+    bool eatWhiteSpaceAtStart = true;
+    bool changeTabsToSpaces = true;
+
+    char* lineptr = line;
+    char* lineend = line+LINE_SIZE-1;
+    bool skipNewline = false;
+    while (ptr<end && lineptr<lineend)
+    {
+        char c = *ptr++;
+        char p = (ptr<end) ? *ptr : 0;
+        if (c=='\r')
+        {
+            // windows line endings are \r\n, mac line endings a lone \r.
+            if (p=='\n') ++ptr;
+
+            if (skipNewline)
+            {
+                skipNewline = false;
+                *lineptr++ = ' ';
+                continue;
+            }
+            else break;
+        }
+        else if (c=='\n')
+        {
+            // unix line ending.
+            if (skipNewline)
+            {
+                *lineptr++ = ' ';
+                continue;
+            }
+            else break;
+        }
+        else if (c=='\\' && (p=='\r' || p=='\n'))
+        {
+            // need to keep return;
+            skipNewline = true;
+        }
+        else
+        {
+            skipNewline = false;
+
+            if (!eatWhiteSpaceAtStart || (c!=' ' && c!='\t'))
+            {
+                eatWhiteSpaceAtStart = false;
+                *lineptr++ = c;
+            }
+        }
+    }
+
+    // strip trailing spaces
+    while (lineptr>line && *(lineptr-1)==' ')
+    {
+        --lineptr;
+    }
+
+    *lineptr = 0;
+
+    if (changeTabsToSpaces)
+    {
+        for(lineptr = line; *lineptr != 0; ++lineptr)
+        {
+            if (*lineptr == '\t') *lineptr=' ';
+        }
+    }
+
+    return ptr;
+}
+
 std::string Model::lastComponent(const char* linep)
 {
     std::string line = std::string(linep);
@@ -514,60 +591,307 @@ std::string trim(const std::string& s)
   return std::string(s, b, e - b + 1);
 }
 
-bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* options)
+namespace
 {
-    OSG_INFO<<"Reading OBJ file"<<std::endl;
 
+const double s_powersOfTen[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parse a number of the form [+-]digits[.digits][(e|E)[+-]digits] ending at a space or the end of the line. The
+// mantissa and the power of ten are both exact as doubles so their product or quotient is correctly rounded, and
+// rounding that on to a float gives the same result as sscanf's %f unless the double lies exactly half way between
+// two floats. Return false for other forms, and for that case, so that sscanf can be used instead.
+inline bool parseFloat(const char*& ptr, float& value)
+{
+    const char* p = ptr;
+
+    bool negative = (*p=='-');
+    if (*p=='-' || *p=='+') ++p;
+
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    for(; *p>='0' && *p<='9'; ++p)
+    {
+        if (mantissa>=100000000000000000ull) return false;
+        mantissa = mantissa*10 + (*p-'0');
+        hasDigits = true;
+    }
+
+    if (*p=='.')
+    {
+        for(++p; *p>='0' && *p<='9'; ++p)
+        {
+            if (mantissa>=100000000000000000ull) return false;
+            mantissa = mantissa*10 + (*p-'0');
+            --exponent;
+            hasDigits = true;
+        }
+    }
+
+    if (!hasDigits) return false;
+
+    if (*p=='e' || *p=='E')
+    {
+        ++p;
+        bool negativeExponent = (*p=='-');
+        if (*p=='-' || *p=='+') ++p;
+        if (*p<'0' || *p>'9') return false;
+
+        int e = 0;
+        for(; *p>='0' && *p<='9'; ++p)
+        {
+            if (e>=1000) return false;
+            e = e*10 + (*p-'0');
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    if (*p!=' ' && *p!=0) return false;
+
+    double d = 0.0;
+    if (mantissa!=0)
+    {
+        if (mantissa>(1ull<<53) || exponent<-22 || exponent>22) return false;
+
+        d = static_cast<double>(mantissa);
+        if (exponent<0) d /= s_powersOfTen[-exponent];
+        else d *= s_powersOfTen[exponent];
+
+        // leave denormals and overflow to sscanf.
+        if (d<FLT_MIN || d>FLT_MAX) return false;
+
+        unsigned long long bits;
+        memcpy(&bits, &d, sizeof(bits));
+        if ((bits & 0x1fffffffull)==0x10000000ull) return false;
+    }
+
+    value = static_cast<float>(negative ? -d : d);
+    ptr = p;
+    return true;
+}
+
+// Parse up to maxValues space separated floats, as sscanf(ptr,"%f %f %f...") would, returning the number read.
+inline unsigned int parseFloats(const char* ptr, float* values, unsigned int maxValues)
+{
+    unsigned int numValues = 0;
+    while(numValues<maxValues)
+    {
+        while(*ptr==' ') ++ptr;
+
+        if (!parseFloat(ptr, values[numValues]))
+        {
+            int numChars = 0;
+            if (sscanf(ptr, "%f%n", &values[numValues], &numChars)!=1) break;
+            ptr += numChars;
+        }
+        ++numValues;
+    }
+    return numValues;
+}
+
+// Parse an index of up to nine digits, as %d would but without skipping leading white space.
+inline bool parseIndex(const char*& ptr, int& value)
+{
+    const char* p = ptr;
+
+    bool negative = (*p=='-');
+    if (*p=='-' || *p=='+') ++p;
+    if (*p<'0' || *p>'9') return false;
+
+    int result = 0;
+    for(int numDigits=0; *p>='0' && *p<='9'; ++p, ++numDigits)
+    {
+        if (numDigits==9) return false;
+        result = result*10 + (*p-'0');
+    }
+
+    value = negative ? -result : result;
+    ptr = p;
+    return true;
+}
+
+enum FaceVertexForm
+{
+    UNKNOWN_FORM,
+    VERTEX,
+    VERTEX_TEXCOORD,
+    VERTEX_NORMAL,
+    VERTEX_TEXCOORD_NORMAL
+};
+
+// Parse a face vertex of the form v, v/t, v//n or v/t/n ending at a space or the end of the line, returning
+// UNKNOWN_FORM for anything else so the sscanf calls of the line by line reader can be used instead.
+inline FaceVertexForm parseFaceVertex(const char* ptr, int& vi, int& ti, int& ni)
+{
+    if (!parseIndex(ptr, vi)) return UNKNOWN_FORM;
+    if (*ptr==' ' || *ptr==0) return VERTEX;
+    if (*ptr++!='/') return UNKNOWN_FORM;
+
+    if (*ptr=='/')
+    {
+        ++ptr;
+        if (!parseIndex(ptr, ni)) return UNKNOWN_FORM;
+        return (*ptr==' ' || *ptr==0) ? VERTEX_NORMAL : UNKNOWN_FORM;
+    }
+
+    if (!parseIndex(ptr, ti)) return UNKNOWN_FORM;
+    if (*ptr==' ' || *ptr==0) return VERTEX_TEXCOORD;
+    if (*ptr++!='/') return UNKNOWN_FORM;
+
+    if (!parseIndex(ptr, ni)) return UNKNOWN_FORM;
+    return (*ptr==' ' || *ptr==0) ? VERTEX_TEXCOORD_NORMAL : UNKNOWN_FORM;
+}
+
+// The contents of one line aligned chunk of an OBJ file. The vertices, normals and texcoords are kept in the
+// chunk's own arrays, and the elements and changes of state as small records in the order they were read so that
+// they can be replayed once all the chunks are read, with the elements and names they refer to held in tables of
+// their own. Until resolveIndices() is called the element indices are as in the file.
+struct Chunk
+{
+    enum RecordType
+    {
+        ELEMENT,
+        USEMTL,
+        MTLLIB,
+        OBJECT,
+        GROUP,
+        SMOOTHING_GROUP,
+        UNHANDLED
+    };
+
+    struct Record
+    {
+        Record(RecordType t, int v=0):
+            type(t),
+            value(v) {}
+
+        RecordType                  type;
+
+        // the index into elements for an ELEMENT, the smoothing group for a SMOOTHING_GROUP, otherwise the index into names.
+        int                         value;
+    };
+
+    struct ElementRecord
+    {
+        ElementRecord(Element* e, unsigned int nv, unsigned int nn, unsigned int nt):
+            element(e),
+            numVertices(nv),
+            numNormals(nn),
+            numTexCoords(nt) {}
+
+        osg::ref_ptr<Element>       element;
+
+        // the chunk's array sizes when the element was read, that negative indices are relative to.
+        unsigned int                numVertices;
+        unsigned int                numNormals;
+        unsigned int                numTexCoords;
+    };
+
+    typedef std::vector<Record> Records;
+    typedef std::vector<ElementRecord> ElementRecords;
+    typedef std::vector<std::string> Names;
+
+    Chunk():
+        begin(0),
+        end(0),
+        vertexOffset(0),
+        normalOffset(0),
+        texCoordOffset(0) {}
+
+    const char*         begin;
+    const char*         end;
+
+    Model::Vec3Array    vertices;
+    Model::Vec3Array    normals;
+    Model::Vec2Array    texcoords;
+    Records             records;
+    ElementRecords      elements;
+    Names               names;
+
+    void addElement(Element* element)
+    {
+        records.push_back(Record(ELEMENT, static_cast<int>(elements.size())));
+        elements.push_back(ElementRecord(element, vertices.size(), normals.size(), texcoords.size()));
+    }
+
+    void addName(RecordType type, const std::string& name)
+    {
+        records.push_back(Record(type, static_cast<int>(names.size())));
+        names.push_back(name);
+    }
+
+    // the number of vertices, normals and texcoords in the chunks before this one.
+    unsigned int        vertexOffset;
+    unsigned int        normalOffset;
+    unsigned int        texCoordOffset;
+};
+
+void parseChunk(Chunk& chunk)
+{
     const int LINE_SIZE = 4096;
     char line[LINE_SIZE];
-    float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+    float values[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    Element::IndexList vertexIndices, normalIndices, texCoordIndices;
 
-    while (fin)
+    const char* next = chunk.begin;
+    while (next<chunk.end)
     {
-        readline(fin,line,LINE_SIZE);
+        next = Model::readline(next, chunk.end, line, LINE_SIZE);
         if (line[0]=='#' || line[0]=='$')
         {
             // comment line
-            // OSG_NOTICE <<"Comment: "<<line<<std::endl;
         }
-        else if (strlen(line)>0)
+        else if (line[0]!=0)
         {
             if (strncmp(line,"v ",2)==0)
             {
-                unsigned int fieldsRead = sscanf(line+2,"%f %f %f %f", &x, &y, &z, &w);
-
-                if (fieldsRead==1) vertices.push_back(osg::Vec3(x,0.0f,0.0f));
-                else if (fieldsRead==2) vertices.push_back(osg::Vec3(x,y,0.0f));
-                else if (fieldsRead==3) vertices.push_back(osg::Vec3(x,y,z));
-                else if (fieldsRead>=4) vertices.push_back(osg::Vec3(x/w,y/w,z/w));
+                float& x = values[0];
+                float& y = values[1];
+                float& z = values[2];
+                float& w = values[3];
+                unsigned int fieldsRead = parseFloats(line+2, values, 4);
+
+                if (fieldsRead==1) chunk.vertices.push_back(osg::Vec3(x,0.0f,0.0f));
+                else if (fieldsRead==2) chunk.vertices.push_back(osg::Vec3(x,y,0.0f));
+                else if (fieldsRead==3) chunk.vertices.push_back(osg::Vec3(x,y,z));
+                else if (fieldsRead>=4) chunk.vertices.push_back(osg::Vec3(x/w,y/w,z/w));
             }
             else if (strncmp(line,"vn ",3)==0)
             {
-                unsigned int fieldsRead = sscanf(line+3,"%f %f %f", &x, &y, &z);
-
-                if (fieldsRead==1) normals.push_back(osg::Vec3(x,0.0f,0.0f));
-                else if (fieldsRead==2) normals.push_back(osg::Vec3(x,y,0.0f));
-                else if (fieldsRead==3) normals.push_back(osg::Vec3(x,y,z));
+                float& x = values[0];
+                float& y = values[1];
+                float& z = values[2];
+                unsigned int fieldsRead = parseFloats(line+3, values, 3);
+
+                if (fieldsRead==1) chunk.normals.push_back(osg::Vec3(x,0.0f,0.0f));
+                else if (fieldsRead==2) chunk.normals.push_back(osg::Vec3(x,y,0.0f));
+                else if (fieldsRead==3) chunk.normals.push_back(osg::Vec3(x,y,z));
             }
             else if (strncmp(line,"vt ",3)==0)
             {
-                unsigned int fieldsRead = sscanf(line+3,"%f %f %f", &x, &y, &z);
+                float& x = values[0];
+                float& y = values[1];
+                unsigned int fieldsRead = parseFloats(line+3, values, 3);
 
-                if (fieldsRead==1) texcoords.push_back(osg::Vec2(x,0.0f));
-                else if (fieldsRead==2) texcoords.push_back(osg::Vec2(x,y));
-                else if (fieldsRead==3) texcoords.push_back(osg::Vec2(x,y));
+                if (fieldsRead==1) chunk.texcoords.push_back(osg::Vec2(x,0.0f));
+                else if (fieldsRead==2) chunk.texcoords.push_back(osg::Vec2(x,y));
+                else if (fieldsRead==3) chunk.texcoords.push_back(osg::Vec2(x,y));
             }
             else if (strncmp(line,"l ",2)==0 ||
                      strncmp(line,"p ",2)==0 ||
                      strncmp(line,"f ",2)==0)
             {
-                char* ptr = line+2;
-
-                Element* element = new Element( (line[0]=='p') ? Element::POINTS :
-                                                (line[0]=='l') ? Element::POLYLINE :
-                                                Element::POLYGON );
+                const char* ptr = line+2;
 
-                // OSG_NOTICE<<"face"<<ptr<<std::endl;
+                // gather the indices in the reused lists, then copy them to the element in one allocation per list.
+                vertexIndices.clear();
+                normalIndices.clear();
+                texCoordIndices.clear();
 
                 int vi=0, ti=0, ni=0;
                 while(*ptr!=0)
@@ -575,129 +899,78 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
                     // skip white space
                     while(*ptr==' ') ++ptr;
 
-                    if (sscanf(ptr, "%d/%d/%d", &vi, &ti, &ni) == 3)
-                    {
-                        // OSG_NOTICE<<"   vi="<<vi<<"/ti="<<ti<<"/ni="<<ni<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
-                        element->normalIndices.push_back(remapNormalIndex(ni));
-                        element->texCoordIndices.push_back(remapTexCoordIndex(ti));
-                    }
-                    else if (sscanf(ptr, "%d//%d", &vi, &ni) == 2)
+                    FaceVertexForm form = parseFaceVertex(ptr, vi, ti, ni);
+                    if (form==UNKNOWN_FORM)
                     {
-                        // OSG_NOTICE<<"   vi="<<vi<<"//ni="<<ni<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
-                        element->normalIndices.push_back(remapNormalIndex(ni));
+                        if (sscanf(ptr, "%d/%d/%d", &vi, &ti, &ni) == 3) form = VERTEX_TEXCOORD_NORMAL;
+                        else if (sscanf(ptr, "%d//%d", &vi, &ni) == 2) form = VERTEX_NORMAL;
+                        else if (sscanf(ptr, "%d/%d", &vi, &ti) == 2) form = VERTEX_TEXCOORD;
+                        else if (sscanf(ptr, "%d", &vi) == 1) form = VERTEX;
                     }
-                    else if (sscanf(ptr, "%d/%d", &vi, &ti) == 2)
-                    {
-                        // OSG_NOTICE<<"   vi="<<vi<<"/ti="<<ti<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
-                        element->texCoordIndices.push_back(remapTexCoordIndex(ti));
-                    }
-                    else if (sscanf(ptr, "%d", &vi) == 1)
+
+                    switch(form)
                     {
-                        // OSG_NOTICE<<"   vi="<<vi<<std::endl;
-                        element->vertexIndices.push_back(remapVertexIndex(vi));
+                        case(VERTEX_TEXCOORD_NORMAL):
+                            vertexIndices.push_back(vi);
+                            normalIndices.push_back(ni);
+                            texCoordIndices.push_back(ti);
+                            break;
+                        case(VERTEX_NORMAL):
+                            vertexIndices.push_back(vi);
+                            normalIndices.push_back(ni);
+                            break;
+                        case(VERTEX_TEXCOORD):
+                            vertexIndices.push_back(vi);
+                            texCoordIndices.push_back(ti);
+                            break;
+                        case(VERTEX):
+                            vertexIndices.push_back(vi);
+                            break;
+                        default:
+                            break;
                     }
 
                     // skip to white space or end of line
                     while(*ptr!=' ' && *ptr!=0) ++ptr;
-
                 }
 
-                if (!element->normalIndices.empty() && element->normalIndices.size() != element->vertexIndices.size())
+                // empty elements aren't worth adding.
+                if (!vertexIndices.empty())
                 {
-                    element->normalIndices.clear();
-                }
+                    osg::ref_ptr<Element> element = new Element( (line[0]=='p') ? Element::POINTS :
+                                                                 (line[0]=='l') ? Element::POLYLINE :
+                                                                 Element::POLYGON );
 
-                if (!element->texCoordIndices.empty() && element->texCoordIndices.size() != element->vertexIndices.size())
-                {
-                    element->texCoordIndices.clear();
-                }
+                    element->vertexIndices = vertexIndices;
+                    if (normalIndices.size()==vertexIndices.size()) element->normalIndices = normalIndices;
+                    if (texCoordIndices.size()==vertexIndices.size()) element->texCoordIndices = texCoordIndices;
 
-                if (!element->vertexIndices.empty())
-                {
-                    Element::CoordinateCombination coordateCombination = element->getCoordinateCombination();
-                    if (coordateCombination!=currentElementState.coordinateCombination)
-                    {
-                        currentElementState.coordinateCombination = coordateCombination;
-                        currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                    }
-                    addElement(element);
-                }
-                else
-                {
-                    // empty element, don't both adding, just unref to delete it.
-                    element->unref();
+                    chunk.addElement(element.get());
                 }
-
             }
             else if (strncmp(line,"usemtl ",7)==0)
             {
-                std::string materialName( line+7 );
-                if (currentElementState.materialName != materialName)
-                {
-                    currentElementState.materialName = materialName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
+                chunk.addName(Chunk::USEMTL, line+7);
             }
             else if (strncmp(line,"mtllib ",7)==0)
             {
-                std::string materialFileName = trim( line+7 );
-                std::string fullPathFileName = osgDB::findDataFile( materialFileName, options );
-                if (!fullPathFileName.empty())
-                {
-                    osgDB::ifstream mfin( fullPathFileName.c_str() );
-                    if (mfin)
-                    {
-                        OSG_INFO << "Obj reading mtllib '" << fullPathFileName << "'\n";
-                        readMTL(mfin);
-                    }
-                    else
-                    {
-                        OSG_WARN << "Obj unable to load mtllib '" << fullPathFileName << "'\n";
-                    }
-                }
-                else
-                {
-                    OSG_WARN << "Obj unable to find mtllib '" << materialFileName << "'\n";
-                }
+                chunk.addName(Chunk::MTLLIB, trim( line+7 ));
             }
             else if (strncmp(line,"o ",2)==0)
             {
-                std::string objectName(line+2);
-                if (currentElementState.objectName != objectName)
-                {
-                    currentElementState.objectName = objectName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
+                chunk.addName(Chunk::OBJECT, line+2);
             }
             else if (strcmp(line,"o")==0)
             {
-                std::string objectName(""); // empty name
-                if (currentElementState.objectName != objectName)
-                {
-                    currentElementState.objectName = objectName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
+                chunk.addName(Chunk::OBJECT, std::string()); // empty name
             }
             else if (strncmp(line,"g ",2)==0)
             {
-                std::string groupName(line+2);
-                if (currentElementState.groupName != groupName)
-                {
-                    currentElementState.groupName = groupName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
+                chunk.addName(Chunk::GROUP, line+2);
             }
             else if (strcmp(line,"g")==0)
             {
-                std::string groupName(""); // empty name
-                if (currentElementState.groupName != groupName)
-                {
-                    currentElementState.groupName = groupName;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
+                chunk.addName(Chunk::GROUP, std::string()); // empty name
             }
             else if (strncmp(line,"s ",2)==0)
             {
@@ -705,19 +978,291 @@ bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* optio
                 if (strncmp(line+2,"off",3)==0) smoothingGroup = 0;
                 else sscanf(line+2,"%d",&smoothingGroup);
 
-                if (currentElementState.smoothingGroup != smoothingGroup)
-                {
-                    currentElementState.smoothingGroup = smoothingGroup;
-                    currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
-                }
+                chunk.records.push_back(Chunk::Record(Chunk::SMOOTHING_GROUP, smoothingGroup));
             }
             else
             {
-                OSG_NOTICE <<"*** line not handled *** :"<<line<<std::endl;
+                // the notice is reported when the records are replayed so it comes in the order of the file.
+                chunk.addName(Chunk::UNHANDLED, line);
             }
+        }
+    }
+}
+
+// OBJ indices count from 1, or when negative back from the last one read, which here is the last of the
+// size read by the chunk so far after the offset read by the chunks before it.
+inline void resolveIndices(Element::IndexList& indices, int offset, int size)
+{
+    for(Element::IndexList::iterator itr = indices.begin();
+        itr != indices.end();
+        ++itr)
+    {
+        *itr = (*itr<0) ? offset+size+(*itr) : (*itr)-1;
+    }
+}
+
+void resolveIndices(Chunk& chunk)
+{
+    for(Chunk::ElementRecords::iterator itr = chunk.elements.begin();
+        itr != chunk.elements.end();
+        ++itr)
+    {
+        Element& element = *(itr->element);
+        resolveIndices(element.vertexIndices, chunk.vertexOffset, itr->numVertices);
+        resolveIndices(element.normalIndices, chunk.normalOffset, itr->numNormals);
+        resolveIndices(element.texCoordIndices, chunk.texCoordOffset, itr->numTexCoords);
+    }
+}
+
+enum ChunkPass
+{
+    PARSE,
+    RESOLVE_INDICES
+};
+
+void processChunk(Chunk& chunk, ChunkPass pass)
+{
+    if (pass==PARSE) parseChunk(chunk);
+    else resolveIndices(chunk);
+}
+
+class ChunkThread : public osg::Referenced, public OpenThreads::Thread
+{
+    public:
+
+        ChunkThread(Chunk& chunk, ChunkPass pass): _chunk(chunk), _pass(pass) {}
+
+        virtual void run() { processChunk(_chunk, _pass); }
+
+    protected:
+
+        virtual ~ChunkThread() {}
+
+        ChunkThread& operator = (const ChunkThread&) { return *this; }
+
+        Chunk&      _chunk;
+        ChunkPass   _pass;
+};
+
+// Run pass over all the chunks, the first on the calling thread and the others on threads of their own.
+void runPass(std::vector<Chunk>& chunks, ChunkPass pass)
+{
+    typedef std::vector< osg::ref_ptr<ChunkThread> > ChunkThreads;
+    ChunkThreads threads;
+    for(unsigned int i=1; i<chunks.size(); ++i)
+    {
+        osg::ref_ptr<ChunkThread> thread = new ChunkThread(chunks[i], pass);
+        if (thread->startThread()==0) threads.push_back(thread);
+        else processChunk(chunks[i], pass);
+    }
+
+    processChunk(chunks[0], pass);
+
+    for(ChunkThreads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+    }
+}
+
+// Append a chunk's array to the model's, where remaining is the number still to be appended from this chunk on.
+// The chunk's array is taken over rather than copied when it is all there is to add, as it is for a file read by
+// a single thread, otherwise room is reserved for all the remaining ones so the array is only grown once.
+template<class A>
+void appendArray(A& array, A& chunkArray, std::size_t& remaining)
+{
+    std::size_t size = chunkArray.size();
+    if (size==0) return;
+
+    if (array.empty() && size==remaining)
+    {
+        array.swap(chunkArray);
+    }
+    else
+    {
+        array.reserve(array.size()+remaining);
+        array.insert(array.end(), chunkArray.begin(), chunkArray.end());
+    }
+    remaining -= size;
+}
+
+// Return the start of the first line beginning at or after ptr. Lines are only split at an end of line which
+// readline() can't treat as part of a \r\n pair or as a continuation, so each chunk starts a line afresh.
+const char* findLineStart(const char* data, const char* ptr, const char* end)
+{
+    if (ptr<=data) return data;
+
+    for(; ptr<end; ++ptr)
+    {
+        char c = *ptr;
+        if (c!='\n' && c!='\r') continue;
 
+        char previous = *(ptr-1);
+        if (previous=='\\' || previous=='\r' || previous=='\n') continue;
+
+        if (c=='\r' && ptr+1<end && *(ptr+1)=='\n') ++ptr;
+        return ptr+1;
+    }
+    return end;
+}
+
+}
+
+bool Model::readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* options, unsigned int numThreads)
+{
+    // read the whole stream into memory so it can be parsed in chunks as a memory mapped file is.
+    std::string buffer;
+    char block[65536];
+    while (fin.read(block, sizeof(block)) || fin.gcount()>0)
+    {
+        buffer.append(block, static_cast<std::size_t>(fin.gcount()));
+    }
+
+    return readOBJ(buffer.data(), buffer.size(), options, numThreads);
+}
+
+bool Model::readOBJ(const char* data, std::size_t size, const osgDB::ReaderWriter::Options* options, unsigned int numThreads)
+{
+    OSG_INFO<<"Reading OBJ file"<<std::endl;
+
+    // chunks smaller than this aren't worth the cost of a thread.
+    const std::size_t minimumChunkSize = 256*1024;
+
+    if (numThreads==0) numThreads = static_cast<unsigned int>(OpenThreads::GetNumberOfProcessors());
+    std::size_t numChunks = osg::minimum(static_cast<std::size_t>(numThreads), size/minimumChunkSize);
+    if (numChunks==0) numChunks = 1;
+
+    const char* end = data+size;
+    std::vector<Chunk> chunks(numChunks);
+    for(std::size_t i=0; i<numChunks; ++i)
+    {
+        chunks[i].begin = (i==0) ? data : chunks[i-1].end;
+        chunks[i].end = (i+1==numChunks) ? end : findLineStart(data, osg::maximum(chunks[i].begin, data+size/numChunks*(i+1)), end);
+    }
+
+    runPass(chunks, PARSE);
+
+    std::size_t numVertices = 0, numNormals = 0, numTexCoords = 0;
+    for(std::vector<Chunk>::iterator itr = chunks.begin();
+        itr != chunks.end();
+        ++itr)
+    {
+        itr->vertexOffset = vertices.size() + numVertices;
+        itr->normalOffset = normals.size() + numNormals;
+        itr->texCoordOffset = texcoords.size() + numTexCoords;
+        numVertices += itr->vertices.size();
+        numNormals += itr->normals.size();
+        numTexCoords += itr->texcoords.size();
+    }
+
+    runPass(chunks, RESOLVE_INDICES);
+
+    for(std::vector<Chunk>::iterator itr = chunks.begin();
+        itr != chunks.end();
+        ++itr)
+    {
+        Chunk& chunk = *itr;
+        appendArray(vertices, chunk.vertices, numVertices);
+        appendArray(normals, chunk.normals, numNormals);
+        appendArray(texcoords, chunk.texcoords, numTexCoords);
+
+        for(Chunk::Records::iterator ritr = chunk.records.begin();
+            ritr != chunk.records.end();
+            ++ritr)
+        {
+            const Chunk::Record& record = *ritr;
+            switch(record.type)
+            {
+                case(Chunk::ELEMENT):
+                {
+                    Element* element = chunk.elements[record.value].element.get();
+                    Element::CoordinateCombination coordateCombination = element->getCoordinateCombination();
+                    if (coordateCombination!=currentElementState.coordinateCombination)
+                    {
+                        currentElementState.coordinateCombination = coordateCombination;
+                        currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+                    }
+                    addElement(element);
+                    break;
+                }
+                case(Chunk::USEMTL):
+                {
+                    const std::string& name = chunk.names[record.value];
+                    if (currentElementState.materialName != name)
+                    {
+                        currentElementState.materialName = name;
+                        currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+                    }
+                    break;
+                }
+                case(Chunk::MTLLIB):
+                {
+                    const std::string& materialFileName = chunk.names[record.value];
+                    std::string fullPathFileName = osgDB::findDataFile( materialFileName, options );
+                    if (!fullPathFileName.empty())
+                    {
+                        osgDB::ifstream mfin( fullPathFileName.c_str() );
+                        if (mfin)
+                        {
+                            OSG_INFO << "Obj reading mtllib '" << fullPathFileName << "'\n";
+                            readMTL(mfin);
+                        }
+                        else
+                        {
+                            OSG_WARN << "Obj unable to load mtllib '" << fullPathFileName << "'\n";
+                        }
+                    }
+                    else
+                    {
+                        OSG_WARN << "Obj unable to find mtllib '" << materialFileName << "'\n";
+                    }
+                    break;
+                }
+                case(Chunk::OBJECT):
+                {
+                    const std::string& name = chunk.names[record.value];
+                    if (currentElementState.objectName != name)
+                    {
+                        currentElementState.objectName = name;
+                        currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+                    }
+                    break;
+                }
+                case(Chunk::GROUP):
+                {
+                    const std::string& name = chunk.names[record.value];
+                    if (currentElementState.groupName != name)
+                    {
+                        currentElementState.groupName = name;
+                        currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+                    }
+                    break;
+                }
+                case(Chunk::SMOOTHING_GROUP):
+                {
+                    if (currentElementState.smoothingGroup != record.value)
+                    {
+                        currentElementState.smoothingGroup = record.value;
+                        currentElementList = 0; // reset the element list to force a recompute of which ElementList to use
+                    }
+                    break;
+                }
+                case(Chunk::UNHANDLED):
+                {
+                    OSG_NOTICE <<"*** line not handled *** :"<<chunk.names[record.value]<<std::endl;
+                    break;
+                }
+            }
         }
 
+        // release the chunk's copies as we go.
+        Vec3Array().swap(chunk.vertices);
+        Vec3Array().swap(chunk.normals);
+        Vec2Array().swap(chunk.texcoords);
+        Chunk::Records().swap(chunk.records);
+        Chunk::ElementRecords().swap(chunk.elements);
+        Chunk::Names().swap(chunk.names);
     }
 #if 0
     OSG_NOTICE <<"vertices :"<<vertices.size()<<std::endl;
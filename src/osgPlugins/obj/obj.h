@@ -195,9 +195,18 @@ public:
 
     std::string lastComponent(const char* linep);
     bool readMTL(std::istream& fin);
-    bool readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* options);
+    bool readOBJ(std::istream& fin, const osgDB::ReaderWriter::Options* options, unsigned int numThreads=1);
+
+    /** Read OBJ data held in memory, such as a memory mapped file. The data is split into line aligned chunks which
+      * are parsed by up to numThreads threads, 0 using one per processor, giving the same result as reading it line by line.
+      * Defaults to a single thread, as readers such as the DatabasePager's threads may already be loading several files at once.*/
+    bool readOBJ(const char* data, std::size_t size, const osgDB::ReaderWriter::Options* options, unsigned int numThreads=1);
 
     bool readline(std::istream& fin, char* line, const int LINE_SIZE);
+
+    /** Read a line from the memory between ptr and end in the same way as readline(std::istream&...), returning the start of the next line.*/
+    static const char* readline(const char* ptr, const char* end, char* line, const int LINE_SIZE);
+
     void addElement(Element* element);
 
     osg::Vec3 averageNormal(const Element& element) const;
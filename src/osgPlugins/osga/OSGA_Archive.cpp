@@ -316,7 +316,8 @@ void OSGA_Archive::IndexBlock::setPositionNextIndexBlock(pos_type position)
     _requiresWrite = true;
 }
 
-OSGA_Archive::OSGA_Archive()
+OSGA_Archive::OSGA_Archive():
+    _useMemoryMapping(true)
 {
 }
 
@@ -337,7 +338,33 @@ bool OSGA_Archive::open(const std::string& filename, ArchiveStatus status, unsig
         _status = status;
         _input.open(filename.c_str(), std::ios_base::binary | std::ios_base::in);
 
-        return _open(_input);
+        if (!_open(_input)) return false;
+
+        if (_useMemoryMapping)
+        {
+            // the index is only read once on open, so from here on the mapping can be read from any number of threads
+            _mappedFile = new osgDB::MappedFile(filename);
+
+            bool entriesFit = _mappedFile->valid();
+            for(FileNamePositionMap::iterator mitr=_indexMap.begin();
+                mitr!=_indexMap.end() && entriesFit;
+                ++mitr)
+            {
+                entriesFit = (mitr->second.first + mitr->second.second) <= pos_type(_mappedFile->size());
+            }
+
+            if (entriesFit)
+            {
+                _mappedFile->adviseRandom();
+            }
+            else
+            {
+                OSG_INFO<<"OSGA_Archive::open("<<filename<<") unable to memory map archive, falling back to serialized reads."<<std::endl;
+                _mappedFile = 0;
+            }
+        }
+
+        return true;
     }
     else
     {
@@ -371,6 +398,7 @@ bool OSGA_Archive::open(const std::string& filename, ArchiveStatus status, unsig
                 }
             }
             _input.close();
+            _mappedFile = 0;
             _status = WRITE;
 
             osgDB::open(_output, filename.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
@@ -490,6 +518,7 @@ void OSGA_Archive::close()
     SERIALIZER();
 
     _input.close();
+    _mappedFile = 0;
 
     if (_status==WRITE)
     {
@@ -722,6 +751,8 @@ struct OSGA_Archive::ReadShaderFunctor : public OSGA_Archive::ReadFunctor
 
 ReaderWriter::ReadResult OSGA_Archive::read(const ReadFunctor& readFunctor)
 {
+    if (_mappedFile.valid()) return readMapped(readFunctor);
+
     SERIALIZER();
 
     if (_status!=READ)
@@ -760,6 +791,29 @@ ReaderWriter::ReadResult OSGA_Archive::read(const ReadFunctor& readFunctor)
     return result;
 }
 
+ReaderWriter::ReadResult OSGA_Archive::readMapped(const ReadFunctor& readFunctor) const
+{
+    // no lock required, the index and mapping aren't modified until close(), which mustn't be called while reads are in progress.
+    FileNamePositionMap::const_iterator itr = _indexMap.find(readFunctor._filename);
+    if (itr==_indexMap.end())
+    {
+        OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") failed, file not found in archive"<<std::endl;
+        return ReadResult(ReadResult::FILE_NOT_FOUND);
+    }
+
+    ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(getLowerCaseFileExtension(readFunctor._filename));
+    if (!rw)
+    {
+        OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") failed to find appropriate plugin to read file."<<std::endl;
+        return ReadResult(ReadResult::FILE_NOT_HANDLED);
+    }
+
+    OSG_INFO<<"OSGA_Archive::readObject(obj, "<<readFunctor._filename<<") from memory mapping"<<std::endl;
+
+    osgDB::MappedFileStream ins(_mappedFile.get(), static_cast<std::size_t>(itr->second.first), static_cast<std::size_t>(itr->second.second));
+    return readFunctor.doRead(*rw, ins);
+}
+
 ReaderWriter::ReadResult OSGA_Archive::readObject(const std::string& fileName,const Options* options) const
 {
     return const_cast<OSGA_Archive*>(this)->read(ReadObjectFunctor(fileName, options));
@@ -14,6 +14,7 @@
 #include <osg/Notify>
 #include <osgDB/Archive>
 #include <osgDB/FileNameUtils>
+#include <osgDB/MappedFile>
 
 #include <OpenThreads/ScopedLock>
 #include <OpenThreads/ReentrantMutex>
@@ -44,6 +45,16 @@ class OSGA_Archive : public osgDB::Archive
         /** close the archive.*/
         virtual void close();
 
+        /** Set whether an archive opened for reading is memory mapped, default is true. Reads from a mapped
+          * archive look up its index and stream straight from the mapping so need no lock, letting several
+          * threads read from it at once, while an archive that isn't mapped serializes its reads through
+          * a single file stream. Must be set before open() is called.*/
+        void setUseMemoryMapping(bool flag) { _useMemoryMapping = flag; }
+        bool getUseMemoryMapping() const { return _useMemoryMapping; }
+
+        /** Return true if the archive is being read from a memory mapping.*/
+        bool isMemoryMapped() const { return _mappedFile.valid(); }
+
         /** Get the file name which represents the archived file.*/
         virtual std::string getArchiveFileName() const { return _archiveFileName; }
 
@@ -203,6 +214,7 @@ class OSGA_Archive : public osgDB::Archive
 
 
         osgDB::ReaderWriter::ReadResult read(const ReadFunctor& readFunctor);
+        osgDB::ReaderWriter::ReadResult readMapped(const ReadFunctor& readFunctor) const;
         osgDB::ReaderWriter::WriteResult write(const WriteFunctor& writeFunctor);
 
         typedef std::list< osg::ref_ptr<IndexBlock> >   IndexBlockList;
@@ -219,6 +231,9 @@ class OSGA_Archive : public osgDB::Archive
         osgDB::ifstream     _input;
         std::fstream        _output;
 
+        bool                                _useMemoryMapping;
+        osg::ref_ptr<osgDB::MappedFile>     _mappedFile;
+
         std::string         _archiveFileName;
         std::string         _masterFileName;
         IndexBlockList      _indexBlockList;
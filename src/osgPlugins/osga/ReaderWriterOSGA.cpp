@@ -12,6 +12,7 @@ public:
     ReaderWriterOSGA()
     {
         supportsExtension("osga","OpenSceneGraph Archive format");
+        supportsOption("NoMemoryMapping","Read the archive through a single file stream rather than a memory mapping, serializing reads.");
     }
 
     virtual const char* className() const { return "OpenSceneGraph Archive Reader/Writer"; }
@@ -30,6 +31,7 @@ public:
         }
 
         osg::ref_ptr<OSGA_Archive> archive = new OSGA_Archive;
+        archive->setUseMemoryMapping(!options || options->getOptionString().find("NoMemoryMapping")==std::string::npos);
         if (!archive->open(fileName, status, indexBlockSize))
         {
             return ReadResult(ReadResult::FILE_NOT_HANDLED);
@@ -52,7 +54,7 @@ public:
 
     virtual ReadResult readImage(const std::string& file,const Options* options) const
     {
-        ReadResult result = openArchive(file,osgDB::Archive::READ);
+        ReadResult result = openArchive(file,osgDB::Archive::READ,4096,options);
 
         if (!result.validArchive()) return result;
 
@@ -80,7 +82,7 @@ public:
 
     virtual ReadResult readNode(const std::string& file,const Options* options) const
     {
-        ReadResult result = openArchive(file,osgDB::Archive::READ);
+        ReadResult result = openArchive(file,osgDB::Archive::READ,4096,options);
 
         if (!result.validArchive()) return result;
 
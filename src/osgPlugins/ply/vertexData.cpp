@@ -13,7 +13,9 @@
 #include "ply.h"
 
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
+#include <osg/Endian>
 #include <osg/Geometry>
 #include <osg/Geode>
 #include <osg/io_utils>
@@ -36,6 +38,87 @@ struct Normal{
     }
 };
 
+namespace
+{
+    // size in bytes of a PLY scalar type, 0 for unknown types
+    int typeSize( const int type )
+    {
+        switch( type )
+        {
+            case PLY_CHAR:
+            case PLY_UCHAR:
+            case PLY_UINT8:
+                return 1;
+            case PLY_SHORT:
+            case PLY_USHORT:
+                return 2;
+            case PLY_INT:
+            case PLY_UINT:
+            case PLY_FLOAT:
+            case PLY_FLOAT32:
+            case PLY_INT32:
+                return 4;
+            case PLY_DOUBLE:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    PlyElement* findElement( PlyFile* file, const char* name )
+    {
+        for( int i = 0; i < file->nelems; ++i )
+            if( equal_strings( file->elems[i]->name, name ) )
+                return file->elems[i];
+        return NULL;
+    }
+
+    // byte offset of the scalar property name within each element, -1 if
+    // the element has no such property, or it isn't of the expected size
+    int findPropertyOffset( const PlyElement* element, const char* name,
+                            const int size )
+    {
+        int offset = 0;
+        for( int i = 0; i < element->nprops; ++i )
+        {
+            const PlyProperty* prop = element->props[i];
+            if( equal_strings( prop->name, name ) )
+                return ( typeSize( prop->external_type ) == size ) ? offset : -1;
+            offset += typeSize( prop->external_type );
+        }
+        return -1;
+    }
+
+    bool isFloatProperty( const PlyElement* element, const char* name )
+    {
+        for( int i = 0; i < element->nprops; ++i )
+            if( equal_strings( element->props[i]->name, name ) )
+                return element->props[i]->external_type == PLY_FLOAT ||
+                       element->props[i]->external_type == PLY_FLOAT32;
+        return false;
+    }
+
+    bool isUCharProperty( const PlyElement* element, const char* name )
+    {
+        for( int i = 0; i < element->nprops; ++i )
+            if( equal_strings( element->props[i]->name, name ) )
+                return element->props[i]->external_type == PLY_UCHAR ||
+                       element->props[i]->external_type == PLY_UINT8;
+        return false;
+    }
+
+    inline float readFloat( const char* ptr )
+    {
+        float value;
+        memcpy( &value, ptr, sizeof( value ) );
+        return value;
+    }
+
+    // number of elements read from the file in one go
+    const int elementsPerBlock = 65536;
+}
+
+
 /*  Contructor.  */
 VertexData::VertexData()
     : _invertFaces( false )
@@ -203,6 +286,110 @@ void VertexData::readVertices( PlyFile* file, const int nVertices,
 }
 
 
+/*  Read the vertices of a binary little endian file in large blocks, if the
+    properties wanted are all of a layout that can be copied straight out.  */
+bool VertexData::readVerticesBulk( PlyFile* file, const int nVertices,
+                                   const int fields )
+{
+    if( file->file_type != PLY_BINARY_LE ||
+        osg::getCpuByteOrder() != osg::LittleEndian )
+        return false;
+
+    // the material colors aren't worth a fast path
+    if( fields & ( AMBIENT | DIFFUSE | SPECULAR ) )
+        return false;
+
+    const PlyElement* element = findElement( file, "vertex" );
+    if( !element )
+        return false;
+
+    // every property must be a scalar so that each vertex is the same size
+    int stride = 0;
+    for( int i = 0; i < element->nprops; ++i )
+    {
+        if( element->props[i]->is_list || typeSize( element->props[i]->external_type ) == 0 )
+            return false;
+        stride += typeSize( element->props[i]->external_type );
+    }
+
+    const char* floatNames[] = { "x", "y", "z", "nx", "ny", "nz" };
+    const char* colorNames[] = { "red", "green", "blue", "alpha" };
+
+    int floatOffsets[6];
+    int numFloats = ( fields & NORMALS ) ? 6 : 3;
+    for( int i = 0; i < numFloats; ++i )
+    {
+        if( !isFloatProperty( element, floatNames[i] ) )
+            return false;
+        floatOffsets[i] = findPropertyOffset( element, floatNames[i], 4 );
+    }
+
+    int colorOffsets[4];
+    int numColors = ( fields & RGBA ) ? 4 : ( fields & RGB ) ? 3 : 0;
+    for( int i = 0; i < numColors; ++i )
+    {
+        if( !isUCharProperty( element, colorNames[i] ) )
+            return false;
+        colorOffsets[i] = findPropertyOffset( element, colorNames[i], 1 );
+    }
+
+    // the same conversion readVertices() makes
+    float colorValues[256];
+    for( unsigned int i = 0; i < 256; ++i )
+        colorValues[i] = i / 255.0;
+
+    if(!_vertices.valid())
+        _vertices = new osg::Vec3Array;
+    _vertices->reserve( _vertices->size() + nVertices );
+
+    if( fields & NORMALS )
+    {
+        if(!_normals.valid())
+            _normals = new osg::Vec3Array;
+        _normals->reserve( _normals->size() + nVertices );
+    }
+
+    if( numColors > 0 )
+    {
+        if(!_colors.valid())
+            _colors = new osg::Vec4Array;
+        _colors->reserve( _colors->size() + nVertices );
+    }
+
+    std::vector<char> buffer( static_cast< size_t >( stride ) * std::min( nVertices, elementsPerBlock ) );
+    for( int first = 0; first < nVertices; first += elementsPerBlock )
+    {
+        int count = std::min( nVertices - first, elementsPerBlock );
+        if( fread( &buffer[0], stride, count, file->fp ) != static_cast< size_t >( count ) )
+            throw MeshException( "Error in reading PLY file."
+                                 "fread not succeeded." );
+
+        const char* vertex = &buffer[0];
+        for( int i = 0; i < count; ++i, vertex += stride )
+        {
+            _vertices->push_back( osg::Vec3( readFloat( vertex + floatOffsets[0] ),
+                                             readFloat( vertex + floatOffsets[1] ),
+                                             readFloat( vertex + floatOffsets[2] ) ) );
+            if( fields & NORMALS )
+                _normals->push_back( osg::Vec3( readFloat( vertex + floatOffsets[3] ),
+                                                readFloat( vertex + floatOffsets[4] ),
+                                                readFloat( vertex + floatOffsets[5] ) ) );
+
+            if( numColors > 0 )
+            {
+                const unsigned char* color = reinterpret_cast< const unsigned char* >( vertex );
+                _colors->push_back( osg::Vec4( colorValues[ color[ colorOffsets[0] ] ],
+                                               colorValues[ color[ colorOffsets[1] ] ],
+                                               colorValues[ color[ colorOffsets[2] ] ],
+                                               ( numColors == 4 ) ? colorValues[ color[ colorOffsets[3] ] ] : 1.0f ) );
+            }
+        }
+    }
+
+    return true;
+}
+
+
 /*  Read the index data from the open file.  */
 void VertexData::readTriangles( PlyFile* file, const int nFaces )
 {
@@ -251,6 +438,66 @@ void VertexData::readTriangles( PlyFile* file, const int nFaces )
 }
 
 
+/*  Read the triangles of a binary little endian file in large blocks, if the
+    faces have nothing but a list of int indices with a one byte count.  */
+bool VertexData::readTrianglesBulk( PlyFile* file, const int nFaces )
+{
+    if( file->file_type != PLY_BINARY_LE ||
+        osg::getCpuByteOrder() != osg::LittleEndian )
+        return false;
+
+    const PlyElement* element = findElement( file, "face" );
+    if( !element || element->nprops != 1 )
+        return false;
+
+    const PlyProperty* prop = element->props[0];
+    if( !equal_strings( prop->name, "vertex_indices" ) || !prop->is_list ||
+        typeSize( prop->count_external ) != 1 ||
+        ( prop->external_type != PLY_INT && prop->external_type != PLY_INT32 &&
+          prop->external_type != PLY_UINT ) )
+        return false;
+
+    if(!_triangles.valid())
+        _triangles = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, 0);
+    _triangles->reserve( _triangles->size() + nFaces * 3 );
+
+    // a triangle is a count and three indices
+    const size_t faceSize = 1 + 3 * sizeof( unsigned int );
+
+    int ind1 = _invertFaces ? 2 : 0;
+    int ind3 = _invertFaces ? 0 : 2;
+
+    std::vector<char> buffer( faceSize * std::min( nFaces, elementsPerBlock ) );
+    for( int first = 0; first < nFaces; first += elementsPerBlock )
+    {
+        int count = std::min( nFaces - first, elementsPerBlock );
+        if( fread( &buffer[0], faceSize, count, file->fp ) != static_cast< size_t >( count ) )
+            throw MeshException( "Error in reading PLY file."
+                                 "fread not succeeded." );
+
+        const char* face = &buffer[0];
+        for( int i = 0; i < count; ++i, face += faceSize )
+        {
+            if( static_cast< unsigned char >( face[0] ) != 3 )
+            {
+                throw MeshException( "Error reading PLY file. Encountered a "
+                                     "face which does not have three vertices." );
+            }
+
+            unsigned int indices[3];
+            memcpy( indices, face + 1, sizeof( indices ) );
+
+            // Add the face indices in the premitive set
+            _triangles->push_back( indices[ind1] );
+            _triangles->push_back( indices[1] );
+            _triangles->push_back( indices[ind3] );
+        }
+    }
+
+    return true;
+}
+
+
 /*  Open a PLY file and read vertex, color and index data. and returns the node  */
 osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColors )
 {
@@ -363,7 +610,8 @@ osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColor
 
             try {
                 // Read vertices and store in a std::vector array
-                readVertices( file, nElems, fields );
+                if( !readVerticesBulk( file, nElems, fields ) )
+                    readVertices( file, nElems, fields );
                 // Check whether all vertices are loaded or not
                 MESHASSERT( _vertices->size() == static_cast< size_t >( nElems ) );
 
@@ -406,7 +654,8 @@ osg::Node* VertexData::readPlyFile( const char* filename, const bool ignoreColor
         try
         {
             // Read Triangles
-            readTriangles( file, nElems );
+            if( !readTrianglesBulk( file, nElems ) )
+                readTriangles( file, nElems );
             // Check whether all face elements read or not
             MESHASSERT( _triangles->size()/3  == static_cast< size_t >( nElems ) );
             result = true;
@@ -63,9 +63,21 @@ namespace ply
         void readVertices( PlyFile* file, const int nVertices,
                            const int vertexFields );
 
+        // Reads the vertices of a binary little endian file with float
+        // positions and normals and unsigned char colors straight from the
+        // file in large blocks, returns false without reading anything for
+        // other layouts, which readVertices() handles
+        bool readVerticesBulk( PlyFile* file, const int nVertices,
+                               const int vertexFields );
+
         // Reads the triangle indices from the ply file
         void readTriangles( PlyFile* file, const int nFaces );
 
+        // Reads the triangle indices of a binary little endian file with
+        // unsigned char counts and int indices in large blocks, returns false
+        // without reading anything for other layouts
+        bool readTrianglesBulk( PlyFile* file, const int nFaces );
+
         // Calculates the normals according to passed flag
         // if vertexNormals is true then computes normal per vertices
         // otherwise per triangle means per face
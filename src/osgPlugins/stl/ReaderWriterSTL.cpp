@@ -45,6 +45,81 @@
 #include <string.h>
 
 #include <memory>
+#include <vector>
+
+/** Merge the vertices with the same position and normal, moving the first of each to the front of the arrays in the
+  * order they come, and return the triangles indexing the merged arrays. The vertices are found in a hash table
+  * keyed on their bits so welding takes linear time.*/
+static osg::DrawElementsUInt* weldVertices(osg::Vec3Array& vertices, osg::Vec3Array* normals)
+{
+    unsigned int numVertices = vertices.size();
+
+    unsigned int tableSize = 1;
+    while (tableSize < numVertices * 2) tableSize <<= 1;
+    const unsigned int emptySlot = 0xffffffff;
+    std::vector<unsigned int> table(tableSize, emptySlot);
+
+    osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES);
+    triangles->reserve(numVertices);
+
+    unsigned int numUnique = 0;
+    for (unsigned int i = 0; i < numVertices; ++i)
+    {
+        const osg::Vec3& vertex = vertices[i];
+        const osg::Vec3* normal = normals ? &(*normals)[i] : 0;
+
+        // FNV-1a over the 32 bit words of the position and normal, then the MurmurHash3 finalizer to bring the high
+        // bits, where nearby floats differ, down into the low bits which index the table.
+        unsigned int words[6];
+        memcpy(words, vertex.ptr(), sizeof(osg::Vec3));
+        unsigned int numWords = 3;
+        if (normal)
+        {
+            memcpy(words + 3, normal->ptr(), sizeof(osg::Vec3));
+            numWords = 6;
+        }
+
+        unsigned int hash = 2166136261u;
+        for (unsigned int w = 0; w < numWords; ++w)
+        {
+            hash = (hash ^ words[w]) * 16777619u;
+        }
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+
+        unsigned int slot = hash & (tableSize - 1);
+        while (table[slot] != emptySlot)
+        {
+            unsigned int index = table[slot];
+            if (memcmp(vertices[index].ptr(), vertex.ptr(), sizeof(osg::Vec3)) == 0 &&
+                (!normal || memcmp((*normals)[index].ptr(), normal->ptr(), sizeof(osg::Vec3)) == 0))
+            {
+                break;
+            }
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == emptySlot)
+        {
+            // a new vertex, numUnique<=i so it's safe to compact the arrays as we go.
+            vertices[numUnique] = vertex;
+            if (normal) (*normals)[numUnique] = *normal;
+            table[slot] = numUnique++;
+        }
+
+        triangles->push_back(table[slot]);
+    }
+
+    vertices.resize(numUnique);
+    if (normals) normals->resize(numUnique);
+
+    OSG_INFO << "STL welded " << numVertices << " vertices to " << numUnique << std::endl;
+
+    return triangles.release();
+}
 
 /**
  * STL importer for OpenSceneGraph.
@@ -57,6 +132,7 @@ public:
         supportsExtension("stl", "STL binary format");
         supportsExtension("sta", "STL ASCII format");
         supportsOption("smooth", "Run SmoothingVisitor");
+        supportsOption("noTriStripPolygons", "Leave the welded triangles as they are rather than tri stripping them");
         supportsOption("separateFiles", "Save each geode in a different file. Can result in a huge amount of files!");
         supportsOption("dontSaveNormals", "Set all normals to [0 0 0] when saving to a file.");
     }
@@ -92,16 +168,17 @@ private:
 
         virtual ReadResult read(FILE *fp) = 0;
 
-        osg::ref_ptr<osg::Geometry> asGeometry() const
+        osg::ref_ptr<osg::Geometry> asGeometry(bool triStrip = true) const
         {
             osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
 
             geom->setVertexArray(_vertex.get());
 
+            osg::ref_ptr<osg::Vec3Array> perVertexNormals;
             if (_normal.valid())
             {
                 // need to convert per triangle normals to per vertex
-                osg::ref_ptr<osg::Vec3Array> perVertexNormals = new osg::Vec3Array;
+                perVertexNormals = new osg::Vec3Array;
                 perVertexNormals->reserveArray(_normal->size() * 3);
                 for(osg::Vec3Array::iterator itr = _normal->begin();
                     itr != _normal->end();
@@ -128,12 +205,20 @@ private:
                     perVertexColours->push_back(*itr);
                 }
                 geom->setColorArray(perVertexColours.get(), osg::Array::BIND_PER_VERTEX);
-            }
 
-            geom->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLES, 0, _numFacets * 3));
+                geom->addPrimitiveSet(new osg::DrawArrays(osg::PrimitiveSet::TRIANGLES, 0, _numFacets * 3));
+            }
+            else
+            {
+                // share the corners of neighbouring facets, which also leaves the tri stripper far fewer vertices to sort.
+                geom->addPrimitiveSet(weldVertices(*_vertex, perVertexNormals.get()));
+            }
 
-            osgUtil::TriStripVisitor tristripper;
-            tristripper.stripify(*geom);
+            if (triStrip)
+            {
+                osgUtil::TriStripVisitor tristripper;
+                tristripper.stripify(*geom);
+            }
 
             return geom;
         }
@@ -415,6 +500,8 @@ osgDB::ReaderWriter::ReadResult ReaderWriterSTL::readNode(const std::string& fil
     // read
     rewind(fp);
 
+    bool triStrip = !options || options->getOptionString().find("noTriStripPolygons") == std::string::npos;
+
     ReaderObject *readerObject;
 
     if (isBinary)
@@ -436,7 +523,7 @@ osgDB::ReaderWriter::ReadResult ReaderWriterSTL::readNode(const std::string& fil
 
         if (!readerPtr->isEmpty())
         {
-            osg::ref_ptr<osg::Geometry> geom = readerPtr->asGeometry();
+            osg::ref_ptr<osg::Geometry> geom = readerPtr->asGeometry(triStrip);
             osg::ref_ptr<osg::Geode> geode = new osg::Geode;
             geode->addDrawable(geom.get());
             geode->setName(readerPtr->getName());
@@ -584,58 +671,74 @@ ReaderWriterSTL::ReaderObject::ReadResult ReaderWriterSTL::BinaryReaderObject::r
     // seek to beginning of facets
     ::fseek(fp, sizeof_StlHeader, SEEK_SET);
 
+    if (!_vertex.valid())
+        _vertex = new osg::Vec3Array;
+    if (!_normal.valid())
+        _normal = new osg::Vec3Array;
+
+    _vertex->reserve(_expectNumFacets * 3);
+    _normal->reserve(_expectNumFacets);
+
+    // read the facets in large blocks rather than one at a time.
+    const unsigned int facetsPerBlock = 65536;
+    std::vector<char> buffer(sizeof_StlFacet * osg::minimum(_expectNumFacets, facetsPerBlock));
+
     StlFacet facet;
-    for (unsigned int i = 0; i < _expectNumFacets; ++i)
+    for (unsigned int first = 0; first < _expectNumFacets; first += facetsPerBlock)
     {
-        if (::fread((void*) &facet, sizeof_StlFacet, 1, fp) != 1)
+        unsigned int count = osg::minimum(_expectNumFacets - first, facetsPerBlock);
+        unsigned int numRead = ::fread((void*) &buffer[0], sizeof_StlFacet, count, fp);
+
+        for (unsigned int i = 0; i < count; ++i)
         {
-            OSG_FATAL << "ReaderWriterSTL::readStlBinary: Failed to read facet " << i << std::endl;
-            return ReadError;
-        }
+            if (i >= numRead)
+            {
+                OSG_FATAL << "ReaderWriterSTL::readStlBinary: Failed to read facet " << first + i << std::endl;
+                return ReadError;
+            }
 
-        // vertices
-        if (!_vertex.valid())
-            _vertex = new osg::Vec3Array;
+            // the facets are packed so aren't aligned for the floats in them.
+            memcpy((void*) &facet, &buffer[i * sizeof_StlFacet], sizeof_StlFacet);
 
-        osg::Vec3 v0(facet.vertex[0].x, facet.vertex[0].y, facet.vertex[0].z);
-        osg::Vec3 v1(facet.vertex[1].x, facet.vertex[1].y, facet.vertex[1].z);
-        osg::Vec3 v2(facet.vertex[2].x, facet.vertex[2].y, facet.vertex[2].z);
-        _vertex->push_back(v0);
-        _vertex->push_back(v1);
-        _vertex->push_back(v2);
+            // vertices
+            osg::Vec3 v0(facet.vertex[0].x, facet.vertex[0].y, facet.vertex[0].z);
+            osg::Vec3 v1(facet.vertex[1].x, facet.vertex[1].y, facet.vertex[1].z);
+            osg::Vec3 v2(facet.vertex[2].x, facet.vertex[2].y, facet.vertex[2].z);
+            _vertex->push_back(v0);
+            _vertex->push_back(v1);
+            _vertex->push_back(v2);
 
-        // per-facet normal
-        osg::Vec3 normal;
-        if (_generateNormal)
-        {
-            osg::Vec3 d01 = v1 - v0;
-            osg::Vec3 d02 = v2 - v0;
-            normal = d01 ^ d02;
-            normal.normalize();
-        }
-        else
-        {
-            normal.set(facet.normal.x, facet.normal.y, facet.normal.z);
-        }
+            // per-facet normal
+            osg::Vec3 normal;
+            if (_generateNormal)
+            {
+                osg::Vec3 d01 = v1 - v0;
+                osg::Vec3 d02 = v2 - v0;
+                normal = d01 ^ d02;
+                normal.normalize();
+            }
+            else
+            {
+                normal.set(facet.normal.x, facet.normal.y, facet.normal.z);
+            }
 
-        if (!_normal.valid())
-            _normal = new osg::Vec3Array;
-        _normal->push_back(normal);
+            _normal->push_back(normal);
 
-        /*
-         * color extension
-         * RGB555 with most-significat bit indicating if color is present
-         */
-        if (facet.color & StlHasColor)
-        {
-            if (!_color.valid())
+            /*
+             * color extension
+             * RGB555 with most-significat bit indicating if color is present
+             */
+            if (facet.color & StlHasColor)
             {
-                _color = new osg::Vec4Array;
+                if (!_color.valid())
+                {
+                    _color = new osg::Vec4Array;
+                }
+                float r = ((facet.color >> 10) & StlColorSize) / StlColorDepth;
+                float g = ((facet.color >> 5) & StlColorSize) / StlColorDepth;
+                float b = (facet.color & StlColorSize) / StlColorDepth;
+                _color->push_back(osg::Vec4(r, g, b, 1.0f));
             }
-            float r = ((facet.color >> 10) & StlColorSize) / StlColorDepth;
-            float g = ((facet.color >> 5) & StlColorSize) / StlColorDepth;
-            float b = (facet.color & StlColorSize) / StlColorDepth;
-            _color->push_back(osg::Vec4(r, g, b, 1.0f));
         }
     }
 
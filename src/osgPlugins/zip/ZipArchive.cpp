@@ -44,9 +44,10 @@ _zipLoaded( false )
 
 ZipArchive::~ZipArchive()
 {
+    close();
 }
 
-/** close the archive (on all threads) */
+/** close the archive (on all threads), must not be called while reads are in progress. */
 void ZipArchive::close()
 {
     if ( _zipLoaded )
@@ -54,15 +55,22 @@ void ZipArchive::close()
         OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive(_zipMutex);
         if ( _zipLoaded )
         {
-            // close the file (on one thread since it's a shared file)
-            const PerThreadData& data = getDataNoLock();
-            CloseZip( data._zipHandle );
-
-            // clear out the file handles
-            _perThreadData.clear();
+            // close the file handles
+            for(ZipHandles::iterator itr = _zipHandles.begin(); itr != _zipHandles.end(); ++itr)
+            {
+                CloseZip( *itr );
+            }
+            _zipHandles.clear();
+            _freeZipHandles.clear();
 
             // clear out the index.
+            for(ZipEntryMap::iterator itr = _zipIndex.begin(); itr != _zipIndex.end(); ++itr)
+            {
+                delete itr->second;
+            }
             _zipIndex.clear();
+            _zipHashTable.clear();
+            _zipItemPositions.clear();
 
             _zipLoaded = false;
         }
@@ -130,12 +138,14 @@ bool ZipArchive::open(const std::string& file, ArchiveStatus status, const osgDB
             _password = ReadPassword(options);
 
             // open the zip file in this thread:
-            const PerThreadData& data = getDataNoLock();
+            HZIP handle = openZipHandle();
 
             // establish a shared (read-only) index:
-            if ( data._zipHandle != NULL )
+            if ( handle != NULL )
             {
-                IndexZipFiles( data._zipHandle );
+                IndexZipFiles( handle );
+                _zipHandles.push_back( handle );
+                _freeZipHandles.push_back( handle );
                 _zipLoaded = true;
             }
         }
@@ -166,11 +176,13 @@ bool ZipArchive::open(std::istream& fin, const osgDB::ReaderWriter::Options* opt
             _password = ReadPassword(options);
 
             // open on this thread:
-            const PerThreadData& data = getDataNoLock();
+            HZIP handle = openZipHandle();
 
-            if ( data._zipHandle != NULL )
+            if ( handle != NULL )
             {
-                IndexZipFiles( data._zipHandle );
+                IndexZipFiles( handle );
+                _zipHandles.push_back( handle );
+                _freeZipHandles.push_back( handle );
                 _zipLoaded = true;
             }
         }
@@ -378,11 +390,19 @@ osgDB::ReaderWriter* ZipArchive::ReadFromZipEntry(const ZIPENTRY* ze, const osgD
         char* ibuf = new (std::nothrow) char[ze->unc_size];
         if (ibuf)
         {
-            // fetch the handle for the current thread:
-            const PerThreadData& data = getData();
-            if ( data._zipHandle != NULL )
+            // fetch a handle no other thread is using:
+            HZIP handle = acquireZipHandle();
+            if ( handle != NULL )
             {
-                ZRESULT result = UnzipItem(data._zipHandle, ze->index, ibuf, ze->unc_size);
+                // go straight to the entry rather than have the unzip code walk the central directory to it.
+                if (ze->index>=0 && ze->index<static_cast<int>(_zipItemPositions.size()))
+                {
+                    SetZipItemPosition(handle, ze->index, _zipItemPositions[ze->index]);
+                }
+
+                ZRESULT result = UnzipItem(handle, ze->index, ibuf, ze->unc_size);
+                releaseZipHandle(handle);
+
                 bool unzipSuccesful = CheckZipErrorCode(result);
                 if(unzipSuccesful)
                 {
@@ -399,6 +419,10 @@ osgDB::ReaderWriter* ZipArchive::ReadFromZipEntry(const ZIPENTRY* ze, const osgD
                     return rw;
                 }
             }
+            else
+            {
+                delete[] ibuf;
+            }
         }
         else
         {
@@ -447,52 +471,79 @@ void ZipArchive::IndexZipFiles(HZIP hz)
         GetZipItem(hz, -1, &_mainRecord);
         int numitems = _mainRecord.index;
 
+        // record where each entry's central directory record is so that reads can go straight to it.
+        bool positionsValid = true;
+        _zipItemPositions.resize(numitems > 0 ? numitems : 0, 0);
+
         // Now loop through each file in zip
         for (int i = 0; i < numitems; i++)
         {
             ZIPENTRY* ze = new ZIPENTRY();
 
             GetZipItem(hz, i, ze);
+            if (GetZipItemPosition(hz, i, &_zipItemPositions[i]) != ZR_OK) positionsValid = false;
+
             std::string name = ze->name;
 
             CleanupFileString(name);
 
-            if(!name.empty())
+            if(name.empty() || !_zipIndex.insert(ZipEntryMapping(name, ze)).second)
             {
-                _zipIndex.insert(ZipEntryMapping(name, ze));
+                delete ze;
             }
         }
+
+        if (!positionsValid) _zipItemPositions.clear();
+
+        buildHashTable();
     }
 }
 
-ZIPENTRY* ZipArchive::GetZipEntry(const std::string& filename)
+static unsigned int hashFileName(const std::string& name)
 {
-    ZIPENTRY* ze = NULL;
-    std::string fileToLoad = filename;
-    CleanupFileString(fileToLoad);
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for(std::string::const_iterator itr = name.begin(); itr != name.end(); ++itr)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*itr)) * 16777619u;
+    }
+    return hash;
+}
 
-    ZipEntryMap::iterator iter = _zipIndex.find(fileToLoad);
-    if(iter != _zipIndex.end())
+void ZipArchive::buildHashTable()
+{
+    // keep the table at most half full so probe sequences stay short.
+    std::size_t size = 16;
+    while (size < _zipIndex.size()*2) size *= 2;
+
+    _zipHashTable.assign(size, 0);
+    for(ZipEntryMap::const_iterator iter = _zipIndex.begin(); iter != _zipIndex.end(); ++iter)
     {
-        ze = (*iter).second;
+        std::size_t i = hashFileName(iter->first) & (size-1);
+        while (_zipHashTable[i] != 0) i = (i+1) & (size-1);
+        _zipHashTable[i] = &(*iter);
     }
+}
 
-    return ze;
+ZIPENTRY* ZipArchive::GetZipEntry(const std::string& filename)
+{
+    return const_cast<ZIPENTRY*>(static_cast<const ZipArchive*>(this)->GetZipEntry(filename));
 }
 
 const ZIPENTRY* ZipArchive::GetZipEntry(const std::string& filename) const
 {
-    ZIPENTRY* ze = NULL;
+    if (_zipHashTable.empty()) return NULL;
+
     std::string fileToLoad = filename;
     CleanupFileString(fileToLoad);
 
-    ZipEntryMap::const_iterator iter = _zipIndex.find(fileToLoad);
-    if(iter != _zipIndex.end())
+    std::size_t mask = _zipHashTable.size()-1;
+    for(std::size_t i = hashFileName(fileToLoad) & mask; _zipHashTable[i] != 0; i = (i+1) & mask)
     {
-        ze = (*iter).second;
+        if (_zipHashTable[i]->first == fileToLoad) return _zipHashTable[i]->second;
     }
 
-    return ze;
+    return NULL;
 }
 
 osgDB::FileType ZipArchive::getFileType(const std::string& filename) const
@@ -614,45 +665,46 @@ bool ZipArchive::CheckZipErrorCode(ZRESULT result) const
     }
 }
 
-const ZipArchive::PerThreadData&
-ZipArchive::getData() const
+HZIP ZipArchive::openZipHandle() const
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive( const_cast<ZipArchive*>(this)->_zipMutex );
-    return getDataNoLock();
+    if ( !_filename.empty() )
+    {
+        return OpenZip( _filename.c_str(), _password.c_str() );
+    }
+    else if ( !_membuffer.empty() )
+    {
+        return OpenZip( (void*)_membuffer.c_str(), _membuffer.length(), _password.c_str() );
+    }
+    else
+    {
+        return NULL;
+    }
 }
 
-
-const ZipArchive::PerThreadData&
-ZipArchive::getDataNoLock() const
+HZIP ZipArchive::acquireZipHandle() const
 {
-    // get/create data for the currently running thread:
-    OpenThreads::Thread* current = OpenThreads::Thread::CurrentThread();
-
-    PerThreadDataMap::const_iterator i = _perThreadData.find( current );
-
-    if ( i == _perThreadData.end() || i->second._zipHandle == NULL )
     {
-        // cache pattern: cast to const for caching purposes
-        ZipArchive* ncThis = const_cast<ZipArchive*>(this);
-
-        // data does not already exist, so open the ZIP with a handle exclusively for this thread:
-        PerThreadData& data = ncThis->_perThreadData[current];
-        if ( !_filename.empty() )
-        {
-            data._zipHandle = OpenZip( _filename.c_str(), _password.c_str() );
-        }
-        else if ( _membuffer.empty() )
-        {
-            data._zipHandle = OpenZip( (void*)_membuffer.c_str(), _membuffer.length(), _password.c_str() );
-        }
-        else
+        OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive( _zipMutex );
+        if ( !_freeZipHandles.empty() )
         {
-            data._zipHandle = NULL;
+            HZIP handle = _freeZipHandles.back();
+            _freeZipHandles.pop_back();
+            return handle;
         }
-        return data;
     }
-    else
+
+    // all the handles are busy, so open another outside of the lock so the other reads aren't held up.
+    HZIP handle = openZipHandle();
+    if ( handle != NULL )
     {
-        return i->second;
+        OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive( _zipMutex );
+        _zipHandles.push_back( handle );
     }
+    return handle;
+}
+
+void ZipArchive::releaseZipHandle(HZIP handle) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> exclusive( _zipMutex );
+    _freeZipHandles.push_back( handle );
 }
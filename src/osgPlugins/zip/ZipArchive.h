@@ -7,6 +7,8 @@
 #include <osgDB/Archive>
 #include <OpenThreads/Mutex>
 
+#include <vector>
+
 #include "unzip.h"
 
 
@@ -79,22 +81,32 @@ class ZipArchive : public osgDB::Archive
         typedef std::pair<std::string, ZIPENTRY*> ZipEntryMapping;
         typedef std::map<std::string, ZIPENTRY*> ZipEntryMap;
 
-        std::string _filename, _password, _membuffer;
+        /** Open addressed hash table over the entries of _zipIndex, built once on open and then only read,
+          * so lookups from several threads need no lock.*/
+        typedef std::vector<const ZipEntryMap::value_type*> ZipEntryHashTable;
+
+        typedef std::vector<HZIP> ZipHandles;
 
-        OpenThreads::Mutex _zipMutex;
-        bool               _zipLoaded;
-        ZipEntryMap        _zipIndex;
-        ZIPENTRY           _mainRecord;
+        void buildHashTable();
 
-        struct PerThreadData {
-            HZIP _zipHandle;
-        };
+        HZIP openZipHandle() const;
+
+        /** Take a handle not in use by another read, opening a new one if they are all in use. Each handle keeps its own
+          * file position and inflate state, so reads on different handles can decompress concurrently.*/
+        HZIP acquireZipHandle() const;
+        void releaseZipHandle(HZIP handle) const;
+
+        std::string _filename, _password, _membuffer;
 
-        typedef std::map<OpenThreads::Thread*, PerThreadData> PerThreadDataMap;
-        PerThreadDataMap _perThreadData;
+        mutable OpenThreads::Mutex _zipMutex;
+        bool                       _zipLoaded;
+        ZipEntryMap                _zipIndex;
+        ZipEntryHashTable          _zipHashTable;
+        std::vector<unsigned long> _zipItemPositions;
+        ZIPENTRY                   _mainRecord;
 
-        const PerThreadData& getData() const;
-        const PerThreadData& getDataNoLock() const;
+        mutable ZipHandles         _zipHandles;
+        mutable ZipHandles         _freeZipHandles;
 };
 
 
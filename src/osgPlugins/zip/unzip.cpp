@@ -3949,6 +3949,8 @@ class TUnzip
   ZRESULT Open(void *z,unsigned int len,DWORD flags);
   ZRESULT Get(int index,ZIPENTRY *ze);
   ZRESULT Find(const TCHAR *name,bool ic,int *index,ZIPENTRY *ze);
+  ZRESULT GetPosition(int index,unsigned long *pos);
+  ZRESULT SetPosition(int index,unsigned long pos);
   ZRESULT Unzip(int index,void *dst,unsigned int len,DWORD flags);
   ZRESULT SetUnzipBaseDir(const TCHAR *dir);
   ZRESULT Close();
@@ -4165,6 +4167,29 @@ ZRESULT TUnzip::Find(const TCHAR *tname,bool ic,int *index,ZIPENTRY *ze)
   return ZR_OK;
 }
 
+ZRESULT TUnzip::GetPosition(int index,unsigned long *pos)
+{ if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
+  if (index<(int)uf->num_file) unzGoToFirstFile(uf);
+  while ((int)uf->num_file<index) unzGoToNextFile(uf);
+  if ((int)uf->num_file!=index || !uf->current_file_ok) return ZR_CORRUPT;
+  *pos = uf->pos_in_central_dir;
+  return ZR_OK;
+}
+
+ZRESULT TUnzip::SetPosition(int index,unsigned long pos)
+{ if (index<0 || index>=(int)uf->gi.number_entry) return ZR_ARGS;
+  if (currentfile!=-1) unzCloseCurrentFile(uf); currentfile=-1;
+  if ((int)uf->num_file==index && uf->pos_in_central_dir==pos && uf->current_file_ok) return ZR_OK;
+  // read the central directory record at pos as unzGoToNextFile would have, which also checks its signature
+  uf->pos_in_central_dir=pos;
+  uf->num_file=index;
+  int err = unzlocal_GetCurrentFileInfoInternal(uf,&uf->cur_file_info,&uf->cur_file_info_internal,NULL,0,NULL,0,NULL,0);
+  uf->current_file_ok = (err==UNZ_OK);
+  if (err!=UNZ_OK) {unzGoToFirstFile(uf); return ZR_CORRUPT;}
+  return ZR_OK;
+}
+
 void EnsureDirectory(const TCHAR *rootdir, const TCHAR *dir)
 { // first check that rootdir exists. nb. rootdir has a trailing slash
   if (rootdir!=0)
@@ -4460,6 +4485,24 @@ ZRESULT FindZipItem(HZIP hz, const TCHAR *name, bool ic, int *index, ZIPENTRY *z
   return lasterrorU;
 }
 
+ZRESULT GetZipItemPosition(HZIP hz, int index, unsigned long *pos)
+{ if (hz==0 || pos==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  lasterrorU = unz->GetPosition(index,pos);
+  return lasterrorU;
+}
+
+ZRESULT SetZipItemPosition(HZIP hz, int index, unsigned long pos)
+{ if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
+  TUnzipHandleData *han = (TUnzipHandleData*)hz;
+  if (han->flag!=1) {lasterrorU=ZR_ZMODE;return ZR_ZMODE;}
+  TUnzip *unz = han->unz;
+  lasterrorU = unz->SetPosition(index,pos);
+  return lasterrorU;
+}
+
 ZRESULT UnzipItemInternal(HZIP hz, int index, void *dst, unsigned int len, DWORD flags)
 { if (hz==0) {lasterrorU=ZR_ARGS;return ZR_ARGS;}
   TUnzipHandleData *han = (TUnzipHandleData*)hz;
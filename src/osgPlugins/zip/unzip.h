@@ -124,6 +124,14 @@ ZRESULT FindZipItem(HZIP hz, const TCHAR *name, bool ic, int *index, ZIPENTRY *z
 // If nothing was found, then index is set to -1 and the function returns
 // an error code.
 
+ZRESULT GetZipItemPosition(HZIP hz, int index, unsigned long *pos);
+ZRESULT SetZipItemPosition(HZIP hz, int index, unsigned long pos);
+// GetZipItemPosition - returns the position of the item's central directory record.
+// SetZipItemPosition - makes the item at that position the current one, so that a
+// following GetZipItem or UnzipItem of index needn't walk the central directory
+// from its start. The positions are the same for every handle opened on the same
+// zipfile, so they can be gathered once and used from any of them.
+
 ZRESULT UnzipItem(HZIP hz, int index, const TCHAR *fn);
 ZRESULT UnzipItem(HZIP hz, int index, void *z,unsigned int len);
 ZRESULT UnzipItemHandle(HZIP hz, int index, HANDLE h);
@@ -1275,7 +1275,9 @@ void GeometryTechnique::generateGeometry(BufferData& buffer, Locator* masterLoca
         //osg::Timer_t before = osg::Timer::instance()->tick();
         //OSG_NOTICE<<"osgTerrain::GeometryTechnique::build kd tree"<<std::endl;
         osg::ref_ptr<osg::KdTreeBuilder> builder = osgDB::Registry::instance()->getKdTreeBuilder()->clone();
+        builder->setBuildInParallel(true);
         buffer._geode->accept(*builder);
+        builder->buildKdTrees();
         //osg::Timer_t after = osg::Timer::instance()->tick();
         //OSG_NOTICE<<"KdTree build time "<<osg::Timer::instance()->delta_m(before, after)<<std::endl;
     }
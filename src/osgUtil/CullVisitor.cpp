@@ -30,14 +30,151 @@
 
 #include <osgUtil/CullVisitor>
 
+#include <OpenThreads/Thread>
+#include <OpenThreads/Condition>
+
 #include <float.h>
 #include <algorithm>
+#include <typeinfo>
 
 #include <osg/Timer>
 
 using namespace osg;
 using namespace osgUtil;
 
+namespace osgUtil
+{
+
+class ParallelCullThreads : public osg::Referenced
+{
+    public:
+
+        /** Thread that culls a range of a Group's children with its own CullVisitor, StateGraph and RenderStage.*/
+        class CullThread : public osg::Referenced, public OpenThreads::Thread
+        {
+            public:
+
+                CullThread(CullVisitor* cv):
+                    _cullVisitor(cv),
+                    _stateGraph(new StateGraph),
+                    _renderStage(new RenderStage),
+                    _group(0),
+                    _begin(0),
+                    _end(0),
+                    _used(false),
+                    _active(false),
+                    _done(false) {}
+
+                void cull(osg::Group* group, unsigned int begin, unsigned int end)
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                    _group = group;
+                    _begin = begin;
+                    _end = end;
+                    _used = true;
+                    _active = true;
+                    _condition.broadcast();
+                }
+
+                void waitForCompletion()
+                {
+                    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                    while(_active) _condition.wait(&_mutex);
+                }
+
+                void reset()
+                {
+                    if (!_used) return;
+
+                    _cullVisitor->reset();
+                    _stateGraph->clean();
+                    _stateGraph->prune();
+                    _renderStage->reset();
+
+                    _used = false;
+                }
+
+                void stop()
+                {
+                    {
+                        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                        _done = true;
+                        _condition.broadcast();
+                    }
+                    join();
+                }
+
+                virtual void run()
+                {
+                    while(true)
+                    {
+                        {
+                            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                            while(!_active && !_done) _condition.wait(&_mutex);
+                            if (_done) return;
+                        }
+
+                        for(unsigned int i=_begin; i<_end; ++i)
+                        {
+                            _group->getChild(i)->accept(*_cullVisitor);
+                        }
+
+                        {
+                            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+                            _group = 0;
+                            _active = false;
+                            _condition.broadcast();
+                        }
+                    }
+                }
+
+                osg::ref_ptr<CullVisitor>   _cullVisitor;
+                osg::ref_ptr<StateGraph>    _stateGraph;
+                osg::ref_ptr<RenderStage>   _renderStage;
+
+            protected:
+
+                virtual ~CullThread() {}
+
+                OpenThreads::Mutex          _mutex;
+                OpenThreads::Condition      _condition;
+                osg::Group*                 _group;
+                unsigned int                _begin;
+                unsigned int                _end;
+                bool                        _used;
+                bool                        _active;
+                bool                        _done;
+        };
+
+        typedef std::vector< osg::ref_ptr<CullThread> > CullThreads;
+
+        void reset()
+        {
+            for(CullThreads::iterator itr = _cullThreads.begin();
+                itr != _cullThreads.end();
+                ++itr)
+            {
+                (*itr)->reset();
+            }
+        }
+
+        CullThreads _cullThreads;
+
+    protected:
+
+        virtual ~ParallelCullThreads()
+        {
+            for(CullThreads::iterator itr = _cullThreads.begin();
+                itr != _cullThreads.end();
+                ++itr)
+            {
+                (*itr)->stop();
+            }
+        }
+};
+
+}
+
 inline float MAX_F(float a, float b)
     { return a>b?a:b; }
 inline int EQUAL_F(float a, float b)
@@ -52,7 +189,9 @@ CullVisitor::CullVisitor():
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _currentReuseRenderLeafIndex(0),
-    _numberOfEncloseOverrideRenderBinDetails(0)
+    _renderLeafPool(new RenderLeafPool),
+    _numberOfEncloseOverrideRenderBinDetails(0),
+    _parallelCullVisitor(false)
 {
     _identifier = new Identifier;
 }
@@ -66,8 +205,10 @@ CullVisitor::CullVisitor(const CullVisitor& rhs):
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _currentReuseRenderLeafIndex(0),
+    _renderLeafPool(new RenderLeafPool),
     _numberOfEncloseOverrideRenderBinDetails(0),
-    _identifier(rhs._identifier)
+    _identifier(rhs._identifier),
+    _parallelCullVisitor(false)
 {
 }
 
@@ -132,6 +273,9 @@ void CullVisitor::reset()
 
     _nearPlaneCandidateMap.clear();
     _farPlaneCandidateMap.clear();
+
+    // reset the CullVisitors used for parallel culling, the RenderLeaf they created last frame are held in our StateGraph.
+    if (_parallelCullThreads.valid()) _parallelCullThreads->reset();
 }
 
 float CullVisitor::getDistanceToEyePoint(const Vec3& pos, bool withLODScale) const
@@ -1214,7 +1358,8 @@ void CullVisitor::apply(Group& node)
     StateSet* node_state = node.getStateSet();
     if (node_state) pushStateSet(node_state);
 
-    handle_cull_callbacks_and_traverse(node);
+    if (requiresParallelCull(node)) parallelCullChildren(node);
+    else handle_cull_callbacks_and_traverse(node);
 
     // pop the node's state off the render graph stack.
     if (node_state) popStateSet();
@@ -1746,3 +1891,195 @@ void CullVisitor::apply(osg::OcclusionQueryNode& node)
     popCurrentMask();
 }
 
+bool CullVisitor::requiresParallelCull(const osg::Group& group) const
+{
+    return !_parallelCullVisitor &&
+           getParallelCullThreshold()>0 &&
+           getNumParallelCullThreads()!=1 &&
+           group.getNumChildren()>=getParallelCullThreshold() &&
+           !group.getCullCallback() &&
+           typeid(group)==typeid(osg::Group) &&
+           (getTraversalMode()==TRAVERSE_ALL_CHILDREN || getTraversalMode()==TRAVERSE_ACTIVE_CHILDREN) &&
+           !_viewportStack.empty() &&
+           !_modelviewStack.empty() &&
+           _index_modelviewCullingStack>0;
+}
+
+void CullVisitor::parallelCullChildren(osg::Group& group)
+{
+    unsigned int numThreads = getNumParallelCullThreads();
+    if (numThreads==0) numThreads = OpenThreads::GetNumberOfProcessors();
+
+    unsigned int numChildren = group.getNumChildren();
+    unsigned int numRanges = osg::minimum(numThreads, numChildren);
+    if (numRanges<2)
+    {
+        traverse(group);
+        return;
+    }
+
+    if (!_parallelCullThreads) _parallelCullThreads = new ParallelCullThreads;
+
+    ParallelCullThreads::CullThreads& cullThreads = _parallelCullThreads->_cullThreads;
+    while(cullThreads.size()<numRanges-1)
+    {
+        osg::ref_ptr<CullVisitor> cv = clone();
+        cv->_parallelCullVisitor = true;
+
+        osg::ref_ptr<ParallelCullThreads::CullThread> cullThread = new ParallelCullThreads::CullThread(cv.get());
+        cullThreads.push_back(cullThread);
+        cullThread->startThread();
+    }
+
+    // record the clear settings so that any changes made by ClearNode's in the parallel culled subgraphs can be detected.
+    RenderStage* currentStage = getCurrentRenderStage();
+    osg::Vec4 clearColor = currentStage->getClearColor();
+    GLbitfield clearMask = currentStage->getClearMask();
+
+    // set up the CullVisitors for all but the first range of children from our current state and start them culling,
+    // once started they no longer reference this CullVisitor so we can cull the first range in this thread.
+    for(unsigned int i=1; i<numRanges; ++i)
+    {
+        ParallelCullThreads::CullThread* cullThread = cullThreads[i-1].get();
+
+        cullThread->_renderStage->setClearColor(clearColor);
+        cullThread->_renderStage->setClearMask(clearMask);
+
+        cullThread->_cullVisitor->setStateGraph(cullThread->_stateGraph.get());
+        cullThread->_cullVisitor->setRenderStage(cullThread->_renderStage.get());
+
+        setUpParallelCullVisitor(*(cullThread->_cullVisitor), *(cullThread->_renderStage));
+
+        cullThread->cull(&group, (numChildren*i)/numRanges, (numChildren*(i+1))/numRanges);
+    }
+
+    for(unsigned int i=0; i<numChildren/numRanges; ++i)
+    {
+        group.getChild(i)->accept(*this);
+    }
+
+    // merge the results in child order so that the rendering backend matches that of a serial cull.
+    for(unsigned int i=1; i<numRanges; ++i)
+    {
+        ParallelCullThreads::CullThread* cullThread = cullThreads[i-1].get();
+        cullThread->waitForCompletion();
+
+        RenderStage& renderStage = *(cullThread->_renderStage);
+        if (renderStage.getClearMask()!=clearMask || renderStage.getClearColor()!=clearColor)
+        {
+            currentStage->setClearColor(renderStage.getClearColor());
+            currentStage->setClearMask(renderStage.getClearMask());
+        }
+
+        mergeParallelCullVisitor(*(cullThread->_cullVisitor), renderStage);
+    }
+}
+
+void CullVisitor::setUpParallelCullVisitor(CullVisitor& cv, RenderStage& renderStage)
+{
+    cv.setCullSettings(*this);
+
+    cv.setTraversalMode(getTraversalMode());
+    cv.setTraversalMask(getTraversalMask());
+    cv.setNodeMaskOverride(getNodeMaskOverride());
+    cv.setTraversalNumber(getTraversalNumber());
+    cv.setFrameStamp(_frameStamp.get());
+    cv.setUserData(_userData.get());
+    cv.setDatabaseRequestHandler(_databaseRequestHandler.get());
+    cv.setImageRequestHandler(_imageRequestHandler.get());
+    cv._nodePath = _nodePath;
+
+    cv._renderInfo = _renderInfo;
+
+    cv.setOccluderList(getOccluderList());
+    cv.pushCullStackState(*this);
+
+    // set up the RenderStage so that nested Camera's inherit the same values they would from our current RenderStage.
+    RenderStage* currentStage = getCurrentRenderStage();
+    renderStage.setCamera(currentStage->getCamera());
+    renderStage.setViewport(currentStage->getViewport());
+    renderStage.setColorMask(currentStage->getColorMask());
+    renderStage.setDrawBuffer(currentStage->getDrawBuffer(), currentStage->getDrawBufferApplyMask());
+    renderStage.setReadBuffer(currentStage->getReadBuffer(), currentStage->getReadBufferApplyMask());
+
+    cv._renderBinStack.clear();
+    cv._numberOfEncloseOverrideRenderBinDetails = _numberOfEncloseOverrideRenderBinDetails;
+
+    // leaves are numbered from 0 and offset when merged
+    cv._traversalNumber = 0;
+
+    cv._computed_znear = FLT_MAX;
+    cv._computed_zfar = -FLT_MAX;
+}
+
+void CullVisitor::mergeParallelCullVisitor(CullVisitor& cv, RenderStage& renderStage)
+{
+    mergeParallelCullRenderBin(renderStage, _traversalNumber);
+    _traversalNumber += cv._traversalNumber;
+
+    getCurrentRenderStage()->moveDependentRenderStages(renderStage);
+
+    if (cv._computed_znear<_computed_znear) _computed_znear = cv._computed_znear;
+    if (cv._computed_zfar>_computed_zfar) _computed_zfar = cv._computed_zfar;
+
+    _nearPlaneCandidateMap.insert(cv._nearPlaneCandidateMap.begin(), cv._nearPlaneCandidateMap.end());
+    _farPlaneCandidateMap.insert(cv._farPlaneCandidateMap.begin(), cv._farPlaneCandidateMap.end());
+    cv._nearPlaneCandidateMap.clear();
+    cv._farPlaneCandidateMap.clear();
+
+    cv.popCullStackState();
+    cv._nodePath.clear();
+
+    renderStage.reset();
+}
+
+void CullVisitor::mergeParallelCullRenderBin(RenderBin& renderBin, unsigned int baseTraversalNumber)
+{
+    RenderBin::StateGraphList& stateGraphList = renderBin.getStateGraphList();
+    for(RenderBin::StateGraphList::iterator itr = stateGraphList.begin();
+        itr != stateGraphList.end();
+        ++itr)
+    {
+        StateGraph* sg = *itr;
+
+        // push the StateSet's that lead to the StateGraph so we arrive at the StateGraph and RenderBin a serial cull would have used.
+        _parallelCullStateSetPath.clear();
+        for(StateGraph* parent = sg; parent->_parent; parent = parent->_parent)
+        {
+            _parallelCullStateSetPath.push_back(parent->getStateSet());
+        }
+
+        for(std::vector<const osg::StateSet*>::reverse_iterator ritr = _parallelCullStateSetPath.rbegin();
+            ritr != _parallelCullStateSetPath.rend();
+            ++ritr)
+        {
+            pushStateSet(*ritr);
+        }
+
+        if (_currentStateGraph->leaves_empty())
+        {
+            _currentRenderBin->addStateGraph(_currentStateGraph);
+        }
+
+        for(StateGraph::LeafList::iterator litr = sg->_leaves.begin();
+            litr != sg->_leaves.end();
+            ++litr)
+        {
+            (*litr)->_traversalNumber += baseTraversalNumber;
+            _currentStateGraph->addLeaf(litr->get());
+        }
+        sg->_leaves.clear();
+
+        for(unsigned int i=0; i<_parallelCullStateSetPath.size(); ++i)
+        {
+            popStateSet();
+        }
+    }
+
+    for(RenderBin::RenderBinList::iterator bitr = renderBin.getRenderBinList().begin();
+        bitr != renderBin.getRenderBinList().end();
+        ++bitr)
+    {
+        mergeParallelCullRenderBin(*(bitr->second), baseTraversalNumber);
+    }
+}
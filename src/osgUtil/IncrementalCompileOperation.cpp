@@ -16,6 +16,8 @@
 #include <osg/Notify>
 #include <osg/Timer>
 #include <osg/GLObjects>
+#include <osg/GraphicsContext>
+#include <osg/GraphicsThread>
 #include <osg/Depth>
 #include <osg/ColorMask>
 #include <osg/ApplicationUsage>
@@ -24,6 +26,7 @@
 
 #include <algorithm>
 #include <iterator>
+#include <float.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -48,6 +51,7 @@ namespace osgUtil
 static osg::ApplicationUsageProxy ICO_e1(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MINIMUM_COMPILE_TIME_PER_FRAME <float>","minimum compile time alloted to compiling OpenGL objects per frame in database pager.");
 static osg::ApplicationUsageProxy UCO_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAXIMUM_OBJECTS_TO_COMPILE_PER_FRAME <int>","maximum number of OpenGL objects to compile per frame in database pager.");
 static osg::ApplicationUsageProxy UCO_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_FORCE_TEXTURE_DOWNLOAD <ON/OFF>","should the texture compiles be forced to download using a dummy Geometry.");
+static osg::ApplicationUsageProxy UCO_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAXIMUM_PROGRAMS_TO_COMPILE_PER_FRAME <int>","maximum number of shader programs to compile per frame in database pager.");
 
 /////////////////////////////////////////////////////////////////
 //
@@ -60,23 +64,91 @@ StateToCompile::StateToCompile(GLObjectsVisitor::Mode mode):
 {
 }
 
+void StateToCompile::pushStateSet(const osg::StateSet* stateset)
+{
+    ShaderAttributeMap attributes;
+    if (!_shaderAttributeStack.empty()) attributes = _shaderAttributeStack.back();
+
+    if (stateset)
+    {
+        const osg::StateSet::AttributeList& al = stateset->getAttributeList();
+        for(osg::StateSet::AttributeList::const_iterator itr = al.begin();
+            itr != al.end();
+            ++itr)
+        {
+            ShaderAttributeMap::iterator inherited = attributes.find(itr->first);
+            if (inherited != attributes.end())
+            {
+                // as osg::State::pushAttributeList(), an inherited OVERRIDE attribute wins unless this one is PROTECTED.
+                if ((inherited->second.second & osg::StateAttribute::OVERRIDE) && !(itr->second.second & osg::StateAttribute::PROTECTED)) continue;
+                inherited->second = itr->second;
+            }
+            else if (itr->second.first->getShaderComponent() || (itr->second.second & osg::StateAttribute::OVERRIDE))
+            {
+                attributes.insert(*itr);
+            }
+        }
+    }
+
+    _shaderAttributeStack.push_back(attributes);
+}
+
+void StateToCompile::popStateSet()
+{
+    if (!_shaderAttributeStack.empty()) _shaderAttributeStack.pop_back();
+}
+
+void StateToCompile::collectShaderComposition()
+{
+    if (_shaderAttributeStack.empty()) return;
+
+    // osg::State::applyShaderComposition() collects the ShaderComponents in the order of the attribute types and members.
+    osg::ShaderComponents shaderComponents;
+    const ShaderAttributeMap& attributes = _shaderAttributeStack.back();
+    for(ShaderAttributeMap::const_iterator itr = attributes.begin();
+        itr != attributes.end();
+        ++itr)
+    {
+        osg::ShaderComponent* sc = itr->second.first->getShaderComponent();
+        if (sc) shaderComponents.push_back(sc);
+    }
+
+    if (!shaderComponents.empty())
+    {
+        _shaderCompositions.insert(ShaderCompositionMap::value_type(osg::ShaderComposer::computeKey(shaderComponents), shaderComponents));
+    }
+}
+
 void StateToCompile::apply(osg::Node& node)
 {
+    bool pushedStateSet = false;
     if (node.getStateSet())
     {
         apply(*(node.getStateSet()));
+
+        if (_mode & GLObjectsVisitor::COMPILE_SHADER_COMPOSITIONS)
+        {
+            pushStateSet(node.getStateSet());
+            pushedStateSet = true;
+        }
     }
 
     traverse(node);
+
+    if (pushedStateSet) popStateSet();
 }
 
 void StateToCompile::apply(osg::Geode& node)
 {
+    bool collectShaderCompositions = (_mode & GLObjectsVisitor::COMPILE_SHADER_COMPOSITIONS)!=0;
+
     if (node.getStateSet())
     {
         apply(*(node.getStateSet()));
     }
 
+    if (collectShaderCompositions) pushStateSet(node.getStateSet());
+
     for(unsigned int i=0;i<node.getNumDrawables();++i)
     {
         osg::Drawable* drawable = node.getDrawable(i);
@@ -87,8 +159,17 @@ void StateToCompile::apply(osg::Geode& node)
             {
                 apply(*(drawable->getStateSet()));
             }
+
+            if (collectShaderCompositions)
+            {
+                pushStateSet(drawable->getStateSet());
+                collectShaderComposition();
+                popStateSet();
+            }
         }
     }
+
+    if (collectShaderCompositions) popStateSet();
 }
 
 void StateToCompile::apply(osg::Drawable& drawable)
@@ -287,6 +368,11 @@ IncrementalCompileOperation::CompileProgramOp::CompileProgramOp(osg::Program* pr
 {
 }
 
+bool IncrementalCompileOperation::CompileProgramOp::okToCompile(CompileInfo& compileInfo) const
+{
+    return compileInfo.okToCompileProgram();
+}
+
 double IncrementalCompileOperation::CompileProgramOp::estimatedTimeForCompile(CompileInfo& compileInfo) const
 {
     osg::GraphicsCostEstimator* gce = compileInfo.getState()->getGraphicsCostEstimator();
@@ -297,13 +383,64 @@ double IncrementalCompileOperation::CompileProgramOp::estimatedTimeForCompile(Co
 bool IncrementalCompileOperation::CompileProgramOp::compile(CompileInfo& compileInfo)
 {
     //OSG_NOTICE<<"CompileProgramOp::compile(..)"<<std::endl;
+    if (compileInfo.maxNumProgramsToCompile>0) --compileInfo.maxNumProgramsToCompile;
     _program->apply(*compileInfo.getState());
     return true;
 }
 
+IncrementalCompileOperation::CompileShaderCompositionOp::CompileShaderCompositionOp(const osg::ShaderComponents& shaderComponents):
+    _shaderComponents(shaderComponents),
+    _shaderComponentRefs(shaderComponents.begin(), shaderComponents.end())
+{
+}
+
+bool IncrementalCompileOperation::CompileShaderCompositionOp::okToCompile(CompileInfo& compileInfo) const
+{
+    return compileInfo.okToCompileProgram();
+}
+
+double IncrementalCompileOperation::CompileShaderCompositionOp::estimatedTimeForCompile(CompileInfo& /*compileInfo*/) const
+{
+    // the Program isn't composed until it's compiled so there is nothing to base an estimate on.
+    return 0.0;
+}
+
+// Return the ShaderComposer that the draw context of state's contextID composes Programs with. A compile context's
+// State has shader composition disabled and a ShaderComposer of its own, which the draw context never looks in, so
+// compile contexts use the ShaderComposer of a draw context sharing their contextID, and so their glPrograms.
+static osg::ref_ptr<osg::ShaderComposer> getDrawShaderComposer(osg::State* state)
+{
+    if (state->getShaderCompositionEnabled()) return state->getShaderComposer();
+
+    osg::GraphicsContext::GraphicsContexts contexts = osg::GraphicsContext::getRegisteredGraphicsContexts(state->getContextID());
+    for(osg::GraphicsContext::GraphicsContexts::iterator itr = contexts.begin();
+        itr != contexts.end();
+        ++itr)
+    {
+        osg::State* contextState = (*itr)->getState();
+        if (contextState && contextState!=state && contextState->getShaderCompositionEnabled()) return contextState->getShaderComposer();
+    }
+    return 0;
+}
+
+bool IncrementalCompileOperation::CompileShaderCompositionOp::compile(CompileInfo& compileInfo)
+{
+    osg::State* state = compileInfo.getState();
+    osg::ref_ptr<osg::ShaderComposer> shaderComposer = getDrawShaderComposer(state);
+    if (!shaderComposer) return true;
+
+    if (compileInfo.maxNumProgramsToCompile>0) --compileInfo.maxNumProgramsToCompile;
+
+    // the ShaderComposer keeps the Program, so osg::State finds it already linked when the combination is first drawn.
+    osg::Program* program = shaderComposer->getOrCreateProgram(_shaderComponents);
+    if (program) program->compileGLObjects(*state);
+    return true;
+}
+
 IncrementalCompileOperation::CompileInfo::CompileInfo(osg::GraphicsContext* context, IncrementalCompileOperation* ico):
     compileAll(false),
     maxNumObjectsToCompile(0),
+    maxNumProgramsToCompile(0),
     allocatedTime(0)
 {
     setState(context->getState());
@@ -348,6 +485,13 @@ bool IncrementalCompileOperation::CompileList::compile(CompileInfo& compileInfo)
         itr != _compileOps.end() && compileInfo.okToCompile();
     )
     {
+        // leave ops that are over the budget for their type of object for a later frame.
+        if (!(*itr)->okToCompile(compileInfo))
+        {
+            ++itr;
+            continue;
+        }
+
         #ifdef USE_TIME_ESTIMATES
         double estimatedCompileCost = (*itr)->estimatedTimeForCompile(compileInfo);
         #endif
@@ -413,6 +557,13 @@ void IncrementalCompileOperation::CompileSet::buildCompileMap(ContextSet& contex
         {
             cl.add(*pitr);
         }
+
+        for(StateToCompile::ShaderCompositionMap::iterator sitr = stc._shaderCompositions.begin();
+            sitr != stc._shaderCompositions.end();
+            ++sitr)
+        {
+            cl.add(sitr->second);
+        }
     }
 }
 
@@ -449,11 +600,13 @@ IncrementalCompileOperation::IncrementalCompileOperation():
     _flushTimeRatio(0.5),
     _conservativeTimeRatio(0.5),
     _currentFrameNumber(0),
-    _compileAllTillFrameNumber(0)
+    _compileAllTillFrameNumber(0),
+    _useCompileContexts(false)
 {
     _targetFrameRate = 100.0;
     _minimumTimeAvailableForGLCompileAndDeletePerFrame = 0.001; // 1ms.
     _maximumNumOfObjectsToCompilePerFrame = 20;
+    _maximumNumOfProgramsToCompilePerFrame = 4;
     const char* ptr = 0;
     if( (ptr = getenv("OSG_MINIMUM_COMPILE_TIME_PER_FRAME")) != 0)
     {
@@ -465,6 +618,11 @@ IncrementalCompileOperation::IncrementalCompileOperation():
         _maximumNumOfObjectsToCompilePerFrame = atoi(ptr);
     }
 
+    if( (ptr = getenv("OSG_MAXIMUM_PROGRAMS_TO_COMPILE_PER_FRAME")) != 0)
+    {
+        _maximumNumOfProgramsToCompilePerFrame = atoi(ptr);
+    }
+
     bool useForceTextureDownload = false;
     if( (ptr = getenv("OSG_FORCE_TEXTURE_DOWNLOAD")) != 0)
     {
@@ -535,8 +693,34 @@ void IncrementalCompileOperation::removeContexts(Contexts& contexts)
 }
 
 
+// return the compile context of gc if it has a graphics thread to run the IncrementalCompileOperation on.
+static osg::GraphicsContext* getCompileContextWithThread(osg::GraphicsContext* gc)
+{
+    if (!gc->getState()) return 0;
+
+    osg::GraphicsContext* compileContext = osg::GraphicsContext::getCompileContext(gc->getState()->getContextID());
+    if (compileContext && compileContext!=gc && compileContext->getGraphicsThread()) return compileContext;
+    else return 0;
+}
+
 void IncrementalCompileOperation::addGraphicsContext(osg::GraphicsContext* gc)
 {
+    osg::GraphicsContext* compileContext = _useCompileContexts ? getCompileContextWithThread(gc) : 0;
+    if (compileContext)
+    {
+        if (_contexts.count(compileContext)==0)
+        {
+            _compileSyncsMap[compileContext];
+            _compileContexts.insert(compileContext);
+            _contexts.insert(compileContext);
+            compileContext->getGraphicsThread()->add(this);
+
+            // the draw threads now lock the GL object managers they share with the compile context.
+            osg::GLObjectsMutex::getGLObjectsMutex(compileContext->getState()->getContextID())->addCompileContext();
+        }
+        return;
+    }
+
     if (_contexts.count(gc)==0)
     {
         gc->add(this);
@@ -546,6 +730,17 @@ void IncrementalCompileOperation::addGraphicsContext(osg::GraphicsContext* gc)
 
 void IncrementalCompileOperation::removeGraphicsContext(osg::GraphicsContext* gc)
 {
+    osg::GraphicsContext* compileContext = getCompileContextWithThread(gc);
+    if (compileContext && _compileContexts.count(compileContext)!=0)
+    {
+        compileContext->getGraphicsThread()->remove(this);
+        _compileContexts.erase(compileContext);
+        _contexts.erase(compileContext);
+
+        osg::GLObjectsMutex::getGLObjectsMutex(compileContext->getState()->getContextID())->removeCompileContext();
+        return;
+    }
+
     if (_contexts.count(gc)!=0)
     {
         gc->remove(this);
@@ -586,8 +781,13 @@ void IncrementalCompileOperation::add(CompileSet* compileSet, bool callBuildComp
 
     OSG_INFO<<"IncrementalCompileOperation::add(CompileSet = "<<compileSet<<", "<<", "<<callBuildCompileMap<<")"<<std::endl;
 
-    OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
-    _toCompile.push_back(compileSet);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex>  lock(_toCompileMutex);
+        _toCompile.push_back(compileSet);
+    }
+
+    // wake up the compile context threads waiting for something to compile.
+    if (!_compileContexts.empty()) _compileContextsBlock.release();
 }
 
 void IncrementalCompileOperation::remove(CompileSet* compileSet)
@@ -654,6 +854,12 @@ void IncrementalCompileOperation::mergeCompiledSubgraphs(const osg::FrameStamp*
 
 void IncrementalCompileOperation::operator () (osg::GraphicsContext* context)
 {
+    if (_compileContexts.count(context)!=0)
+    {
+        compileOnCompileContext(context);
+        return;
+    }
+
     osg::NotifySeverity level = osg::INFO;
 
     //glFinish();
@@ -692,6 +898,7 @@ void IncrementalCompileOperation::operator () (osg::GraphicsContext* context)
 
     CompileInfo compileInfo(context, this);
     compileInfo.maxNumObjectsToCompile = _maximumNumOfObjectsToCompilePerFrame;
+    compileInfo.maxNumProgramsToCompile = _maximumNumOfProgramsToCompilePerFrame>0 ? _maximumNumOfProgramsToCompilePerFrame : _maximumNumOfObjectsToCompilePerFrame;
     compileInfo.allocatedTime = compileTime;
     compileInfo.compileAll = (_compileAllTillFrameNumber > _currentFrameNumber);
 
@@ -726,8 +933,6 @@ void IncrementalCompileOperation::operator () (osg::GraphicsContext* context)
 
 void IncrementalCompileOperation::compileSets(CompileSets& toCompile, CompileInfo& compileInfo)
 {
-    osg::NotifySeverity level = osg::INFO;
-
     for(CompileSets::iterator itr = toCompile.begin();
         itr != toCompile.end() && compileInfo.okToCompile();
         )
@@ -735,28 +940,7 @@ void IncrementalCompileOperation::compileSets(CompileSets& toCompile, CompileInf
         CompileSet* cs = itr->get();
         if (cs->compile(compileInfo))
         {
-            {
-                OpenThreads::ScopedLock<OpenThreads::Mutex>  toCompile_lock(_toCompileMutex);
-
-                CompileSets::iterator cs_itr = std::find(_toCompile.begin(), _toCompile.end(), *itr);
-                if (cs_itr != _toCompile.end())
-                {
-                    OSG_NOTIFY(level)<<"    Erasing from list"<<std::endl;
-
-                    // remove from the _toCompile list, note cs won't be deleted here as the tempoary
-                    // toCompile_Copy list will retain a reference.
-                    _toCompile.erase(cs_itr);
-                }
-            }
-            if (cs->_compileCompletedCallback.valid() && cs->_compileCompletedCallback->compileCompleted(cs))
-            {
-                // callback will handle merging of subgraph so no need to place CompileSet in merge.
-            }
-            else
-            {
-                OpenThreads::ScopedLock<OpenThreads::Mutex>  compilded_lock(_compiledMutex);
-                _compiled.push_back(cs);
-            }
+            compileSetCompleted(cs);
 
             // remove entry from list.
             itr = toCompile.erase(itr);
@@ -770,6 +954,124 @@ void IncrementalCompileOperation::compileSets(CompileSets& toCompile, CompileInf
 }
 
 
+void IncrementalCompileOperation::compileSetCompleted(CompileSet* cs)
+{
+    osg::NotifySeverity level = osg::INFO;
+
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex>  toCompile_lock(_toCompileMutex);
+
+        // a CompileSet that has been removed, or already completed by another context, isn't merged.
+        CompileSets::iterator cs_itr = std::find(_toCompile.begin(), _toCompile.end(), cs);
+        if (cs_itr == _toCompile.end()) return;
+
+        OSG_NOTIFY(level)<<"    Erasing from list"<<std::endl;
+
+        // remove from the _toCompile list, note cs won't be deleted here as the caller's
+        // copy of the list will retain a reference.
+        _toCompile.erase(cs_itr);
+    }
+
+    if (cs->_compileCompletedCallback.valid() && cs->_compileCompletedCallback->compileCompleted(cs))
+    {
+        // callback will handle merging of subgraph so no need to place CompileSet in merge.
+    }
+    else
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex>  compilded_lock(_compiledMutex);
+        _compiled.push_back(cs);
+    }
+}
+
+void IncrementalCompileOperation::compileListsCompleted(CompileSets& compileSets)
+{
+    for(CompileSets::iterator itr = compileSets.begin();
+        itr != compileSets.end();
+        ++itr)
+    {
+        CompileSet* cs = itr->get();
+        if (--(cs->_numberCompileListsToCompile)==0)
+        {
+            compileSetCompleted(cs);
+        }
+    }
+}
+
+void IncrementalCompileOperation::compileOnCompileContext(osg::GraphicsContext* context)
+{
+    // reset before looking for work, so that a CompileSet added while compiling releases the block below.
+    _compileContextsBlock.reset();
+
+    osg::State* state = context->getState();
+    osg::GLBufferObject::Extensions* extensions = osg::GLBufferObject::getExtensions(state->getContextID(), true);
+
+    // the compile context doesn't draw so has no frame time to fit within, only the number of objects compiled
+    // between fences is limited so the CompileSets completed are merged promptly.
+    CompileInfo compileInfo(context, this);
+    compileInfo.maxNumObjectsToCompile = _maximumNumOfObjectsToCompilePerFrame;
+    compileInfo.maxNumProgramsToCompile = _maximumNumOfProgramsToCompilePerFrame>0 ? _maximumNumOfProgramsToCompilePerFrame : _maximumNumOfObjectsToCompilePerFrame;
+    compileInfo.allocatedTime = DBL_MAX;
+
+    CompileSets toCompileCopy;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex>  toCompile_lock(_toCompileMutex);
+        std::copy(_toCompile.begin(),_toCompile.end(),std::back_inserter<CompileSets>(toCompileCopy));
+    }
+
+    CompileSets compiledSets;
+    for(CompileSets::iterator itr = toCompileCopy.begin();
+        itr != toCompileCopy.end() && compileInfo.okToCompile();
+        ++itr)
+    {
+        CompileSet* cs = itr->get();
+        CompileSet::CompileMap::iterator cl_itr = cs->_compileMap.find(context);
+        if (cl_itr == cs->_compileMap.end() || cl_itr->second.empty()) continue;
+
+        if (cl_itr->second.compile(compileInfo))
+        {
+            compiledSets.push_back(cs);
+        }
+    }
+
+    bool idle = compileInfo.maxNumObjectsToCompile==_maximumNumOfObjectsToCompilePerFrame;
+
+    CompileSyncs& compileSyncs = _compileSyncsMap[context];
+    if (!compiledSets.empty())
+    {
+        if (extensions->isSyncSupported())
+        {
+            GLsync fence = extensions->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            compileSyncs.push_back(CompileSync(fence, compiledSets));
+        }
+        else
+        {
+            // without sync objects wait for the GPU to complete the downloads before the draw threads can use them.
+            glFinish();
+            compileListsCompleted(compiledSets);
+        }
+    }
+
+    // merge the CompileSets the GPU has completed, waiting on the oldest fence when there is nothing left to compile.
+    const GLuint64 tenMilliseconds = 10000000;
+    while(!compileSyncs.empty())
+    {
+        CompileSync& compileSync = compileSyncs.front();
+        GLenum result = extensions->glClientWaitSync(compileSync.fence, GL_SYNC_FLUSH_COMMANDS_BIT, idle ? tenMilliseconds : 0);
+        if (result==GL_TIMEOUT_EXPIRED) break;
+
+        extensions->glDeleteSync(compileSync.fence);
+        compileListsCompleted(compileSync.compileSets);
+        compileSyncs.pop_front();
+    }
+
+    // wait for more CompileSets, with a timeout so the graphics thread can still be stopped.
+    if (idle && compileSyncs.empty())
+    {
+        _compileContextsBlock.block(100);
+    }
+}
+
 void IncrementalCompileOperation::compileAllForNextFrame(unsigned int numFramesToDoCompileAll)
 {
     _compileAllTillFrameNumber = _currentFrameNumber+numFramesToDoCompileAll;
@@ -48,6 +48,58 @@ void GeometryCollector::apply(Geode& geode)
     }
 }
 
+namespace
+{
+// Calls a GeometryCollector member function on each Geometry from the
+// threads of an Optimizer::PassScheduler.
+template<class V>
+struct GeometryPassOperation : public Optimizer::PassScheduler::Operation
+{
+    typedef void (V::*Function)(osg::Geometry&);
+
+    GeometryPassOperation(V& visitor, Function function)
+        : _visitor(visitor), _function(function)
+    {
+    }
+
+    virtual void operator()(osg::Object& object)
+    {
+        (_visitor.*_function)(static_cast<osg::Geometry&>(object));
+    }
+
+    V& _visitor;
+    Function _function;
+};
+
+// Apply function to every Geometry in the list, in parallel when the
+// visitor has more than one thread.
+template<class V>
+void runGeometryPass(V& visitor, GeometryCollector::GeometryList& geometryList,
+                     void (V::*function)(osg::Geometry&))
+{
+    if (visitor.getNumThreads() > 1 && geometryList.size() > 1)
+    {
+        Optimizer::PassScheduler scheduler(visitor.getNumThreads());
+        for (GeometryCollector::GeometryList::iterator itr = geometryList.begin(), end = geometryList.end();
+             itr != end;
+             ++itr)
+        {
+            scheduler.add(*itr);
+        }
+        GeometryPassOperation<V> operation(visitor, function);
+        scheduler.run(operation);
+        return;
+    }
+
+    for (GeometryCollector::GeometryList::iterator itr = geometryList.begin(), end = geometryList.end();
+         itr != end;
+         ++itr)
+    {
+        (visitor.*function)(*(*itr));
+    }
+}
+}
+
 namespace
 {
 typedef std::vector<unsigned int> IndexList;
@@ -399,12 +451,7 @@ void IndexMeshVisitor::makeMesh(Geometry& geom)
 
 void IndexMeshVisitor::makeMesh()
 {
-    for(GeometryList::iterator itr=_geometryList.begin();
-        itr!=_geometryList.end();
-        ++itr)
-    {
-        makeMesh(*(*itr));
-    }
+    runGeometryPass(*this, _geometryList, &IndexMeshVisitor::makeMesh);
 }
 
 namespace
@@ -876,12 +923,7 @@ void VertexCacheVisitor::doVertexOptimization(Geometry& geom,
 
 void VertexCacheVisitor::optimizeVertices()
 {
-    for(GeometryList::iterator itr=_geometryList.begin();
-        itr!=_geometryList.end();
-        ++itr)
-    {
-        optimizeVertices(*(*itr));
-    }
+    runGeometryPass(*this, _geometryList, &VertexCacheVisitor::optimizeVertices);
 }
 
 VertexCacheMissVisitor::VertexCacheMissVisitor(unsigned cacheSize)
@@ -1098,12 +1140,7 @@ struct VertexReorder : public TriangleIndexFunctor<VertexReorderOperator>
 
 void VertexAccessOrderVisitor::optimizeOrder()
 {
-    for (GeometryList::iterator itr = _geometryList.begin(), end = _geometryList.end();
-         itr != end;
-         ++itr)
-    {
-        optimizeOrder(*(*itr));
-    }
+    runGeometryPass(*this, _geometryList, &VertexAccessOrderVisitor::optimizeOrder);
 }
 
 template<typename DE>
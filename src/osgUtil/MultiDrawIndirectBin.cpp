@@ -0,0 +1,814 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osgUtil/MultiDrawIndirectBin>
+
+#include <osg/Geometry>
+#include <osg/BufferObject>
+#include <osg/observer_ptr>
+#include <osg/buffered_value>
+#include <osg/Notify>
+
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <map>
+
+using namespace osg;
+using namespace osgUtil;
+
+namespace
+{
+
+enum VertexLayout
+{
+    LAYOUT_NORMALS = 0x1,
+    LAYOUT_TEXCOORDS = 0x2
+};
+
+const osg::DrawElements* getBatchableElements(const osg::Geometry* geometry)
+{
+    if (geometry->getPrimitiveSetList().size()!=1) return 0;
+
+    const osg::DrawElements* de = geometry->getPrimitiveSet(0)->getDrawElements();
+    if (!de || de->getMode()!=GL_TRIANGLES || de->getNumInstances()!=0 || de->getNumIndices()==0) return 0;
+
+    switch(de->getType())
+    {
+        case(osg::PrimitiveSet::DrawElementsUShortPrimitiveType):
+        case(osg::PrimitiveSet::DrawElementsUIntPrimitiveType):
+            return de;
+        default:
+            return 0;
+    }
+}
+
+unsigned int getVertexLayout(const osg::Geometry* geometry)
+{
+    unsigned int layout = 0;
+    if (geometry->getNormalArray()) layout |= LAYOUT_NORMALS;
+    if (geometry->getTexCoordArray(0)) layout |= LAYOUT_TEXCOORDS;
+    return layout;
+}
+
+/** Apply the projection, modelview and StateSet of leaf in the same way as RenderLeaf::render does.*/
+void applyLeafState(osg::State& state, RenderLeaf* leaf, RenderLeaf* previous)
+{
+    state.applyProjectionMatrix(leaf->_projection.get());
+    state.applyModelViewMatrix(leaf->_modelview.get());
+
+    StateGraph* rg = leaf->_parent;
+    if (previous)
+    {
+        StateGraph* prev_rg = previous->_parent;
+        StateGraph* prev_rg_parent = prev_rg->_parent;
+        if (prev_rg_parent!=rg->_parent)
+        {
+            StateGraph::moveStateGraph(state,prev_rg_parent,rg->_parent);
+            state.apply(rg->getStateSet());
+        }
+        else if (rg!=prev_rg)
+        {
+            state.apply(rg->getStateSet());
+        }
+    }
+    else
+    {
+        StateGraph::moveStateGraph(state,NULL,rg->_parent);
+        state.apply(rg->getStateSet());
+    }
+
+    if (state.getUseModelViewAndProjectionUniforms()) state.applyModelViewAndProjectionUniformsIfRequired();
+}
+
+/** Geometry data of all batched Geometry with the same vertex layout, packed into one vertex buffer object
+  * and one element buffer object, along with the per context buffers used to pass draw commands. The pool observes each Geometry it holds, so the space of deleted Geometry is
+  * reclaimed when the pool is next compacted.*/
+class GeometryPool : public osg::Referenced, public osg::Observer
+{
+    public:
+
+        GeometryPool(unsigned int layout):
+            _numVertices(0),
+            _numIndices(0),
+            _numLiveVertices(0)
+        {
+            _vbo = new osg::VertexBufferObject;
+            _vbo->setUsage(GL_STATIC_DRAW_ARB);
+
+            _vertices = new osg::Vec3Array;
+            _vertices->setVertexBufferObject(_vbo.get());
+
+            if (layout & LAYOUT_NORMALS)
+            {
+                _normals = new osg::Vec3Array;
+                _normals->setBinding(osg::Array::BIND_PER_VERTEX);
+                _normals->setVertexBufferObject(_vbo.get());
+            }
+
+            if (layout & LAYOUT_TEXCOORDS)
+            {
+                _texcoords = new osg::Vec2Array;
+                _texcoords->setBinding(osg::Array::BIND_PER_VERTEX);
+                _texcoords->setVertexBufferObject(_vbo.get());
+            }
+
+            _indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+            _indices->setElementBufferObject(new osg::ElementBufferObject);
+        }
+
+        struct Entry
+        {
+            Entry():
+                vertices(0),
+                elements(0),
+                modifiedCount(0),
+                firstIndex(0),
+                count(0),
+                baseVertex(0),
+                numVertices(0) {}
+
+            osg::observer_ptr<const osg::Geometry>  geometry;
+            const osg::Array*                       vertices;
+            const osg::DrawElements*                elements;
+            unsigned int                            modifiedCount;
+            unsigned int                            firstIndex;
+            unsigned int                            count;
+            unsigned int                            baseVertex;
+            unsigned int                            numVertices;
+        };
+
+        struct DrawBuffers
+        {
+            DrawBuffers():
+                numUploadedVertices(0),
+                numUploadedIndices(0) {}
+
+            osg::ref_ptr<osg::UIntArray>    commands;
+            unsigned int                    numUploadedVertices;
+            unsigned int                    numUploadedIndices;
+        };
+
+        typedef std::map<const osg::Geometry*, Entry> EntryMap;
+        typedef std::vector<void*> DeletedList;
+
+        OpenThreads::Mutex                      _mutex;
+        EntryMap                                _entries;
+
+        // the arrays are kept at their capacity, only the first _numVertices and _numIndices elements are in use.
+        unsigned int                            _numVertices;
+        unsigned int                            _numIndices;
+        unsigned int                            _numLiveVertices;
+
+        OpenThreads::Mutex                      _deletedMutex;
+        DeletedList                             _deleted;
+
+        osg::ref_ptr<osg::VertexBufferObject>   _vbo;
+        osg::ref_ptr<osg::Vec3Array>            _vertices;
+        osg::ref_ptr<osg::Vec3Array>            _normals;
+        osg::ref_ptr<osg::Vec2Array>            _texcoords;
+        osg::ref_ptr<osg::DrawElementsUInt>     _indices;
+
+        osg::buffered_object<DrawBuffers>       _drawBuffers;
+
+        static unsigned int computeModifiedCount(const osg::Geometry* geometry, const osg::DrawElements* de)
+        {
+            unsigned int modifiedCount = geometry->getVertexArray()->getModifiedCount() + de->getModifiedCount();
+            if (geometry->getNormalArray()) modifiedCount += geometry->getNormalArray()->getModifiedCount();
+            if (geometry->getTexCoordArray(0)) modifiedCount += geometry->getTexCoordArray(0)->getModifiedCount();
+            return modifiedCount;
+        }
+
+        /** Called from whichever thread deletes an observed Geometry, the entry is removed on the next getEntry().*/
+        virtual void objectDeleted(void* ptr)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_deletedMutex);
+            _deleted.push_back(ptr);
+        }
+
+        /** Remove the entries of deleted Geometry so that their space counts towards compaction.*/
+        void removeDeletedEntries()
+        {
+            DeletedList deleted;
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_deletedMutex);
+                deleted.swap(_deleted);
+            }
+
+            for(DeletedList::iterator itr = deleted.begin();
+                itr != deleted.end();
+                ++itr)
+            {
+                // a new Geometry may since have been added at the same address.
+                EntryMap::iterator eitr = _entries.find(static_cast<const osg::Geometry*>(*itr));
+                if (eitr!=_entries.end() && !eitr->second.geometry.valid())
+                {
+                    _numLiveVertices -= eitr->second.numVertices;
+                    _entries.erase(eitr);
+                }
+            }
+        }
+
+        /** Return the up to date entry for geometry, appending its data to the pool if it is new or has been modified.*/
+        const Entry& getEntry(const osg::Geometry* geometry)
+        {
+            removeDeletedEntries();
+
+            const osg::DrawElements* de = getBatchableElements(geometry);
+            unsigned int modifiedCount = computeModifiedCount(geometry, de);
+
+            EntryMap::iterator itr = _entries.find(geometry);
+            if (itr!=_entries.end())
+            {
+                Entry& entry = itr->second;
+                if (entry.geometry.valid() &&
+                    entry.vertices==geometry->getVertexArray() &&
+                    entry.numVertices==geometry->getVertexArray()->getNumElements() &&
+                    entry.elements==de &&
+                    entry.modifiedCount==modifiedCount)
+                {
+                    return entry;
+                }
+
+                // stale entry, its space is reclaimed the next time the pool is compacted.
+                _numLiveVertices -= entry.numVertices;
+                _entries.erase(itr);
+            }
+
+            if (_numVertices > 2*_numLiveVertices+1024) compact();
+
+            // observers are held in a set, so adding a modified Geometry again is harmless.
+            geometry->addObserver(this);
+
+            Entry& entry = _entries[geometry];
+            entry.geometry = geometry;
+            entry.vertices = geometry->getVertexArray();
+            entry.elements = de;
+            entry.modifiedCount = modifiedCount;
+            append(entry);
+            return entry;
+        }
+
+        /** Grow the arrays to hold at least numVertices and numIndices, doubling their capacity so that appends rarely
+          * need the buffer objects to be reallocated and uploaded in full.*/
+        void reserve(unsigned int numVertices, unsigned int numIndices)
+        {
+            if (numVertices>_vertices->size())
+            {
+                unsigned int capacity = osg::maximum(numVertices, static_cast<unsigned int>(_vertices->size())*2);
+                _vertices->resize(capacity);
+                _vertices->dirty();
+                if (_normals.valid()) { _normals->resize(capacity); _normals->dirty(); }
+                if (_texcoords.valid()) { _texcoords->resize(capacity); _texcoords->dirty(); }
+            }
+
+            if (numIndices>_indices->size())
+            {
+                _indices->resize(osg::maximum(numIndices, static_cast<unsigned int>(_indices->size())*2));
+                _indices->dirty();
+            }
+        }
+
+        void append(Entry& entry)
+        {
+            const osg::Geometry* geometry = entry.geometry.get();
+            const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+
+            entry.baseVertex = _numVertices;
+            entry.numVertices = vertices->size();
+            entry.firstIndex = _numIndices;
+            entry.count = entry.elements->getNumIndices();
+
+            for(unsigned int i=0; i<entry.count; ++i)
+            {
+                if (entry.elements->index(i)>=entry.numVertices)
+                {
+                    OSG_NOTICE<<"Warning: MultiDrawIndirectBin Geometry \""<<geometry->getName()<<"\" indexes beyond its vertex array, not drawing it."<<std::endl;
+                    entry.count = 0;
+                    break;
+                }
+            }
+
+            reserve(_numVertices+entry.numVertices, _numIndices+entry.count);
+
+            std::copy(vertices->begin(), vertices->end(), _vertices->begin()+_numVertices);
+
+            if (_normals.valid())
+            {
+                const osg::Vec3Array* normals = static_cast<const osg::Vec3Array*>(geometry->getNormalArray());
+                std::copy(normals->begin(), normals->end(), _normals->begin()+_numVertices);
+            }
+
+            if (_texcoords.valid())
+            {
+                const osg::Vec2Array* texcoords = static_cast<const osg::Vec2Array*>(geometry->getTexCoordArray(0));
+                std::copy(texcoords->begin(), texcoords->end(), _texcoords->begin()+_numVertices);
+            }
+
+            for(unsigned int i=0; i<entry.count; ++i)
+            {
+                (*_indices)[_numIndices+i] = entry.elements->index(i);
+            }
+
+            _numVertices += entry.numVertices;
+            _numIndices += entry.count;
+            _numLiveVertices += entry.numVertices;
+        }
+
+        /** Remove the data of deleted or modified Geometry from the pool.*/
+        void compact()
+        {
+            _numVertices = 0;
+            _numIndices = 0;
+            _numLiveVertices = 0;
+
+            for(EntryMap::iterator itr = _entries.begin();
+                itr != _entries.end();)
+            {
+                if (itr->second.geometry.valid())
+                {
+                    append(itr->second);
+                    ++itr;
+                }
+                else
+                {
+                    _entries.erase(itr++);
+                }
+            }
+
+            _vertices->dirty();
+            if (_normals.valid()) _normals->dirty();
+            if (_texcoords.valid()) _texcoords->dirty();
+            _indices->dirty();
+        }
+
+        /** Upload the data appended since the last upload to contextID, or everything if the buffer objects need recompiling,
+          * leaving the vertex and element buffer objects bound.*/
+        void upload(osg::State& state)
+        {
+            unsigned int contextID = state.getContextID();
+            GLBufferObject::Extensions* extensions = GLBufferObject::getExtensions(contextID,true);
+            DrawBuffers& drawBuffers = getDrawBuffers(contextID);
+
+            GLBufferObject* vbo = _vertices->getOrCreateGLBufferObject(contextID);
+            if (vbo->isDirty())
+            {
+                vbo->compileBuffer();
+                drawBuffers.numUploadedVertices = _numVertices;
+            }
+            state.bindVertexBufferObject(vbo);
+
+            if (drawBuffers.numUploadedVertices<_numVertices)
+            {
+                unsigned int first = drawBuffers.numUploadedVertices;
+                unsigned int num = _numVertices-first;
+                uploadRange(extensions, GL_ARRAY_BUFFER_ARB, vbo, _vertices.get(), first, num);
+                if (_normals.valid()) uploadRange(extensions, GL_ARRAY_BUFFER_ARB, vbo, _normals.get(), first, num);
+                if (_texcoords.valid()) uploadRange(extensions, GL_ARRAY_BUFFER_ARB, vbo, _texcoords.get(), first, num);
+            }
+            drawBuffers.numUploadedVertices = _numVertices;
+
+            GLBufferObject* ebo = _indices->getOrCreateGLBufferObject(contextID);
+            if (ebo->isDirty())
+            {
+                ebo->compileBuffer();
+                drawBuffers.numUploadedIndices = _numIndices;
+            }
+            state.bindElementBufferObject(ebo);
+
+            if (drawBuffers.numUploadedIndices<_numIndices)
+            {
+                unsigned int first = drawBuffers.numUploadedIndices;
+                extensions->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER_ARB,
+                                            (GLintptrARB)(ebo->getOffset(_indices->getBufferIndex()) + first*sizeof(GLuint)),
+                                            (GLsizeiptrARB)((_numIndices-first)*sizeof(GLuint)),
+                                            &((*_indices)[first]));
+            }
+            drawBuffers.numUploadedIndices = _numIndices;
+        }
+
+        static void uploadRange(GLBufferObject::Extensions* extensions, GLenum target, GLBufferObject* bo, const osg::Array* array, unsigned int first, unsigned int num)
+        {
+            unsigned int elementSize = array->getElementSize();
+            extensions->glBufferSubData(target,
+                                        (GLintptrARB)(bo->getOffset(array->getBufferIndex()) + first*elementSize),
+                                        (GLsizeiptrARB)(num*elementSize),
+                                        static_cast<const char*>(array->getDataPointer()) + first*elementSize);
+        }
+
+        DrawBuffers& getDrawBuffers(unsigned int contextID)
+        {
+            DrawBuffers& drawBuffers = _drawBuffers[contextID];
+            if (!drawBuffers.commands)
+            {
+                drawBuffers.commands = new osg::UIntArray;
+                drawBuffers.commands->setBufferObject(new osg::DrawIndirectBufferObject);
+            }
+            return drawBuffers;
+        }
+
+    protected:
+
+        virtual ~GeometryPool()
+        {
+            for(EntryMap::iterator itr = _entries.begin();
+                itr != _entries.end();
+                ++itr)
+            {
+                osg::ref_ptr<const osg::Geometry> geometry;
+                if (itr->second.geometry.lock(geometry)) geometry->removeObserver(this);
+            }
+        }
+};
+
+}
+
+/** The GeometryPool for each vertex layout, shared between a MultiDrawIndirectBin prototype and all of its clones.*/
+class MultiDrawIndirectBin::GeometryPools : public osg::Referenced
+{
+    public:
+
+        GeometryPool* getGeometryPool(unsigned int layout)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            osg::ref_ptr<GeometryPool>& pool = _pools[layout];
+            if (!pool) pool = new GeometryPool(layout);
+            return pool.get();
+        }
+
+        /** Return the buffer of modelview matrices of the leaves of the bin being drawn on contextID.*/
+        osg::FloatArray* getLeafMatrices(unsigned int contextID)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+            osg::ref_ptr<osg::FloatArray>& matrices = _leafMatrices[contextID];
+            if (!matrices)
+            {
+                matrices = new osg::FloatArray;
+                matrices->setBufferObject(new osg::ShaderStorageBufferObject);
+            }
+            return matrices.get();
+        }
+
+    protected:
+
+        virtual ~GeometryPools() {}
+
+        typedef std::map< unsigned int, osg::ref_ptr<GeometryPool> > PoolMap;
+
+        OpenThreads::Mutex                                  _mutex;
+        PoolMap                                             _pools;
+        osg::buffered_object< osg::ref_ptr<osg::FloatArray> > _leafMatrices;
+};
+
+MultiDrawIndirectBin::MultiDrawIndirectBin():
+    _modelViewMatrixBinding(0),
+    _minimumBatchSize(2),
+    _geometryPools(new GeometryPools)
+{
+}
+
+MultiDrawIndirectBin::MultiDrawIndirectBin(SortMode mode):
+    RenderBin(mode),
+    _modelViewMatrixBinding(0),
+    _minimumBatchSize(2),
+    _geometryPools(new GeometryPools)
+{
+}
+
+MultiDrawIndirectBin::MultiDrawIndirectBin(const MultiDrawIndirectBin& rhs,const CopyOp& copyop):
+    RenderBin(rhs,copyop),
+    _modelViewMatrixBinding(rhs._modelViewMatrixBinding),
+    _minimumBatchSize(rhs._minimumBatchSize),
+    _geometryPools(rhs._geometryPools)
+{
+}
+
+MultiDrawIndirectBin::~MultiDrawIndirectBin()
+{
+}
+
+bool MultiDrawIndirectBin::isSupported(unsigned int contextID)
+{
+    GLBufferObject::Extensions* extensions = GLBufferObject::getExtensions(contextID,true);
+    return extensions->isBufferObjectSupported() &&
+           extensions->isMultiDrawIndirectSupported() &&
+           extensions->isShaderStorageBufferObjectSupported() &&
+           extensions->isShaderDrawParametersSupported();
+}
+
+bool MultiDrawIndirectBin::isBatchable(const RenderLeaf* leaf)
+{
+    const osg::Geometry* geometry = leaf->_drawable->asGeometry();
+    if (!geometry || geometry->getDrawCallback() || geometry->containsDeprecatedData()) return false;
+
+    const osg::Array* vertices = geometry->getVertexArray();
+    if (!vertices || vertices->getType()!=osg::Array::Vec3ArrayType || vertices->getNumElements()==0) return false;
+
+    const osg::Array* normals = geometry->getNormalArray();
+    if (normals && (normals->getType()!=osg::Array::Vec3ArrayType ||
+                    normals->getBinding()!=osg::Array::BIND_PER_VERTEX ||
+                    normals->getNumElements()!=vertices->getNumElements())) return false;
+
+    const osg::Array* texcoords = geometry->getTexCoordArray(0);
+    if (texcoords && (texcoords->getType()!=osg::Array::Vec2ArrayType ||
+                      texcoords->getNumElements()!=vertices->getNumElements())) return false;
+
+    if (geometry->getColorArray() || geometry->getSecondaryColorArray() || geometry->getFogCoordArray() ||
+        geometry->getNumTexCoordArrays()>1 || !geometry->getVertexAttribArrayList().empty()) return false;
+
+    return getBatchableElements(geometry)!=0;
+}
+
+void MultiDrawIndirectBin::drawImplementation(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
+{
+    osg::State& state = *renderInfo.getState();
+
+    unsigned int numToPop = (previous ? StateGraph::numToPop(previous->_parent) : 0);
+    if (numToPop>1) --numToPop;
+    unsigned int insertStateSetPosition = state.getStateSetStackSize() - numToPop;
+
+    if (_stateset.valid())
+    {
+        state.insertStateSet(insertStateSetPosition, _stateset.get());
+    }
+
+    // draw first set of draw bins.
+    RenderBinList::iterator rbitr;
+    for(rbitr = _bins.begin();
+        rbitr!=_bins.end() && rbitr->first<0;
+        ++rbitr)
+    {
+        rbitr->second->draw(renderInfo,previous);
+    }
+
+    if (isSupported(state.getContextID()) && state.isVertexBufferObjectSupported())
+    {
+        // the fine grained ordering is drawn first and leaf by leaf, followed by the coarse grained ordering, as a RenderBin does.
+        RenderLeafList leaves(_renderLeafList);
+        LeafRuns runs;
+        if (!leaves.empty())
+        {
+            runs.push_back(LeafRun(0, 0, false));
+            runs.back().count = leaves.size();
+        }
+
+        for(StateGraphList::iterator oitr=_stateGraphList.begin();
+            oitr!=_stateGraphList.end();
+            ++oitr)
+        {
+            addLeafRuns(*oitr, leaves, runs);
+        }
+
+        drawLeafRuns(renderInfo, leaves, runs, previous);
+    }
+    else
+    {
+        // draw fine grained ordering.
+        for(RenderLeafList::iterator rlitr= _renderLeafList.begin();
+            rlitr!= _renderLeafList.end();
+            ++rlitr)
+        {
+            RenderLeaf* rl = *rlitr;
+            rl->render(renderInfo,previous);
+            previous = rl;
+        }
+
+        // draw coarse grained ordering.
+        for(StateGraphList::iterator oitr=_stateGraphList.begin();
+            oitr!=_stateGraphList.end();
+            ++oitr)
+        {
+            for(StateGraph::LeafList::iterator dw_itr = (*oitr)->_leaves.begin();
+                dw_itr != (*oitr)->_leaves.end();
+                ++dw_itr)
+            {
+                RenderLeaf* rl = dw_itr->get();
+                rl->render(renderInfo,previous);
+                previous = rl;
+            }
+        }
+    }
+
+    // draw post bins.
+    for(;
+        rbitr!=_bins.end();
+        ++rbitr)
+    {
+        rbitr->second->draw(renderInfo,previous);
+    }
+
+    if (_stateset.valid())
+    {
+        state.removeStateSet(insertStateSetPosition);
+    }
+}
+
+void MultiDrawIndirectBin::addLeafRuns(StateGraph* sg, RenderLeafList& leaves, LeafRuns& runs) const
+{
+    // batches never span StateGraphs, as the StateSet is only applied for the first leaf of a batch.
+    unsigned int firstRun = runs.size();
+
+    for(StateGraph::LeafList::iterator dw_itr = sg->_leaves.begin();
+        dw_itr != sg->_leaves.end();
+        ++dw_itr)
+    {
+        RenderLeaf* rl = dw_itr->get();
+        bool batchable = isBatchable(rl);
+        unsigned int layout = batchable ? getVertexLayout(rl->_drawable->asGeometry()) : 0;
+
+        LeafRun* run = runs.empty() ? 0 : &runs.back();
+        bool extendRun = false;
+        if (run && batchable && run->batched && runs.size()>firstRun && run->layout==layout)
+        {
+            const osg::RefMatrix* runProjection = leaves[run->first]->_projection.get();
+            const osg::RefMatrix* projection = rl->_projection.get();
+            extendRun = runProjection==projection || (runProjection && projection && *runProjection==*projection);
+        }
+        else if (run && !batchable && !run->batched)
+        {
+            extendRun = true;
+        }
+
+        if (extendRun) ++(run->count);
+        else runs.push_back(LeafRun(leaves.size(), layout, batchable));
+
+        leaves.push_back(rl);
+    }
+
+    // batches too small to be worth a multi draw call are drawn leaf by leaf.
+    for(LeafRuns::iterator ritr = runs.begin()+firstRun;
+        ritr != runs.end();
+        ++ritr)
+    {
+        if (ritr->batched && ritr->count<_minimumBatchSize) ritr->batched = false;
+    }
+
+    if (runs.empty()) return;
+
+    // merge neighbouring runs that are drawn leaf by leaf.
+    unsigned int numRuns = (firstRun>0) ? firstRun : 1;
+    for(unsigned int i=numRuns; i<runs.size(); ++i)
+    {
+        LeafRun& last = runs[numRuns-1];
+        if (!last.batched && !runs[i].batched) last.count += runs[i].count;
+        else runs[numRuns++] = runs[i];
+    }
+    runs.erase(runs.begin()+numRuns, runs.end());
+}
+
+void MultiDrawIndirectBin::drawLeafRuns(osg::RenderInfo& renderInfo, const RenderLeafList& leaves, LeafRuns& runs, RenderLeaf*& previous)
+{
+    if (runs.empty()) return;
+
+    osg::State& state = *renderInfo.getState();
+    unsigned int contextID = state.getContextID();
+    GLBufferObject::Extensions* extensions = GLBufferObject::getExtensions(contextID,true);
+
+    // each leaf drawn on its own and each batch starts on a 256 byte boundary, the largest
+    // GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT allowed, so that its range can be bound on its own.
+    const unsigned int alignment = 64;
+
+    unsigned int numFloats = 0;
+    for(LeafRuns::iterator ritr = runs.begin();
+        ritr != runs.end();
+        ++ritr)
+    {
+        ritr->matrixOffset = numFloats;
+        numFloats += ritr->batched ? ((ritr->count*16+alignment-1)/alignment)*alignment : ritr->count*alignment;
+    }
+
+    osg::FloatArray& matrices = *(_geometryPools->getLeafMatrices(contextID));
+    matrices.resize(numFloats);
+    for(LeafRuns::iterator ritr = runs.begin();
+        ritr != runs.end();
+        ++ritr)
+    {
+        unsigned int stride = ritr->batched ? 16 : alignment;
+        for(unsigned int i=0; i<ritr->count; ++i)
+        {
+            const RenderLeaf* rl = leaves[ritr->first+i];
+            osg::Matrixf modelview;
+            if (rl->_modelview.valid()) modelview = *(rl->_modelview);
+            std::copy(modelview.ptr(), modelview.ptr()+16, &matrices[ritr->matrixOffset+i*stride]);
+        }
+    }
+    matrices.dirty();
+
+    GLBufferObject* matrixBuffer = matrices.getOrCreateGLBufferObject(contextID);
+    if (matrixBuffer->isDirty()) matrixBuffer->compileBuffer();
+
+    unsigned int matrixBufferOffset = matrixBuffer->getOffset(matrices.getBufferIndex());
+    for(LeafRuns::iterator ritr = runs.begin();
+        ritr != runs.end();
+        ++ritr)
+    {
+        if (state.getAbortRendering()) break;
+
+        if (ritr->batched)
+        {
+            drawBatch(renderInfo, leaves, *ritr, matrixBuffer, matrixBufferOffset, previous);
+            continue;
+        }
+
+        for(unsigned int i=0; i<ritr->count; ++i)
+        {
+            // gl_DrawIDARB and gl_BaseInstanceARB are 0 outside of a multi draw, so the shader reads this leaf's matrix.
+            GLintptr offset = matrixBufferOffset + (ritr->matrixOffset+i*alignment)*sizeof(float);
+            extensions->glBindBufferRange(GL_SHADER_STORAGE_BUFFER, _modelViewMatrixBinding, matrixBuffer->getGLObjectID(), offset, 16*sizeof(float));
+
+            RenderLeaf* rl = leaves[ritr->first+i];
+            rl->render(renderInfo,previous);
+            previous = rl;
+        }
+    }
+
+    extensions->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, _modelViewMatrixBinding, 0);
+}
+
+void MultiDrawIndirectBin::drawBatch(osg::RenderInfo& renderInfo, const RenderLeafList& leaves, const LeafRun& run, GLBufferObject* matrixBuffer, unsigned int matrixBufferOffset, RenderLeaf*& previous)
+{
+    osg::State& state = *renderInfo.getState();
+    unsigned int contextID = state.getContextID();
+    GLBufferObject::Extensions* extensions = GLBufferObject::getExtensions(contextID,true);
+
+    RenderLeafList::const_iterator begin = leaves.begin()+run.first;
+    RenderLeafList::const_iterator end = begin+run.count;
+
+    applyLeafState(state, *begin, previous);
+
+    GeometryPool* pool = _geometryPools->getGeometryPool(run.layout);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(pool->_mutex);
+
+    // make sure the pool holds the current data of every Geometry in the batch before recording the commands,
+    // as appending to the pool may compact it and move previously recorded entries.
+    for(RenderLeafList::const_iterator litr = begin;
+        litr != end;
+        ++litr)
+    {
+        pool->getEntry((*litr)->_drawable->asGeometry());
+    }
+
+    GeometryPool::DrawBuffers& drawBuffers = pool->getDrawBuffers(contextID);
+    osg::UIntArray& commands = *drawBuffers.commands;
+    commands.clear();
+    commands.reserve(run.count*5);
+
+    unsigned int drawIndex = 0;
+    for(RenderLeafList::const_iterator litr = begin;
+        litr != end;
+        ++litr, ++drawIndex)
+    {
+        const GeometryPool::Entry& entry = pool->getEntry((*litr)->_drawable->asGeometry());
+
+        // DrawElementsIndirectCommand { count, instanceCount, firstIndex, baseVertex, baseInstance }
+        commands.push_back(entry.count);
+        commands.push_back(1);
+        commands.push_back(entry.firstIndex);
+        commands.push_back(entry.baseVertex);
+        commands.push_back(drawIndex);
+    }
+    commands.dirty();
+
+    pool->upload(state);
+
+    state.lazyDisablingOfVertexAttributes();
+    state.setVertexPointer(pool->_vertices.get());
+    if (pool->_normals.valid()) state.setNormalPointer(pool->_normals.get());
+    if (pool->_texcoords.valid()) state.setTexCoordPointer(0, pool->_texcoords.get());
+    state.applyDisablingOfVertexAttributes();
+
+    extensions->glBindBufferRange(GL_SHADER_STORAGE_BUFFER, _modelViewMatrixBinding, matrixBuffer->getGLObjectID(),
+                                  (GLintptr)(matrixBufferOffset + run.matrixOffset*sizeof(float)),
+                                  (GLsizeiptr)(run.count*16*sizeof(float)));
+
+    GLBufferObject* commandBuffer = commands.getOrCreateGLBufferObject(contextID);
+    if (commandBuffer->isDirty()) commandBuffer->compileBuffer();
+    else commandBuffer->bindBuffer();
+
+    extensions->glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                            (const GLvoid*)(commandBuffer->getOffset(commands.getBufferIndex())),
+                                            static_cast<GLsizei>(run.count), 0);
+
+    commandBuffer->unbindBuffer();
+
+    state.unbindVertexBufferObject();
+    state.unbindElementBufferObject();
+
+    for(RenderLeafList::const_iterator litr = begin;
+        litr != end;
+        ++litr)
+    {
+        if ((*litr)->_dynamic) state.decrementDynamicObjectCount();
+    }
+
+    previous = *(end-1);
+}
@@ -41,6 +41,9 @@
 #include <osgUtil/Statistics>
 #include <osgUtil/MeshOptimizers>
 
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+
 #include <typeinfo>
 #include <algorithm>
 #include <numeric>
@@ -52,10 +55,29 @@ using namespace osgUtil;
 
 // #define GEOMETRYDEPRECATED
 
+static osg::ApplicationUsageProxy Optimizer_e1(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER_NUM_THREADS <int>","Set the number of threads used by the per Geometry Optimizer passes, 0 uses the number of processors.");
+static osg::ApplicationUsageProxy Optimizer_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER_REPORT_TIMINGS","Report the time taken by each Optimizer pass.");
+
+Optimizer::Optimizer():
+    _numThreads(1),
+    _reportPassTimings(false)
+{
+    const char* ptr = getenv("OSG_OPTIMIZER_NUM_THREADS");
+    if (ptr) setNumThreads(atoi(ptr));
+
+    if (getenv("OSG_OPTIMIZER_REPORT_TIMINGS")) _reportPassTimings = true;
+}
+
 void Optimizer::reset()
 {
 }
 
+void Optimizer::setNumThreads(unsigned int numThreads)
+{
+    _numThreads = numThreads>0 ? numThreads : static_cast<unsigned int>(OpenThreads::GetNumberOfProcessors());
+    if (_numThreads==0) _numThreads = 1;
+}
+
 static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES  | TRISTRIP_GEOMETRY | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM");
 
 void Optimizer::optimize(osg::Node* node)
@@ -146,8 +168,81 @@ void Optimizer::optimize(osg::Node* node)
 
 }
 
+namespace
+{
+
+/** Records the time taken by the pass that runs for the lifetime of the PassTimer.*/
+class PassTimer
+{
+    public:
+
+        PassTimer(Optimizer::PassTimings& timings, const char* name):
+            _timings(timings),
+            _name(name),
+            _startTick(osg::Timer::instance()->tick())
+        {
+            OSG_INFO<<"Optimizer::optimize() doing "<<_name<<std::endl;
+        }
+
+        ~PassTimer()
+        {
+            double time = osg::Timer::instance()->delta_s(_startTick, osg::Timer::instance()->tick());
+            _timings.push_back(Optimizer::PassTimings::value_type(_name, time));
+
+            OSG_INFO<<_name<<" took "<<time<<std::endl;
+        }
+
+    protected:
+
+        PassTimer& operator = (const PassTimer&) { return *this; }
+
+        Optimizer::PassTimings& _timings;
+        const char*             _name;
+        osg::Timer_t            _startTick;
+};
+
+/** Collects the Geodes that MergeGeometryVisitor would merge, in traversal order.*/
+class MergeGeometryGeodeCollector : public osg::NodeVisitor
+{
+    public:
+
+        MergeGeometryGeodeCollector():
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+        {
+            setNodeMaskOverride(0xffffffff);
+        }
+
+        virtual void apply(osg::Geode& geode)
+        {
+            if (_geodeSet.insert(&geode).second) _geodes.push_back(&geode);
+        }
+
+        virtual void apply(osg::Billboard&) {}
+
+        std::set<osg::Geode*>       _geodeSet;
+        std::vector<osg::Geode*>    _geodes;
+};
+
+struct MergeGeodeOperation : public Optimizer::PassScheduler::Operation
+{
+    MergeGeodeOperation(Optimizer::MergeGeometryVisitor& visitor): _visitor(visitor) {}
+
+    virtual void operator () (osg::Object& object)
+    {
+        _visitor.mergeGeode(static_cast<osg::Geode&>(object));
+    }
+
+    Optimizer::MergeGeometryVisitor& _visitor;
+};
+
+}
+
 void Optimizer::optimize(osg::Node* node, unsigned int options)
 {
+    _passTimings.clear();
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
     StatsVisitor stats;
 
     if (osg::getNotifyLevel()>=osg::INFO)
@@ -160,13 +255,15 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & STATIC_OBJECT_DETECTION)
     {
+        PassTimer timer(_passTimings, "STATIC_OBJECT_DETECTION");
+
         StaticObjectDetectionVisitor sodv;
         node->accept(sodv);
     }
 
     if (options & TESSELLATE_GEOMETRY)
     {
-        OSG_INFO<<"Optimizer::optimize() doing TESSELLATE_GEOMETRY"<<std::endl;
+        PassTimer timer(_passTimings, "TESSELLATE_GEOMETRY");
 
         TessellateVisitor tsv;
         node->accept(tsv);
@@ -174,7 +271,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & REMOVE_LOADED_PROXY_NODES)
     {
-        OSG_INFO<<"Optimizer::optimize() doing REMOVE_LOADED_PROXY_NODES"<<std::endl;
+        PassTimer timer(_passTimings, "REMOVE_LOADED_PROXY_NODES");
 
         RemoveLoadedProxyNodesVisitor rlpnv(this);
         node->accept(rlpnv);
@@ -184,7 +281,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & COMBINE_ADJACENT_LODS)
     {
-        OSG_INFO<<"Optimizer::optimize() doing COMBINE_ADJACENT_LODS"<<std::endl;
+        PassTimer timer(_passTimings, "COMBINE_ADJACENT_LODS");
 
         CombineLODsVisitor clv(this);
         node->accept(clv);
@@ -193,7 +290,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & OPTIMIZE_TEXTURE_SETTINGS)
     {
-        OSG_INFO<<"Optimizer::optimize() doing OPTIMIZE_TEXTURE_SETTINGS"<<std::endl;
+        PassTimer timer(_passTimings, "OPTIMIZE_TEXTURE_SETTINGS");
 
         TextureVisitor tv(true,true, // unref image
                           false,false, // client storage
@@ -204,7 +301,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & SHARE_DUPLICATE_STATE)
     {
-        OSG_INFO<<"Optimizer::optimize() doing SHARE_DUPLICATE_STATE"<<std::endl;
+        PassTimer timer(_passTimings, "SHARE_DUPLICATE_STATE");
 
         bool combineDynamicState = false;
         bool combineStaticState = true;
@@ -217,7 +314,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & TEXTURE_ATLAS_BUILDER)
     {
-        OSG_INFO<<"Optimizer::optimize() doing TEXTURE_ATLAS_BUILDER"<<std::endl;
+        PassTimer timer(_passTimings, "TEXTURE_ATLAS_BUILDER");
 
         // traverse the scene collecting textures into texture atlas.
         TextureAtlasVisitor tav(this);
@@ -236,7 +333,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & COPY_SHARED_NODES)
     {
-        OSG_INFO<<"Optimizer::optimize() doing COPY_SHARED_NODES"<<std::endl;
+        PassTimer timer(_passTimings, "COPY_SHARED_NODES");
 
         CopySharedSubgraphsVisitor cssv(this);
         node->accept(cssv);
@@ -245,7 +342,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_STATIC_TRANSFORMS)
     {
-        OSG_INFO<<"Optimizer::optimize() doing FLATTEN_STATIC_TRANSFORMS"<<std::endl;
+        PassTimer timer(_passTimings, "FLATTEN_STATIC_TRANSFORMS");
 
         int i=0;
         bool result = false;
@@ -266,7 +363,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS)
     {
-        OSG_INFO<<"Optimizer::optimize() doing FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS"<<std::endl;
+        PassTimer timer(_passTimings, "FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS");
 
         // now combine any adjacent static transforms.
         FlattenStaticTransformsDuplicatingSharedSubgraphsVisitor fstdssv(this);
@@ -276,21 +373,15 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MERGE_GEODES)
     {
-        OSG_INFO<<"Optimizer::optimize() doing MERGE_GEODES"<<std::endl;
-
-        osg::Timer_t startTick = osg::Timer::instance()->tick();
+        PassTimer timer(_passTimings, "MERGE_GEODES");
 
         MergeGeodesVisitor visitor;
         node->accept(visitor);
-
-        osg::Timer_t endTick = osg::Timer::instance()->tick();
-
-        OSG_INFO<<"MERGE_GEODES took "<<osg::Timer::instance()->delta_s(startTick,endTick)<<std::endl;
     }
 
     if (options & CHECK_GEOMETRY)
     {
-        OSG_INFO<<"Optimizer::optimize() doing CHECK_GEOMETRY"<<std::endl;
+        PassTimer timer(_passTimings, "CHECK_GEOMETRY");
 
         CheckGeometryVisitor mgv(this);
         node->accept(mgv);
@@ -298,7 +389,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MAKE_FAST_GEOMETRY)
     {
-        OSG_INFO<<"Optimizer::optimize() doing MAKE_FAST_GEOMETRY"<<std::endl;
+        PassTimer timer(_passTimings, "MAKE_FAST_GEOMETRY");
 
         MakeFastGeometryVisitor mgv(this);
         node->accept(mgv);
@@ -306,22 +397,37 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & MERGE_GEOMETRY)
     {
-        OSG_INFO<<"Optimizer::optimize() doing MERGE_GEOMETRY"<<std::endl;
-
-        osg::Timer_t startTick = osg::Timer::instance()->tick();
+        PassTimer timer(_passTimings, "MERGE_GEOMETRY");
 
         MergeGeometryVisitor mgv(this);
         mgv.setTargetMaximumNumberOfVertices(10000);
-        node->accept(mgv);
 
-        osg::Timer_t endTick = osg::Timer::instance()->tick();
+        if (mgv.getNumThreads()>1)
+        {
+            // merging only touches the drawables of each Geode, so collect the Geodes and merge them in parallel.
+            MergeGeometryGeodeCollector collector;
+            node->accept(collector);
 
-        OSG_INFO<<"MERGE_GEOMETRY took "<<osg::Timer::instance()->delta_s(startTick,endTick)<<std::endl;
+            PassScheduler scheduler(mgv.getNumThreads());
+            for(std::vector<osg::Geode*>::iterator itr = collector._geodes.begin();
+                itr != collector._geodes.end();
+                ++itr)
+            {
+                scheduler.add(*itr);
+            }
+
+            MergeGeodeOperation operation(mgv);
+            scheduler.run(operation);
+        }
+        else
+        {
+            node->accept(mgv);
+        }
     }
 
     if (options & TRISTRIP_GEOMETRY)
     {
-        OSG_INFO<<"Optimizer::optimize() doing TRISTRIP_GEOMETRY"<<std::endl;
+        PassTimer timer(_passTimings, "TRISTRIP_GEOMETRY");
 
         TriStripVisitor tsv(this);
         node->accept(tsv);
@@ -330,7 +436,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & REMOVE_REDUNDANT_NODES)
     {
-        OSG_INFO<<"Optimizer::optimize() doing REMOVE_REDUNDANT_NODES"<<std::endl;
+        PassTimer timer(_passTimings, "REMOVE_REDUNDANT_NODES");
 
         RemoveEmptyNodesVisitor renv(this);
         node->accept(renv);
@@ -344,6 +450,8 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & FLATTEN_BILLBOARDS)
     {
+        PassTimer timer(_passTimings, "FLATTEN_BILLBOARDS");
+
         FlattenBillboardVisitor fbv(this);
         node->accept(fbv);
         fbv.process();
@@ -351,7 +459,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & SPATIALIZE_GROUPS)
     {
-        OSG_INFO<<"Optimizer::optimize() doing SPATIALIZE_GROUPS"<<std::endl;
+        PassTimer timer(_passTimings, "SPATIALIZE_GROUPS");
 
         SpatializeGroupsVisitor sv(this);
         node->accept(sv);
@@ -360,7 +468,7 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & INDEX_MESH)
     {
-        OSG_INFO<<"Optimizer::optimize() doing INDEX_MESH"<<std::endl;
+        PassTimer timer(_passTimings, "INDEX_MESH");
         IndexMeshVisitor imv(this);
         node->accept(imv);
         imv.makeMesh();
@@ -368,16 +476,16 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
 
     if (options & VERTEX_POSTTRANSFORM)
     {
-        OSG_INFO<<"Optimizer::optimize() doing VERTEX_POSTTRANSFORM"<<std::endl;
-        VertexCacheVisitor vcv;
+        PassTimer timer(_passTimings, "VERTEX_POSTTRANSFORM");
+        VertexCacheVisitor vcv(this);
         node->accept(vcv);
         vcv.optimizeVertices();
     }
 
     if (options & VERTEX_PRETRANSFORM)
     {
-        OSG_INFO<<"Optimizer::optimize() doing VERTEX_PRETRANSFORM"<<std::endl;
-        VertexAccessOrderVisitor vaov;
+        PassTimer timer(_passTimings, "VERTEX_PRETRANSFORM");
+        VertexAccessOrderVisitor vaov(this);
         node->accept(vaov);
         vaov.optimizeOrder();
     }
@@ -390,6 +498,244 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
         OSG_NOTICE<<std::endl<<"Stats after:"<<std::endl;
         stats.print(osg::notify(osg::NOTICE));
     }
+
+    osg::Timer_t endTick = osg::Timer::instance()->tick();
+
+    osg::NotifySeverity level = _reportPassTimings ? osg::NOTICE : osg::INFO;
+    if (osg::isNotifyEnabled(level) && !_passTimings.empty())
+    {
+        osg::notify(level)<<"Optimizer::optimize() pass timings, using "<<_numThreads<<" thread(s):"<<std::endl;
+        for(PassTimings::const_iterator itr = _passTimings.begin();
+            itr != _passTimings.end();
+            ++itr)
+        {
+            osg::notify(level)<<"    "<<itr->first<<" "<<itr->second*1000.0<<"ms"<<std::endl;
+        }
+        osg::notify(level)<<"    total "<<osg::Timer::instance()->delta_m(startTick,endTick)<<"ms"<<std::endl;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// PassScheduler - run per Geometry/Geode work in parallel
+////////////////////////////////////////////////////////////////////////////
+namespace
+{
+
+typedef std::vector<osg::Object*> PassGroup;
+
+/** Hands out the groups of a PassScheduler to the threads processing them.*/
+class PassGroupQueue
+{
+    public:
+
+        PassGroupQueue(const std::vector<const PassGroup*>& groups, Optimizer::PassScheduler::Operation& operation):
+            _groups(groups),
+            _operation(operation) {}
+
+        void process()
+        {
+            unsigned int numGroups = static_cast<unsigned int>(_groups.size());
+            for(unsigned int i = (++_nextGroup)-1; i<numGroups; i = (++_nextGroup)-1)
+            {
+                const PassGroup& group = *_groups[i];
+                for(PassGroup::const_iterator itr = group.begin();
+                    itr != group.end();
+                    ++itr)
+                {
+                    _operation(**itr);
+                }
+            }
+        }
+
+    protected:
+
+        PassGroupQueue& operator = (const PassGroupQueue&) { return *this; }
+
+        const std::vector<const PassGroup*>&    _groups;
+        Optimizer::PassScheduler::Operation&    _operation;
+        OpenThreads::Atomic                     _nextGroup;
+};
+
+class PassThread : public osg::Referenced, public OpenThreads::Thread
+{
+    public:
+
+        PassThread(PassGroupQueue& queue): _queue(queue) {}
+
+        virtual void run() { _queue.process(); }
+
+    protected:
+
+        virtual ~PassThread() {}
+
+        PassThread& operator = (const PassThread&) { return *this; }
+
+        PassGroupQueue& _queue;
+};
+
+struct LargerPassGroup
+{
+    bool operator() (const PassGroup* lhs, const PassGroup* rhs) const { return lhs->size()>rhs->size(); }
+};
+
+}
+
+Optimizer::PassScheduler::PassScheduler(unsigned int numThreads):
+    _numThreads(numThreads),
+    _numGroups(0)
+{
+    if (_numThreads==0) _numThreads = static_cast<unsigned int>(OpenThreads::GetNumberOfProcessors());
+    if (_numThreads==0) _numThreads = 1;
+}
+
+unsigned int Optimizer::PassScheduler::findRoot(unsigned int index)
+{
+    unsigned int root = index;
+    while(_parents[root]!=root) root = _parents[root];
+
+    // compress the path so later lookups are quick.
+    while(_parents[index]!=root)
+    {
+        unsigned int next = _parents[index];
+        _parents[index] = root;
+        index = next;
+    }
+    return root;
+}
+
+void Optimizer::PassScheduler::addDependency(unsigned int index, const osg::Referenced* data)
+{
+    if (!data) return;
+
+    DependencyMap::iterator itr = _dependencies.find(data);
+    if (itr==_dependencies.end())
+    {
+        _dependencies[data] = index;
+        return;
+    }
+
+    // data is shared with an earlier object so join their groups, keeping the lowest index as root.
+    unsigned int lhs = findRoot(itr->second);
+    unsigned int rhs = findRoot(index);
+    if (lhs<rhs) _parents[rhs] = lhs;
+    else if (rhs<lhs) _parents[lhs] = rhs;
+}
+
+void Optimizer::PassScheduler::addDependencies(unsigned int index, osg::Geometry& geometry)
+{
+    addDependency(index, &geometry);
+
+    osg::Geometry::ArrayList arrays;
+    geometry.getArrayList(arrays);
+    for(osg::Geometry::ArrayList::iterator itr = arrays.begin();
+        itr != arrays.end();
+        ++itr)
+    {
+        addDependency(index, itr->get());
+        addDependency(index, (*itr)->getBufferObject());
+    }
+
+    for(unsigned int i=0; i<geometry.getNumPrimitiveSets(); ++i)
+    {
+        osg::PrimitiveSet* primitiveSet = geometry.getPrimitiveSet(i);
+        addDependency(index, primitiveSet);
+        addDependency(index, primitiveSet ? primitiveSet->getBufferObject() : 0);
+    }
+}
+
+void Optimizer::PassScheduler::add(osg::Geometry* geometry)
+{
+    if (!geometry) return;
+
+    unsigned int index = static_cast<unsigned int>(_objects.size());
+    _objects.push_back(geometry);
+    _parents.push_back(index);
+
+    addDependencies(index, *geometry);
+}
+
+void Optimizer::PassScheduler::add(osg::Geode* geode)
+{
+    if (!geode) return;
+
+    unsigned int index = static_cast<unsigned int>(_objects.size());
+    _objects.push_back(geode);
+    _parents.push_back(index);
+
+    addDependency(index, geode);
+
+    for(unsigned int i=0; i<geode->getNumDrawables(); ++i)
+    {
+        osg::Drawable* drawable = geode->getDrawable(i);
+        if (drawable && drawable->asGeometry()) addDependencies(index, *(drawable->asGeometry()));
+        else addDependency(index, drawable);
+    }
+}
+
+void Optimizer::PassScheduler::run(Operation& operation)
+{
+    _numGroups = 0;
+    if (_objects.empty()) return;
+
+    // gather the objects of each group, they keep the order they were added in.
+    std::vector<PassGroup> groups;
+    std::vector<unsigned int> rootGroups(_objects.size(), 0);
+    for(unsigned int i=0; i<_objects.size(); ++i)
+    {
+        unsigned int root = findRoot(i);
+        if (root==i)
+        {
+            rootGroups[i] = static_cast<unsigned int>(groups.size());
+            groups.push_back(PassGroup());
+        }
+        groups[rootGroups[root]].push_back(_objects[i]);
+    }
+
+    _numGroups = static_cast<unsigned int>(groups.size());
+
+    unsigned int numThreads = osg::minimum(_numThreads, _numGroups);
+    if (numThreads<=1)
+    {
+        for(std::vector<osg::Object*>::iterator itr = _objects.begin();
+            itr != _objects.end();
+            ++itr)
+        {
+            operation(**itr);
+        }
+        return;
+    }
+
+    // hand out the largest groups first so a large group isn't left running on its own at the end.
+    std::vector<const PassGroup*> sortedGroups;
+    sortedGroups.reserve(groups.size());
+    for(std::vector<PassGroup>::const_iterator itr = groups.begin();
+        itr != groups.end();
+        ++itr)
+    {
+        sortedGroups.push_back(&(*itr));
+    }
+    std::stable_sort(sortedGroups.begin(), sortedGroups.end(), LargerPassGroup());
+
+    PassGroupQueue queue(sortedGroups, operation);
+
+    typedef std::vector< osg::ref_ptr<PassThread> > PassThreads;
+    PassThreads threads;
+    for(unsigned int i=1; i<numThreads; ++i)
+    {
+        osg::ref_ptr<PassThread> thread = new PassThread(queue);
+        if (thread->startThread()==0) threads.push_back(thread);
+    }
+
+    // the calling thread works through the queue too.
+    queue.process();
+
+    for(PassThreads::iterator itr = threads.begin();
+        itr != threads.end();
+        ++itr)
+    {
+        (*itr)->join();
+    }
 }
 
 
@@ -2117,8 +2463,7 @@ bool Optimizer::MergeGeometryVisitor::mergeGeode(osg::Geode& geode)
                     {
                         geode.removeDrawable(rhs);
 
-                        static int co = 0;
-                        OSG_INFO<<"merged and removed Geometry "<<++co<<std::endl;
+                        OSG_INFO<<"merged and removed Geometry"<<std::endl;
                     }
                 }
             }
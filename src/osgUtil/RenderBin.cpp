@@ -15,6 +15,7 @@
 
 #include <osgUtil/RenderBin>
 #include <osgUtil/RenderStage>
+#include <osgUtil/MultiDrawIndirectBin>
 #include <osgUtil/Statistics>
 
 #include <osg/Notify>
@@ -38,6 +39,7 @@ class RenderBinPrototypeList : osg::depends_on<OpenThreads::Mutex*, osg::Referen
             add("SORT_BACK_TO_FRONT",new RenderBin(RenderBin::SORT_BACK_TO_FRONT));
             add("SORT_FRONT_TO_BACK",new RenderBin(RenderBin::SORT_FRONT_TO_BACK));
             add("TraversalOrderBin",new RenderBin(RenderBin::TRAVERSAL_ORDER));
+            add("MultiDrawIndirectBin",new MultiDrawIndirectBin(RenderBin::SORT_BY_STATE));
         }
 
         void add(const std::string& name, RenderBin* bin)
@@ -272,78 +274,160 @@ void RenderBin::sortByState()
 }
 
 
-struct StateGraphFrontToBackSortFunctor
+namespace
 {
-    bool operator() (const StateGraph* lhs,const StateGraph* rhs) const
-    {
-        return (lhs->_minimumDistance<rhs->_minimumDistance);
-    }
+
+/** Sort entry made up of a 64 bit key and the object it sorts, held in a flat array so that sorting
+  * doesn't need to chase pointers back to the RenderLeaf or StateGraph for each comparison.*/
+template<class T>
+struct SortEntry
+{
+    unsigned long long  _key;
+    T*                  _object;
+
+    bool operator < (const SortEntry& rhs) const { return _key<rhs._key; }
 };
 
-void RenderBin::sortByStateThenFrontToBack()
+/** Map a float onto an unsigned int with the same ordering, so depths can be sorted as integers.*/
+inline unsigned int sortableDepth(float depth)
 {
-    for(StateGraphList::iterator itr=_stateGraphList.begin();
-        itr!=_stateGraphList.end();
-        ++itr)
-    {
-        (*itr)->sortFrontToBack();
-        (*itr)->getMinimumDistance();
-    }
-    std::sort(_stateGraphList.begin(),_stateGraphList.end(),StateGraphFrontToBackSortFunctor());
+    unsigned int bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
 }
 
-struct FrontToBackSortFunctor
+/** Sort the entries on the lowest numKeyBytes bytes of their keys, using a least significant byte radix
+  * sort for large lists and std::sort for small ones where the radix sort's histograms don't pay off.*/
+template<class T>
+void sortEntries(std::vector< SortEntry<T> >& entries, unsigned int numKeyBytes)
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    const unsigned int numEntries = entries.size();
+    if (numEntries<256)
     {
-        return (lhs->_depth<rhs->_depth);
+        std::sort(entries.begin(), entries.end());
+        return;
     }
-};
 
+    unsigned int histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
 
-void RenderBin::sortFrontToBack()
-{
-    copyLeavesFromStateGraphListToRenderLeafList();
+    for(unsigned int i=0; i<numEntries; ++i)
+    {
+        unsigned long long key = entries[i]._key;
+        for(unsigned int b=0; b<numKeyBytes; ++b)
+        {
+            ++histograms[b][(key>>(b*8)) & 0xff];
+        }
+    }
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),FrontToBackSortFunctor());
+    std::vector< SortEntry<T> > scratch(numEntries);
+    SortEntry<T>* src = &entries.front();
+    SortEntry<T>* dst = &scratch.front();
+
+    for(unsigned int b=0; b<numKeyBytes; ++b)
+    {
+        unsigned int* histogram = histograms[b];
+        unsigned int shift = b*8;
+
+        // skip the pass if all the keys share the same value for this byte.
+        if (histogram[(src[0]._key>>shift) & 0xff]==numEntries) continue;
+
+        unsigned int offset = 0;
+        for(unsigned int i=0; i<256; ++i)
+        {
+            unsigned int count = histogram[i];
+            histogram[i] = offset;
+            offset += count;
+        }
+
+        for(unsigned int i=0; i<numEntries; ++i)
+        {
+            dst[histogram[(src[i]._key>>shift) & 0xff]++] = src[i];
+        }
 
-//    cout << "sort front to back"<<endl;
+        std::swap(src, dst);
+    }
+
+    if (src!=&entries.front()) entries.swap(scratch);
 }
 
-struct BackToFrontSortFunctor
+enum RenderLeafSortKey
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
-    {
-        return (rhs->_depth<lhs->_depth);
-    }
+    FRONT_TO_BACK_KEY,
+    BACK_TO_FRONT_KEY,
+    TRAVERSAL_ORDER_KEY
 };
 
-void RenderBin::sortBackToFront()
+void sortRenderLeafList(RenderBin::RenderLeafList& renderLeafList, RenderLeafSortKey sortKey)
 {
-    copyLeavesFromStateGraphListToRenderLeafList();
+    std::vector< SortEntry<RenderLeaf> > entries(renderLeafList.size());
+    for(unsigned int i=0; i<renderLeafList.size(); ++i)
+    {
+        RenderLeaf* leaf = renderLeafList[i];
+        unsigned long long key = leaf->_traversalNumber;
+        switch(sortKey)
+        {
+            case(FRONT_TO_BACK_KEY): key |= static_cast<unsigned long long>(sortableDepth(leaf->_depth))<<32; break;
+            case(BACK_TO_FRONT_KEY): key |= static_cast<unsigned long long>(~sortableDepth(leaf->_depth))<<32; break;
+            case(TRAVERSAL_ORDER_KEY): break;
+        }
+        entries[i]._key = key;
+        entries[i]._object = leaf;
+    }
 
-    // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),BackToFrontSortFunctor());
+    // the traversal number occupies the lower 32 bits, and breaks ties between equal depths.
+    sortEntries(entries, sortKey==TRAVERSAL_ORDER_KEY ? 4 : 8);
 
-//    cout << "sort back to front"<<endl;
+    for(unsigned int i=0; i<entries.size(); ++i)
+    {
+        renderLeafList[i] = entries[i]._object;
+    }
 }
 
+}
 
-struct TraversalOrderFunctor
+void RenderBin::sortByStateThenFrontToBack()
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    std::vector< SortEntry<StateGraph> > entries(_stateGraphList.size());
+    for(unsigned int i=0; i<_stateGraphList.size(); ++i)
     {
-        return (lhs->_traversalNumber<rhs->_traversalNumber);
+        StateGraph* sg = _stateGraphList[i];
+        sg->sortFrontToBack();
+
+        entries[i]._key = (static_cast<unsigned long long>(sortableDepth(sg->getMinimumDistance()))<<32) | i;
+        entries[i]._object = sg;
     }
-};
 
-void RenderBin::sortTraversalOrder()
+    sortEntries(entries, 8);
+
+    for(unsigned int i=0; i<entries.size(); ++i)
+    {
+        _stateGraphList[i] = entries[i]._object;
+    }
+}
+
+void RenderBin::sortFrontToBack()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
     // now sort the list into acending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),TraversalOrderFunctor());
+    sortRenderLeafList(_renderLeafList, FRONT_TO_BACK_KEY);
+}
+
+void RenderBin::sortBackToFront()
+{
+    copyLeavesFromStateGraphListToRenderLeafList();
+
+    // now sort the list into decending depth order.
+    sortRenderLeafList(_renderLeafList, BACK_TO_FRONT_KEY);
+}
+
+void RenderBin::sortTraversalOrder()
+{
+    copyLeavesFromStateGraphListToRenderLeafList();
+
+    // now sort the list into acending traversal order.
+    sortRenderLeafList(_renderLeafList, TRAVERSAL_ORDER_KEY);
 }
 
 void RenderBin::copyLeavesFromStateGraphListToRenderLeafList()
@@ -17,6 +17,100 @@
 using namespace osg;
 using namespace osgUtil;
 
+namespace
+{
+
+/** Header in front of every RenderLeaf, pointing to the RenderLeafPool block the leaf was allocated from,
+  * or 0 for a leaf allocated on its own.  The union keeps the leaf that follows it aligned.*/
+union RenderLeafHeader
+{
+    RenderLeafPool::Block*  _block;
+    double                  _align;
+};
+
+const std::size_t s_renderLeafSlotSize = ((sizeof(RenderLeafHeader)+sizeof(RenderLeaf)+sizeof(RenderLeafHeader)-1)/sizeof(RenderLeafHeader))*sizeof(RenderLeafHeader);
+
+}
+
+/** Block of contiguous RenderLeaf slots, each RenderLeaf allocated from it holds a reference to it.  The slots of
+  * deleted RenderLeaf aren't reused, as CullVisitor keeps its RenderLeaf for reuse in later frames rather than deleting them.*/
+class RenderLeafPool::Block : public osg::Referenced
+{
+    public:
+
+        Block(unsigned int numSlots):
+            _memory(new char[numSlots*s_renderLeafSlotSize]),
+            _numSlots(numSlots) {}
+
+        unsigned int getNumSlots() const { return _numSlots; }
+
+        char* getSlot(unsigned int i) { return _memory + i*s_renderLeafSlotSize; }
+
+    protected:
+
+        virtual ~Block() { delete [] _memory; }
+
+        char*           _memory;
+        unsigned int    _numSlots;
+};
+
+RenderLeafPool::RenderLeafPool():
+    _numUsed(0)
+{
+}
+
+RenderLeafPool::~RenderLeafPool()
+{
+}
+
+void* RenderLeafPool::allocate()
+{
+    if (!_block || _numUsed==_block->getNumSlots())
+    {
+        // start small so that CullVisitors that only ever create a few leaves don't hold on to much memory.
+        const unsigned int minNumSlots = 64;
+        const unsigned int maxNumSlots = 1024;
+        unsigned int numSlots = _block.valid() ? osg::minimum(_block->getNumSlots()*2, maxNumSlots) : minNumSlots;
+
+        _block = new Block(numSlots);
+        _numUsed = 0;
+    }
+
+    char* slot = _block->getSlot(_numUsed++);
+    reinterpret_cast<RenderLeafHeader*>(slot)->_block = _block.get();
+    _block->ref();
+    return slot + sizeof(RenderLeafHeader);
+}
+
+void* RenderLeaf::operator new(std::size_t size)
+{
+    char* memory = static_cast<char*>(::operator new(sizeof(RenderLeafHeader)+size));
+    reinterpret_cast<RenderLeafHeader*>(memory)->_block = 0;
+    return memory + sizeof(RenderLeafHeader);
+}
+
+void* RenderLeaf::operator new(std::size_t size, RenderLeafPool* pool)
+{
+    // subclasses of RenderLeaf won't fit in the pool's slots so allocate them on their own.
+    if (!pool || size!=sizeof(RenderLeaf)) return RenderLeaf::operator new(size);
+
+    return pool->allocate();
+}
+
+void RenderLeaf::operator delete(void* ptr, std::size_t)
+{
+    if (!ptr) return;
+
+    RenderLeafHeader* header = reinterpret_cast<RenderLeafHeader*>(static_cast<char*>(ptr) - sizeof(RenderLeafHeader));
+    if (header->_block) header->_block->unref();
+    else ::operator delete(header);
+}
+
+void RenderLeaf::operator delete(void* ptr, RenderLeafPool*)
+{
+    RenderLeaf::operator delete(ptr, sizeof(RenderLeaf));
+}
+
 void RenderLeaf::render(osg::RenderInfo& renderInfo,RenderLeaf* previous)
 {
     osg::State& state = *renderInfo.getState();
@@ -206,6 +206,61 @@ void RenderStage::addPostRenderStage(RenderStage* rs, int order)
     }
 }
 
+void RenderStage::moveDependentRenderStages(RenderStage& rs)
+{
+    PositionalStateContainer* psc = rs._renderStageLighting.get();
+    if (psc)
+    {
+        PositionalStateContainer::AttrMatrixList& attrList = psc->getAttrMatrixList();
+        for(PositionalStateContainer::AttrMatrixList::iterator itr = attrList.begin();
+            itr != attrList.end();
+            ++itr)
+        {
+            addPositionedAttribute(itr->second.get(), itr->first.get());
+        }
+
+        PositionalStateContainer::TexUnitAttrMatrixListMap& texAttrListMap = psc->getTexUnitAttrMatrixListMap();
+        for(PositionalStateContainer::TexUnitAttrMatrixListMap::iterator titr = texAttrListMap.begin();
+            titr != texAttrListMap.end();
+            ++titr)
+        {
+            for(PositionalStateContainer::AttrMatrixList::iterator itr = titr->second.begin();
+                itr != titr->second.end();
+                ++itr)
+            {
+                addPositionedTextureAttribute(titr->first, itr->second.get(), itr->first.get());
+            }
+        }
+
+        psc->reset();
+    }
+
+    for(RenderStageList::iterator pre_itr = rs._preRenderList.begin();
+        pre_itr != rs._preRenderList.end();
+        ++pre_itr)
+    {
+        if (psc && pre_itr->second->getInheritedPositionalStateContainer()==psc)
+        {
+            pre_itr->second->setInheritedPositionalStateContainer(getPositionalStateContainer());
+        }
+        addPreRenderStage(pre_itr->second.get(), pre_itr->first);
+    }
+
+    for(RenderStageList::iterator post_itr = rs._postRenderList.begin();
+        post_itr != rs._postRenderList.end();
+        ++post_itr)
+    {
+        if (psc && post_itr->second->getInheritedPositionalStateContainer()==psc)
+        {
+            post_itr->second->setInheritedPositionalStateContainer(getPositionalStateContainer());
+        }
+        addPostRenderStage(post_itr->second.get(), post_itr->first);
+    }
+
+    rs._preRenderList.clear();
+    rs._postRenderList.clear();
+}
+
 void RenderStage::drawPreRenderStages(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     if (_preRenderList.empty()) return;
@@ -19,6 +19,7 @@
 #include <osg/GLObjects>
 #include <osg/Notify>
 #include <osg/Texture>
+#include <osg/GLMemoryBudget>
 #include <osg/AlphaFunc>
 #include <osg/TexEnv>
 #include <osg/ColorMatrix>
@@ -1002,6 +1003,12 @@ void SceneView::draw()
         flushDeletedGLObjects(availableTime);
     }
 
+    // bring the texture and buffer objects left from previous frames within the context's GL memory budget,
+    // before the draw downloads any new ones.
+    osg::GLMemoryBudget* budget = osg::GLMemoryBudget::getGLMemoryBudget(state->getContextID()).get();
+    budget->newFrame(state->getFrameStamp());
+    if (budget->isEnabled()) budget->enforce(*state);
+
     // assume the the draw which is about to happen could generate GL objects that need flushing in the next frame.
     _requiresFlush = _automaticFlush;
 
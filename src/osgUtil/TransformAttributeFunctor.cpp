@@ -29,19 +29,16 @@ void TransformAttributeFunctor::apply(osg::Drawable::AttributeType type,unsigned
 {
     if (type == osg::Drawable::VERTICES)
     {
-        osg::Vec3* end = begin+count;
-        for (osg::Vec3* itr=begin;itr<end;++itr)
-        {
-            (*itr) = (*itr)*_m;
-        }
+        _m.preMult(begin,begin,count);
     }
     else if (type == osg::Drawable::NORMALS)
     {
+        // note post mult by inverse for normals.
+        osg::Matrix::transform3x3(_im,begin,begin,count);
+
         osg::Vec3* end = begin+count;
         for (osg::Vec3* itr=begin;itr<end;++itr)
         {
-            // note post mult by inverse for normals.
-            (*itr) = osg::Matrix::transform3x3(_im,(*itr));
             (*itr).normalize();
         }
     }
@@ -51,19 +48,16 @@ void TransformAttributeFunctor::apply(osg::Drawable::AttributeType type,unsigned
 {
     if (type == osg::Drawable::VERTICES)
     {
-        osg::Vec3d* end = begin+count;
-        for (osg::Vec3d* itr=begin;itr<end;++itr)
-        {
-            (*itr) = (*itr)*_m;
-        }
+        _m.preMult(begin,begin,count);
     }
     else if (type == osg::Drawable::NORMALS)
     {
+        // note post mult by inverse for normals.
+        osg::Matrix::transform3x3(_im,begin,begin,count);
+
         osg::Vec3d* end = begin+count;
         for (osg::Vec3d* itr=begin;itr<end;++itr)
         {
-            // note post mult by inverse for normals.
-            (*itr) = osg::Matrix::transform3x3(_im,(*itr));
             (*itr).normalize();
         }
     }
@@ -563,8 +563,41 @@ void TriStripVisitor::stripify(Geometry& geom)
 
 }
 
+namespace
+{
+
+struct StripifyOperation : public osgUtil::Optimizer::PassScheduler::Operation
+{
+    StripifyOperation(TriStripVisitor& visitor): _visitor(visitor) {}
+
+    virtual void operator () (osg::Object& object)
+    {
+        _visitor.stripify(static_cast<osg::Geometry&>(object));
+    }
+
+    TriStripVisitor& _visitor;
+};
+
+}
+
 void TriStripVisitor::stripify()
 {
+    if (getNumThreads()>1 && _geometryList.size()>1)
+    {
+        // each Geometry is stripped independently, so spread them over several threads.
+        Optimizer::PassScheduler scheduler(getNumThreads());
+        for(GeometryList::iterator itr=_geometryList.begin();
+            itr!=_geometryList.end();
+            ++itr)
+        {
+            scheduler.add(*itr);
+        }
+
+        StripifyOperation operation(*this);
+        scheduler.run(operation);
+        return;
+    }
+
     for(GeometryList::iterator itr=_geometryList.begin();
         itr!=_geometryList.end();
         ++itr)
@@ -594,6 +594,7 @@ void CompositeViewer::realize()
 
     unsigned int maxTexturePoolSize = ds->getMaxTexturePoolSize();
     unsigned int maxBufferObjectPoolSize = ds->getMaxBufferObjectPoolSize();
+    unsigned int maxGLMemorySize = ds->getMaxGLMemorySize();
 
     for(Contexts::iterator citr = contexts.begin();
         citr != contexts.end();
@@ -604,6 +605,7 @@ void CompositeViewer::realize()
         // set the pool sizes, 0 the default will result in no GL object pools.
         gc->getState()->setMaxTexturePoolSize(maxTexturePoolSize);
         gc->getState()->setMaxBufferObjectPoolSize(maxBufferObjectPoolSize);
+        gc->getState()->setMaxGLMemorySize(maxGLMemorySize);
 
         gc->realize();
 
@@ -617,9 +619,6 @@ void CompositeViewer::realize()
         }
     }
 
-    // attach contexts to _incrementalCompileOperation if attached.
-    if (_incrementalCompileOperation) _incrementalCompileOperation->assignContexts(contexts);
-
 
     bool grabFocus = true;
     if (grabFocus)
@@ -665,6 +664,13 @@ void CompositeViewer::realize()
         }
     }
 
+    // attach contexts to _incrementalCompileOperation if attached, which compiles on their compile contexts when there are any.
+    if (_incrementalCompileOperation)
+    {
+        if (osg::DisplaySettings::instance()->getCompileContextsHint()) _incrementalCompileOperation->setUseCompileContexts(true);
+        _incrementalCompileOperation->assignContexts(contexts);
+    }
+
 }
 
 void CompositeViewer::advance(double simulationTime)
@@ -14,6 +14,7 @@
 #include <stdio.h>
 
 #include <osg/GLExtensions>
+#include <osg/GLMemoryBudget>
 #include <OpenThreads/ReentrantMutex>
 
 #include <osgUtil/Optimizer>
@@ -603,6 +604,40 @@ static void collectSceneViewStats(unsigned int frameNumber, osgUtil::SceneView*
     stats->setAttribute(frameNumber, "Visible number of GL_POLYGON", static_cast<double>(pcm[GL_POLYGON]));
 }
 
+// the GLBufferObjectManager's running counts, taken before the draw so that the counts of the frame can be recorded after it.
+struct BufferObjectCounts
+{
+    BufferObjectCounts(osg::GLBufferObjectManager* bom):
+        numStreamingStalls(bom->getNumberStreamingStalls()),
+        numPoolHits(bom->getNumberPoolHits()),
+        numPoolMisses(bom->getNumberPoolMisses()) {}
+
+    unsigned int numStreamingStalls;
+    unsigned int numPoolHits;
+    unsigned int numPoolMisses;
+};
+
+// the manager's counts are reset along with its other stats, so don't report a negative count.
+static double countSince(unsigned int count, unsigned int countBefore)
+{
+    return count>=countBefore ? static_cast<double>(count-countBefore) : 0.0;
+}
+
+static void recordBufferObjectStats(unsigned int frameNumber, osg::Stats* stats, osg::GLBufferObjectManager* bom, const BufferObjectCounts& countsBeforeDraw)
+{
+    stats->setAttribute(frameNumber, "Buffer object streaming stalls", countSince(bom->getNumberStreamingStalls(), countsBeforeDraw.numStreamingStalls));
+    stats->setAttribute(frameNumber, "Buffer object pool hits", countSince(bom->getNumberPoolHits(), countsBeforeDraw.numPoolHits));
+    stats->setAttribute(frameNumber, "Buffer object pool misses", countSince(bom->getNumberPoolMisses(), countsBeforeDraw.numPoolMisses));
+    stats->setAttribute(frameNumber, "Buffer object pool KB wasted", static_cast<double>(bom->computeNumBytesWasted()/1024));
+}
+
+static void recordGLMemoryBudgetStats(unsigned int frameNumber, osg::Stats* stats, unsigned int contextID)
+{
+    osg::GLMemoryBudget* budget = osg::GLMemoryBudget::getGLMemoryBudget(contextID).get();
+    stats->setAttribute(frameNumber, "GL memory KB resident", static_cast<double>(budget->computeNumBytesResident()/1024));
+    stats->setAttribute(frameNumber, "GL memory KB evicted", static_cast<double>(budget->getNumBytesEvicted()/1024));
+}
+
 void Renderer::cull()
 {
     DEBUG_MESSAGE<<"cull()"<<std::endl;
@@ -734,6 +769,9 @@ void Renderer::draw()
             _querySupport->beginQuery(frameNumber, state);
         }
 
+        osg::GLBufferObjectManager* bom = osg::GLBufferObjectManager::getGLBufferObjectManager(state->getContextID()).get();
+        BufferObjectCounts bufferObjectCountsBeforeDraw(bom);
+
         osg::Timer_t beforeDrawTick;
 
 
@@ -769,6 +807,8 @@ void Renderer::draw()
             stats->setAttribute(frameNumber, "Draw traversal begin time", osg::Timer::instance()->delta_s(_startTick, beforeDrawTick));
             stats->setAttribute(frameNumber, "Draw traversal end time", osg::Timer::instance()->delta_s(_startTick, afterDrawTick));
             stats->setAttribute(frameNumber, "Draw traversal time taken", osg::Timer::instance()->delta_s(beforeDrawTick, afterDrawTick));
+            recordBufferObjectStats(frameNumber, stats, bom, bufferObjectCountsBeforeDraw);
+            recordGLMemoryBudgetStats(frameNumber, stats, state->getContextID());
         }
 
         sceneView->clearReferencesToDependentCameras();
@@ -849,6 +889,9 @@ void Renderer::cull_draw()
         _querySupport->beginQuery(frameNumber, state);
     }
 
+    osg::GLBufferObjectManager* bom = osg::GLBufferObjectManager::getGLBufferObjectManager(state->getContextID()).get();
+    BufferObjectCounts bufferObjectCountsBeforeDraw(bom);
+
     osg::Timer_t beforeDrawTick;
 
     if (_serializeDraw)
@@ -883,6 +926,8 @@ void Renderer::cull_draw()
         stats->setAttribute(frameNumber, "Draw traversal begin time", osg::Timer::instance()->delta_s(_startTick, beforeDrawTick));
         stats->setAttribute(frameNumber, "Draw traversal end time", osg::Timer::instance()->delta_s(_startTick, afterDrawTick));
         stats->setAttribute(frameNumber, "Draw traversal time taken", osg::Timer::instance()->delta_s(beforeDrawTick, afterDrawTick));
+        recordBufferObjectStats(frameNumber, stats, bom, bufferObjectCountsBeforeDraw);
+        recordGLMemoryBudgetStats(frameNumber, stats, state->getContextID());
     }
 
     DEBUG_MESSAGE<<"end cull_draw() "<<this<<std::endl;
@@ -522,6 +522,13 @@ struct CameraSceneStatsTextDrawCallback : public virtual osg::Drawable::DrawCall
                 STATS_ATTRIBUTE("Visible number of GL_QUAD_STRIP")
                 STATS_ATTRIBUTE("Visible number of GL_POLYGON")
 
+                STATS_ATTRIBUTE("Buffer object streaming stalls")
+                STATS_ATTRIBUTE("Buffer object pool hits")
+                STATS_ATTRIBUTE("Buffer object pool misses")
+                STATS_ATTRIBUTE("Buffer object pool KB wasted")
+                STATS_ATTRIBUTE("GL memory KB resident")
+                STATS_ATTRIBUTE("GL memory KB evicted")
+
                 text->setText(viewStr.str());
             }
         }
@@ -942,6 +949,7 @@ struct PagerCallback : public virtual osg::NodeCallback
                     osgText::Text* averageValue,
                     osgText::Text* filerequestlist,
                     osgText::Text* compilelist,
+                    osgText::Text* kdTreeValue,
                     double multiplier):
         _dp(dp),
         _minValue(minValue),
@@ -949,6 +957,7 @@ struct PagerCallback : public virtual osg::NodeCallback
         _averageValue(averageValue),
         _filerequestlist(filerequestlist),
         _compilelist(compilelist),
+        _kdTreeValue(kdTreeValue),
         _multiplier(multiplier)
     {
     }
@@ -997,6 +1006,16 @@ struct PagerCallback : public virtual osg::NodeCallback
 
             sprintf(tmpText,"%4d", _dp->getDataToCompileListSize());
             _compilelist->setText(tmpText);
+
+            if (_dp->getNumKdTreeBuilds()>0)
+            {
+                sprintf(tmpText,"%4.0f",_dp->getAverageTimeToBuildKdTrees() * _multiplier);
+                _kdTreeValue->setText(tmpText);
+            }
+            else
+            {
+                _kdTreeValue->setText("");
+            }
         }
 
         traverse(node,nv);
@@ -1009,6 +1028,7 @@ struct PagerCallback : public virtual osg::NodeCallback
     osg::ref_ptr<osgText::Text> _averageValue;
     osg::ref_ptr<osgText::Text> _filerequestlist;
     osg::ref_ptr<osgText::Text> _compilelist;
+    osg::ref_ptr<osgText::Text> _kdTreeValue;
     double                      _multiplier;
 };
 
@@ -1447,9 +1467,31 @@ void StatsHandler::setUpScene(osgViewer::ViewerBase* viewer)
                 compileList->setPosition(pos);
                 compileList->setText("0");
 
+                pos.x() = compileList->getBound().xMax() + 2.0f*_characterSize;
+
+                osg::ref_ptr<osgText::Text> kdTreeLabel = new osgText::Text;
+                _statsGeode->addDrawable( kdTreeLabel.get() );
+
+                kdTreeLabel->setColor(colorDP);
+                kdTreeLabel->setFont(_font);
+                kdTreeLabel->setCharacterSize(_characterSize);
+                kdTreeLabel->setPosition(pos);
+                kdTreeLabel->setText("kdtrees: ");
+
+                pos.x() = kdTreeLabel->getBound().xMax();
+
+                osg::ref_ptr<osgText::Text> kdTreeValue = new osgText::Text;
+                _statsGeode->addDrawable( kdTreeValue.get() );
+
+                kdTreeValue->setColor(colorDP);
+                kdTreeValue->setFont(_font);
+                kdTreeValue->setCharacterSize(_characterSize);
+                kdTreeValue->setPosition(pos);
+                kdTreeValue->setText("");
+
                 pos.x() = maxLabel->getBound().xMax();
 
-                _statsGeode->setCullCallback(new PagerCallback(dp, minValue.get(), maxValue.get(), averageValue.get(), requestList.get(), compileList.get(), 1000.0));
+                _statsGeode->setCullCallback(new PagerCallback(dp, minValue.get(), maxValue.get(), averageValue.get(), requestList.get(), compileList.get(), kdTreeValue.get(), 1000.0));
             }
 
             pos.x() = _leftPos;
@@ -1469,7 +1511,7 @@ void StatsHandler::setUpScene(osgViewer::ViewerBase* viewer)
         group->addChild(geode);
         geode->addDrawable(createBackgroundRectangle(pos + osg::Vec3(-backgroundMargin, _characterSize + backgroundMargin, 0),
                                                         10 * _characterSize + 2 * backgroundMargin,
-                                                        22 * _characterSize + 2 * backgroundMargin,
+                                                        28 * _characterSize + 2 * backgroundMargin,
                                                         backgroundColor));
 
         // Camera scene & primitive stats static text
@@ -1506,6 +1548,12 @@ void StatsHandler::setUpScene(osgViewer::ViewerBase* viewer)
         viewStr << "Quads" << std::endl;
         viewStr << "Quad strips" << std::endl;
         viewStr << "Polygons" << std::endl;
+        viewStr << "Stream stalls" << std::endl;
+        viewStr << "Pool hits" << std::endl;
+        viewStr << "Pool misses" << std::endl;
+        viewStr << "Pool waste KB" << std::endl;
+        viewStr << "GL mem KB" << std::endl;
+        viewStr << "Evicted KB" << std::endl;
         viewStr.setf(std::ios::right,std::ios::adjustfield);
         camStaticText->setText(viewStr.str());
 
@@ -1518,7 +1566,7 @@ void StatsHandler::setUpScene(osgViewer::ViewerBase* viewer)
         {
             geode->addDrawable(createBackgroundRectangle(pos + osg::Vec3(-backgroundMargin, _characterSize + backgroundMargin, 0),
                                                             5 * _characterSize + 2 * backgroundMargin,
-                                                            22 * _characterSize + 2 * backgroundMargin,
+                                                            28 * _characterSize + 2 * backgroundMargin,
                                                             backgroundColor));
 
             // Camera scene stats
@@ -531,6 +531,7 @@ void Viewer::realize()
 
     unsigned int maxTexturePoolSize = ds->getMaxTexturePoolSize();
     unsigned int maxBufferObjectPoolSize = ds->getMaxBufferObjectPoolSize();
+    unsigned int maxGLMemorySize = ds->getMaxGLMemorySize();
 
     for(Contexts::iterator citr = contexts.begin();
         citr != contexts.end();
@@ -541,6 +542,7 @@ void Viewer::realize()
         // set the pool sizes, 0 the default will result in no GL object pools.
         gc->getState()->setMaxTexturePoolSize(maxTexturePoolSize);
         gc->getState()->setMaxBufferObjectPoolSize(maxBufferObjectPoolSize);
+        gc->getState()->setMaxGLMemorySize(maxGLMemorySize);
 
         gc->realize();
 
@@ -554,9 +556,6 @@ void Viewer::realize()
         }
     }
 
-    // attach contexts to _incrementalCompileOperation if attached.
-    if (_incrementalCompileOperation) _incrementalCompileOperation->assignContexts(contexts);
-
     bool grabFocus = true;
     if (grabFocus)
     {
@@ -599,6 +598,14 @@ void Viewer::realize()
             }
         }
     }
+
+    // attach contexts to _incrementalCompileOperation if attached, which compiles on their compile contexts when there are any.
+    if (_incrementalCompileOperation)
+    {
+        if (osg::DisplaySettings::instance()->getCompileContextsHint()) _incrementalCompileOperation->setUseCompileContexts(true);
+        _incrementalCompileOperation->assignContexts(contexts);
+    }
+
 #if 0
     osgGA::GUIEventAdapter* eventState = getEventQueue()->getCurrentEventState();
     if (getCamera()->getViewport())